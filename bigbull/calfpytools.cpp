@@ -5,7 +5,13 @@
 #include <map>
 #include <iostream>
 #include <fstream>
+#include <vector>
+#include <algorithm>
+#include <dlfcn.h>
+#include <string.h>
 #include <jack/jack.h>
+#include <calf/giface.h>
+#include <lv2/lv2plug.in/ns/lv2core/lv2.h>
 
 //////////////////////////////////////////////////// PyJackClient
 
@@ -545,6 +551,294 @@ static PyMethodDef jackport_methods[] = {
 };
 
 
+//////////////////////////////////////////////////// PyCalfPlugin
+
+struct PyCalfPlugin
+{
+    PyObject_HEAD
+    void *library;
+    const LV2_Descriptor *descriptor;
+    LV2_Handle handle;
+    calf_plugins::plugin_ctl_iface *pci;
+    const calf_plugins::plugin_metadata_iface *metadata;
+    std::vector<float> *params;
+    /// set while process runs without the GIL, so that it isn't re-entered from another thread
+    bool busy;
+};
+
+static PyTypeObject calfplugin_type = {
+    PyObject_HEAD_INIT(NULL)
+    0,                         /*ob_size*/
+    "calfpytools.Plugin",      /*tp_name*/
+    sizeof(PyCalfPlugin),      /*tp_basicsize*/
+};
+
+/// Same as LV2_Calf_Descriptor in lv2wrap.h
+struct CalfPluginExtension
+{
+    calf_plugins::plugin_ctl_iface *(*get_pci)(LV2_Handle Instance);
+};
+
+/// Number of samples passed to a single LV2 run call
+enum { PROCESS_CHUNK = 8192 };
+
+static int calfplugin_init(PyCalfPlugin *self, PyObject *args, PyObject *kwds)
+{
+    const char *library_name = NULL, *uri = NULL;
+    double sample_rate = 44100;
+    if (!PyArg_ParseTuple(args, "ss|d:__init__", &library_name, &uri, &sample_rate))
+        return -1;
+    self->library = dlopen(library_name, RTLD_NOW | RTLD_LOCAL);
+    if (!self->library)
+    {
+        PyErr_SetString(PyExc_IOError, dlerror());
+        return -1;
+    }
+    typedef const LV2_Descriptor *(*descriptor_function)(uint32_t index);
+    descriptor_function get_descriptor = (descriptor_function)dlsym(self->library, "lv2_descriptor");
+    for (uint32_t i = 0; get_descriptor && (self->descriptor = get_descriptor(i)) != NULL; i++)
+    {
+        if (!strcmp(self->descriptor->URI, uri))
+            break;
+    }
+    if (!self->descriptor)
+    {
+        PyErr_Format(PyExc_ValueError, "Plugin %s not found in %s", uri, library_name);
+        return -1;
+    }
+    const CalfPluginExtension *ext = (const CalfPluginExtension *)self->descriptor->extension_data("http://foltman.com/ns/calf-plugin-instance");
+    if (!ext)
+    {
+        PyErr_SetString(PyExc_ValueError, "Not a Calf plugin");
+        self->descriptor = NULL;
+        return -1;
+    }
+    static const LV2_Feature *const no_features[] = { NULL };
+    self->handle = self->descriptor->instantiate(self->descriptor, sample_rate, "", no_features);
+    if (!self->handle)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Cannot instantiate the plugin");
+        return -1;
+    }
+    self->pci = ext->get_pci(self->handle);
+    self->metadata = self->pci->get_metadata_iface();
+    int param_count = self->metadata->get_param_count();
+    self->params = new std::vector<float>(param_count);
+    uint32_t first_param = self->metadata->get_input_count() + self->metadata->get_output_count();
+    for (int i = 0; i < param_count; i++)
+    {
+        (*self->params)[i] = self->metadata->get_param_props(i)->def_value;
+        self->descriptor->connect_port(self->handle, first_param + i, &(*self->params)[i]);
+    }
+    self->descriptor->activate(self->handle);
+    return 0;
+}
+
+static void calfplugin_dealloc(PyCalfPlugin *self)
+{
+    if (self->handle)
+    {
+        self->descriptor->deactivate(self->handle);
+        self->descriptor->cleanup(self->handle);
+    }
+    delete self->params;
+    if (self->library)
+        dlclose(self->library);
+    self->ob_type->tp_free((PyObject *)self);
+}
+
+#define CHECK_PLUGIN if (!self->handle) { PyErr_SetString(PyExc_ValueError, "The plugin is not instantiated"); return NULL; }
+
+static int calfplugin_find_param(PyCalfPlugin *self, PyObject *param)
+{
+    int count = self->metadata->get_param_count();
+    if (PyInt_Check(param))
+    {
+        long index = PyInt_AsLong(param);
+        if (index >= 0 && index < count)
+            return index;
+    }
+    else if (PyString_Check(param))
+    {
+        const char *name = PyString_AsString(param);
+        for (int i = 0; i < count; i++)
+        {
+            if (!strcmp(self->metadata->get_param_props(i)->short_name, name))
+                return i;
+        }
+    }
+    PyErr_SetString(PyExc_KeyError, "No such parameter");
+    return -1;
+}
+
+static PyObject *calfplugin_get_port_counts(PyCalfPlugin *self, PyObject *args)
+{
+    if (!PyArg_ParseTuple(args, ":get_port_counts"))
+        return NULL;
+    CHECK_PLUGIN
+    return Py_BuildValue("iii", self->metadata->get_input_count(), self->metadata->get_output_count(), self->metadata->get_param_count());
+}
+
+static PyObject *calfplugin_get_memory_footprint(PyCalfPlugin *self, PyObject *args)
+{
+    if (!PyArg_ParseTuple(args, ":get_memory_footprint"))
+        return NULL;
+    CHECK_PLUGIN
+    return PyInt_FromLong(self->pci->get_memory_footprint());
+}
+
+static PyObject *calfplugin_get_param_names(PyCalfPlugin *self, PyObject *args)
+{
+    if (!PyArg_ParseTuple(args, ":get_param_names"))
+        return NULL;
+    CHECK_PLUGIN
+    PyObject *res = PyList_New(0);
+    for (int i = 0; i < self->metadata->get_param_count(); i++)
+        PyList_Append(res, PyString_FromString(self->metadata->get_param_props(i)->short_name));
+    return res;
+}
+
+static PyObject *calfplugin_get_param(PyCalfPlugin *self, PyObject *args)
+{
+    PyObject *param = NULL;
+    if (!PyArg_ParseTuple(args, "O:get_param", &param))
+        return NULL;
+    CHECK_PLUGIN
+    int index = calfplugin_find_param(self, param);
+    if (index == -1)
+        return NULL;
+    return PyFloat_FromDouble((*self->params)[index]);
+}
+
+static PyObject *calfplugin_set_param(PyCalfPlugin *self, PyObject *args)
+{
+    PyObject *param = NULL;
+    float value = 0;
+    if (!PyArg_ParseTuple(args, "Of:set_param", &param, &value))
+        return NULL;
+    CHECK_PLUGIN
+    int index = calfplugin_find_param(self, param);
+    if (index == -1)
+        return NULL;
+    (*self->params)[index] = value;
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+/// Get buffers of float32 samples from a sequence of objects supporting the buffer protocol
+static bool calfplugin_get_buffers(PyObject *seq, int count, bool writable, std::vector<Py_buffer> &views, Py_ssize_t &length)
+{
+    if (!PySequence_Check(seq) || PySequence_Size(seq) != count)
+    {
+        PyErr_Format(PyExc_ValueError, "Expected a sequence of %d buffers", count);
+        return false;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        PyObject *item = PySequence_GetItem(seq, i);
+        if (!item)
+            return false;
+        Py_buffer view;
+        int res = PyObject_GetBuffer(item, &view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT | (writable ? PyBUF_WRITABLE : 0));
+        Py_DECREF(item);
+        if (res < 0)
+            return false;
+        views.push_back(view);
+        // float32 arrays, or raw bytes (like bytearrays) holding float32 samples
+        const char *format = view.format ? view.format : "B";
+        bool is_float = view.itemsize == sizeof(float) && (!strcmp(format, "f") || !strcmp(format, "<f") || !strcmp(format, "=f"));
+        bool is_raw = view.itemsize == 1 && (!strcmp(format, "B") || !strcmp(format, "b") || !strcmp(format, "c")) && !(view.len % sizeof(float));
+        if (!is_float && !is_raw)
+        {
+            PyErr_SetString(PyExc_TypeError, "Buffers must contain float32 samples");
+            return false;
+        }
+        Py_ssize_t len = view.len / sizeof(float);
+        if (length != -1 && len != length)
+        {
+            PyErr_SetString(PyExc_ValueError, "All buffers must have the same length");
+            return false;
+        }
+        length = len;
+    }
+    return true;
+}
+
+static PyObject *calfplugin_process(PyCalfPlugin *self, PyObject *args)
+{
+    PyObject *inputs = NULL, *outputs = Py_None;
+    Py_ssize_t length = -1;
+    if (!PyArg_ParseTuple(args, "O|On:process", &inputs, &outputs, &length))
+        return NULL;
+    CHECK_PLUGIN
+    if (self->busy)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "The plugin is already processing in another thread");
+        return NULL;
+    }
+    int in_count = self->metadata->get_input_count(), out_count = self->metadata->get_output_count();
+    std::vector<Py_buffer> in_views, out_views;
+    PyObject *result = NULL;
+    if (calfplugin_get_buffers(inputs, in_count, false, in_views, length))
+    {
+        if (outputs == Py_None)
+        {
+            // no output buffers given - allocate them as bytearrays (numpy.frombuffer(x, numpy.float32) uses them as they are)
+            if (length == -1)
+                PyErr_SetString(PyExc_ValueError, "The length must be given for plugins without inputs");
+            else
+            {
+                outputs = PyList_New(out_count);
+                for (int i = 0; i < out_count; i++)
+                    PyList_SET_ITEM(outputs, i, PyByteArray_FromStringAndSize(NULL, length * sizeof(float)));
+                result = outputs;
+            }
+        }
+        else
+        {
+            Py_INCREF(Py_None);
+            result = Py_None;
+        }
+        if (result && !calfplugin_get_buffers(outputs, out_count, true, out_views, length))
+        {
+            Py_DECREF(result);
+            result = NULL;
+        }
+    }
+    if (result)
+    {
+        self->busy = true;
+        Py_BEGIN_ALLOW_THREADS
+        // the buffers are connected directly, chunk by chunk, and stay locked by the views
+        for (Py_ssize_t pos = 0; pos < length; pos += PROCESS_CHUNK)
+        {
+            uint32_t len = (uint32_t)std::min<Py_ssize_t>(length - pos, PROCESS_CHUNK);
+            for (int i = 0; i < in_count; i++)
+                self->descriptor->connect_port(self->handle, i, (float *)in_views[i].buf + pos);
+            for (int i = 0; i < out_count; i++)
+                self->descriptor->connect_port(self->handle, in_count + i, (float *)out_views[i].buf + pos);
+            self->descriptor->run(self->handle, len);
+        }
+        Py_END_ALLOW_THREADS
+        self->busy = false;
+    }
+    for (size_t i = 0; i < in_views.size(); i++)
+        PyBuffer_Release(&in_views[i]);
+    for (size_t i = 0; i < out_views.size(); i++)
+        PyBuffer_Release(&out_views[i]);
+    return result;
+}
+
+static PyMethodDef calfplugin_methods[] = {
+    {"get_port_counts", (PyCFunction)calfplugin_get_port_counts, METH_VARARGS, "Retrieve the numbers of audio inputs, audio outputs and parameters"},
+    {"get_param_names", (PyCFunction)calfplugin_get_param_names, METH_VARARGS, "Retrieve a list of parameter short names"},
+    {"get_memory_footprint", (PyCFunction)calfplugin_get_memory_footprint, METH_VARARGS, "Retrieve the number of bytes used by the plugin instance (object and DSP buffers)"},
+    {"get_param", (PyCFunction)calfplugin_get_param, METH_VARARGS, "Get parameter value (by index or short name)"},
+    {"set_param", (PyCFunction)calfplugin_set_param, METH_VARARGS, "Set parameter value (by index or short name)"},
+    {"process", (PyCFunction)calfplugin_process, METH_VARARGS, "Process a sequence of float32 input buffers (like NumPy arrays) into a sequence of writable output buffers, in place and with the GIL released; without the output buffers, new bytearrays are returned (length is needed only for plugins without inputs when no output buffers are given)"},
+    {NULL, NULL, 0, NULL}
+};
+
 //////////////////////////////////////////////////// calfpytools
 
 static PyObject *calfpytools_scan_ttl_file(PyObject *self, PyObject *args)
@@ -598,12 +892,23 @@ PyMODINIT_FUNC initcalfpytools()
     jackport_type.tp_repr = (reprfunc)jackport_repr;
     if (PyType_Ready(&jackport_type) < 0)
         return;
+
+    calfplugin_type.tp_new = PyType_GenericNew;
+    calfplugin_type.tp_flags = Py_TPFLAGS_DEFAULT;
+    calfplugin_type.tp_doc = "Calf plugin instance (Plugin(library, uri, sample_rate)) for offline processing";
+    calfplugin_type.tp_methods = calfplugin_methods;
+    calfplugin_type.tp_init = (initproc)calfplugin_init;
+    calfplugin_type.tp_dealloc = (destructor)calfplugin_dealloc;
+    if (PyType_Ready(&calfplugin_type) < 0)
+        return;
     
     PyObject *mod = Py_InitModule3("calfpytools", module_methods, "Python utilities for Calf");
     Py_INCREF(&jackclient_type);
     Py_INCREF(&jackport_type);
+    Py_INCREF(&calfplugin_type);
     PyModule_AddObject(mod, "JackClient", (PyObject *)&jackclient_type);
     PyModule_AddObject(mod, "JackPort", (PyObject *)&jackport_type);
+    PyModule_AddObject(mod, "Plugin", (PyObject *)&calfplugin_type);
     
     PyModule_AddObject(mod, "JackPortIsInput", PyInt_FromLong(JackPortIsInput));
     PyModule_AddObject(mod, "JackPortIsOutput", PyInt_FromLong(JackPortIsOutput));
@@ -2,7 +2,8 @@
 from distutils.core import setup, Extension
 
 module1 = Extension('calfpytools',
-                    libraries = ['jack'],
+                    libraries = ['jack', 'dl'],
+                    include_dirs = ['..', '../src'],
                     sources = ['calfpytools.cpp', 'ttl.cpp'],
                     extra_compile_args = ["-g"],
                     extra_link_args = ["-g"]
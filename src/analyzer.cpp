@@ -35,7 +35,7 @@ using namespace calf_plugins;
 #define sinc(x) (x == 0) ? 1 : sin(M_PI * x)/(M_PI * x);
 #define RGBAtoINT(r, g, b, a) ((uint32_t)(r * 255) << 24) + ((uint32_t)(g * 255) << 16) + ((uint32_t)(b * 255) << 8) + (uint32_t)(a * 255)
 
-analyzer::analyzer() {
+analyzer::analyzer(dsp::memory_arena &arena) {
     _accuracy       = -1;
     _acc            = -1;
     _scale          = -1;
@@ -54,46 +54,29 @@ analyzer::analyzer() {
     sanitize        = true;
     recreate_plan   = true;
     
-    spline_buffer = (int*) calloc(200, sizeof(int));
+    spline_buffer = arena.alloc<int>(200);
     
-    fft_buffer = (float*) calloc(max_fft_buffer_size, sizeof(float));
+    fft_buffer = arena.alloc<float>(max_fft_buffer_size);
     
-    fft_inL = (float*) calloc(max_fft_cache_size, sizeof(float));
-    fft_outL = (float*) calloc(max_fft_cache_size, sizeof(float));
-    fft_inR = (float*) calloc(max_fft_cache_size, sizeof(float));
-    fft_outR = (float*) calloc(max_fft_cache_size, sizeof(float));
+    fft_inL = arena.alloc<float>(max_fft_cache_size);
+    fft_outL = arena.alloc<float>(max_fft_cache_size);
+    fft_inR = arena.alloc<float>(max_fft_cache_size);
+    fft_outR = arena.alloc<float>(max_fft_cache_size);
     
-    fft_smoothL = (float*) calloc(max_fft_cache_size, sizeof(float));
-    fft_smoothR = (float*) calloc(max_fft_cache_size, sizeof(float));
+    fft_smoothL = arena.alloc<float>(max_fft_cache_size);
+    fft_smoothR = arena.alloc<float>(max_fft_cache_size);
     
-    fft_deltaL = (float*) calloc(max_fft_cache_size, sizeof(float));
-    fft_deltaR = (float*) calloc(max_fft_cache_size, sizeof(float));
+    fft_deltaL = arena.alloc<float>(max_fft_cache_size);
+    fft_deltaR = arena.alloc<float>(max_fft_cache_size);
     
-    fft_holdL = (float*) calloc(max_fft_cache_size, sizeof(float));
-    fft_holdR = (float*) calloc(max_fft_cache_size, sizeof(float));
+    fft_holdL = arena.alloc<float>(max_fft_cache_size);
+    fft_holdR = arena.alloc<float>(max_fft_cache_size);
     
-    fft_freezeL = (float*) calloc(max_fft_cache_size, sizeof(float));
-    fft_freezeR = (float*) calloc(max_fft_cache_size, sizeof(float));
+    fft_freezeL = arena.alloc<float>(max_fft_cache_size);
+    fft_freezeR = arena.alloc<float>(max_fft_cache_size);
     
     analyzer_phase_drawn = 0;
 }
-analyzer::~analyzer()
-{
-    free(fft_freezeR);
-    free(fft_freezeL);
-    free(fft_holdR);
-    free(fft_holdL);
-    free(fft_deltaR);
-    free(fft_deltaL);
-    free(fft_smoothR);
-    free(fft_smoothL);
-    free(fft_outR);
-    free(fft_outL);
-    free(fft_inR);
-    free(fft_inL);
-    free(fft_buffer);
-    free(spline_buffer);
-}
 void analyzer::set_sample_rate(uint32_t sr) {
     srate = sr;
 }
@@ -934,9 +917,9 @@ bool analyzer::get_gridline(int subindex, int phase, float &pos, bool &vertical,
             if ((!(subindex & 1) && !_draw_upper)
               || ((sub & 1) && _draw_upper > 0)) {
                 // add a label and make the lines straight
-                std::stringstream ss;
-                ss << (subindex - std::max(0, _draw_upper)) * -6 << " dB";
-                legend = ss.str();
+                char buf[16];
+                snprintf(buf, sizeof(buf), "%d dB", (subindex - std::max(0, _draw_upper)) * -6);
+                legend = buf;
                 context->set_dash(dash, 0);
             }
         
@@ -974,9 +957,9 @@ bool analyzer::get_gridline(int subindex, int phase, float &pos, bool &vertical,
             context->set_dash(dash, 1);
             if ((!(subindex & 1) && !_draw_upper)
               || ((subindex & 1) && _draw_upper)) {
-                std::stringstream ss;
-                ss << (subindex - std::max(0, _draw_upper)) * 6 - 72 << " dB";
-                legend = ss.str();
+                char buf[16];
+                snprintf(buf, sizeof(buf), "%d dB", (subindex - std::max(0, _draw_upper)) * 6 - 72);
+                legend = buf;
                 context->set_dash(dash, 0);
             }
             
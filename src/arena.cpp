@@ -0,0 +1,87 @@
+/* Calf DSP Library
+ * Per-instance memory arena.
+ *
+ * Copyright (C) 2001-2010 Krzysztof Foltman, Markus Schmidt, Thor Harald Johansen and others
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <calf/arena.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace dsp;
+
+memory_arena::~memory_arena()
+{
+    for (size_t i = 0; i < blocks.size(); i++)
+        munmap(blocks[i].data, blocks[i].size);
+}
+
+char *memory_arena::map_block(size_t bytes)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    bytes = (bytes + page - 1) & ~(page - 1);
+    // anonymous mappings come zeroed and page aligned, and go back to the system when unmapped
+    void *data = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED)
+        return NULL;
+    if (locked)
+        mlock(data, bytes);
+    block b = { (char *)data, bytes };
+    blocks.push_back(b);
+    size += bytes;
+    return (char *)data;
+}
+
+void *memory_arena::allocate(size_t bytes)
+{
+    bytes = (bytes + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1);
+    size_t total = bytes + ALIGNMENT;
+    char *header;
+    if (total > LARGE_SIZE)
+        header = map_block(total);
+    else
+    {
+        if ((size_t)(end - pos) < total)
+        {
+            pos = map_block(BLOCK_SIZE);
+            end = pos ? pos + blocks.back().size : NULL;
+        }
+        header = pos;
+        if (pos)
+            pos += total;
+    }
+    if (!header)
+        return NULL;
+    char *result = header + ALIGNMENT;
+    ((size_t *)result)[-1] = bytes;
+    return result;
+}
+
+bool memory_arena::lock()
+{
+    locked = true;
+    bool ok = true;
+    for (size_t i = 0; i < blocks.size(); i++)
+        ok = !mlock(blocks[i].data, blocks[i].size) && ok;
+    return ok;
+}
+
+bool memory_arena::lock_range(const void *data, size_t bytes)
+{
+    return !bytes || !mlock(data, bytes);
+}
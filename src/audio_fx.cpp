@@ -365,6 +365,160 @@ void reverb::process(float &left, float &right)
     left = out_left, right = out_right;
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Prime delay lengths (in samples at 44.1 kHz), spread exponentially
+static const int fdn_lengths[fdn_reverb::LINES] = { 521, 571, 631, 691, 757, 829, 911, 997, 1097, 1213, 1319, 1447, 1597, 1747, 1913, 2111 };
+
+fdn_reverb::fdn_reverb()
+{
+    type = 2;
+    time = 1.0;
+    cutoff = 9000;
+    diffusion = 1.f;
+    sr = 0;
+    for (int i = 0; i < LINES; i++)
+    {
+        // even lines get the left input, odd lines the right one; the output
+        // taps use two different sign patterns to decorrelate the channels
+        in_sign[i] = (i & 2) ? -1.f : 1.f;
+        out_left[i] = (i & 1) ? 0.f : ((i & 4) ? -1.f : 1.f);
+        out_right[i] = (i & 1) ? ((i & 8) ? -1.f : 1.f) : 0.f;
+        lfo_phase[i] = 2 * M_PI * i / LINES;
+    }
+    setup(44100);
+}
+
+void fdn_reverb::setup(int sample_rate)
+{
+    sr = sample_rate;
+    float scale = sr / 44100.0;
+    mod_depth = 12 * scale;
+    // the longest line in the largest room, plus modulation and interpolation
+    uint32_t size = 1;
+    while(size < fdn_lengths[LINES - 1] * 1.3 * scale + mod_depth + BLOCK + 2)
+        size <<= 1;
+    mask = size - 1;
+    buffer.resize(LINES * size);
+    set_cutoff(cutoff);
+    update_lines();
+    reset();
+}
+
+void fdn_reverb::set_cutoff(float cutoff)
+{
+    this->cutoff = cutoff;
+    damp = 1 - exp(-2 * M_PI * cutoff / sr);
+}
+
+void fdn_reverb::set_type_and_diffusion(int type, float diffusion)
+{
+    this->type = type;
+    this->diffusion = diffusion;
+    update_lines();
+}
+
+void fdn_reverb::update_lines()
+{
+    // room size: overall scaling, and the spread of the delay lengths around the center (small spread = tunnel-like resonance)
+    static const float room_scale[] = { 0.5, 0.75, 1.0, 1.2, 1.1, 0.6 };
+    static const float room_spread[] = { 1.0, 1.0, 1.0, 0.15, 0.7, 1.4 };
+    int t = std::max(0, std::min(type, 5));
+    float center = 1050, scale = sr / 44100.0;
+    float shortest = BLOCK;
+    for (int i = 0; i < LINES; i++)
+    {
+        delay[i] = center * pow(fdn_lengths[i] / center, room_spread[t]) * room_scale[t] * scale;
+        // decay of 60 dB over the reverb time
+        gain[i] = pow(10.0, -3.0 * delay[i] / (time * sr));
+        shortest = std::min(shortest, delay[i] - mod_depth);
+    }
+    // a block must not read samples that are written in the same block
+    block = std::max(1, (int)shortest);
+    // the LFOs advance once per block
+    for (int i = 0; i < LINES; i++)
+        lfo_step[i] = 2 * M_PI * (0.2 + 0.4 * i / LINES) * block / sr;
+    // Householder reflection scaled between 1 and 2: 2 is lossless and mixes all lines evenly,
+    // 1 leaves more of each line's own signal (less dense)
+    mix = (1 + diffusion) / LINES;
+}
+
+void fdn_reverb::reset()
+{
+    std::fill(buffer.begin(), buffer.end(), 0.f);
+    for (int i = 0; i < LINES; i++)
+        lp[i] = 0.f;
+    pos = 0;
+}
+
+void fdn_reverb::process(float *left, float *right, uint32_t len)
+{
+    const uint32_t size = mask + 1;
+    // 8 lines go to each output; the output gain matches the loudness of the classic algorithm
+    const float in_gain = 0.25f, out_gain = 1.41421f;
+    while(len)
+    {
+        uint32_t count = std::min<uint32_t>(len, block);
+        // read the delay outputs for the whole block, the delays are longer than the block
+        for (int i = 0; i < LINES; i++)
+        {
+            float d = delay[i] + mod_depth * sin(lfo_phase[i]);
+            lfo_phase[i] += lfo_step[i];
+            if (lfo_phase[i] > 2 * M_PI)
+                lfo_phase[i] -= 2 * M_PI;
+            int di = (int)d;
+            float frac = d - di;
+            const float *line = &buffer[i * size];
+            uint32_t start = (pos - di) & mask;
+            if (start >= 1 && start + count <= size)
+            {
+                // the usual case - no wraparound, contiguous reads
+                const float *src = line + start, *prev = src - 1;
+                for (uint32_t t = 0; t < count; t++)
+                    taps[t][i] = src[t] + frac * (prev[t] - src[t]);
+            }
+            else
+            {
+                for (uint32_t t = 0; t < count; t++)
+                {
+                    uint32_t rpos = (start + t) & mask;
+                    taps[t][i] = line[rpos] + frac * (line[(rpos - 1) & mask] - line[rpos]);
+                }
+            }
+        }
+        for (uint32_t t = 0; t < count; t++)
+        {
+            float *tap = taps[t], *fb = feedback[t];
+            float sum = 0.f, outL = 0.f, outR = 0.f;
+            for (int i = 0; i < LINES; i++)
+            {
+                lp[i] += damp * (tap[i] - lp[i]);
+                float v = lp[i] * gain[i];
+                tap[i] = v;
+                sum += v;
+                outL += v * out_left[i];
+                outR += v * out_right[i];
+            }
+            float in_l = left[t] * in_gain, in_r = right[t] * in_gain;
+            sum *= mix;
+            for (int i = 0; i < LINES; i++)
+                fb[i] = tap[i] - sum + in_sign[i] * ((i & 1) ? in_r : in_l);
+            left[t] = outL * out_gain;
+            right[t] = outR * out_gain;
+        }
+        for (int i = 0; i < LINES; i++)
+        {
+            float *line = &buffer[i * size];
+            for (uint32_t t = 0; t < count; t++)
+                line[(pos + t) & mask] = feedback[t][i];
+        }
+        pos = (pos + count) & mask;
+        left += count;
+        right += count;
+        len -= count;
+    }
+}
+
 /// Distortion Module by Tom Szilagyi
 ///
 /// This module provides a blendable saturation stage
@@ -615,12 +769,6 @@ lookahead_limiter::lookahead_limiter() {
     nextpos = NULL;
     nextdelta = NULL;
 }
-lookahead_limiter::~lookahead_limiter()
-{
-    free(buffer);
-    free(nextpos);
-    free(nextdelta);
-}
 
 void lookahead_limiter::activate()
 {
@@ -643,21 +791,17 @@ float lookahead_limiter::get_attenuation()
     return a;
 }
 
-void lookahead_limiter::set_sample_rate(uint32_t sr)
+void lookahead_limiter::set_sample_rate(uint32_t sr, memory_arena &arena)
 {
     srate = sr;
     
-    free(buffer);
-    free(nextpos);
-    free(nextdelta);
-    
     // rebuild buffer
     overall_buffer_size = (int)(srate * (100.f / 1000.f) * channels) + channels; // buffer size attack rate multiplied by 2 channels
-    buffer = (float*) calloc(overall_buffer_size, sizeof(float));
+    buffer = arena.realloc(buffer, overall_buffer_size);
     pos = 0;
 
-    nextdelta = (float*) calloc(overall_buffer_size, sizeof(float));
-    nextpos = (int*) malloc(overall_buffer_size * sizeof(int));
+    nextdelta = arena.realloc(nextdelta, overall_buffer_size);
+    nextpos = arena.realloc(nextpos, overall_buffer_size);
     memset(nextpos, -1, overall_buffer_size * sizeof(int));
     
     reset();
@@ -64,13 +64,13 @@ public:
     using frequency_response_line_graph::get_layers;
 
     uint32_t srate;
-    analyzer();
+    /// @param arena memory for the FFT buffers (the owner's)
+    analyzer(dsp::memory_arena &arena);
     void process(float L, float R);
     void set_sample_rate(uint32_t sr);
     bool set_mode(int mode);
     void invalidate();
     void set_params(float resolution, float offset, int accuracy, int hold, int smoothing, int mode, int scale, int post, int speed, int windowing, int view, int freeze);
-    ~analyzer();
     bool do_fft(int subindex, int points) const;
     void draw(int subindex, float *data, int points, bool fftdone) const;
     bool get_graph(int subindex, int phase, float *data, int points, cairo_iface *context, int *mode) const;
@@ -0,0 +1,102 @@
+/* Calf DSP Library
+ * Per-instance memory arena.
+ *
+ * Copyright (C) 2001-2010 Krzysztof Foltman, Markus Schmidt, Thor Harald Johansen and others
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02111-1307, USA.
+ */
+#ifndef CALF_ARENA_H
+#define CALF_ARENA_H
+
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+
+namespace dsp {
+
+/// Memory for the DSP buffers of one plugin instance. Buffers are carved out of a few large
+/// mapped blocks, all released when the arena is destroyed, so the footprint of an instance is
+/// known and it can be locked in RAM as a whole. Not real-time safe - allocate when instantiating
+/// or setting the sample rate, never in process.
+class memory_arena
+{
+public:
+    enum {
+        /// Size of the blocks shared by small buffers
+        BLOCK_SIZE = 65536,
+        /// Buffers larger than this get a block of their own
+        LARGE_SIZE = BLOCK_SIZE / 4,
+        /// Alignment of every buffer (a cache line - enough for any SIMD type)
+        ALIGNMENT = 64,
+    };
+    memory_arena() : pos(NULL), end(NULL), size(0), locked(false) {}
+    ~memory_arena();
+    /// @return zeroed memory aligned to ALIGNMENT bytes (preceded by a header of the same size,
+    /// which holds the capacity), NULL if out of memory
+    void *allocate(size_t bytes);
+    /// @return zeroed array of count items
+    template<class T>
+    T *alloc(size_t count) { return (T *)allocate(count * sizeof(T)); }
+    /// Resize a buffer allocated from this arena (or NULL), for buffers that depend on the sample
+    /// rate or the oversampling. The contents are not preserved. If the buffer has room for count
+    /// items, it's cleared and reused; otherwise a new one is allocated and the old one stays reserved
+    /// until the arena is released, so a buffer grown in steps takes the sum of the sizes it grew
+    /// through - allocate the largest size first. Growing may map and lock memory, so do it from
+    /// set_sample_rate and not from the audio thread.
+    /// @return zeroed array of count items
+    template<class T>
+    T *realloc(T *buf, size_t count)
+    {
+        if (buf && get_capacity(buf) >= count * sizeof(T))
+        {
+            memset(buf, 0, count * sizeof(T));
+            return buf;
+        }
+        return alloc<T>(count);
+    }
+    /// @return usable size of a buffer returned by allocate
+    static size_t get_capacity(const void *buf) { return ((const size_t *)buf)[-1]; }
+    /// Lock all the blocks (present and future) in RAM
+    /// @retval false if that's not allowed (see RLIMIT_MEMLOCK)
+    bool lock();
+    /// Lock a range of memory allocated elsewhere in RAM
+    /// @retval false if that's not allowed
+    static bool lock_range(const void *data, size_t bytes);
+    /// @return bytes reserved by the arena
+    size_t get_size() const { return size; }
+    /// @return number of blocks
+    int get_block_count() const { return blocks.size(); }
+
+private:
+    struct block
+    {
+        char *data;
+        size_t size;
+    };
+    std::vector<block> blocks;
+    /// Free part of the current shared block
+    char *pos, *end;
+    size_t size;
+    bool locked;
+
+    char *map_block(size_t bytes);
+    memory_arena(const memory_arena &);
+    memory_arena &operator=(const memory_arena &);
+};
+
+};
+
+#endif
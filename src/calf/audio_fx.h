@@ -28,6 +28,7 @@
 #include "giface.h"
 #include "onepole.h"
 #include <complex>
+#include <vector>
 
 namespace calf_plugins {
     struct cairo_iface;
@@ -436,6 +437,48 @@ public:
     }
 };
 
+/**
+ * Feedback delay network reverb: 16 delay lines with one-pole damping, mixed through a
+ * Householder matrix. All lines are processed together (one SIMD-friendly loop over the
+ * lines per sample), and the delay times are modulated at block rate. Blocks are never
+ * longer than the shortest (modulated) delay - at low sample rates they are shortened to
+ * fit - so the delay line reads for a whole block can be done before the feedback is computed.
+ */
+class fdn_reverb: public audio_effect
+{
+public:
+    enum { LINES = 16, BLOCK = 64 };
+private:
+    /// Delay line memory, LINES lines of (mask + 1) samples each
+    std::vector<float> buffer;
+    uint32_t mask, pos;
+    /// Processing block length, at most BLOCK and at most the shortest delay
+    uint32_t block;
+    /// Delay line outputs and inputs for the current block, [sample][line]
+    float taps[BLOCK][LINES], feedback[BLOCK][LINES];
+    /// Nominal delay lengths (samples), decay gain per line and lowpass state
+    float delay[LINES], gain[LINES], lp[LINES];
+    /// Sign pattern used for injecting the input and for the outputs
+    float in_sign[LINES], out_left[LINES], out_right[LINES];
+    /// LFO phases (radians), updated once per block
+    float lfo_phase[LINES], lfo_step[LINES];
+    float mod_depth, damp, mix;
+    int type;
+    float time, cutoff, diffusion;
+    int sr;
+    void update_lines();
+public:
+    fdn_reverb();
+    virtual void setup(int sample_rate);
+    void set_time(float time) { this->time = time; update_lines(); }
+    void set_cutoff(float cutoff);
+    /// Room size (same meaning as in reverb, it scales the delay lengths) and diffusion (amount of mixing between the lines)
+    void set_type_and_diffusion(int type, float diffusion);
+    void reset();
+    /// Process a block of stereo samples in place (wet signal only)
+    void process(float *left, float *right, uint32_t len);
+};
+
 class filter_module_iface
 {
 public:
@@ -588,20 +631,24 @@ public:
     float asc_coeff;
     bool _asc_used;
     static inline void denormal(volatile float *f) {
+#if !USE_FTZ
         *f += 1e-18;
         *f -= 1e-18;
+#endif
     }
     inline float get_rdelta(float peak, float _limit, float _att, bool _asc = true);
     void reset();
     void reset_asc();
     bool get_asc();
     lookahead_limiter();
-    ~lookahead_limiter();
     void set_multi(bool set);
     void process(float &left, float &right, float *multi_buffer);
-    void set_sample_rate(uint32_t sr);
+    /// @param arena memory for the lookahead buffers (the owner's)
+    void set_sample_rate(uint32_t sr, memory_arena &arena);
     void set_params(float l, float a, float r, float weight = 1.f, bool ar = false, float arc = 1.f, bool d = false);
     float get_attenuation();
+    /// @return lookahead delay in samples, at the rate passed to set_sample_rate
+    int get_latency() const { return buffer_size ? buffer_size / channels - 1 : 0; }
     void activate();
     void deactivate();
 };
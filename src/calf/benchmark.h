@@ -97,15 +97,26 @@ class simple_benchmark: public benchmark_globals
 public:
     Target target;
     Stat &stat;
+    /// Run with flush-to-zero/denormals-are-zero enabled, same as the plugin wrappers do
+    bool flush_denormals;
 
-    simple_benchmark(const Target &_target, Stat &_stat)
+    simple_benchmark(const Target &_target, Stat &_stat, bool _flush_denormals = true)
     : target(_target)
     , stat(_stat)
+    , flush_denormals(_flush_denormals)
+    {
+    }
+    /// Benchmark a default-constructed target (for targets that can't be copied, like plugin modules)
+    simple_benchmark(Stat &_stat, bool _flush_denormals = true)
+    : target()
+    , stat(_stat)
+    , flush_denormals(_flush_denormals)
     {
     }
     
     void measure(int runs, int repeats)
     {
+        dsp::denormal_guard ftz(flush_denormals);
         int priority = getpriority(PRIO_PROCESS, getpid());
         stat.start(runs);
         if (setpriority(PRIO_PROCESS, getpid(), -20) < 0) {
@@ -147,14 +158,14 @@ public:
 };
 
 template<class T>
-void do_simple_benchmark(int runs = 5, int repeats = 50000)
+void do_simple_benchmark(int runs = 5, int repeats = 50000, bool flush_denormals = true)
 {
     dsp::median_stat stat;
-    dsp::simple_benchmark<T, dsp::median_stat> benchmark(T(), stat);
+    dsp::simple_benchmark<T, dsp::median_stat> benchmark(stat, flush_denormals);
     
     benchmark.measure(runs, repeats);
     
-    printf("%-30s: %f/sec, %f/CDsr, value = %f\n", typeid(T).name(), 1.0 / stat.get(), 1.0 / (44100 * stat.get()), benchmark.target.result);
+    printf("%-30s%s: %f/sec, %f/CDsr, value = %f\n", typeid(T).name(), flush_denormals ? "" : " (no FTZ)", 1.0 / stat.get(), 1.0 / (44100 * stat.get()), benchmark.target.result);
 }
 
 
@@ -0,0 +1,82 @@
+/* Calf DSP Library
+ * Zero-latency partitioned convolution.
+ *
+ * Copyright (C) 2001-2010 Krzysztof Foltman, Markus Schmidt, Thor Harald Johansen and others
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02111-1307, USA.
+ */
+#ifndef CALF_CONVOLVER_H
+#define CALF_CONVOLVER_H
+
+#include <stdint.h>
+#include <vector>
+
+namespace dsp {
+
+/// Convolution with a long impulse response, without added latency. The impulse response
+/// is split into non-uniform partitions (Gardner's scheme):
+/// - the first head_size taps are applied directly, sample by sample
+/// - the next taps are applied using uniformly partitioned FFT convolution (overlap-save
+///   with a frequency domain delay line) with a block size of head_size, computed inside process()
+/// - the tail uses the same method with 16x and 128x longer blocks, computed on background
+///   threads (one per stage, at the lowest real-time priority if allowed), which get one whole
+///   block period to deliver the results. If a result is still not ready when process() needs it,
+///   process() waits for it, so the tail stages must keep up with real time.
+/// The cost of process() is therefore small and nearly constant for impulse responses of any length.
+/// Construction (which transforms the impulse response) and destruction are not real-time safe.
+class convolver
+{
+public:
+    enum { MAX_CHANNELS = 2 };
+    /// @param ir            impulse response, one array per channel
+    /// @param ir_channels   number of impulse response channels (1 = the same response for all channels)
+    /// @param ir_length     impulse response length in samples
+    /// @param channels      number of channels processed (1 or 2)
+    /// @param head_size     block size of the first partition (power of 2, at least 32)
+    convolver(const float *const *ir, int ir_channels, uint32_t ir_length, int channels, uint32_t head_size = 64);
+    ~convolver();
+    /// Clear the processing state; waits for the background stages to finish the work in progress
+    void reset();
+    /// Convolve len samples of each channel; in and out may point to the same buffers
+    void process(const float *const *in, float *const *out, uint32_t len);
+    /// @return impulse response length in samples
+    uint32_t get_length() const { return length; }
+    /// @return number of FFT stages (not including the direct head)
+    int get_stage_count() const { return stages.size(); }
+    /// @return number of FFT stages processed on background threads
+    int get_background_stage_count() const;
+
+private:
+    struct stage;
+    friend struct stage;
+
+    int channels;
+    uint32_t length, head;
+    /// Reversed head of the impulse response, [channel][head]
+    std::vector<float> head_taps[MAX_CHANNELS];
+    /// Last 2 * head input samples, [channel][2 * head]
+    std::vector<float> head_history[MAX_CHANNELS];
+    /// Input history for the FFT stages, [channel][in_mask + 1]
+    std::vector<float> input[MAX_CHANNELS];
+    uint32_t in_mask;
+    /// Number of samples processed since the last reset
+    uint64_t time;
+    std::vector<stage *> stages;
+};
+
+};
+
+#endif
@@ -0,0 +1,78 @@
+/* Calf DSP Library
+ * Run-time selection of instruction set specific DSP kernels.
+ *
+ * Copyright (C) 2001-2010 Krzysztof Foltman, Markus Schmidt, Thor Harald Johansen and others
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02111-1307, USA.
+ */
+#ifndef CALF_CPUDISPATCH_H
+#define CALF_CPUDISPATCH_H
+
+#include <stdint.h>
+
+namespace dsp {
+
+/// Instruction set levels the kernels are compiled for. The generic level
+/// uses whatever the library itself was compiled for (SSE2 on x86-64).
+enum cpu_isa
+{
+    cpu_isa_generic,
+    cpu_isa_avx2,
+    cpu_isa_avx512,
+    cpu_isa_count
+};
+
+/// Block kernels used by the DSP code, one set per instruction set level.
+/// None of them require aligned buffers; len can be any value.
+struct dsp_kernels
+{
+    cpu_isa isa;
+    /// dst[i] = a[i] * b[i]
+    void (*mul)(float *dst, const float *a, const float *b, uint32_t len);
+    /// dst[i] += a[i] * b[i]
+    void (*mul_add)(float *dst, const float *a, const float *b, uint32_t len);
+    /// dst[i] *= gain
+    void (*scale)(float *dst, float gain, uint32_t len);
+    /// dst[i] += src[i] * gain
+    void (*axpy)(float *dst, const float *src, float gain, uint32_t len);
+    /// max(|a[i]|)
+    float (*peak)(const float *a, uint32_t len);
+    /// max(|a[i] * w[i]|)
+    float (*peak_mul)(const float *a, const float *w, uint32_t len);
+    /// max(|(a[i] + b[i]) * w[i]|)
+    float (*peak_sum_mul)(const float *a, const float *b, const float *w, uint32_t len);
+    /// Move (x[i] + delta[i]) towards the range [-level * w[i], level * w[i]] by boost times the overshoot (adjusting delta[i])
+    void (*clip_to_limit)(const float *x, float *delta, const float *w, float level, float boost, uint32_t len);
+    /// Scale interleaved complex values so that 2 * |c[i]| does not exceed limit[i]
+    void (*limit_complex)(float *c, const float *limit, uint32_t len);
+};
+
+/// @return the best instruction set level supported by the CPU
+cpu_isa detect_cpu_isa();
+/// @return the instruction set level of the kernels in use, which is the detected one unless
+/// overridden by CALF_FORCE_ISA environment variable (generic, sse2, avx2 or avx512; levels not
+/// supported by the CPU or the compiler fall back to the best available one)
+cpu_isa get_cpu_isa();
+/// @return name of an instruction set level
+const char *get_cpu_isa_name(cpu_isa isa);
+/// @return kernels for a specific instruction set level, NULL if not supported by the CPU or not compiled in
+const dsp_kernels *get_kernels_for(cpu_isa isa);
+/// @return kernels selected for this CPU (determined once, on first use)
+const dsp_kernels &get_kernels();
+
+};
+
+#endif
@@ -0,0 +1,215 @@
+/* Calf DSP Library
+ * Line graph data streamed from the plugin to the GUI.
+ *
+ * Copyright (C) 2001-2010 Krzysztof Foltman, Markus Schmidt, Thor Harald Johansen and others
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02111-1307, USA.
+ */
+#ifndef CALF_DISPLAY_STREAM_H
+#define CALF_DISPLAY_STREAM_H
+
+#include <math.h>
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "giface.h"
+
+namespace calf_plugins {
+
+/// Line graph contents sent by the plugin to a GUI that can't access the plugin instance
+/// (in LV2, as atom:Chunk events on the event ports). The GUI subscribes to each line graph
+/// with its size; the plugin then calls get_layers on the audio thread, at most fps times per
+/// second, and sends the grid lines, graphs and dots of the changed layers, leaving out the
+/// ones that are the same as last sent. A frame message tells the GUI which layers to redraw.
+/// Graph values are sent as 16-bit fixed point. Moving graphs are not supported.
+struct display_stream
+{
+    enum {
+        /// "CDS1" - first word of every message
+        MAGIC = 0x31534443,
+        DEFAULT_FPS = 30,
+        MAX_SUBSCRIPTIONS = 8,
+        MAX_POINTS = 1024,
+        /// Grid lines, graphs or dots in one layer
+        MAX_ITEMS = 64,
+        /// Bytes of recorded cairo_iface calls per item
+        MAX_STYLE = 256,
+        MAX_LEGEND = 63,
+        /// Item count of a layer that wasn't sent in a frame
+        UNCHANGED = 0xFFFF,
+    };
+    enum message_type { MSG_SUBSCRIBE, MSG_UNSUBSCRIBE, MSG_ITEM, MSG_FRAME };
+    enum item_kind { KIND_GRID, KIND_GRAPH, KIND_DOT, KIND_COUNT };
+    /// Start of every message
+    struct header
+    {
+        uint32_t magic;
+        uint8_t type, phase, kind, reserved;
+        /// Line graph (parameter) index, -1 for all in MSG_UNSUBSCRIBE
+        int32_t index;
+        /// Item number in MSG_ITEM
+        int32_t subindex;
+    };
+    /// MSG_SUBSCRIBE: header followed by the graph size and the rate
+    struct subscribe_body
+    {
+        uint16_t size_x, size_y, fps, reserved;
+    };
+    /// MSG_FRAME: header followed by the layers to redraw and the item counts of the layers sent
+    struct frame_body
+    {
+        uint32_t layers;
+        uint16_t counts[2][KIND_COUNT];
+    };
+    /// MSG_ITEM: header, uint16 style size, recorded style calls, then the item:
+    /// - graph: int32 mode, uint16 point count, int16 values
+    /// - grid line: float position, uint8 vertical, uint8 legend length, legend
+    /// - dot: float x, float y, int32 size
+
+    /// @return layer flag of a given item kind and drawing phase
+    static unsigned int get_layer(int phase, int kind) { return (phase ? LG_REALTIME_GRID : LG_CACHE_GRID) << (2 * kind); }
+    /// 16-bit form of a graph value: range +/- 8 (beyond the edges of the graph, which is +/- 1),
+    /// INFINITY (and NaN) for gaps
+    static int16_t quantize(float value)
+    {
+        if (!(value < INFINITY))
+            return -32768;
+        if (value > 32767.f / 4096.f)
+            return 32767;
+        if (value < -32767.f / 4096.f)
+            return -32767;
+        return (int16_t)lrintf(value * 4096.f);
+    }
+    static float dequantize(int16_t value) { return value == -32768 ? INFINITY : value * (1.f / 4096.f); }
+};
+
+/// Destination for the messages of display_stream_writer
+struct display_stream_output
+{
+    /// @return space for a message of a given size, NULL if there's no more room in this cycle
+    virtual void *add_message(uint32_t size) = 0;
+    /// @return size of the largest message that fits in an empty cycle
+    virtual uint32_t get_message_capacity() const = 0;
+    virtual ~display_stream_output() {}
+};
+
+/// Plugin side: sends the line graphs of a plugin to the subscribed GUIs. run calls the plugin's
+/// line_graph_iface on the audio thread, so its get_graph, get_dot, get_gridline and get_layers must
+/// not lock or allocate; grid legends go into a string reserved by init, so format them with snprintf
+/// (no streams or string concatenation) and keep them within display_stream::MAX_LEGEND characters.
+class display_stream_writer
+{
+public:
+    display_stream_writer();
+    /// Allocate the subscriptions for a given line graph source (not real-time safe)
+    void init(const line_graph_iface *_source, uint32_t _sample_rate);
+    /// @retval true if there's a line graph source to send
+    bool is_enabled() const { return source != NULL; }
+    /// @retval true if any GUI is subscribed
+    bool is_active() const { return active_count > 0; }
+    /// Handle a message from the GUI
+    /// @retval false if it's not a valid display stream request
+    bool process_request(const void *data, uint32_t size);
+    /// Send the changes due after nsamples samples, as far as there's room in the output
+    /// (the rest is sent in the next cycles); called from the audio thread
+    void run(uint32_t nsamples, display_stream_output &output);
+    /// @return number of bytes sent so far
+    uint64_t get_bytes_sent() const { return bytes_sent; }
+
+private:
+    struct subscription
+    {
+        int32_t index;
+        uint16_t size_x, size_y;
+        /// Samples between frames and until the next one
+        uint32_t interval, countdown;
+        /// Number of frames sent, passed to get_layers (0 = redraw everything)
+        int generation;
+        /// Layers of the frame being sent
+        unsigned int pending;
+        /// Hashes of the items last sent, 0 if not sent
+        uint64_t sent[2][display_stream::KIND_COUNT][display_stream::MAX_ITEMS];
+    };
+    const line_graph_iface *source;
+    uint32_t sample_rate;
+    int active_count;
+    uint64_t bytes_sent;
+    std::vector<subscription> subscriptions;
+    /// Scratch space for one item message
+    std::vector<uint8_t> message;
+    std::vector<float> values;
+    std::string legend;
+
+    /// Send the pending layers of a subscription
+    /// @retval false if some of it didn't fit
+    bool send_frame(subscription &sub, display_stream_output &output);
+    /// Get an item from the source into message
+    /// @return message size, 0 if there's no such item
+    uint32_t make_item(const subscription &sub, int phase, int kind, int subindex);
+};
+
+/// GUI side: a line_graph_iface drawing from the messages of display_stream_writer
+class display_stream_reader: public line_graph_iface
+{
+public:
+    /// Handle a message from the plugin
+    /// @retval false if it's not a valid display stream message
+    bool process_message(const void *data, uint32_t size);
+    /// Cancel all the subscriptions (when the GUI is closed)
+    void unsubscribe_all();
+
+    virtual bool get_graph(int index, int subindex, int phase, float *data, int points, cairo_iface *context, int *mode = 0) const;
+    virtual bool get_dot(int index, int subindex, int phase, float &x, float &y, int &size, cairo_iface *context) const;
+    virtual bool get_gridline(int index, int subindex, int phase, float &pos, bool &vertical, std::string &legend, cairo_iface *context) const;
+    virtual bool get_layers(int index, int generation, unsigned int &layers) const;
+
+protected:
+    /// Send a request to the plugin
+    virtual void send_request(const void *data, uint32_t size) const = 0;
+
+private:
+    struct item
+    {
+        /// Recorded cairo_iface calls
+        std::string style;
+        int mode, size;
+        float x, y;
+        bool vertical;
+        std::string legend;
+        std::vector<int16_t> values;
+    };
+    typedef std::vector<item> item_list;
+    struct graph
+    {
+        uint16_t size_x, size_y;
+        /// Layers received and not redrawn yet
+        unsigned int layers;
+        /// Items of the last complete frame
+        item_list items[2][display_stream::KIND_COUNT];
+        /// Items of the frame being received
+        item_list incoming[2][display_stream::KIND_COUNT];
+        graph() : size_x(0), size_y(0), layers(0) {}
+    };
+    mutable std::map<int, graph> graphs;
+
+    /// @return item to draw, subscribing to the graph first if needed
+    const item *get_item(int index, int subindex, int phase, int kind, cairo_iface *context) const;
+};
+
+};
+
+#endif
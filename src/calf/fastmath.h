@@ -0,0 +1,398 @@
+/* Calf DSP Library
+ * Fast approximations of transcendental functions (scalar and SSE2).
+ *
+ * Copyright (C) 2001-2010 Krzysztof Foltman, Markus Schmidt, Thor Harald Johansen and others
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02111-1307, USA.
+ */
+#ifndef CALF_FASTMATH_H
+#define CALF_FASTMATH_H
+
+#include "primitives.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace dsp {
+
+/// Accuracy-bounded approximations of exp2, exp, log2, log, log10, pow, tanh, atan and sqrt.
+/// They are compared against libm over (a dense, evenly spaced subset of) every float in their domain
+/// by 'calfbenchmark -u fastmath', which fails if any of the following bounds is exceeded:
+/// - exp2, exp: relative error < 3e-7 (inputs are clamped to [-126, 127] octaves, so the result is always a normal float)
+/// - log2, log, log10: error < 2.5e-7 * max(1, |result|) for positive normal floats (0 and denormals give about -127 octaves)
+/// - pow: computed as exp2(y * log2(x)), the relative error grows with |y * log2(x)|
+/// - tanh: absolute error < 2e-7, relative error < 6e-7
+/// - atan: absolute error < 2e-7, relative error < 4e-7
+/// - sqrt: correctly rounded (hardware instruction)
+/// The scalar versions are slower than libm (they are there for the accuracy tests and the ends of
+/// blocks), so per-sample DSP code keeps calling libm. Only the SSE2 block versions of exp2 and exp
+/// beat libm in 'calfbenchmark -u fastmath', and math_block uses them with USE_APPROX_MATH.
+namespace fastmath {
+
+static const float LOG2E = 1.44269504088896340736f;
+static const float LN2 = 0.69314718055994530942f;
+static const float LOG10_2 = 0.30102999566398119521f;
+/// Cody-Waite split of ln(2): LN2_HI has only 9 significant bits, so i * LN2_HI is exact
+static const float LN2_HI = 0.693359375f;
+static const float LN2_LO = -2.12194440e-4f;
+static const float SQRT2 = 1.41421356237309504880f;
+static const float PI_2 = 1.57079632679489661923f;
+static const float PI_4 = 0.78539816339744830962f;
+static const float TAN_PI_8 = 0.41421356237309504880f;
+
+/// Near-minimax polynomial of e^r, accurate to 7.5e-8 relative for |r| <= ln(2)/2
+#define CALF_FASTMATH_EXP_POLY(r, MUL, ADD, C) \
+    ADD(C(1.00000007f), MUL(r, ADD(C(0.999999692f), MUL(r, ADD(C(0.499988949f), MUL(r, ADD(C(0.166675749f), MUL(r, ADD(C(0.0419153813f), MUL(r, C(0.00829764229f)))))))))))
+
+/// 2 * atanh(t) = ln((1 + t) / (1 - t)) series, accurate to 3e-8 for |t| <= 3 - 2 * sqrt(2)
+#define CALF_FASTMATH_LN_POLY(t, t2, MUL, ADD, C) \
+    MUL(MUL(C(2.f), t), ADD(C(1.f), MUL(t2, ADD(C(1.f / 3), MUL(t2, ADD(C(1.f / 5), MUL(t2, C(1.f / 7))))))))
+
+/// Near-minimax polynomial of atan(u) / u in u^2, accurate to 2e-8 relative for |u| <= tan(pi/8)
+#define CALF_FASTMATH_ATAN_POLY(u2, MUL, ADD, C) \
+    ADD(C(0.999999982f), MUL(u2, ADD(C(-0.333327992f), MUL(u2, ADD(C(0.199744699f), MUL(u2, ADD(C(-0.138520837f), MUL(u2, C(0.0798672335f)))))))))
+
+/// tanh Taylor series (divided by x), accurate to 3.5e-7 relative for |x| < 1/4
+#define CALF_FASTMATH_TANH_POLY(x2, MUL, ADD, C) \
+    ADD(C(1.f), MUL(x2, ADD(C(-1.f / 3), MUL(x2, ADD(C(2.f / 15), MUL(x2, C(-17.f / 315)))))))
+
+#define CALF_FASTMATH_SMUL(a, b) ((a) * (b))
+#define CALF_FASTMATH_SADD(a, b) ((a) + (b))
+#define CALF_FASTMATH_SCONST(c) (c)
+
+union float_bits
+{
+    float f;
+    int32_t i;
+};
+
+/// Round to nearest integer (|x| < 2^31)
+inline int round_int(float x)
+{
+    return (int)lrintf(x);
+}
+
+/// Calf is built with -ffast-math, which would otherwise fold the two-step (Cody-Waite)
+/// range reduction in exp() back into a single, inexact multiplication by ln(2)
+template<class T>
+inline T opaque(T x)
+{
+#if defined(__GNUC__) && defined(__SSE2__)
+    __asm__("" : "+x"(x));
+#elif defined(__GNUC__) && defined(__aarch64__)
+    __asm__("" : "+w"(x));
+#endif
+    return x;
+}
+
+/// 2^i for integer i in [-126, 127]
+inline float pow2_int(int i)
+{
+    float_bits u;
+    u.i = (i + 127) << 23;
+    return u.f;
+}
+
+/// e^r for |r| <= ln(2)/2
+inline float exp_reduced(float r)
+{
+    return CALF_FASTMATH_EXP_POLY(r, CALF_FASTMATH_SMUL, CALF_FASTMATH_SADD, CALF_FASTMATH_SCONST);
+}
+
+/// 2^x
+inline float exp2(float x)
+{
+    x = std::max(-126.f, std::min(x, 127.f));
+    int i = round_int(x);
+    return exp_reduced((x - i) * LN2) * pow2_int(i);
+}
+
+/// e^x
+inline float exp(float x)
+{
+    x = std::max(-126.f * LN2, std::min(x, 127.f * LN2));
+    int i = round_int(x * LOG2E);
+    float r = opaque(x - i * LN2_HI);
+    r -= i * LN2_LO;
+    return exp_reduced(r) * pow2_int(i);
+}
+
+/// ln(x) for x > 0, split into octave (returned) and ln of the mantissa (in lnm)
+inline int log_split(float x, float &lnm)
+{
+    float_bits u;
+    u.f = x;
+    int e = ((u.i >> 23) & 255) - 127;
+    u.i = (u.i & 0x007FFFFF) | 0x3F800000;
+    float m = u.f;
+    if (m > SQRT2)
+    {
+        m *= 0.5f;
+        e++;
+    }
+    float t = (m - 1.f) / (m + 1.f);
+    float t2 = t * t;
+    lnm = CALF_FASTMATH_LN_POLY(t, t2, CALF_FASTMATH_SMUL, CALF_FASTMATH_SADD, CALF_FASTMATH_SCONST);
+    return e;
+}
+
+/// log2(x) for x > 0
+inline float log2(float x)
+{
+    float lnm;
+    int e = log_split(x, lnm);
+    return e + lnm * LOG2E;
+}
+
+/// ln(x) for x > 0
+inline float log(float x)
+{
+    float lnm;
+    int e = log_split(x, lnm);
+    return e * LN2 + lnm;
+}
+
+/// log10(x) for x > 0
+inline float log10(float x)
+{
+    return log2(x) * LOG10_2;
+}
+
+/// x^y for x > 0 (x = 0 gives 0 for positive y)
+inline float pow(float x, float y)
+{
+    if (x <= 0.f)
+        return 0.f;
+    return exp2(y * log2(x));
+}
+
+/// Hyperbolic tangent
+inline float tanh(float x)
+{
+    float ax = std::abs(x);
+    if (ax < 0.25f)
+        return x * CALF_FASTMATH_TANH_POLY(x * x, CALF_FASTMATH_SMUL, CALF_FASTMATH_SADD, CALF_FASTMATH_SCONST);
+    float r = ax > 9.f ? 1.f : 1.f - 2.f / (exp2(2.f * LOG2E * ax) + 1.f);
+    return x < 0 ? -r : r;
+}
+
+/// Arc tangent
+inline float atan(float x)
+{
+    float ax = std::abs(x);
+    bool inv = ax > 1.f;
+    if (inv)
+        ax = 1.f / ax;
+    bool shift = ax > TAN_PI_8;
+    if (shift)
+        ax = (ax - 1.f) / (ax + 1.f);
+    float r = ax * CALF_FASTMATH_ATAN_POLY(ax * ax, CALF_FASTMATH_SMUL, CALF_FASTMATH_SADD, CALF_FASTMATH_SCONST);
+    if (shift)
+        r += PI_4;
+    if (inv)
+        r = PI_2 - r;
+    return x < 0 ? -r : r;
+}
+
+/// Square root for x >= 0 (the hardware instruction is already fast, this is here for the block version)
+inline float sqrt(float x)
+{
+    return std::sqrt(x);
+}
+
+#if defined(__SSE2__)
+
+#define CALF_FASTMATH_VMUL(a, b) _mm_mul_ps((a), (b))
+#define CALF_FASTMATH_VADD(a, b) _mm_add_ps((a), (b))
+#define CALF_FASTMATH_VCONST(c) _mm_set1_ps(c)
+
+/// Bitwise select: mask ? a : b
+inline __m128 select_ps(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+inline __m128 abs_ps(__m128 x)
+{
+    return _mm_andnot_ps(_mm_set1_ps(-0.f), x);
+}
+
+/// Round to nearest integer (|x| < 2^31, default MXCSR rounding mode)
+inline __m128i round_int_ps(__m128 x)
+{
+    return _mm_cvtps_epi32(x);
+}
+
+inline __m128 pow2_int_ps(__m128i i)
+{
+    return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(i, _mm_set1_epi32(127)), 23));
+}
+
+inline __m128 exp2_ps(__m128 x)
+{
+    x = _mm_max_ps(_mm_set1_ps(-126.f), _mm_min_ps(x, _mm_set1_ps(127.f)));
+    __m128i i = round_int_ps(x);
+    __m128 r = _mm_mul_ps(_mm_sub_ps(x, _mm_cvtepi32_ps(i)), _mm_set1_ps(LN2));
+    return _mm_mul_ps(CALF_FASTMATH_EXP_POLY(r, CALF_FASTMATH_VMUL, CALF_FASTMATH_VADD, CALF_FASTMATH_VCONST), pow2_int_ps(i));
+}
+
+inline __m128 exp_ps(__m128 x)
+{
+    x = _mm_max_ps(_mm_set1_ps(-126.f * LN2), _mm_min_ps(x, _mm_set1_ps(127.f * LN2)));
+    __m128i i = round_int_ps(_mm_mul_ps(x, _mm_set1_ps(LOG2E)));
+    __m128 fi = _mm_cvtepi32_ps(i);
+    __m128 r = opaque(_mm_sub_ps(x, _mm_mul_ps(fi, _mm_set1_ps(LN2_HI))));
+    r = _mm_sub_ps(r, _mm_mul_ps(fi, _mm_set1_ps(LN2_LO)));
+    return _mm_mul_ps(CALF_FASTMATH_EXP_POLY(r, CALF_FASTMATH_VMUL, CALF_FASTMATH_VADD, CALF_FASTMATH_VCONST), pow2_int_ps(i));
+}
+
+/// Vector version of log_split, returns the octave as float
+inline __m128 log_split_ps(__m128 x, __m128 &lnm)
+{
+    __m128i xi = _mm_castps_si128(x);
+    __m128i e = _mm_sub_epi32(_mm_and_si128(_mm_srli_epi32(xi, 23), _mm_set1_epi32(255)), _mm_set1_epi32(127));
+    __m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(xi, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000)));
+    __m128 big = _mm_cmpgt_ps(m, _mm_set1_ps(SQRT2));
+    m = select_ps(big, _mm_mul_ps(m, _mm_set1_ps(0.5f)), m);
+    __m128 fe = _mm_add_ps(_mm_cvtepi32_ps(e), _mm_and_ps(big, _mm_set1_ps(1.f)));
+    __m128 t = _mm_div_ps(_mm_sub_ps(m, _mm_set1_ps(1.f)), _mm_add_ps(m, _mm_set1_ps(1.f)));
+    __m128 t2 = _mm_mul_ps(t, t);
+    lnm = CALF_FASTMATH_LN_POLY(t, t2, CALF_FASTMATH_VMUL, CALF_FASTMATH_VADD, CALF_FASTMATH_VCONST);
+    return fe;
+}
+
+inline __m128 log2_ps(__m128 x)
+{
+    __m128 lnm;
+    __m128 fe = log_split_ps(x, lnm);
+    return _mm_add_ps(fe, _mm_mul_ps(lnm, _mm_set1_ps(LOG2E)));
+}
+
+inline __m128 log_ps(__m128 x)
+{
+    __m128 lnm;
+    __m128 fe = log_split_ps(x, lnm);
+    return _mm_add_ps(_mm_mul_ps(fe, _mm_set1_ps(LN2)), lnm);
+}
+
+inline __m128 log10_ps(__m128 x)
+{
+    return _mm_mul_ps(log2_ps(x), _mm_set1_ps(LOG10_2));
+}
+
+inline __m128 pow_ps(__m128 x, __m128 y)
+{
+    __m128 positive = _mm_cmpgt_ps(x, _mm_setzero_ps());
+    return _mm_and_ps(positive, exp2_ps(_mm_mul_ps(y, log2_ps(x))));
+}
+
+inline __m128 tanh_ps(__m128 x)
+{
+    __m128 sign = _mm_and_ps(x, _mm_set1_ps(-0.f));
+    __m128 ax = abs_ps(x);
+    __m128 x2 = _mm_mul_ps(ax, ax);
+    __m128 small = _mm_mul_ps(ax, CALF_FASTMATH_TANH_POLY(x2, CALF_FASTMATH_VMUL, CALF_FASTMATH_VADD, CALF_FASTMATH_VCONST));
+    __m128 e = exp2_ps(_mm_mul_ps(ax, _mm_set1_ps(2.f * LOG2E)));
+    __m128 large = _mm_sub_ps(_mm_set1_ps(1.f), _mm_div_ps(_mm_set1_ps(2.f), _mm_add_ps(e, _mm_set1_ps(1.f))));
+    large = _mm_min_ps(large, _mm_set1_ps(1.f));
+    __m128 r = select_ps(_mm_cmplt_ps(ax, _mm_set1_ps(0.25f)), small, large);
+    return _mm_or_ps(r, sign);
+}
+
+inline __m128 atan_ps(__m128 x)
+{
+    __m128 sign = _mm_and_ps(x, _mm_set1_ps(-0.f));
+    __m128 ax = abs_ps(x);
+    __m128 inv = _mm_cmpgt_ps(ax, _mm_set1_ps(1.f));
+    ax = select_ps(inv, _mm_div_ps(_mm_set1_ps(1.f), ax), ax);
+    __m128 shift = _mm_cmpgt_ps(ax, _mm_set1_ps(TAN_PI_8));
+    ax = select_ps(shift, _mm_div_ps(_mm_sub_ps(ax, _mm_set1_ps(1.f)), _mm_add_ps(ax, _mm_set1_ps(1.f))), ax);
+    __m128 r = _mm_mul_ps(ax, CALF_FASTMATH_ATAN_POLY(_mm_mul_ps(ax, ax), CALF_FASTMATH_VMUL, CALF_FASTMATH_VADD, CALF_FASTMATH_VCONST));
+    r = _mm_add_ps(r, _mm_and_ps(shift, _mm_set1_ps(PI_4)));
+    r = select_ps(inv, _mm_sub_ps(_mm_set1_ps(PI_2), r), r);
+    return _mm_or_ps(r, sign);
+}
+
+inline __m128 sqrt_ps(__m128 x)
+{
+    return _mm_sqrt_ps(x);
+}
+
+#endif
+
+/// block_faster: the SSE2 block version measures faster than a loop of libm calls
+#define CALF_FASTMATH_BLOCK_OP(name, faster) \
+    struct name##_op { \
+        enum { block_faster = faster }; \
+        static inline float scalar(float x) { return name(x); } \
+        static inline float libm(float x) { return std::name(x); } \
+        CALF_FASTMATH_BLOCK_VEC(name) \
+    };
+
+#if defined(__SSE2__)
+#define CALF_FASTMATH_BLOCK_VEC(name) static inline __m128 vector(__m128 x) { return name##_ps(x); }
+#else
+#define CALF_FASTMATH_BLOCK_VEC(name)
+#endif
+
+CALF_FASTMATH_BLOCK_OP(exp2, 1)
+CALF_FASTMATH_BLOCK_OP(exp, 1)
+CALF_FASTMATH_BLOCK_OP(log2, 0)
+CALF_FASTMATH_BLOCK_OP(log, 0)
+CALF_FASTMATH_BLOCK_OP(log10, 0)
+CALF_FASTMATH_BLOCK_OP(tanh, 0)
+CALF_FASTMATH_BLOCK_OP(atan, 0)
+CALF_FASTMATH_BLOCK_OP(sqrt, 0)
+
+#undef CALF_FASTMATH_BLOCK_VEC
+#undef CALF_FASTMATH_BLOCK_OP
+
+/// Apply a function (one of the *_op structs above) to a block of values multiplied by scale,
+/// 4 at a time where possible (dst and src may be the same array; no alignment is required)
+template<class Op>
+inline void apply_block(float *dst, const float *src, uint32_t count, float scale = 1.f)
+{
+    uint32_t i = 0;
+#if defined(__SSE2__)
+    __m128 vscale = _mm_set1_ps(scale);
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(dst + i, Op::vector(_mm_mul_ps(_mm_loadu_ps(src + i), vscale)));
+#endif
+    for (; i < count; i++)
+        dst[i] = Op::scalar(src[i] * scale);
+}
+
+/// Apply a function to a block of values multiplied by scale: apply_block with USE_APPROX_MATH
+/// for the functions whose SSE2 version is faster than libm, a plain libm loop otherwise
+template<class Op>
+inline void math_block(float *dst, const float *src, uint32_t count, float scale = 1.f)
+{
+#if USE_APPROX_MATH && defined(__SSE2__)
+    if (Op::block_faster)
+    {
+        apply_block<Op>(dst, src, count, scale);
+        return;
+    }
+#endif
+    for (uint32_t i = 0; i < count; i++)
+        dst[i] = Op::libm(src[i] * scale);
+}
+
+};
+
+};
+
+#endif
@@ -22,10 +22,13 @@
 #define CALF_GIFACE_H
 
 #include <config.h>
+#include "arena.h"
 #include "primitives.h"
+#include <atomic>
 #include <complex>
 #include <exception>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace osctl {
@@ -35,7 +38,9 @@ namespace osctl {
 namespace calf_plugins {
 
 enum {
-    MAX_SAMPLE_RUN = 256
+    MAX_SAMPLE_RUN = 256,
+    /// Capacity of the hosts' MIDI event queues (more events in a buffer are passed in several calls)
+    MAX_QUEUED_EVENTS = 256
 };
 
 struct automation_range;
@@ -77,13 +82,14 @@ enum parameter_flags
   PF_CTLO_LABEL     = 0x004000, ///< add a text display to the control (meters only)
   PF_CTLO_REVERSE   = 0x008000, ///< use VU_MONOCHROME_REVERSE mode (meters only)
 
-  PF_PROP_MASK     =  0x3F0000, ///< bit mask for properties
+  PF_PROP_MASK     =  0x7F0000, ///< bit mask for properties
   PF_PROP_NOBOUNDS =  0x010000, ///< no epp:hasStrictBounds
   PF_PROP_EXPENSIVE = 0x020000, ///< epp:expensive, may trigger expensive calculation
   PF_PROP_OUTPUT_GAIN=0x040000, ///< epp:outputGain + skip epp:hasStrictBounds
   PF_PROP_OPTIONAL  = 0x080000, ///< connection optional
   PF_PROP_GRAPH     = 0x100000, ///< add graph
   PF_PROP_OUTPUT    = 0x200000, ///< output port (flag, cannot be combined with others)
+  PF_PROP_LATENCY   = 0x400000, ///< output port reporting the plugin latency in samples (lv2:reportsLatency)
 
   PF_UNITMASK     = 0x0F000000,  ///< bit mask for units   \todo reduce to use only 5 bits
   PF_UNIT_DB      = 0x01000000,  ///< decibels
@@ -172,6 +178,24 @@ struct progress_report_iface
     virtual ~progress_report_iface() {}
 };
 
+/// Host interface for running lengthy jobs (loading files, precalculating tables) on a non-realtime thread
+struct worker_iface
+{
+    /// Queue a job for audio_module_iface::work; data is copied. Only valid from the audio thread
+    /// (process and the functions called around it, including work_response).
+    /// @retval false if the job cannot be queued now - the module has to do the work in some other way
+    virtual bool schedule_work(uint32_t size, const void *data) = 0;
+    virtual ~worker_iface() {}
+};
+
+/// Interface for sending the results of a job back to the audio thread
+struct worker_response_iface
+{
+    /// Queue a response for audio_module_iface::work_response; data is copied
+    virtual bool respond(uint32_t size, const void *data) = 0;
+    virtual ~worker_response_iface() {}
+};
+
 /// possible bit masks for get_layers
 enum layers_flags {
     LG_NONE            = 0x000000,
@@ -330,7 +354,7 @@ struct ladspa_plugin_info
 /// An interface returning metadata about a plugin
 struct plugin_metadata_iface
 {
-    enum { simulate_stereo_input = true, has_live_updates = true };
+    enum { simulate_stereo_input = true, has_live_updates = true, use_worker = false };
     /// @return plugin long name
     virtual const char *get_name() const = 0;
     /// @return plugin LV2 label
@@ -379,6 +403,8 @@ struct plugin_metadata_iface
     virtual bool get_simulate_stereo_input() const = 0;
     /// @return whether live UI events are generated
     virtual bool sends_live_updates() const = 0;
+    /// @return whether the plugin can run jobs on a worker thread (audio_module_iface::work)
+    virtual bool uses_worker() const = 0;
 
     /// Do-nothing destructor to silence compiler warning
     virtual ~plugin_metadata_iface() {}
@@ -415,6 +441,8 @@ struct plugin_ctl_iface
     virtual const line_graph_iface *get_line_graph_iface() const = 0;
     /// @return phase_graph_iface if any
     virtual const phase_graph_iface *get_phase_graph_iface() const = 0;
+    /// @return bytes used by the plugin instance (see audio_module_iface::get_memory_footprint), 0 if unknown
+    virtual size_t get_memory_footprint() const { return 0; }
     /// @return serial number of last automation write (JACK host only)
     virtual int get_write_serial(int param_no) { return 0; }
 
@@ -440,8 +468,15 @@ class plugin_registry
 public:
     typedef std::vector<const plugin_metadata_iface *> plugin_vector;
 private:
+    typedef std::unordered_map<std::string, const plugin_metadata_iface *> plugin_index;
     plugin_vector plugins;
+    /// Plugins by URI label
+    plugin_index by_label;
+    /// Plugins by lowercase ID
+    plugin_index by_id;
     plugin_registry();
+    /// Add a plugin to the list and the indexes
+    void add(const plugin_metadata_iface *plugin);
 public:
     /// Get the singleton object.
     static plugin_registry &instance();
@@ -457,6 +492,125 @@ public:
 /// Load and strdup a text file with GUI definition
 extern char *load_gui_xml(const std::string &plugin_id);
 
+/// Set of parameters modified since the last params_changed call (one bit per parameter)
+class param_mask
+{
+public:
+    enum { MAX_PARAMS = 512, WORDS = MAX_PARAMS / 32 };
+protected:
+    uint32_t bits[WORDS];
+public:
+    param_mask() { clear(); }
+    /// Mark all parameters as unchanged
+    inline void clear() { memset(bits, 0, sizeof(bits)); }
+    /// Mark all parameters as changed
+    inline void set_all() { memset(bits, 0xFF, sizeof(bits)); }
+    /// Mark a single parameter as changed (parameters outside of the supported range mark everything as changed)
+    inline void set(int param_no)
+    {
+        if (param_no >= 0 && param_no < MAX_PARAMS)
+            bits[param_no >> 5] |= 1U << (param_no & 31);
+        else
+            set_all();
+    }
+    /// @retval true if a given parameter has been changed
+    inline bool test(int param_no) const
+    {
+        if (param_no < 0 || param_no >= MAX_PARAMS)
+            return true;
+        return (bits[param_no >> 5] & (1U << (param_no & 31))) != 0;
+    }
+    /// @retval true if any parameter has been changed
+    inline bool any() const
+    {
+        for (int i = 0; i < WORDS; i++)
+            if (bits[i])
+                return true;
+        return false;
+    }
+    /// @retval true if any parameter is marked in both masks
+    inline bool intersects(const param_mask &other) const
+    {
+        for (int i = 0; i < WORDS; i++)
+            if (bits[i] & other.bits[i])
+                return true;
+        return false;
+    }
+    /// Add all parameters marked in another mask
+    inline param_mask &operator|=(const param_mask &other)
+    {
+        for (int i = 0; i < WORDS; i++)
+            bits[i] |= other.bits[i];
+        return *this;
+    }
+    /// A mask with all the parameters marked as changed
+    static const param_mask &all()
+    {
+        static param_mask mask = make_all();
+        return mask;
+    }
+private:
+    static param_mask make_all() { param_mask m; m.set_all(); return m; }
+    friend class shared_param_mask;
+};
+
+/// param_mask marked by other threads (GUI, MIDI automation) and taken by the audio thread,
+/// so that no change can be lost between marking and params_changed
+class shared_param_mask
+{
+    std::atomic<uint32_t> bits[param_mask::WORDS];
+public:
+    shared_param_mask() { clear(); }
+    /// Mark all parameters as unchanged
+    inline void clear()
+    {
+        for (int i = 0; i < param_mask::WORDS; i++)
+            bits[i].store(0, std::memory_order_relaxed);
+    }
+    /// Mark all parameters as changed
+    inline void set_all()
+    {
+        for (int i = 0; i < param_mask::WORDS; i++)
+            bits[i].store(~0U, std::memory_order_release);
+    }
+    /// Mark a single parameter as changed (parameters outside of the supported range mark everything as changed)
+    inline void set(int param_no)
+    {
+        if (param_no >= 0 && param_no < param_mask::MAX_PARAMS)
+            bits[param_no >> 5].fetch_or(1U << (param_no & 31), std::memory_order_release);
+        else
+            set_all();
+    }
+    /// Move the marked parameters to mask (replacing its contents) and mark them as unchanged here
+    /// @retval true if any parameter has been changed
+    inline bool take(param_mask &mask)
+    {
+        bool any = false;
+        for (int i = 0; i < param_mask::WORDS; i++)
+        {
+            // only exchange the words that have something in them
+            uint32_t word = bits[i].load(std::memory_order_relaxed);
+            if (word)
+                word = bits[i].exchange(0, std::memory_order_acquire);
+            mask.bits[i] = word;
+            any = any || word;
+        }
+        return any;
+    }
+};
+
+/// Short MIDI message with its position in the buffer, as queued by the hosts
+struct midi_event
+{
+    /// Sample offset within the buffer being processed
+    uint32_t time;
+    /// Status byte and up to two data bytes (unused bytes are 0)
+    uint8_t data[3];
+
+    /// @retval true for Note On and Note Off, which are always applied at their exact position
+    bool is_note() const { return (data[0] & 0xE0) == 0x80; }
+};
+
 /// Interface to audio processing plugins (the real things, not only metadata)
 struct audio_module_iface
 {
@@ -476,6 +630,9 @@ struct audio_module_iface
     virtual void channel_pressure(int channel, int value) = 0;
     /// Called when params are changed (before processing)
     virtual void params_changed() = 0;
+    /// Called when params are changed (before processing), with the set of parameters modified since the last call
+    /// @param dirty parameters that changed; modules that don't override this recalculate everything
+    virtual void params_changed(const param_mask &dirty) = 0;
     /// LADSPA-esque activate function, except it is called after ports are connected, not before
     virtual void activate() = 0;
     /// LADSPA-esque deactivate function
@@ -500,16 +657,34 @@ struct audio_module_iface
     virtual const plugin_metadata_iface *get_metadata_iface() const = 0;
     /// Set the progress report interface to communicate progress to
     virtual void set_progress_report_iface(progress_report_iface *iface) = 0;
+    /// Set the interface for scheduling jobs on a worker thread (called before post_instantiate, if the host has one)
+    virtual void set_worker_iface(worker_iface *iface) = 0;
+    /// Do a job queued by worker_iface::schedule_work; called on a non-realtime thread, one job at a time
+    virtual void work(uint32_t size, const void *data, worker_response_iface *response) = 0;
+    /// Receive a result sent by work; called on the audio thread, between process calls
+    virtual void work_response(uint32_t size, const void *data) = 0;
     /// Clear a part of output buffers that have 0s at mask; subdivide the buffer so that no runs > MAX_SAMPLE_RUN are fed to process function
     virtual uint32_t process_slice(uint32_t offset, uint32_t end) = 0;
+    /// Process samples from offset to end, handling MIDI events (sorted by time, within [offset, end)) on the way
+    virtual uint32_t process_slice_events(uint32_t offset, uint32_t end, const midi_event *events, uint32_t event_count) = 0;
     /// The audio processing loop; assumes numsamples <= MAX_SAMPLE_RUN, for larger buffers, call process_slice
     virtual uint32_t process(uint32_t offset, uint32_t numsamples, uint32_t inputs_mask, uint32_t outputs_mask) = 0;
     /// Message port processing function
     virtual uint32_t message_run(const void *valid_ports, void *output_ports) = 0;
+    /// @return delay between the input and the output, in samples at the current sample rate
+    /// (as set by the current parameter values); called on the audio thread, after process
+    virtual uint32_t get_latency() = 0;
     /// @return line_graph_iface if any
     virtual const line_graph_iface *get_line_graph_iface() const = 0;
      /// @return phase_graph_iface if any
     virtual const phase_graph_iface *get_phase_graph_iface() const = 0;
+    /// @return bytes used by the instance: the module object and its DSP buffers (the arena)
+    virtual size_t get_memory_footprint() const = 0;
+    /// @return the part of get_memory_footprint taken by the DSP buffers
+    virtual size_t get_arena_size() const = 0;
+    /// Lock the module object and its DSP buffers in RAM, so that they never get paged out
+    /// @retval false if it's not allowed (see RLIMIT_MEMLOCK)
+    virtual bool lock_memory() = 0;
     virtual ~audio_module_iface() {}
 };
 
@@ -529,9 +704,21 @@ public:
     bool questionable_data_reported_out;
 
     progress_report_iface *progress_report;
+    /// Worker thread interface, NULL if the host has none (then everything is done synchronously)
+    worker_iface *worker;
+    /// Resolution (in samples from the start of the buffer) at which process_slice_events applies
+    /// controller-type events; set to the control rate by modules that only read the controllers once per block
+    uint32_t event_granularity;
+    /// DSP buffers of this instance
+    dsp::memory_arena arena;
+    /// Size of the whole module object (set by new_audio_module)
+    size_t object_size;
 
     audio_module() {
         progress_report = NULL;
+        worker = NULL;
+        event_granularity = 1;
+        object_size = 0;
         memset(ins, 0, sizeof(ins));
         memset(outs, 0, sizeof(outs));
         memset(params, 0, sizeof(params));
@@ -555,6 +742,8 @@ public:
     void channel_pressure(int channel, int value) {}
     /// Called when params are changed (before processing)
     void params_changed() {}
+    /// Called when params are changed - by default, ignore the mask and recalculate everything
+    void params_changed(const param_mask &dirty) { params_changed(); }
     /// LADSPA-esque activate function, except it is called after ports are connected, not before
     void activate() {}
     /// LADSPA-esque deactivate function
@@ -590,6 +779,14 @@ public:
     virtual const plugin_metadata_iface *get_metadata_iface() const { return this; }
     /// Set the progress report interface to communicate progress to
     virtual void set_progress_report_iface(progress_report_iface *iface) { progress_report = iface; }
+    /// Set the worker thread interface
+    virtual void set_worker_iface(worker_iface *iface) { worker = iface; }
+    /// Do a job on the worker thread (none by default)
+    virtual void work(uint32_t size, const void *data, worker_response_iface *response) {}
+    /// Receive a job result on the audio thread (none by default)
+    virtual void work_response(uint32_t size, const void *data) {}
+    /// Latency in samples (none by default)
+    virtual uint32_t get_latency() { return 0; }
 
     /// utility function: zero port values if mask is 0
     inline void zero_by_mask(uint32_t mask, uint32_t offset, uint32_t nsamples)
@@ -653,12 +850,91 @@ public:
         }
         return total_out_mask;
     }
+    /// utility function: call the MIDI handler for a Channel Voice message (channels are numbered from 1)
+    void handle_midi_event(const uint8_t *data)
+    {
+        int channel = (data[0] & 0x0f) + 1;
+        switch(data[0] >> 4)
+        {
+        case 8:
+            note_off(channel, data[1], data[2]);
+            break;
+        case 9:
+            if (!data[2])
+                note_off(channel, data[1], 0);
+            else
+                note_on(channel, data[1], data[2]);
+            break;
+        case 11:
+            control_change(channel, data[1], data[2]);
+            break;
+        case 12:
+            program_change(channel, data[1]);
+            break;
+        case 13:
+            channel_pressure(channel, data[1]);
+            break;
+        case 14:
+            pitch_bend(channel, data[1] + 128 * data[2] - 8192);
+            break;
+        }
+    }
+    /// @return position at which an event is applied by process_slice_events, not counting the events after it
+    inline uint32_t event_apply_time(const midi_event &event) const
+    {
+        if (event.is_note())
+            return event.time;
+        return (event.time + event_granularity - 1) / event_granularity * event_granularity;
+    }
+    /// utility function: process_slice split at the events; notes split it at their exact positions,
+    /// other events are postponed to the next multiple of event_granularity (which is where a module
+    /// with block-rate controllers would see them anyway) or to the next note, so that a dense
+    /// controller stream costs at most one split per granule
+    uint32_t process_slice_events(uint32_t offset, uint32_t end, const midi_event *events, uint32_t event_count)
+    {
+        uint32_t total_out_mask = 0;
+        for (uint32_t i = 0; i < event_count; i++)
+        {
+            uint32_t time = event_apply_time(events[i]);
+            for (uint32_t j = i + 1; j < event_count && events[j].time < time; j++)
+                time = std::min(time, event_apply_time(events[j]));
+            time = std::min(std::max(time, offset), end);
+            if (time > offset)
+            {
+                total_out_mask |= process_slice(offset, time);
+                offset = time;
+            }
+            handle_midi_event(events[i].data);
+        }
+        if (offset < end)
+            total_out_mask |= process_slice(offset, end);
+        return total_out_mask;
+    }
     /// @return line_graph_iface if any
     virtual const line_graph_iface *get_line_graph_iface() const { return dynamic_cast<const line_graph_iface *>(this); }
     /// @return phase_graph_iface if any
     virtual const phase_graph_iface *get_phase_graph_iface() const { return dynamic_cast<const phase_graph_iface *>(this); }
+    /// @return bytes used by the module object and the arena
+    virtual size_t get_memory_footprint() const { return object_size + arena.get_size(); }
+    /// @return bytes reserved by the arena
+    virtual size_t get_arena_size() const { return arena.get_size(); }
+    /// Lock the module object and the arena in RAM
+    virtual bool lock_memory() {
+        // the complete object, not just this base class
+        bool ok = dsp::memory_arena::lock_range(dynamic_cast<void *>(static_cast<audio_module_iface *>(this)), object_size);
+        return arena.lock() && ok;
+    }
 };
 
+/// Create a module instance, recording its size for get_memory_footprint
+template<class Module>
+Module *new_audio_module()
+{
+    Module *module = new Module;
+    module->object_size = sizeof(Module);
+    return module;
+}
+
 #if USE_EXEC_GUI || USE_DSSI
 
 enum line_graph_item
@@ -734,6 +1010,7 @@ public:
     const ladspa_plugin_info &get_plugin_info() const { return plugin_info; }
     bool get_simulate_stereo_input() const { return Metadata::simulate_stereo_input; }
     bool sends_live_updates() const { return Metadata::has_live_updates; }
+    bool uses_worker() const { return Metadata::use_worker; }
 };
 
 #define CALF_PORT_NAMES(name) template<> const char *calf_plugins::plugin_metadata<name##_metadata>::port_names[]
@@ -872,6 +1149,30 @@ struct automation_map: public std::multimap<uint32_t, automation_range>
 {
 };
 
+/// automation_map compiled for the audio thread: a flat table indexed by MIDI channel and controller,
+/// with the parameter value precalculated for each of the 128 controller values
+struct automation_table
+{
+    enum { CHANNELS = 16, CONTROLLERS = 128 };
+    struct target
+    {
+        int param_no;
+        float values[128];
+    };
+    /// Targets of each controller, in [first[index], first[index + 1])
+    uint32_t first[CHANNELS * CONTROLLERS + 1];
+    std::vector<target> targets;
+
+    /// Compile the mappings (not real-time safe)
+    automation_table(const automation_map &map, const plugin_metadata_iface *metadata);
+    /// @return table index of a controller designator ((channel << 8) | controller), -1 if it isn't a MIDI controller
+    static inline int get_index(uint32_t designator)
+    {
+        uint32_t channel = designator >> 8, controller = designator & 0xFF;
+        return channel < CHANNELS && controller < CONTROLLERS ? channel * CONTROLLERS + controller : -1;
+    }
+};
+
 inline float subindex_to_freq(int subindex)
 {
   float freq = 100;
@@ -53,6 +53,8 @@ namespace calf_plugins {
         plugin_gui_widget *gui_widget;
         calf_connector *connector;
         GtkWidget *strip_table, *name, *entry, *button, *con, *midi_in, *extra, *leftBG, *rightBG, *inBox, *outBox;
+        /// DSP load of the plugin
+        GtkWidget *load;
         std::vector<GtkWidget *> audio_in, audio_out;
         
         plugin_strip()
@@ -73,6 +75,7 @@ namespace calf_plugins {
         , rightBG()
         , inBox()
         , outBox()
+        , load()
         {}
         
     };
@@ -107,12 +110,16 @@ namespace calf_plugins {
     protected:
         GtkWidget *progress_window;
         window_update_controller refresh_controller;
+        /// Number of on_idle calls, for updating the DSP load displays less often than the meters
+        int idle_count;
     
     protected:
         plugin_strip *create_strip(jack_host *plugin);
         void update_strip(plugin_ctl_iface *plugin);
         void sort_strips();
         static gboolean on_idle(void *data);
+        /// Show the DSP load statistics of a plugin
+        void update_load(plugin_strip *strip);
         std::string make_plugin_list(GtkActionGroup *actions);
         static void add_plugin_action(GtkWidget *src, gpointer data);
         void display_error(const char *error, const char *filename);
@@ -56,6 +56,7 @@ struct image_factory
 
 class plugin_gui;
 class jack_host;
+class gui_layout;
 
 class control_base
 {
@@ -143,7 +144,6 @@ class plugin_gui: public send_configure_iface, public send_updates_iface
 protected:
     int param_count;
     std::multimap<int, param_control *> par2ctl;
-    XML_Parser parser;
     control_base *top_container;
     std::map<std::string, int> param_name_map;
     int ignore_stack;
@@ -183,6 +183,8 @@ public:
 
     plugin_gui(plugin_gui_widget *_window);
     GtkWidget *create_from_xml(plugin_ctl_iface *_plugin, const char *xml);
+    /// Create the widgets from a precompiled layout (see get_gui_layout)
+    GtkWidget *create_from_layout(plugin_ctl_iface *_plugin, const gui_layout *layout);
     control_base *create_widget_from_xml(const char *element, const char *attributes[]);
 
     void add_param_ctl(int param, param_control *ctl) { par2ctl.insert(std::pair<int, param_control *>(param, ctl)); }
@@ -0,0 +1,117 @@
+/* Calf DSP Library
+ * Precompiled GUI layouts.
+ *
+ * Copyright (C) 2001-2010 Krzysztof Foltman, Markus Schmidt, Thor Harald Johansen and others
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02111-1307, USA.
+ */
+#ifndef CALF_GUI_LAYOUT_H
+#define CALF_GUI_LAYOUT_H
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "utils.h"
+
+namespace calf_plugins {
+
+/// A GUI definition (gui/*.xml, strips/*.xml) compiled into a flat element list, which is
+/// replayed as expat-style element callbacks - with no file access and no XML parsing
+class gui_layout
+{
+public:
+    typedef void (*start_handler)(void *user_data, const char *element, const char *attributes[]);
+    typedef void (*end_handler)(void *user_data, const char *element);
+
+    gui_layout() {}
+    /// Compile XML text, replacing the current contents
+    /// @retval false on parse error (described in error)
+    bool compile(const char *xml, std::string &error);
+    /// Call start for every element opening tag and end for every closing tag, in document order
+    void replay(void *user_data, start_handler start, end_handler end) const;
+    /// @return number of elements
+    int get_element_count() const { return nodes.size() / 2; }
+    /// Append the binary form to out
+    void serialize(std::string &out) const;
+    /// Read the binary form from [pos, end), advancing pos
+    /// @retval false if the data is truncated or inconsistent
+    bool deserialize(const char *&pos, const char *end);
+
+private:
+    /// Element opening or closing tag
+    struct node
+    {
+        /// Element name, as an offset into strings
+        int32_t element;
+        /// Start of the attribute list in attribute_offsets (-1 for a closing tag)
+        int32_t attributes;
+    };
+    /// All the names and values, NUL-terminated
+    std::string strings;
+    std::vector<node> nodes;
+    /// Name/value string offsets for each element, each list terminated by -1
+    std::vector<int32_t> attribute_offsets;
+    /// attribute_offsets converted to pointers, in the NULL-terminated form expected by the handlers
+    std::vector<const char *> attribute_ptrs;
+
+    /// Fill attribute_ptrs after strings or attribute_offsets have changed
+    void resolve();
+    // pointers into strings make copies unsafe
+    gui_layout(const gui_layout &);
+    gui_layout &operator=(const gui_layout &);
+
+    friend struct gui_layout_compiler;
+};
+
+/// Compiled layouts for all plugins, keyed by "prefix/plugin_id" (like gui/organ)
+class gui_layout_library
+{
+    std::unordered_map<std::string, gui_layout> layouts;
+    /// The compiled file has been looked for
+    bool file_checked;
+    calf_utils::ptmutex mutex;
+
+public:
+    gui_layout_library() : file_checked(false) {}
+    /// The process-wide library, populated from PKGLIBDIR "gui-layouts.bin"
+    static gui_layout_library &instance();
+    /// @return layout for a plugin (from the compiled file, or compiled from the XML file if it
+    /// isn't there), NULL if there's no GUI definition; the result stays valid for the life of the library
+    const gui_layout *get(const char *prefix, const char *plugin_id);
+    /// @return layout stored under a given key, NULL if there's none (no files are read)
+    const gui_layout *find(const std::string &key) const;
+    /// Compile an XML file and add it under a given key
+    /// @retval false if the file can't be read or parsed
+    bool add_xml_file(const std::string &key, const std::string &filename);
+    /// Compile all the XML files in a directory, under keys made of prefix and the file name
+    /// @return number of layouts added, -1 if the directory can't be read (reported on stderr)
+    int add_xml_directory(const std::string &prefix, const std::string &path);
+    /// Write all the layouts to a binary file (as made by calfmakerdf -m layouts)
+    bool save(const std::string &filename) const;
+    /// Add the layouts from a binary file
+    /// @retval false if the file is missing or not valid
+    bool load(const std::string &filename);
+    /// @return number of layouts in the library
+    int size() const { return layouts.size(); }
+};
+
+/// @return compiled layout of a plugin GUI (prefix is gui or strips), NULL if there is none
+extern const gui_layout *get_gui_layout(const char *prefix, const char *plugin_id);
+
+};
+
+#endif
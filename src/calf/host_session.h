@@ -30,6 +30,7 @@
 namespace calf_plugins {
 
 class main_window;
+struct plugin_preset;
 
 class host_session: public main_window_owner_iface, public session_client_iface
 {
@@ -64,6 +65,8 @@ public:
     volatile int quit_on_next_idle_call;
     /// JACK session event to handle on the next idle call
     jack_session_event_t *volatile handle_event_on_next_idle_call;
+    /// Number of xruns already reported on the console
+    uint32_t xruns_reported;
     /// File name of the current rack
     std::string current_filename;
     /// Jack session ID, if given via command line, otherwise empty
@@ -81,12 +84,35 @@ public:
     std::set<std::string> instances;
     bool has_gui;
     bool has_trayicon;
+    /// Lock the memory of the plugins in RAM as they are created (--lock-memory)
+    bool lock_memory;
     plugin_gui_window *gui_win;
     session_environment_iface *session_env;
     
+    /// A plugin to be created by add_plugins, with the state to restore
+    struct plugin_request
+    {
+        /// Plugin name, as on the command line
+        std::string name;
+        /// Instance name (empty = generated from the plugin name)
+        std::string instance_name;
+        /// Name of a user or built-in preset to activate
+        std::string preset_name;
+        /// Preset to activate (alternative to preset_name), must stay valid during add_plugins
+        const plugin_preset *preset;
+        /// Configure variables (MIDI automation etc.) to set after the preset
+        std::vector<std::pair<std::string, std::string> > configure_vars;
+        /// Port numbers (-1 = continue from the previous plugin)
+        int input_nr, output_nr, midi_nr;
+        plugin_request() : preset(NULL), input_nr(-1), output_nr(-1), midi_nr(-1) {}
+    };
+    
     host_session(session_environment_iface *);
     void open();
     void add_plugin(std::string name, std::string preset, std::string instance_name = std::string());
+    /// Create several plugins, constructing them and restoring their state in parallel; JACK ports
+    /// are registered afterwards, in the order of the list
+    void add_plugins(const std::vector<plugin_request> &requests);
     void create_plugins_from_list();
     void connect();
     void close();
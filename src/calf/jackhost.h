@@ -27,6 +27,7 @@
 
 #include "utils.h"
 #include "vumeter.h"
+#include <atomic>
 #include <pthread.h>
 #include <jack/jack.h>
 #include <jack/session.h>
@@ -40,7 +41,34 @@
 namespace calf_plugins {
 
 class jack_host;
-    
+
+/// Processing time of a plugin, written by the process thread and read by the GUI without locking
+struct dsp_load_meter
+{
+    enum { HISTORY = 256 };
+    /// Processing time in the last HISTORY periods, as a fraction of the period
+    float history[HISTORY];
+    /// Number of periods measured (history is written at count % HISTORY, before count is released)
+    std::atomic<uint32_t> count;
+    /// Number of xruns that happened while this plugin was processing, or after it took most of the period
+    std::atomic<uint32_t> xruns;
+
+    dsp_load_meter() : count(0), xruns(0)
+    {
+        for (int i = 0; i < HISTORY; i++)
+            history[i] = 0.f;
+    }
+    /// Add the load of one period (process thread only)
+    inline void add(float load)
+    {
+        uint32_t n = count.load(std::memory_order_relaxed);
+        history[n % HISTORY] = load;
+        count.store(n + 1, std::memory_order_release);
+    }
+    /// Calculate the mean, the 95th percentile and the maximum over the history
+    void get_stats(float &mean, float &p95, float &peak) const;
+};
+
 struct automation_iface
 {
     virtual uint32_t apply_and_adjust(uint32_t start, uint32_t time) = 0;
@@ -54,12 +82,27 @@ protected:
 
     /// Common port for MIDI parameter automation
     jack_port_t *automation_port;
+    /// Plugins in dependency order (upstream first), as used for latency propagation
+    std::vector<jack_host *> latency_order;
+    /// Plugin being processed right now (NULL between the plugins)
+    std::atomic<jack_host *> running_plugin;
+    /// Plugin that took the most time in the last period
+    std::atomic<jack_host *> busiest_plugin;
+    /// Number of xruns attributed to the plugins so far
+    uint32_t xruns_attributed;
 
 public:
     jack_client_t *client;
     int input_nr, output_nr, midi_nr;
     std::string name, input_name, output_name, midi_name;
     int sample_rate;
+    /// Set when connections or a plugin latency changed, cleared by the caller of update_latency_compensation
+    volatile bool latency_changed;
+    /// Number of xruns reported by JACK; incremented with release semantics after xrun_plugin is stored,
+    /// so a reader that loads it with acquire semantics sees the culprit of that xrun (or of a later one)
+    std::atomic<uint32_t> xrun_count;
+    /// Plugin that was running at the last xrun (or took most of the period before it), may be already deleted
+    std::atomic<jack_host *> xrun_plugin;
 
     jack_client();
     void add(jack_host *plugin);
@@ -76,9 +119,17 @@ public:
     void apply_plugin_order(const std::vector<int> &indices);
     void calculate_plugin_order(std::vector<int> &indices);
     const char **get_ports(const char *name_re, const char *type_re, unsigned long flags);
+    /// Recalculate the output delays that align the signals arriving at every port fed by the plugins,
+    /// and make JACK recompute the port latencies (main thread only)
+    void update_latency_compensation();
     
     static int do_jack_process(jack_nframes_t nframes, void *p);
     static int do_jack_bufsize(jack_nframes_t numsamples, void *p);
+    static int do_jack_graph_order(void *p);
+    static int do_jack_xrun(void *p);
+#if JACK_HAS_LATENCY
+    static void do_jack_latency(jack_latency_callback_mode_t mode, void *p);
+#endif
     template<class T>
     void atomic_swap(T &v1, T &v2)
     {
@@ -94,29 +145,45 @@ public:
         float *data;
         std::string name, nice_name;
         dsp::vumeter meter;
-        port() : handle(NULL), data(NULL) {}
+        /// Latency compensation delay line, as long as the delay (outputs only)
+        std::vector<float> delay_line;
+        uint32_t delay_pos;
+        port() : handle(NULL), data(NULL), delay_pos(0) {}
         ~port() { }
+        /// Delay the samples in place by the length of the delay line
+        void delay(float *buf, uint32_t len);
     };
 public:
     float **ins, **outs, **params;
     std::vector<port> inputs, outputs;
     float *param_values;
     float midi_meter;
+    /// MIDI events for the current process_part call
+    midi_event midi_queue[MAX_QUEUED_EVENTS];
     audio_module_iface *module;
     automation_map *cc_mappings;
+    /// cc_mappings compiled for handle_automation_cc, replaced together with it
+    automation_table *cc_table;
     std::vector<int> write_serials;
     int last_modify_serial;
     uint32_t last_designator;
+    /// Index of the latency reporting output parameter, -1 if none
+    int latency_param;
     
 public:
     typedef int (*process_func)(jack_nframes_t nframes, void *p);
     jack_client *client;
-    bool changed;
+    /// Parameters modified since the last params_changed call (by the GUI or MIDI automation)
+    shared_param_mask dirty_params;
     port midi_port;
     std::string name;
     std::string instance_name;
     int in_count, out_count, param_count;
     const plugin_metadata_iface *metadata;
+    /// Plugin latency in samples, as of the last process call
+    uint32_t latency;
+    /// Time taken by the process calls
+    dsp_load_meter load;
     
 public:
     jack_host(jack_client *_client, audio_module_iface *_module, const std::string &_name, const std::string &_instance_name, calf_plugins::progress_report_iface *_priface);
@@ -128,10 +195,8 @@ public:
     ~jack_host();
     
     void rename(std::string name);
-    /// Handle JACK MIDI port data
-    void handle_event(uint8_t *buffer, uint32_t size);
-    /// Process audio and update meters
-    void process_part(unsigned int time, unsigned int len);
+    /// Process audio with the queued MIDI events and update meters
+    void process_part(unsigned int time, unsigned int len, uint32_t event_count);
     /// Get meter value for the Nth port
     virtual float get_level(unsigned int port);
     /// Process audio/MIDI buffers
@@ -160,7 +225,7 @@ public:
     virtual void set_param_value(int param_no, float value) {
         assert(param_no >= 0 && param_no < param_count);
         param_values[param_no] = value;
-        changed = true;
+        dirty_params.set(param_no);
     }
     virtual std::string get_instance_name() { return instance_name; }
     virtual void execute(int cmd_no) { module->execute(cmd_no); }
@@ -171,6 +236,7 @@ public:
     virtual const plugin_metadata_iface *get_metadata_iface() const { return module->get_metadata_iface(); }
     virtual const line_graph_iface *get_line_graph_iface() const { return module->get_line_graph_iface(); }
     virtual const phase_graph_iface *get_phase_graph_iface() const { return module->get_phase_graph_iface(); }
+    virtual size_t get_memory_footprint() const { return module->get_memory_footprint(); }
     virtual int get_write_serial(int param_no) { return write_serials[param_no]; }
     virtual void add_automation(uint32_t source, const automation_range &dest);
     virtual void delete_automation(uint32_t source, int param_no);
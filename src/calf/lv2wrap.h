@@ -27,6 +27,7 @@
 #include <vector>
 #include "lv2/lv2plug.in/ns/lv2core/lv2.h"
 #include <calf/giface.h>
+#include <calf/display_stream.h>
 #include <calf/lv2_atom.h>
 #include <calf/lv2_atom_util.h>
 #include <calf/lv2_midi.h>
@@ -34,11 +35,12 @@
 #include <calf/lv2_options.h>
 #include <calf/lv2_progress.h>
 #include <calf/lv2_urid.h>
+#include <calf/lv2_worker.h>
 #include <string.h>
 
 namespace calf_plugins {
 
-struct lv2_instance: public plugin_ctl_iface, public progress_report_iface
+struct lv2_instance: public plugin_ctl_iface, public progress_report_iface, public worker_iface, public display_stream_output
 {
     const plugin_metadata_iface *metadata;
     audio_module_iface *module;
@@ -46,14 +48,27 @@ struct lv2_instance: public plugin_ctl_iface, public progress_report_iface
     int srate_to_set;
     LV2_Atom_Sequence *event_in_data, *event_out_data;
     uint32_t event_out_capacity;
+    /// MIDI events for the current process_slice_events call
+    midi_event midi_queue[MAX_QUEUED_EVENTS];
     LV2_URID_Map *urid_map;
-    uint32_t midi_event_type, property_type, string_type, sequence_type;
+    uint32_t midi_event_type, property_type, string_type, sequence_type, chunk_type;
     LV2_Progress *progress_report_feature;
     LV2_Options_Interface *options_feature;
+    LV2_Worker_Schedule *worker_schedule_feature;
+    /// True within run and work_response, the only places where the host accepts new worker jobs
+    bool in_run;
     float **ins, **outs, **params;
     int in_count;
     int out_count;
     int real_param_count;
+    /// Control port values seen in the previous run, used to find out which parameters changed
+    std::vector<float> last_param_values;
+    /// Indices of input (non-meter) parameters
+    std::vector<int> input_params;
+    /// Index of the latency reporting parameter (lv2:reportsLatency), -1 if none
+    int latency_param;
+    /// Parameters modified since the last params_changed call (set_param_value may be called by the GUI)
+    shared_param_mask dirty_params;
     struct lv2_var
     {
         std::string name;
@@ -61,6 +76,8 @@ struct lv2_instance: public plugin_ctl_iface, public progress_report_iface
     };
     std::vector<lv2_var> vars;
     std::map<uint32_t, int> uri_to_var;
+    /// Line graphs sent to the GUIs without instance access
+    display_stream_writer display;
 
     lv2_instance(audio_module_iface *_module);
     void lv2_instantiate(const LV2_Descriptor * Descriptor, double sample_rate, const char *bundle_path, const LV2_Feature *const *features);
@@ -82,6 +99,14 @@ struct lv2_instance: public plugin_ctl_iface, public progress_report_iface
     void send_configures(send_configure_iface *sci) { 
         module->send_configures(sci);
     }
+    virtual bool schedule_work(uint32_t size, const void *data) {
+        return in_run && (*worker_schedule_feature->schedule_work)(worker_schedule_feature->handle, size, data) == LV2_WORKER_SUCCESS;
+    }
+    void work_response(uint32_t size, const void *data) {
+        in_run = true;
+        module->work_response(size, data);
+        in_run = false;
+    }
     LV2_State_Status state_save(LV2_State_Store_Function store, LV2_State_Handle handle,
         uint32_t flags, const LV2_Feature *const * features);
     void impl_restore(LV2_State_Retrieve_Function retrieve, void *callback_data);
@@ -94,7 +119,7 @@ struct lv2_instance: public plugin_ctl_iface, public progress_report_iface
     {
         uint32_t remaining = event_out_capacity - event_out_data->atom.size;
         uint32_t hdr_size = sizeof(LV2_Atom_Event);
-        if (remaining < sizeof(LV2_Atom_Event) + data_size)
+        if (remaining < lv2_atom_pad_size(hdr_size + data_size))
             return NULL;
         LV2_Atom_Event *event = lv2_atom_sequence_end(&event_out_data->body, event_out_data->atom.size);
         event->time.frames = time_frames;
@@ -103,11 +128,18 @@ struct lv2_instance: public plugin_ctl_iface, public progress_report_iface
         event_out_data->atom.size += lv2_atom_pad_size(hdr_size + data_size);
         return ((uint8_t *)event) + hdr_size;
     }
+    virtual void *add_message(uint32_t size) { return add_event_to_seq(0, chunk_type, size); }
+    virtual uint32_t get_message_capacity() const {
+        uint32_t overhead = sizeof(LV2_Atom_Sequence_Body) + sizeof(LV2_Atom_Event);
+        return event_out_capacity > overhead ? (event_out_capacity - overhead) & ~7 : 0;
+    }
     void output_event_string(const char *str, int len = -1);
     void output_event_property(const char *key, const char *value);
     void process_event_string(const char *str);
     void process_event_property(const LV2_Atom_Property *prop);
-    void process_events(uint32_t &offset);
+    /// Process the audio with the events of the input sequence
+    void process_events(uint32_t sample_count);
+    void update_dirty_params();
     void run(uint32_t SampleCount, bool has_simulate_stereo_input_flag);
     virtual float get_param_value(int param_no)
     {
@@ -122,10 +154,12 @@ struct lv2_instance: public plugin_ctl_iface, public progress_report_iface
         if (param_no >= real_param_count)
             return;
         *params[param_no] = value;
+        dirty_params.set(param_no);
     }
     virtual const plugin_metadata_iface *get_metadata_iface() const { return metadata; }
     virtual const line_graph_iface *get_line_graph_iface() const { return module->get_line_graph_iface(); }
     virtual const phase_graph_iface *get_phase_graph_iface() const { return module->get_phase_graph_iface(); }
+    virtual size_t get_memory_footprint() const { return module->get_memory_footprint(); }
     virtual int send_status_updates(send_updates_iface *sui, int last_serial) { return module->send_status_updates(sui, last_serial); }
 };
 
@@ -133,6 +167,17 @@ struct LV2_Calf_Descriptor {
     plugin_ctl_iface *(*get_pci)(LV2_Handle Instance);
 };
 
+/// Passes the results of worker jobs to the host's respond function
+struct lv2_worker_response: public worker_response_iface
+{
+    LV2_Worker_Respond_Function respond_function;
+    LV2_Worker_Respond_Handle handle;
+
+    virtual bool respond(uint32_t size, const void *data) {
+        return (*respond_function)(handle, size, data) == LV2_WORKER_SUCCESS;
+    }
+};
+
 struct store_lv2_state: public send_configure_iface
 {
     LV2_State_Store_Function store;
@@ -151,6 +196,7 @@ struct lv2_wrapper
     static LV2_Descriptor descriptor;
     static LV2_Calf_Descriptor calf_descriptor;
     static LV2_State_Interface state_iface;
+    static LV2_Worker_Interface worker_interface;
     std::string uri;
     
     lv2_wrapper()
@@ -167,6 +213,9 @@ struct lv2_wrapper
         descriptor.extension_data = cb_ext_data;
         state_iface.save = cb_state_save;
         state_iface.restore = cb_state_restore;
+        worker_interface.work = cb_work;
+        worker_interface.work_response = cb_work_response;
+        worker_interface.end_run = NULL;
         calf_descriptor.get_pci = cb_get_pci;
     }
 
@@ -210,7 +259,7 @@ struct lv2_wrapper
 
     static LV2_Handle cb_instantiate(const LV2_Descriptor * Descriptor, double sample_rate, const char *bundle_path, const LV2_Feature *const *features)
     {
-        instance *mod = new instance(new Module);
+        instance *mod = new instance(new_audio_module<Module>());
         mod->lv2_instantiate(Descriptor, sample_rate, bundle_path, features);
         return mod;
     }
@@ -237,6 +286,8 @@ struct lv2_wrapper
             return &calf_descriptor;
         if (!strcmp(URI, LV2_STATE__interface))
             return &state_iface;
+        if (!strcmp(URI, LV2_WORKER__interface) && Module::use_worker)
+            return &worker_interface;
         return NULL;
     }
     static LV2_State_Status cb_state_save(
@@ -255,6 +306,24 @@ struct lv2_wrapper
         return LV2_STATE_SUCCESS;
     }
     
+    static LV2_Worker_Status cb_work(
+        LV2_Handle Instance, LV2_Worker_Respond_Function respond, LV2_Worker_Respond_Handle handle,
+        uint32_t size, const void *data)
+    {
+        instance *const inst = (instance *)Instance;
+        lv2_worker_response response;
+        response.respond_function = respond;
+        response.handle = handle;
+        inst->module->work(size, data, &response);
+        return LV2_WORKER_SUCCESS;
+    }
+    static LV2_Worker_Status cb_work_response(LV2_Handle Instance, uint32_t size, const void *data)
+    {
+        instance *const inst = (instance *)Instance;
+        inst->work_response(size, data);
+        return LV2_WORKER_SUCCESS;
+    }
+    
     static lv2_wrapper &get() { 
         static lv2_wrapper instance;
         return instance;
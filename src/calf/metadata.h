@@ -97,11 +97,27 @@ struct reverb_metadata: public plugin_metadata<reverb_metadata>
            par_decay, par_hfdamp, par_roomsize, par_diffusion, par_amount, par_dry, par_predelay, par_basscut, par_treblecut, par_on,
            param_level_in, param_level_out,
            param_meter_outL, param_meter_outR, param_clip_inL, param_clip_inR, param_clip_outR,
+           par_algorithm,
            param_count };
+    enum { algorithm_classic, algorithm_fdn, algorithm_count };
     enum { in_count = 2, out_count = 2, ins_optional = 0, outs_optional = 0, support_midi = false, require_midi = false, rt_capable = true, require_instance_access = false };
     PLUGIN_NAME_ID_LABEL("reverb", "reverb", "Reverb")
 };
 
+/// Convolution reverb - metadata
+struct convolution_reverb_metadata: public plugin_metadata<convolution_reverb_metadata>
+{
+    enum { param_bypass, param_level_in, param_level_out,
+           STEREO_VU_METER_PARAMS,
+           param_dry, param_wet, param_ir_length,
+           param_count };
+    enum { in_count = 2, out_count = 2, ins_optional = 0, outs_optional = 0, support_midi = false, require_midi = false, rt_capable = true, require_instance_access = false };
+    PLUGIN_NAME_ID_LABEL("convolution_reverb", "convolutionreverb", "Convolution Reverb")
+
+public:
+    void get_configure_vars(std::vector<std::string> &names) const;
+};
+
 struct vintage_delay_metadata: public plugin_metadata<vintage_delay_metadata>
 {
     enum {  param_on, param_level_in, param_level_out,
@@ -196,6 +212,7 @@ struct monosynth_metadata: public plugin_metadata<monosynth_metadata>
         par_o2unison, par_o2unisonfrq,
         par_osc1xpose,
         par_midi,
+        par_o2unisonvoices, par_o2unisonspread,
         param_count };
     enum { in_count = 0, out_count = 2, ins_optional = 0, outs_optional = 0, support_midi = true, require_midi = true, rt_capable = true, require_instance_access = false };
     enum { step_size = 64, step_shift = 6 };
@@ -356,7 +373,7 @@ struct limiter_metadata: public plugin_metadata<limiter_metadata>
            param_asc, param_asc_led, param_asc_coeff,
            param_oversampling,
            param_auto_level,
-           param_count };
+           param_latency, param_count };
     PLUGIN_NAME_ID_LABEL("limiter", "limiter", "Limiter")
 };
 
@@ -377,7 +394,7 @@ struct multibandlimiter_metadata: public plugin_metadata<multibandlimiter_metada
            param_asc, param_asc_led, param_asc_coeff,
            param_oversampling,
            param_auto_level,
-           param_count };
+           param_latency, param_count };
     PLUGIN_NAME_ID_LABEL("multibandlimiter", "multibandlimiter", "Multiband Limiter")
 };
 
@@ -399,7 +416,7 @@ struct sidechainlimiter_metadata: public plugin_metadata<sidechainlimiter_metada
            param_asc, param_asc_led, param_asc_coeff,
            param_oversampling, param_level_sc,
            param_auto_level,
-           param_count };
+           param_latency, param_count };
     PLUGIN_NAME_ID_LABEL("sidechainlimiter", "sidechainlimiter", "Sidechain Limiter")
 };
 
@@ -734,7 +751,7 @@ struct psyclipper_metadata: public plugin_metadata<psyclipper_metadata>
            param_protection8000,
            param_protection16000,
            param_margin_shift,
-           param_count };
+           param_latency, param_count };
     PLUGIN_NAME_ID_LABEL("psyclipper", "psyclipper", "Psychoacoustic Clipper")
 };
 /// Markus's Stereo Module - metadata
@@ -814,7 +831,7 @@ struct transientdesigner_metadata: public plugin_metadata<transientdesigner_meta
            param_sustain_threshold, param_release_time, param_release_boost,
            param_display, param_display_threshold, param_lookahead,
            param_view, param_hipass, param_lopass, param_hp_mode, param_lp_mode, param_listen,
-           param_count };
+           param_latency, param_count };
     PLUGIN_NAME_ID_LABEL("transientdesigner", "transientdesigner", "Transient Designer")
 };
 /// Markus's Vinyl Simulator
@@ -935,7 +952,7 @@ struct organ_enums
 /// Organ - metadata
 struct organ_metadata: public organ_enums, public plugin_metadata<organ_metadata>
 {
-    enum { in_count = 0, out_count = 2, ins_optional = 0, outs_optional = 0, support_midi = true, require_midi = true, rt_capable = true, require_instance_access = false };
+    enum { in_count = 0, out_count = 2, ins_optional = 0, outs_optional = 0, support_midi = true, require_midi = true, rt_capable = true, require_instance_access = false, use_worker = true };
     PLUGIN_NAME_ID_LABEL("organ", "organ", "Organ")
 
 public:
@@ -947,7 +964,7 @@ public:
 struct fluidsynth_metadata: public plugin_metadata<fluidsynth_metadata>
 {
     enum { par_master, par_interpolation, par_reverb, par_chorus, param_count };
-    enum { in_count = 0, out_count = 2, ins_optional = 0, outs_optional = 0, support_midi = true, require_midi = true, rt_capable = false, require_instance_access = true };
+    enum { in_count = 0, out_count = 2, ins_optional = 0, outs_optional = 0, support_midi = true, require_midi = true, rt_capable = false, require_instance_access = true, use_worker = true };
     PLUGIN_NAME_ID_LABEL("fluidsynth", "fluidsynth", "Fluidsynth")
 
 public:
@@ -22,7 +22,9 @@
 #define __CALF_MODMATRIX_H
  
 #include "giface.h"
+#include <atomic>
 #include <stdio.h>
+#include <vector>
 
 namespace dsp {
 
@@ -61,6 +63,15 @@ struct modulation_entry
     }
 };
 
+/// Active row of the modulation matrix, prepared for evaluation:
+/// moddest[dest] += (c[0] + c[1] * x + c[2] * x^2) * modsrc[src2], where x = modsrc[src1]
+/// (the mapping polynomial and the amount are combined into c)
+struct modulation_op
+{
+    int src1, src2, dest;
+    float c[3];
+};
+
 };
 
 namespace calf_plugins {
@@ -73,23 +84,71 @@ protected:
     unsigned int matrix_rows;
     /// Polynomials for different scaling modes (1, x, x^2)
     static const float scaling_coeffs[calf_plugins::mod_matrix_metadata::map_type_count][3];
+    enum { COMPILED_FRESH = 4 };
+    /// Three copies of the compiled matrix (triple buffer): the one used for processing,
+    /// the one being compiled and the latest one handed over between them
+    std::vector<dsp::modulation_op> compiled_ops[3];
+    int compiled_count[3];
+    /// Copy used by the audio thread
+    int compiled_front;
+    /// Copy overwritten by the next compile_matrix call
+    int compiled_back;
+    /// Copy handed over, with COMPILED_FRESH set if the audio thread hasn't picked it up yet
+    std::atomic<int> compiled_middle;
+    
+    /// Convert the rows that have any effect into a list of operations, called whenever the matrix
+    /// changes (by one thread at a time, which may run concurrently with the audio thread)
+    void compile_matrix();
+    /// @return copy of the compiled matrix to use, switching to the latest one if there is one;
+    /// the copy returned is never written to until the next call
+    inline int get_compiled()
+    {
+        if (compiled_middle.load(std::memory_order_relaxed) & COMPILED_FRESH)
+            compiled_front = compiled_middle.exchange(compiled_front, std::memory_order_acq_rel) & ~COMPILED_FRESH;
+        return compiled_front;
+    }
 
 public:
     mod_matrix_impl(dsp::modulation_entry *_matrix, calf_plugins::mod_matrix_metadata *_metadata);
 
-    /// Process modulation matrix, calculate outputs from inputs
+    /// Process modulation matrix, calculate outputs from inputs. The source 0 ("None") must be 1.
     inline void calculate_modmatrix(float *moddest, int moddest_count, float *modsrc)
     {
         for (int i = 0; i < moddest_count; i++)
             moddest[i] = 0;
-        for (unsigned int i = 0; i < matrix_rows; ++i)
+        int current = get_compiled();
+        const dsp::modulation_op *ops = &compiled_ops[current][0];
+        for (int i = 0; i < compiled_count[current]; ++i)
+        {
+            const dsp::modulation_op &op = ops[i];
+            float value = modsrc[op.src1];
+            moddest[op.dest] += (op.c[0] + (op.c[1] + op.c[2] * value) * value) * modsrc[op.src2];
+        }
+    }
+    /// Process modulation matrix for several voices at once. The values for voice v are
+    /// modsrc[src * stride + v] and moddest[dest * stride + v]. The voices are processed in
+    /// groups of 4, so stride must be a multiple of 4 (the values past the last voice are
+    /// calculated too). The source 0 ("None") must be 1.
+    inline void calculate_modmatrix_voices(float *moddest, int moddest_count, const float *modsrc, int stride, int voices)
+    {
+        int lanes = (voices + 3) & ~3;
+        for (int i = 0; i < moddest_count; i++)
+            for (int v = 0; v < lanes; v += 4)
+                for (int l = 0; l < 4; l++)
+                    moddest[i * stride + v + l] = 0;
+        int current = get_compiled();
+        const dsp::modulation_op *ops = &compiled_ops[current][0];
+        for (int i = 0; i < compiled_count[current]; ++i)
         {
-            dsp::modulation_entry &slot = matrix[i];
-            if (slot.dest) {
-                float value = modsrc[slot.src1];
-                const float *c = scaling_coeffs[slot.mapping];
-                value = c[0] + c[1] * value + c[2] * value * value;
-                moddest[slot.dest] += value * modsrc[slot.src2] * slot.amount;
+            const dsp::modulation_op &op = ops[i];
+            float c0 = op.c[0], c1 = op.c[1], c2 = op.c[2];
+            for (int v = 0; v < lanes; v += 4)
+            {
+                const float *__restrict x = modsrc + op.src1 * stride + v;
+                const float *__restrict y = modsrc + op.src2 * stride + v;
+                float *__restrict d = moddest + op.dest * stride + v;
+                for (int l = 0; l < 4; l++)
+                    d[l] += (c0 + (c1 + c2 * x[l]) * x[l]) * y[l];
             }
         }
     }
@@ -19,6 +19,7 @@
     
     // Reverb
     PER_MODULE_ITEM(reverb,              false, "reverb")
+    PER_MODULE_ITEM(convolution_reverb,  false, "convolutionreverb")
     
     // Delay
     PER_MODULE_ITEM(vintage_delay,       false, "vintagedelay")
@@ -32,7 +32,11 @@
 #include "metadata.h"
 #include "loudness.h"
 #include <math.h>
+#include <atomic>
+#include <semaphore.h>
+#include "convolver.h"
 #include "plugin_tools.h"
+#include "utils.h"
 
 namespace calf_plugins {
 
@@ -47,12 +51,15 @@ class reverb_audio_module: public audio_module<reverb_metadata>
     vumeters meters;
 public:    
     dsp::reverb reverb;
+    dsp::fdn_reverb fdn;
     dsp::simple_delay<131072, dsp::stereo_sample<float> > pre_delay;
     dsp::onepole<float> left_lo, right_lo, left_hi, right_hi;
     uint32_t srate;
     dsp::gain_smoothing amount, dryamount;
     int predelay_amt;
+    int algorithm;
     
+    reverb_audio_module();
     void params_changed();
     uint32_t process(uint32_t offset, uint32_t numsamples, uint32_t inputs_mask, uint32_t outputs_mask);
     void activate();
@@ -60,6 +67,51 @@ public:
     void deactivate();
 };
 
+/**********************************************************************
+ * CONVOLUTION REVERB
+**********************************************************************/
+
+class convolution_reverb_audio_module: public audio_module<convolution_reverb_metadata>
+{
+    vumeters meters;
+    dsp::bypass bypass;
+    dsp::gain_smoothing dry, wet;
+    uint32_t srate;
+    /// Convolver used by process()
+    dsp::convolver *conv;
+    /// Convolver prepared by the loader thread, picked up by process()
+    std::atomic<dsp::convolver *> pending;
+    /// Convolver replaced by process(), deleted by the loader thread
+    std::atomic<dsp::convolver *> retired;
+
+    /// Impulse responses are loaded, resampled and transformed on a separate thread,
+    /// which also frees the old convolvers (so that nothing of that happens in process())
+    pthread_t loader;
+    sem_t loader_wakeup;
+    std::atomic<bool> loader_quit;
+    /// Protects the variables below (shared between configure, the loader and the GUI)
+    calf_utils::ptmutex file_mutex;
+    std::string ir_file, ir_status;
+    /// Sample rate of the last load (0 = the file needs to be loaded again)
+    uint32_t loaded_srate;
+    /// Incremented by the loader thread when ir_status changes, read by the GUI thread
+    std::atomic<int> status_serial;
+
+    static void *loader_thread(void *arg);
+    void load_impulse_response();
+public:
+    convolution_reverb_audio_module();
+    ~convolution_reverb_audio_module();
+    void params_changed();
+    uint32_t process(uint32_t offset, uint32_t numsamples, uint32_t inputs_mask, uint32_t outputs_mask);
+    void activate();
+    void set_sample_rate(uint32_t sr);
+    void deactivate();
+    char *configure(const char *key, const char *value);
+    void send_configures(send_configure_iface *sci);
+    int send_status_updates(send_updates_iface *sui, int last_serial);
+};
+
 /**********************************************************************
  * VINTAGE DELAY by Krzysztof Foltman
 **********************************************************************/
@@ -71,7 +123,8 @@ public:
     enum { MAX_DELAY = 524288, ADDR_MASK = MAX_DELAY - 1 };
     enum { MIXMODE_STEREO, MIXMODE_PINGPONG, MIXMODE_LR, MIXMODE_RL }; 
     enum { FRAG_PERIODIC, FRAG_PATTERN };
-    float buffers[2][MAX_DELAY];
+    /// MAX_DELAY samples per channel, in the arena
+    float *buffers[2];
     int bufptr, deltime_l, deltime_r, mixmode, medium, old_medium;
     /// number of table entries written (value is only important when it is less than MAX_DELAY, which means that the buffer hasn't been totally filled yet)
     int age;
@@ -82,9 +135,14 @@ public:
     
     uint32_t srate;
     
+    /// Derived values recalculated on parameter changes
+    enum { coeff_timing, coeff_gains, coeff_dry, coeff_width, coeff_count };
+    coeff_cache<coeff_count> coeffs;
+    
     vintage_delay_audio_module();
     
     void params_changed();
+    void params_changed(const param_mask &dirty);
     void activate();
     void deactivate();
     void set_sample_rate(uint32_t sr);
@@ -123,7 +181,6 @@ public:
     vumeters meters;
 
     comp_delay_audio_module();
-    virtual ~comp_delay_audio_module();
 
     void params_changed();
     void activate();
@@ -152,7 +209,6 @@ public:
     float s_bal_l[2], s_bal_r[2];
 
     haas_enhancer_audio_module();
-    virtual ~haas_enhancer_audio_module();
 
     void params_changed();
     void activate();
@@ -168,8 +224,11 @@ public:
 class reverse_delay_audio_module: public audio_module<reverse_delay_metadata>
 {
 public:
-    enum { MAX_DELAY = 6144000, ADDR_MASK = MAX_DELAY - 1 };
-    float buffers[2][MAX_DELAY];
+    /// Longest delay: 16 beats at 30 BPM
+    enum { MAX_DELAY_SECONDS = 32 };
+    /// buffer_size samples per channel, in the arena (sized for the sample rate)
+    float *buffers[2];
+    uint32_t buffer_size;
     int counters[2];
     dsp::overlap_window ow[2];
     int deltime_l, deltime_r;
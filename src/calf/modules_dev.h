@@ -35,6 +35,28 @@ namespace calf_plugins {
 class fluidsynth_audio_module: public audio_module<fluidsynth_metadata>
 {
 protected:
+    /// A synth object with a soundfont loaded, along with the information read from the soundfont.
+    /// Created off the audio thread and swapped with the module's current state in O(1).
+    struct loaded_soundfont
+    {
+        fluid_settings_t *settings;
+        fluid_synth_t *synth;
+        int sfid;
+        std::string soundfont, soundfont_name, soundfont_preset_list;
+        std::map<uint32_t, std::string> sf_preset_names;
+
+        loaded_soundfont();
+        ~loaded_soundfont();
+    };
+    /// Worker thread job types
+    enum { job_load_soundfont, job_free_soundfont };
+    /// Worker thread job message, followed by the soundfont file name for job_load_soundfont
+    struct soundfont_job
+    {
+        int type;
+        loaded_soundfont *data;
+    };
+
     /// Current sample rate
     uint32_t srate;
     /// FluidSynth Settings object
@@ -59,12 +81,19 @@ protected:
     volatile int set_presets[16];
     volatile bool soundfont_loaded;
 
-    /// Update last_selected_preset based on synth object state
+    /// Convert a MIDI channel (numbered from 1) to FluidSynth's channel index, -1 if out of range
+    static int synth_channel(int channel) { return (channel >= 1 && channel <= 16) ? channel - 1 : -1; }
+    /// Update last_selected_preset based on synth object state (ch = FluidSynth channel index)
     void update_preset_num(int channel);
     /// Send a bank/program change sequence for a specific channel/preset combo
     void select_preset_in_channel(int ch, int new_preset);
-    /// Create a fluidsynth object and load the current soundfont
-    fluid_synth_t *create_synth(int &new_sfid);
+    /// Create a fluidsynth object and load a soundfont (empty file name = none); not realtime safe
+    /// @return NULL if the soundfont could not be loaded
+    loaded_soundfont *load_soundfont(const std::string &filename);
+    /// Exchange the current synth and soundfont information with the ones in data (O(1), no allocation)
+    void swap_soundfont(loaded_soundfont *data);
+    /// Free the soundfont data on the worker thread if possible
+    void free_soundfont(loaded_soundfont *data);
 public:
     /// Constructor to initialize handles to NULL
     fluidsynth_audio_module();
@@ -78,7 +107,9 @@ public:
     /// Handle pitch bend message.
     inline void pitch_bend(int channel, int value)
     {
-        fluid_synth_pitch_bend(synth, channel, value + 0x2000);
+        int ch = synth_channel(channel);
+        if (ch >= 0)
+            fluid_synth_pitch_bend(synth, ch, value + 0x2000);
     }
     /// Handle control change messages.
     void control_change(int channel, int controller, int value);
@@ -98,6 +129,10 @@ public:
     uint32_t process(uint32_t offset, uint32_t nsamples, uint32_t inputs_mask, uint32_t outputs_mask);
     /// DSSI-style configure function for handling string port data
     char *configure(const char *key, const char *value);
+    /// Load a soundfont or free an old one on the worker thread
+    void work(uint32_t size, const void *data, worker_response_iface *response);
+    /// Swap in a soundfont loaded by the worker thread
+    void work_response(uint32_t size, const void *data);
     void send_configures(send_configure_iface *sci);
     int send_status_updates(send_updates_iface *sui, int last_serial);
     uint32_t message_run(const void *valid_inputs, void *output_ports) { 
@@ -390,7 +390,6 @@ public:
     vumeters meters;
     dsp::crossover crossover;
     xover_audio_module();
-    ~xover_audio_module();
     void activate();
     void deactivate();
     void params_changed();
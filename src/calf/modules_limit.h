@@ -59,6 +59,7 @@ public:
     void set_srates();
     uint32_t process(uint32_t offset, uint32_t numsamples, uint32_t inputs_mask, uint32_t outputs_mask);
     void set_sample_rate(uint32_t sr);
+    uint32_t get_latency();
 };
 
 /**********************************************************************
@@ -96,13 +97,13 @@ public:
     uint32_t srate;
     bool is_active;
     multibandlimiter_audio_module();
-    ~multibandlimiter_audio_module();
     void activate();
     void deactivate();
     void params_changed();
     void set_srates();
     uint32_t process(uint32_t offset, uint32_t numsamples, uint32_t inputs_mask, uint32_t outputs_mask);
     void set_sample_rate(uint32_t sr);
+    uint32_t get_latency();
     bool get_graph(int index, int subindex, int phase, float *data, int points, cairo_iface *context, int *mode) const;
     bool get_layers(int index, int generation, unsigned int &layers) const;
 };
@@ -138,13 +139,13 @@ public:
     uint32_t srate;
     bool is_active;
     sidechainlimiter_audio_module();
-    ~sidechainlimiter_audio_module();
     void activate();
     void deactivate();
     void params_changed();
     void set_srates();
     uint32_t process(uint32_t offset, uint32_t numsamples, uint32_t inputs_mask, uint32_t outputs_mask);
     void set_sample_rate(uint32_t sr);
+    uint32_t get_latency();
     bool get_graph(int index, int subindex, int phase, float *data, int points, cairo_iface *context, int *mode) const;
     bool get_layers(int index, int generation, unsigned int &layers) const;
 };
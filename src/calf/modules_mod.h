@@ -143,6 +143,9 @@ public:
     float maspeed_h;
     
     int meter_l, meter_h;
+    /// Derived coefficient groups recalculated on parameter changes
+    enum { coeff_damper, coeff_count };
+    coeff_cache<coeff_count> coeffs;
     
     rotary_speaker_audio_module();
     void set_sample_rate(uint32_t sr);
@@ -151,6 +154,7 @@ public:
     void deactivate();
     
     void params_changed();
+    void params_changed(const param_mask &dirty);
     void set_vibrato();
     /// Convert RPM speed to delta-phase
     uint32_t rpm2dphase(float rpm);
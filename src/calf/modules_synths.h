@@ -46,6 +46,8 @@ public:
     dsp::waveform_oscillator<MONOSYNTH_WAVE_BITS> osc1, osc2, detosc;
     dsp::triangle_lfo lfo1, lfo2;
     dsp::simple_oscillator unison_osc;
+    /// Detuned copies of OSC2
+    dsp::waveform_unison<MONOSYNTH_WAVE_BITS> unison_bank;
     dsp::biquad_d1_lerp filter, filter2;
     /// The step code is producing non-zero values
     bool running;
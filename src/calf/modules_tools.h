@@ -63,7 +63,6 @@ class stereo_audio_module:
     float _phase, _phase_sin_coef, _phase_cos_coef, _sc_level, _inv_atan_shape;
 public:
     stereo_audio_module();
-    ~stereo_audio_module();
     void params_changed();
     void activate();
     void set_sample_rate(uint32_t sr);
@@ -96,7 +95,6 @@ class mono_audio_module:
     float _phase, _phase_sin_coef, _phase_cos_coef, _sc_level, _inv_atan_shape;
 public:
     mono_audio_module();
-    ~mono_audio_module();
     void params_changed();
     void activate();
     void set_sample_rate(uint32_t sr);
@@ -133,7 +131,6 @@ public:
     bool get_moving(int index, int subindex, int &direction, float *data, int x, int y, int &offset, uint32_t &color) const;
     bool get_gridline(int index, int subindex, int phase, float &pos, bool &vertical, std::string &legend, cairo_iface *context) const;
     bool get_layers(int index, int generation, unsigned int &layers) const;
-    ~analyzer_audio_module();
 protected:
     static const int max_phase_buffer_size = 8192;
     int phase_buffer_size;
@@ -164,7 +161,6 @@ public:
     uint32_t srate;
     bool is_active;
     multibandenhancer_audio_module();
-    ~multibandenhancer_audio_module();
     void activate();
     void deactivate();
     void params_changed();
@@ -198,7 +194,6 @@ public:
     float amount0, amount1, amount2, amount3, filters, intensity;
     float fcoeff;
     multispread_audio_module();
-    ~multispread_audio_module();
     void activate();
     void deactivate();
     void params_changed();
@@ -92,9 +92,30 @@ public:
         // apply the voice offset/depth (rescale from -65535..65535 to appropriate voice's "band")
         return -65535 + voice * voice_offset + ((voice_depth >> (30-13)) * (65536 + intval) >> 13);
     }
+    /// Get LFO values (same as get_value) for given voice and count consecutive samples starting from the current phase;
+    /// the phase is not advanced, and if running is false, all the values are the same
+    inline void get_values(uint32_t voice, int *values, int count, bool running) const {
+        uint32_t voice_phase = (phase + vphase * (int)voice).get();
+        uint32_t step = running ? dphase.get() : 0;
+        int offset = -65535 + voice * voice_offset;
+        uint32_t depth = voice_depth >> (30-13);
+        // same arithmetic as get_value, written out on the raw phase values so that the loop can be vectorized
+        for (int i = 0; i < count; i++) {
+            uint32_t p = voice_phase + i * step;
+            unsigned int ipart = p >> 20;
+            int fpart = (p & 0xFFFFF) >> (20 - 14);
+            int v1 = sine.data[ipart], v2 = sine.data[ipart + 1];
+            int intval = v1 + ((v2 - v1) * fpart >> 14);
+            values[i] = offset + (int)(depth * (65536 + intval) >> 13);
+        }
+    }
     inline void step() {
         phase += dphase;
     }
+    /// Advance the phase by count samples
+    inline void step(int count) {
+        phase += dphase * count;
+    }
     inline T get_scale() const {
         return scale;
     }
@@ -111,6 +132,7 @@ template<class T, class MultiLfo, class Postprocessor, int MaxDelay=4096>
 class multichorus: public chorus_base
 {
 protected:
+    enum { BlockSize = 64 };
     simple_delay<MaxDelay,T> delay;
 public:    
     MultiLfo lfo;
@@ -150,32 +172,47 @@ public:
         // NB: calculation of mod_depth_samples (and multiply-by-32) is in chorus_base::set_mod_depth
         mdepth = mdepth >> 2;
         T scale = lfo.get_scale();
-        for (int i=0; i<nsamples; i++) {
-            if (lfo_active)
-                phase += dphase;
-            float in = *buf_in++ * level_in;
-            
-            delay.put(in);
-            unsigned int nvoices = lfo.get_voices();
-            T out = 0.f;
+        unsigned int nvoices = lfo.get_voices();
+        T in[BlockSize], out[BlockSize];
+        int lfo_output[BlockSize];
+        const T *data = &delay.data[0];
+        // Processed in blocks: the whole block is written into the delay line first, then the taps are read voice by voice
+        // (with LFO values computed for the whole block). This gives the same result as doing it sample by sample,
+        // as long as the longest tap plus the block length fits in the delay line (20 ms + 64 samples at 192 kHz does).
+        while(nsamples > 0) {
+            int len = std::min<int>(nsamples, BlockSize);
+            for (int i = 0; i < len; i++) {
+                in[i] = *buf_in++ * level_in;
+                delay.put(in[i]);
+                out[i] = 0.f;
+            }
+            // write position just after sample i was written
+            int base = delay.pos - len + 1 + MaxDelay;
             // add up values from all voices, each voice tell its LFO phase and the buffer value is picked at that location
             for (unsigned int v = 0; v < nvoices; v++)
             {
-                int lfo_output = lfo.get_value(v);
-                // 3 = log2(32 >> 2) + 1 because the LFO value is in range of [-65535, 65535] (17 bits)
-                int dv = mds + (mdepth * lfo_output >> (3 + 1));
-                int ifv = dv >> 16;
-                T fd; // signal from delay's output
-                delay.get_interp(fd, ifv, (dv & 0xFFFF)*(1.0/65536.0));
-                out += fd;
+                lfo.get_values(v, lfo_output, len, lfo_active);
+                for (int i = 0; i < len; i++)
+                {
+                    // 3 = log2(32 >> 2) + 1 because the LFO value is in range of [-65535, 65535] (17 bits)
+                    int dv = mds + (mdepth * lfo_output[i] >> (3 + 1));
+                    int ppos = (base + i - (dv >> 16)) & (MaxDelay - 1);
+                    float udelay = (dv & 0xFFFF)*(1.0/65536.0);
+                    out[i] += lerp(data[ppos], data[(ppos - 1) & (MaxDelay - 1)], udelay);
+                }
+            }
+            for (int i = 0; i < len; i++) {
+                // apply the post filter
+                T wet = post.process(out[i]);
+                T sdry = in[i] * gs_dry.get();
+                T swet = wet * gs_wet.get() * scale;
+                *buf_out++ = (sdry + (active ? swet : 0)) * level_out;
+            }
+            if (lfo_active) {
+                phase += dphase * len;
+                lfo.step(len);
             }
-            // apply the post filter
-            out = post.process(out);
-            T sdry = in * gs_dry.get();
-            T swet = out * gs_wet.get() * scale;
-            *buf_out++ = (sdry + (active ? swet : 0)) * level_out;
-            if (lfo_active)
-                lfo.step();
+            nsamples -= len;
         }
         post.sanitize();
     }
@@ -29,6 +29,8 @@
 #include <numeric>
 #include <algorithm>
 #include <functional>
+#include <new>
+#include "arena.h"
 
 namespace OrfanidisEq {
 
@@ -420,6 +422,37 @@ public:
 	}
 };
 
+/*
+ * Fixed capacity list of FO sections (a filter of order N needs at most
+ * N/2 + 1), so that a filter is a single block of memory that can be
+ * placed in a per-instance arena.
+ */
+static const size_t maxFOSections = defaultEqBandPassFiltersOrder / 2 + 1;
+
+class FOSectionList {
+	FOSection items[maxFOSections];
+	size_t count;
+
+public:
+	FOSectionList() : count(0) {}
+
+	void push_back(const FOSection& s)
+	{
+		if (count < maxFOSections)
+			items[count++] = s;
+	}
+
+	size_t size() const
+	{
+		return count;
+	}
+
+	FOSection& operator[](size_t i)
+	{
+		return items[i];
+	}
+};
+
 /*
  * Bandpass filter representation.
  */
@@ -432,7 +465,7 @@ public:
 };
 
 class ButterworthBPFilter : public BPFilter {
-	std::vector<FOSection> sections;
+	FOSectionList sections;
 
 	ButterworthBPFilter() {}
 public:
@@ -520,7 +553,7 @@ public:
 };
 
 class ChebyshevType1BPFilter : public BPFilter {
-	std::vector<FOSection> sections;
+	FOSectionList sections;
 
 	ChebyshevType1BPFilter() {}
 public:
@@ -606,7 +639,7 @@ public:
 };
 
 class ChebyshevType2BPFilter : public BPFilter {
-	std::vector<FOSection> sections;
+	FOSectionList sections;
 
 	ChebyshevType2BPFilter() {}
 public:
@@ -695,7 +728,7 @@ class EllipticTypeBPFilter : public BPFilter {
 private:
 	/* complex -1. */
 	std::complex<eq_double_t> j;
-	std::vector<FOSection> sections;
+	FOSectionList sections;
 
 	EllipticTypeBPFilter() {}
 
@@ -896,7 +929,7 @@ private:
 	 * Bilinear transformation of analog second-order sections.
 	 */
 	void blt(const std::vector<SOSection>& aSections, eq_double_t w0,
-	    std::vector<FOSection>& sections)
+	    FOSectionList& sections)
 	{
 		eq_double_t c0 = cos(w0);
 		size_t K = aSections.size();
@@ -1134,14 +1167,33 @@ class EqChannel {
 	size_t currentFilterIndex;
 	eq_double_t currentGainDb;
 
-	std::vector<BPFilter*> filters;
+	/*
+	 * Filters for every gain value, one slot of filterSlotSize() bytes
+	 * each, taken from the arena if there is one (else from the heap).
+	 */
+	dsp::memory_arena *arena;
+	char *filters;
+	size_t numberOfFilters;
 	filter_type currentChannelType;
 
 	EqChannel() {}
 
+	static size_t filterSlotSize()
+	{
+		size_t size = std::max(sizeof(ButterworthBPFilter),
+		    sizeof(ChebyshevType1BPFilter));
+		size = std::max(size, sizeof(ChebyshevType2BPFilter));
+
+		return std::max(size, sizeof(EllipticTypeBPFilter));
+	}
+
+	BPFilter* getFilter(size_t i)
+	{
+		return (BPFilter*)(filters + i * filterSlotSize());
+	}
+
 	size_t getFltIndex(eq_double_t gainDb)
 	{
-		size_t numberOfFilters = filters.size();
 		eq_double_t scaleCoef = gainDb / gainRangeDb;
 
 		return (numberOfFilters / 2) + (numberOfFilters / 2) * scaleCoef;
@@ -1149,21 +1201,26 @@ class EqChannel {
 
 	void cleanupFiltersArray()
 	{
-		for(size_t j = 0; j < filters.size(); j++)
-			delete filters[j];
+		for(size_t j = 0; j < numberOfFilters; j++)
+			getFilter(j)->~BPFilter();
+		numberOfFilters = 0;
 	}
 
 public:
 	EqChannel(filter_type ft,
 	    eq_double_t fs, eq_double_t f0, eq_double_t fb,
 	    eq_double_t gainRangeDb = eqGainRangeDb,
-	    eq_double_t gainStepDb = eqGainStepDb)
+	    eq_double_t gainStepDb = eqGainStepDb,
+	    dsp::memory_arena *arena = NULL)
 	{
 		samplingFrequency = fs;
 		this->f0 = f0;
 		this->fb = fb;
 		this->gainRangeDb = gainRangeDb;
 		this->gainStepDb = gainStepDb;
+		this->arena = arena;
+		filters = NULL;
+		numberOfFilters = 0;
 		currentGainDb = 0;
 		currentFilterIndex = 0;
 		currentChannelType = ft;
@@ -1174,28 +1231,54 @@ public:
 	~EqChannel()
 	{
 		cleanupFiltersArray();
+		if (!arena)
+			delete []filters;
+	}
+
+	/*
+	 * Recalculate the filters for another band or sample rate, reusing
+	 * their memory.
+	 */
+	eq_error_t setBand(filter_type ft,
+	    eq_double_t fs, eq_double_t f0, eq_double_t fb)
+	{
+		this->f0 = f0;
+		this->fb = fb;
+		currentChannelType = ft;
+
+		return setChannel(ft, fs);
 	}
 
 	eq_error_t setChannel(filter_type ft, eq_double_t fs)
 	{
-		(void)fs;
+		samplingFrequency = fs;
 
 		eq_double_t wb = Conversions::hz2Rad(fb, samplingFrequency);
 		eq_double_t w0 = Conversions::hz2Rad(f0, samplingFrequency);
 
-		for (eq_double_t gain = -gainRangeDb; gain <= gainRangeDb;
-		    gain+= gainStepDb) {
+		cleanupFiltersArray();
+		/* One slot more than needed, in case the gain steps don't add up exactly. */
+		size_t maxFilters = (size_t)(2 * gainRangeDb / gainStepDb) + 2;
+		if (arena)
+			filters = arena->realloc(filters,
+			    maxFilters * filterSlotSize());
+		else {
+			delete []filters;
+			filters = new char[maxFilters * filterSlotSize()];
+		}
+
+		for (eq_double_t gain = -gainRangeDb; gain <= gainRangeDb &&
+		    numberOfFilters < maxFilters; gain+= gainStepDb) {
+			void *slot = filters + numberOfFilters * filterSlotSize();
+
 			switch(ft) {
 			case (butterworth): {
 				eq_double_t bw_gain =
 				    ButterworthBPFilter::computeBWGainDb(gain);
 
-				ButterworthBPFilter* bf =
-				    new ButterworthBPFilter(
+				new (slot) ButterworthBPFilter(
 				    defaultEqBandPassFiltersOrder, w0,
 				    wb, gain, bw_gain);
-
-				filters.push_back(bf);
 				break;
 			}
 
@@ -1203,12 +1286,9 @@ public:
 				eq_double_t bwGain =
 				    ChebyshevType1BPFilter::computeBWGainDb(gain);
 
-				ChebyshevType1BPFilter* cf1 =
-				    new ChebyshevType1BPFilter(
+				new (slot) ChebyshevType1BPFilter(
 				    defaultEqBandPassFiltersOrder, w0,
 				    wb, gain, bwGain);
-
-				filters.push_back(cf1);
 				break;
 			}
 
@@ -1216,12 +1296,9 @@ public:
 				eq_double_t bwGain =
 				    ChebyshevType2BPFilter::computeBWGainDb(gain);
 
-				ChebyshevType2BPFilter* cf2 =
-				    new ChebyshevType2BPFilter(
+				new (slot) ChebyshevType2BPFilter(
 				    defaultEqBandPassFiltersOrder, w0,
 				    wb, gain, bwGain);
-
-				filters.push_back(cf2);
 				break;
 			}
 
@@ -1229,12 +1306,9 @@ public:
 				eq_double_t bwGain =
 				    EllipticTypeBPFilter::computeBWGainDb(gain);
 
-				EllipticTypeBPFilter* e =
-				    new EllipticTypeBPFilter(
+				new (slot) EllipticTypeBPFilter(
 				    defaultEqBandPassFiltersOrder, w0,
 				    wb, gain, bwGain);
-
-				filters.push_back(e);
 				break;
 			}
 
@@ -1243,6 +1317,7 @@ public:
 				return invalid_input_data_error;
 			}
 			}
+			numberOfFilters++;
 		}
 
 		/* Get current filter index. */
@@ -1266,7 +1341,7 @@ public:
 
 	eq_error_t SBSProcess(eq_double_t *in, eq_double_t *out)
 	{
-		*out = filters[currentFilterIndex]->process(*in);
+		*out = getFilter(currentFilterIndex)->process(*in);
 
 		return no_error;
 	}
@@ -1297,6 +1372,7 @@ class Eq {
 	FrequencyGrid freqGrid;
 	std::vector<EqChannel*> channels;
 	filter_type currentEqType;
+	dsp::memory_arena *arena;
 
 	void cleanupChannelsArray()
 	{
@@ -1305,7 +1381,9 @@ class Eq {
 	}
 
 public:
-	Eq(FrequencyGrid &fg, filter_type eq_t) : conv(46)
+	/* The filters are allocated from arena if it's not NULL. */
+	Eq(FrequencyGrid &fg, filter_type eq_t,
+	    dsp::memory_arena *arena = NULL) : conv(46), arena(arena)
 	{
 		samplingFrequency = defaultSampleFreqHz;
 		freqGrid = fg;
@@ -1320,19 +1398,28 @@ public:
 
 	eq_error_t setEq(const FrequencyGrid& fg, filter_type ft)
 	{
-		cleanupChannelsArray();
-		channels.clear();
-
 		freqGrid = fg;
 		currentEqType = ft;
 
+		/* Keep the channels (and their filter memory) if the number of bands is the same. */
+		if (channels.size() != freqGrid.getNumberOfBands()) {
+			cleanupChannelsArray();
+			channels.clear();
+		}
+
 		for (size_t i = 0; i < freqGrid.getNumberOfBands(); i++) {
 			Band bFres = freqGrid.getFreqs()[i];
 
-			EqChannel* eq_ch = new EqChannel(ft, samplingFrequency,
-			    bFres.centerFreq, bFres.maxFreq - bFres.minFreq);
+			if (i < channels.size()) {
+				channels[i]->setBand(ft, samplingFrequency,
+				    bFres.centerFreq, bFres.maxFreq - bFres.minFreq);
+			} else {
+				EqChannel* eq_ch = new EqChannel(ft, samplingFrequency,
+				    bFres.centerFreq, bFres.maxFreq - bFres.minFreq,
+				    eqGainRangeDb, eqGainStepDb, arena);
 
-			channels.push_back(eq_ch);
+				channels.push_back(eq_ch);
+			}
 			channels[i]->setGainDb(eqDefaultGainDb);
 		}
 
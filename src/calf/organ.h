@@ -159,6 +159,24 @@ protected:
         // wrap to fit within the wave
         return ph.lerp_table_lookup_float_mask(data, ORGAN_BIG_WAVE_SIZE - 1);
     }
+    /// Same as wave() for len consecutive phases ph + i * dph (20 fractional bits), in a loop that can be vectorized
+    static inline void wave_block(const float *data, uint32_t ph, uint32_t dph, float *out, int len) {
+        for (int i = 0; i < len; i++) {
+            uint32_t p = ph + i * dph;
+            unsigned int pos = p >> 20;
+            float frac = (p & 0xFFFFF) * (1.f / 0x100000);
+            out[i] = data[pos] + (data[pos + 1] - data[pos]) * frac;
+        }
+    }
+    /// Same as big_wave() for len consecutive phases ph + i * dph (20 fractional bits), in a loop that can be vectorized
+    static inline void big_wave_block(const float *data, uint64_t ph, uint64_t dph, float *out, int len) {
+        for (int i = 0; i < len; i++) {
+            uint64_t p = ph + i * dph;
+            unsigned int pos = (unsigned int)(p >> 20) & (ORGAN_BIG_WAVE_SIZE - 1);
+            float frac = (p & 0xFFFFF) * (1.f / 0x100000);
+            out[i] = data[pos] + (data[pos + 1] - data[pos]) * frac;
+        }
+    }
 public:
     static inline small_wave_family &get_wave(int wave) {
         return (*waves)[wave];
@@ -166,7 +184,10 @@ public:
     static inline big_wave_family &get_big_wave(int wave) {
         return (*big_waves)[wave];
     }
+    /// Calculate the wave tables shared by all instances, if not done yet
     static void precalculate_waves(calf_plugins::progress_report_iface *reporter);
+    /// @return true if the wave tables are ready for use (can be called from any thread)
+    static bool waves_precalculated();
     void update_pitch();
     // this doesn't really have a voice interface
     void render_percussion_to(float (*buf)[2], int nsamples);
@@ -195,7 +216,8 @@ public:
 /// selected outputs of the line box.
 ///
 /// @note
-/// This is a true CPU hog, and it should be optimised some day.
+/// This is a true CPU hog. In per-voice mode, process_voices() runs the line boxes
+/// of several voices together (in single precision), one voice per vector lane.
 /// @note
 /// The line box is mono. 36 lowpass filters might be an overkill.
 /// @note 
@@ -204,13 +226,16 @@ public:
 class scanner_vibrato
 {
 protected:
-    enum { ScannerSize = 18 };
+    enum { ScannerSize = 18, Lanes = 4 };
     float lfo_phase;
     dsp::biquad_d2 scanner[ScannerSize];
     organ_vibrato legacy;
 public:
     void reset();
     void process(organ_parameters *parameters, float (*data)[2], unsigned int len, float sample_rate);
+    /// Process count vibratos (each with its own state) on count separate buffers of len samples,
+    /// computing the line boxes of up to Lanes vibratos at a time in parallel
+    static void process_voices(scanner_vibrato *const *vibratos, float (*const *data)[2], int count, organ_parameters *parameters, unsigned int len, float sample_rate);
 };
 
 class organ_voice: public dsp::voice, public organ_voice_base {
@@ -246,6 +271,13 @@ public:
     virtual float get_priority() { return stolen ? 20000 : (perc_released ? 1 : (sostenuto ? 200 : 100)); }
     virtual void steal();
     void render_block(int current_snapshot);
+    /// First part of render_block, up to (not including) the per-voice vibrato
+    /// @retval true if the voice is playing and the rest of the block needs to be rendered by render_block_post_vibrato
+    bool render_block_pre_vibrato(int current_snapshot);
+    /// Second part of render_block, after the per-voice vibrato
+    void render_block_post_vibrato();
+    scanner_vibrato &get_vibrato() { return vibrato; }
+    float (*get_output_buffer())[Channels] { return output_buffer; }
     
     virtual int get_current_note() {
         return note;
@@ -284,7 +316,8 @@ public:
     }
 };
 
-struct drawbar_organ: public dsp::basic_synth, public calf_plugins::organ_enums {
+struct drawbar_organ: public dsp::pooled_synth<dsp::block_voice<organ_voice> >, public calf_plugins::organ_enums {
+    typedef dsp::block_voice<organ_voice> organ_block_voice;
     organ_parameters *parameters;
     percussion_voice percussion;
     scanner_vibrato global_vibrato;
@@ -293,10 +326,12 @@ struct drawbar_organ: public dsp::basic_synth, public calf_plugins::organ_enums
      drawbar_organ(organ_parameters *_parameters)
     : parameters(_parameters)
     , percussion(_parameters) {
-        init_voices(36);
+        init_pool(36);
     }
     void render_separate(float *output[], int nsamples);
-    dsp::voice *alloc_voice();
+    /// Same as pooled_synth::render_to, but with the per-voice vibrato of all the voices processed together
+    void render_voices(float (*output)[2], int nsamples);
+    void init_voice(organ_block_voice *v);
     virtual void percussion_note_on(int note, int vel);
     virtual void params_changed() = 0;
     virtual void setup(int sr);
@@ -325,6 +360,10 @@ public:
     uint32_t srate;
     bool panic_flag;
     mutable bool redraw;
+    /// Wave tables can be used in process (set when the worker thread finishes calculating them)
+    bool waves_ready;
+    /// Wave calculation job has been queued
+    bool waves_requested;
     
     /// Value for configure variable map_curve
     std::string var_map_curve;
@@ -332,6 +371,8 @@ public:
     organ_audio_module();
     
     void post_instantiate(uint32_t sample_rate);
+    /// Worker thread job: calculate the wave tables
+    void work(uint32_t size, const void *data, worker_response_iface *response);
 
     void set_sample_rate(uint32_t sr) {
         srate = sr;
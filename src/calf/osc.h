@@ -24,6 +24,9 @@
 
 #include "fft.h"
 #include <map>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace dsp
 {
@@ -296,6 +299,123 @@ struct waveform_oscillator: public simple_oscillator
     }
 };
 
+/**
+ * Up to 8 detuned copies of a waveform_oscillator (used for unison), each with its own
+ * phase and phase increment and a gain for each of the two output channels. Every copy
+ * is processed 4 samples at a time, as vector lanes.
+ */
+template<int SIZE_BITS>
+struct waveform_unison
+{
+    enum { SIZE = 1 << SIZE_BITS, MASK = SIZE - 1, SCALE = 1 << (32 - SIZE_BITS), MaxVoices = 8, Lanes = 4 };
+    uint32_t phase[MaxVoices];
+    uint32_t phasedelta[MaxVoices];
+    float gain_left[MaxVoices];
+    float gain_right[MaxVoices];
+    /// Number of voices used (the phase and the gains of the others are ignored)
+    int voices;
+    
+    waveform_unison()
+    {
+        voices = 0;
+        for (int i = 0; i < MaxVoices; i++)
+        {
+            phase[i] = phasedelta[i] = 0;
+            gain_left[i] = gain_right[i] = 0.f;
+        }
+    }
+    /// Same as waveform_oscillator::get_phaseshifted for one of the voices
+    inline float get_voice(const float *waveform, int v, uint32_t shift, float mix) const
+    {
+        uint32_t ph = phase[v], ph2 = phase[v] + shift;
+        uint32_t wpos = ph >> (32 - SIZE_BITS), wpos2 = ph2 >> (32 - SIZE_BITS);
+        float value1 = dsp::lerp(waveform[wpos], waveform[(wpos + 1) & MASK], (ph & (SCALE - 1)) * (1.0f / SCALE));
+        float value2 = dsp::lerp(waveform[wpos2], waveform[(wpos2 + 1) & MASK], (ph2 & (SCALE - 1)) * (1.0f / SCALE));
+        return value1 + mix * value2;
+    }
+    /// Add the sum of get_phaseshifted(shift, mix) of all the voices, multiplied by
+    /// the voice gains, to left and right (which may be NULL if not needed). The shift
+    /// changes by shift_delta every sample.
+    void render(const float *waveform, float *left, float *right, int count, uint32_t shift, int32_t shift_delta, float mix)
+    {
+#if defined(__SSE2__)
+        // each voice is processed 4 samples at a time
+        const __m128i fracmask = _mm_set1_epi32(SCALE - 1);
+        const __m128 fracscale = _mm_set1_ps(1.0f / SCALE), vmix = _mm_set1_ps(mix);
+        const __m128i sh_step = _mm_set1_epi32(4 * shift_delta);
+        int count4 = count & ~3;
+        for (int v = 0; v < voices; v++)
+        {
+            uint32_t p = phase[v], dp = phasedelta[v];
+            __m128i ph = _mm_setr_epi32(p, p + dp, p + 2 * dp, p + 3 * dp);
+            __m128i ph_step = _mm_set1_epi32(4 * dp);
+            __m128i sh = _mm_setr_epi32(shift, shift + shift_delta, shift + 2 * shift_delta, shift + 3 * shift_delta);
+            __m128 gl = _mm_set1_ps(gain_left[v]), gr = _mm_set1_ps(gain_right[v]);
+            for (int i = 0; i < count4; i += 4)
+            {
+                __m128i ph2 = _mm_add_epi32(ph, sh);
+                uint32_t pos1[Lanes] __attribute__((aligned(16))), pos2[Lanes] __attribute__((aligned(16)));
+                float a[2][Lanes] __attribute__((aligned(16))), b[2][Lanes] __attribute__((aligned(16)));
+                _mm_store_si128((__m128i *)pos1, _mm_srli_epi32(ph, 32 - SIZE_BITS));
+                _mm_store_si128((__m128i *)pos2, _mm_srli_epi32(ph2, 32 - SIZE_BITS));
+                for (int l = 0; l < Lanes; l++)
+                {
+                    a[0][l] = waveform[pos1[l]];
+                    a[1][l] = waveform[(pos1[l] + 1) & MASK];
+                    b[0][l] = waveform[pos2[l]];
+                    b[1][l] = waveform[(pos2[l] + 1) & MASK];
+                }
+                __m128 frac1 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(ph, fracmask)), fracscale);
+                __m128 frac2 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(ph2, fracmask)), fracscale);
+                __m128 a0 = _mm_load_ps(a[0]), b0 = _mm_load_ps(b[0]);
+                __m128 value1 = _mm_add_ps(a0, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(a[1]), a0), frac1));
+                __m128 value2 = _mm_add_ps(b0, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(b[1]), b0), frac2));
+                __m128 value = _mm_add_ps(value1, _mm_mul_ps(vmix, value2));
+                if (left)
+                    _mm_storeu_ps(left + i, _mm_add_ps(_mm_loadu_ps(left + i), _mm_mul_ps(value, gl)));
+                if (right)
+                    _mm_storeu_ps(right + i, _mm_add_ps(_mm_loadu_ps(right + i), _mm_mul_ps(value, gr)));
+                ph = _mm_add_epi32(ph, ph_step);
+                sh = _mm_add_epi32(sh, sh_step);
+            }
+            phase[v] = p + count4 * dp;
+        }
+        shift += count4 * shift_delta;
+        // the remaining samples (if count is not a multiple of 4)
+        for (int i = count4; i < count; i++)
+        {
+            for (int v = 0; v < voices; v++)
+            {
+                float value = get_voice(waveform, v, shift, mix);
+                if (left)
+                    left[i] += value * gain_left[v];
+                if (right)
+                    right[i] += value * gain_right[v];
+                phase[v] += phasedelta[v];
+            }
+            shift += shift_delta;
+        }
+#else
+        for (int i = 0; i < count; i++)
+        {
+            float suml = 0.f, sumr = 0.f;
+            for (int v = 0; v < voices; v++)
+            {
+                float value = get_voice(waveform, v, shift, mix);
+                suml += value * gain_left[v];
+                sumr += value * gain_right[v];
+                phase[v] += phasedelta[v];
+            }
+            if (left)
+                left[i] += suml;
+            if (right)
+                right[i] += sumr;
+            shift += shift_delta;
+        }
+#endif
+    }
+};
+
 /**
  * Simple triangle LFO without any smoothing or anything of this sort. 
  */
@@ -73,6 +73,46 @@ public:
     }
 };
 
+/// Tracks which derived values (filter coefficients, gain targets etc.) depend on which parameters,
+/// so that params_changed(const param_mask &) can recalculate only the groups affected by a change.
+/// Groups are identified by small integers (0 to Groups - 1), usually a module-local enum.
+template<int Groups>
+class coeff_cache
+{
+    param_mask deps[Groups];
+    uint32_t stale;
+public:
+    coeff_cache() { invalidate_all(); }
+    /// Declare that a group depends on a given parameter
+    void depends_on(int group, int param_no) { deps[group].set(param_no); }
+    /// Declare that a group depends on a list of parameters (terminated with -1)
+    void depends_on(int group, const int *param_nos)
+    {
+        for (; *param_nos != -1; param_nos++)
+            deps[group].set(*param_nos);
+    }
+    /// Mark the groups that depend on any of the dirty parameters as needing recalculation
+    void invalidate(const param_mask &dirty)
+    {
+        for (int i = 0; i < Groups; i++)
+            if (deps[i].intersects(dirty))
+                stale |= 1U << i;
+    }
+    /// Mark a single group as needing recalculation (e.g. when it also depends on the sample rate)
+    void invalidate_group(int group) { stale |= 1U << group; }
+    /// Mark all groups as needing recalculation
+    void invalidate_all() { stale = (Groups >= 32) ? ~0U : ((1U << Groups) - 1); }
+    /// @retval true if the group needs recalculating (the flag is cleared, the caller is expected to do the work)
+    bool update(int group)
+    {
+        uint32_t bit = 1U << group;
+        if (!(stale & bit))
+            return false;
+        stale &= ~bit;
+        return true;
+    }
+};
+
 struct debug_send_configure_iface: public send_configure_iface
 {
     void send_configure(const char *key, const char *value)
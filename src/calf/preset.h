@@ -22,7 +22,9 @@
 #define __CALF_PRESET_H
 
 #include <vector>
+#include <unordered_map>
 #include <string.h>
+#include <sys/stat.h>
 #include "utils.h"
 
 namespace calf_plugins {
@@ -51,7 +53,7 @@ struct plugin_preset
     /// Export preset as XML
     std::string to_xml();   
     /// "Upload" preset content to the plugin
-    void activate(plugin_ctl_iface *plugin);
+    void activate(plugin_ctl_iface *plugin) const;
     /// "Download" preset content from the plugin
     void get_from(plugin_ctl_iface *plugin);
         
@@ -134,6 +136,14 @@ struct preset_list
     bool rack_mode;
     /// List of plugin states for rack mode
     std::vector<plugin_snapshot> plugins;
+    /// Indices of presets for each plugin, in file order (see update_index)
+    std::unordered_map<std::string, std::vector<int> > plugin_index;
+    /// Indices of presets by plugin and preset name (plugin + '\0' + name)
+    std::unordered_map<std::string, int> name_index;
+    /// Number of presets covered by the indexes
+    size_t indexed_count;
+
+    preset_list() : indexed_count(0) {}
 
     /// Return the name of the built-in or user-defined preset file
     static std::string get_preset_filename(bool builtin, const std::string *pkglibdir_path = NULL);
@@ -143,14 +153,32 @@ struct preset_list
     void parse(const std::string &data, bool in_rack_mode);
     /// Load preset list from XML file
     void load(const char *filename, bool in_rack_mode);
+    /// Load preset list from XML file via a binary cache, which is used if it is newer than the XML
+    /// file and rewritten from the XML file otherwise
+    /// @retval true if the presets came from the cache
+    bool load_cached(const char *filename, const std::string &cache_filename);
+    /// Return the name of the binary cache of a preset file (in $XDG_CACHE_HOME/calf or ~/.cache/calf)
+    static std::string get_cache_filename(const std::string &filename);
+    /// Append the presets from a binary cache file, if it was made from a file with the given stat data
+    /// @retval false if the cache is missing, stale or damaged (and nothing was loaded)
+    bool load_cache(const char *cache_filename, const struct stat &source);
+    /// Write all the presets to a binary cache file, tagged with the stat data of the source file
+    /// @retval false if the file could not be written
+    bool save_cache(const char *cache_filename, const struct stat &source);
     /// Save preset list as XML file
     void save(const char *filename);
     /// Append or replace a preset (replaces a preset with the same plugin and preset name)
     void add(const plugin_preset &sp);
     /// Get a sublist of presets for a given plugin (those with plugin_preset::plugin == plugin)
     void get_for_plugin(preset_vector &vec, const char *plugin);
+    /// @return indices (into presets) of the presets for a given plugin
+    const std::vector<int> &get_indices_for_plugin(const std::string &plugin);
+    /// @return index of the preset with a given plugin and preset name, -1 if there's none
+    int find(const std::string &plugin, const std::string &name);
     
 protected:
+    /// Internal function: bring the indexes up to date with the presets vector (new presets are only ever appended or replaced in place)
+    void update_index();
     /// Internal function: start element handler for expat
     static void xml_start_element_handler(void *user_data, const char *name, const char *attrs[]);
     /// Internal function: end element handler for expat
@@ -21,6 +21,7 @@
 #ifndef __CALF_PRIMITIVES_H
 #define __CALF_PRIMITIVES_H
 
+#include <config.h>
 #include <assert.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -29,6 +30,9 @@
 #include <cstdlib>
 #include <map>
 #include <algorithm>
+#if defined(__SSE2__)
+#include <xmmintrin.h>
+#endif
 
 namespace dsp {
 
@@ -343,6 +347,58 @@ public:
     }
 };
 
+/**
+ * Scoped flush-to-zero (FTZ) and denormals-are-zero (DAZ) mode for the calling thread.
+ * Used by the wrappers around processing calls, so that denormals never reach the DSP code.
+ * The previous mode is restored when the object goes out of scope.
+ */
+class denormal_guard
+{
+#if defined(__SSE2__)
+    unsigned int old_csr;
+public:
+    enum { FTZ_DAZ_BITS = 0x8040 };
+    denormal_guard(bool enable = true)
+    {
+        old_csr = _mm_getcsr();
+        if (enable)
+            _mm_setcsr(old_csr | FTZ_DAZ_BITS);
+    }
+    ~denormal_guard() { _mm_setcsr(old_csr); }
+#elif defined(__aarch64__)
+    uint64_t old_fpcr;
+public:
+    enum { FZ_BIT = 1 << 24 };
+    denormal_guard(bool enable = true)
+    {
+        asm volatile("mrs %0, fpcr" : "=r"(old_fpcr));
+        if (enable)
+            asm volatile("msr fpcr, %0" : : "r"(old_fpcr | FZ_BIT));
+    }
+    ~denormal_guard() { asm volatile("msr fpcr, %0" : : "r"(old_fpcr)); }
+#else
+public:
+    denormal_guard(bool enable = true) {}
+#endif
+};
+
+/// USE_FTZ means that all processing happens under denormal_guard, so the per-sample
+/// denormal removal functions below can be compiled out
+#if USE_FTZ
+
+#if !defined(__SSE2__) && !defined(__aarch64__)
+#error "USE_FTZ needs SSE2 or AArch64, where denormal_guard can set flush-to-zero mode"
+#endif
+
+inline void sanitize(float &value) {}
+inline float _sanitize(float value) { return value; }
+inline void sanitize_denormal(float& value) {}
+inline void sanitize_denormal(double & value) {}
+inline void sanitize(double &value) {}
+inline double _sanitize(double value) { return value; }
+
+#else
+
 /**
  * Force "small enough" float value to zero
  */
@@ -397,6 +453,8 @@ inline double _sanitize(double value)
         
     return value;
 }
+
+#endif
 /**
  * Force "small enough" stereo value to zero
  */
@@ -419,20 +477,20 @@ template<class T, int N, int Multiplier>
 class sine_table
 {
 public:
-    static bool initialized;
     static T data[N+1];
     sine_table() {
-        if (initialized)
-            return;
-        initialized = true;
+        // a local static is initialized exactly once, even when plugins are created on several threads
+        static bool initialized = fill();
+        (void)initialized;
+    }
+private:
+    static bool fill() {
         for (int i=0; i<N+1; i++)
             data[i] = (T)(Multiplier*sin(i*2*M_PI*(1.0/N)));
+        return true;
     }
 };
 
-template<class T, int N, int Multiplier>
-bool sine_table<T,N,Multiplier>::initialized = false;
-
 template<class T, int N, int Multiplier>
 T sine_table<T,N,Multiplier>::data[N+1];
 
@@ -18,8 +18,12 @@
  * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
  * Boston, MA  02110-1301  USA
  */
+#ifndef CALF_SHAPING_CLIPPER_H
+#define CALF_SHAPING_CLIPPER_H
+
 #include <vector>
 #include "pffft.h"
+#include "cpudispatch.h"
 
 class shaping_clipper
 {
@@ -51,11 +55,17 @@ public:
     void set_clip_level(float clip_level);
 
     /**
-     *  Set the number of clipping iterations.
+     *  Set the maximum number of clipping iterations.
      *  Setting iterations to 0 effectively works as a bypass.
      */
     void set_iterations(int iterations);
 
+    /**
+     *  Returns the number of clipping iterations done in the last feed call
+     *  (fewer than the maximum when the clip target was met earlier)
+     */
+    int get_last_iterations() const { return last_iterations; }
+
     /**
      *  Set the adaptive distortion strength.
      *  The adaptive distortion strength affects how easily the clipper gives up
@@ -72,15 +82,39 @@ public:
      */
     void set_margin_curve(int points[][2], int num_points);
 
+    /**
+     *  Only use the part of each spreading function within 60dB of its peak.
+     *  This halves the work in calculate_mask_curve, but changes the mask curve
+     *  (by a few thousandths of a dB) and so the output slightly. Off by default.
+     */
+    void set_spread_trim(bool trim);
+
 private:
     int size;
     int overlap;
     int num_psy_bins;
     PFFFT_Setup* pffft;
+    const dsp::dsp_kernels* kernels;
     float sample_rate;
     float clip_level;
     float iterations;
     float adaptive_distortion_strength;
+    int last_iterations;
+    bool spread_trim;
+
+    /**
+     *  in_frame and out_dist_frame are rings of 4 feed blocks, so that nothing has to be shifted;
+     *  frame_pos is where the oldest block (the first one of the frame) starts
+     */
+    int frame_pos;
+
+    /**
+     *  Scratch buffers for feed, in one aligned block (as required by pffft):
+     *  windowed_frame, clipping_delta, spectrum_buf and fft_work have size values each,
+     *  mask_curve has size / 2 + 1
+     */
+    float *scratch;
+    float *windowed_frame, *clipping_delta, *spectrum_buf, *fft_work, *mask_curve;
 
     /**
      *  in_frame: unmodified input audio
@@ -105,12 +139,19 @@ private:
      */
     void generate_hann_window();
 
+    /**
+     *  Like apply_window, for a frame stored in a ring buffer (in_frame or out_dist_frame) starting at frame_pos:
+     *  windows the ring into out_frame, or adds the windowed in_frame to the ring if to_ring is true
+     */
+    void apply_window_ring(const float* in_frame, float* out_frame, bool to_ring);
+
     /**
     *  Generate the spreading functions used by calculate_mask_curve
     *  The spread_table contains entries of size/2 values each.
     *  To save memory, only 2 entries are stored per octave, and each entry is shared by a range of bins.
     *  The spread scale proportionally with frequency.
     *  The spread_table entries are normalized to add up to 1.
+    *  Only the part of each entry within 60 dB of its peak is used.
     #  Eacn entry is centred, meaning the num_psy_bins/2'th value is the peak of the tent-shaped function.
     */
     void generate_spread_table();
@@ -143,3 +184,5 @@ private:
     void limit_clip_spectrum(float* clip_spectrum, const float* mask_curve);
 
 };
+
+#endif
@@ -106,8 +106,12 @@ class voice {
 public:
     int sample_rate;
     bool released, sostenuto, stolen;
+    /// Neighbours in the list of stealable voices of the same class (maintained by basic_synth)
+    voice *steal_prev, *steal_next;
+    /// Stealing class (basic_synth::steal_class), or -1 if not in any of the lists
+    int steal_class;
 
-    voice() : sample_rate(-1), released(false), sostenuto(false), stolen(false) {}
+    voice() : sample_rate(-1), released(false), sostenuto(false), stolen(false), steal_prev(NULL), steal_next(NULL), steal_class(-1) {}
 
     /// reset voice to default state (used when a voice is to be reused)
     virtual void setup(int sr) { sample_rate = sr; }
@@ -273,11 +277,20 @@ struct basic_pool {
 /// somewhat reasonable voice management, pedal support - and 
 /// little else. It's implemented as a base class with virtual
 /// functions, so there's some performance loss, but it shouldn't
-/// be horrible.
+/// be horrible (see pooled_synth for the rendering part).
+/// Voices that can be stolen are kept in lists by their priority class, oldest first,
+/// so that finding the voice to steal doesn't require scanning all the voices.
 /// @todo it would make sense to support all notes off controller too
 struct basic_synth {
 protected:
     typedef basic_pool<dsp::voice *> voice_array; 
+    /// Stealing classes, in order of preference; voices with priority of 10000 or more are never stolen
+    enum steal_class { steal_released, steal_playing, steal_sostenuto, steal_class_count };
+    /// Stealable voices of one class, in order of joining the class
+    struct steal_list {
+        dsp::voice *head, *tail;
+        unsigned int count;
+    };
     /// Current sample rate
     int sample_rate;
     /// Hold pedal state
@@ -294,10 +307,23 @@ protected:
     std::bitset<128> gate;
     /// Maximum allocated number of channels
     unsigned int polyphony_limit;
+    /// Stealable voices, by class
+    steal_list steal_lists[steal_class_count];
 
+    basic_synth();
+    /// Allocate count voices using alloc_voice
     void init_voices(int count);
+    /// Allocate voice lists for count voices (without allocating the voices themselves)
+    void init_voice_arrays(int count);
     void kill_note(int note, int vel, bool just_one);
     virtual dsp::voice *alloc_voice() = 0;
+    /// Put the voice into the right stealing list for its current priority (at the end, if the class has changed)
+    void update_steal_class(dsp::voice *v, float priority);
+    /// Remove the voice from the stealing lists
+    void unlink_stealable(dsp::voice *v);
+    /// Move a voice that isn't playing anymore from the active list to the unused list
+    /// @return iterator pointing to the next active voice
+    voice_array::iterator release_voice(voice_array::iterator i);
 public:
     virtual void setup(int sr) {
         sample_rate = sr;
@@ -320,6 +346,53 @@ public:
     virtual ~basic_synth();
 };
 
+/// Polyphonic instrument with all the voices of the same type, allocated in one contiguous
+/// array when the instrument is created. The voices are rendered without virtual calls.
+template<class Voice>
+struct pooled_synth: public basic_synth {
+protected:
+    Voice *pool;
+    int pool_size;
+    
+    pooled_synth() : pool(NULL), pool_size(0) {}
+    /// Allocate count voices, call init_voice for each of them
+    void init_pool(int count)
+    {
+        assert(!pool);
+        pool = new Voice[count];
+        pool_size = count;
+        init_voice_arrays(count);
+        for (int i = 0; i < count; i++)
+        {
+            init_voice(&pool[i]);
+            unused_voices.add(&pool[i]);
+        }
+    }
+    /// Called once for every voice in the pool, to set up its references to the instrument etc.
+    virtual void init_voice(Voice *v) {}
+    /// Not used, the voices are allocated by init_pool
+    virtual dsp::voice *alloc_voice() { return NULL; }
+public:
+    virtual void render_to(float (*output)[2], int nsamples)
+    {
+        // same as basic_synth::render_to, but the calls are resolved at compile time
+        for (dsp::voice **i = active_voices.begin(); i != active_voices.end(); ) {
+            Voice *v = static_cast<Voice *>(*i);
+            v->Voice::render_to(output, nsamples);
+            if (!v->Voice::get_active()) {
+                i = release_voice(i);
+                continue;
+            }
+            update_steal_class(v, v->Voice::get_priority());
+            i++;
+        }
+    }
+    virtual ~pooled_synth()
+    {
+        delete []pool;
+    }
+};
+
 }
 
 #endif
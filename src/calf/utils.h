@@ -206,8 +206,14 @@ struct direntry {
     std::string full_path;
     std::string directory;
 };
+/// @return files in a directory, except the ones starting with a dot (empty if the directory can't be read)
 std::vector <direntry> list_directory(const std::string &path);
 
+/// Call job(arg, index) for every index from 0 to count - 1, on up to max_threads threads
+/// (0 = one per CPU core), and wait until all the calls are finished. The order of the calls is
+/// not defined, and the job function must not throw.
+void parallel_for(int count, void (*job)(void *arg, int index), void *arg, int max_threads = 0);
+
 };
 
 #endif
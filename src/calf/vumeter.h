@@ -22,6 +22,8 @@
 #define __CALF_VUMETER_H
 
 #include <math.h>
+#include <algorithm>
+#include "cpudispatch.h"
 
 namespace dsp {
 
@@ -96,6 +98,17 @@ struct vumeter
     }
     inline void run_sample_loop(const float *src, unsigned int len)
     {
+        // if nothing goes over 0 dB, only the peak is needed, and that is a dispatched block kernel
+        if (!reverse && len && level <= 1.f)
+        {
+            float peak = dsp::get_kernels().peak(src, len);
+            if (peak <= 1.f)
+            {
+                level = std::max(level, peak);
+                count_over = 0;
+                return;
+            }
+        }
         for (unsigned int i = 0; i < len; i++)
             process(src[i]);
     }
@@ -2,6 +2,7 @@
 #define __CALF_WAVETABLE_H
 
 #include <assert.h>
+#include <vector>
 #include "biquad.h"
 #include "onepole.h"
 #include "audio_fx.h"
@@ -17,30 +18,46 @@ namespace calf_plugins {
 
 class wavetable_audio_module;
     
-struct wavetable_oscillator: public dsp::simple_oscillator
+/// Band-limited float copies of the wavetables. Every one of the 129 slices of every wave
+/// has a set of octave spaced mip levels: level k contains harmonics up to 128 >> k (the
+/// ones below the Nyquist frequency of the 256 sample original) and is stored with at least
+/// 4 samples (8 from level 3 on) per period of the highest harmonic, for 4-point interpolation.
+struct wavetable_mipmap
 {
-    enum { SIZE = 1 << 8, MASK = SIZE - 1, SCALE = 1 << (32 - 8) };
-    int16_t (*tables)[256];
-    inline float get(uint16_t slice)
+    enum { Levels = 8, MaxHarmonics = 128, Slices = 129, SliceSize = 1208 };
+    /// log2 of the table length of each level
+    static const int level_bits[Levels];
+    /// Start of each level within a slice; each table is preceded by a copy of its last
+    /// sample and followed by copies of its first two samples
+    static const int level_offsets[Levels];
+    /// [wt_count][Slices][SliceSize], scaled to -1..1
+    std::vector<float> data;
+
+    wavetable_mipmap(const int16_t (*tables)[129][256], int count);
+    /// @return band-limited slices of a wave, [Slices][SliceSize]
+    const float *get_wave(int wave) const { return &data[wave * Slices * SliceSize]; }
+    /// @return the least band-limited level that does not alias at a given phase increment
+    static inline int get_level(uint32_t phasedelta)
     {
-        float fracslice = (slice & 255) * (1.0 / 256.0);
-        slice = slice >> 8;
-        int16_t *waveform = tables[slice];
-        int16_t *waveform2 = tables[slice + 1];
-        float value1 = 0.f, value2 = 0.f;
-        uint32_t cphase = phase, cphasedelta = phasedelta >> 3;
-        for (int j = 0; j < 8; j++)
-        {
-            uint32_t wpos = cphase >> (32 - 8);
-            uint32_t wpos2 = (wpos + 1) & MASK;
-            float frac = (cphase & (SCALE - 1)) * (1.0f / SCALE);
-            value1 += dsp::lerp((float)waveform[wpos], (float)waveform[wpos2], frac);
-            value2 += dsp::lerp((float)waveform2[wpos], (float)waveform2[wpos2], frac);
-            cphase += cphasedelta;
-        }
-        phase += phasedelta;
-        return dsp::lerp(value1, value2, fracslice) * (1.0 / 8.0) * (1.0 / 32768.0);;
+        int level = 0;
+        while(level < Levels - 1 && (uint64_t)(MaxHarmonics >> level) * phasedelta >= (1ULL << 31))
+            level++;
+        return level;
     }
+    /// The tables are the same for every instance of the synth, so the mip levels are
+    /// calculated once (by the first instance) and shared
+    static const wavetable_mipmap &get_shared(const int16_t (*tables)[129][256], int count);
+};
+
+struct wavetable_oscillator: public dsp::simple_oscillator
+{
+    /// 16-bit tables of the current wave, used for display
+    int16_t (*tables)[256];
+    /// Band-limited version of the current wave, from wavetable_mipmap::get_wave
+    const float *mips;
+    /// Add count samples to out. The wave position (slice * 256, 0 to 127 * 256) and the
+    /// amplitude change linearly, starting from shift and amp.
+    void render_add(float *out, int count, float shift, float shift_step, float amp, float amp_step);
 };
 
 class wavetable_voice: public dsp::voice
@@ -59,6 +76,8 @@ protected:
     float velocity;
     /// Current calculated mod matrix outputs
     float moddest[wavetable_metadata::moddest_count];
+    /// Amplitude envelope value (with velocity scaling) for the current block
+    float env0_scaled;
     /// Last oscillator shift (wavetable index) of each oscillator
     float last_oscshift[OscCount];
     /// Last oscillator amplitude of each oscillator
@@ -75,6 +94,11 @@ public:
     void channel_pressure(int value);
     void steal();
     void render_block(int current_snapshot);
+    /// First part of render_block: advance the envelopes and LFOs, calculate the modulation sources (modsrc_count values)
+    void update_modsrc(float *modsrc);
+    /// Second part of render_block: render the block using the outputs of the modulation matrix (get_moddest)
+    void render_modulated_block(int current_snapshot);
+    float *get_moddest() { return moddest; }
     const int16_t *get_last_table(int osc) const;
     virtual int get_current_note() {
         return note;
@@ -91,7 +115,7 @@ public:
     }
 };    
 
-class wavetable_audio_module: public audio_module<wavetable_metadata>, public dsp::basic_synth, public dsp::block_allvoices_base<wavetable_voice>, public line_graph_iface, public mod_matrix_impl
+class wavetable_audio_module: public audio_module<wavetable_metadata>, public dsp::pooled_synth<dsp::block_voice<wavetable_voice> >, public dsp::block_allvoices_base<wavetable_voice>, public line_graph_iface, public mod_matrix_impl
 {
 public:
     using dsp::basic_synth::note_on;
@@ -105,6 +129,8 @@ protected:
 
 public:
     int16_t tables[wt_count][129][256]; // one dummy level for interpolation
+    /// Band-limited float version of tables
+    const wavetable_mipmap *mipmaps;
     /// Rows of the modulation matrix
     dsp::modulation_entry mod_matrix_data[mod_matrix_slots];
     /// Smoothed pitch bend value
@@ -124,13 +150,13 @@ public:
 public:
     wavetable_audio_module();
 
-    dsp::voice *alloc_voice() {
-        dsp::block_voice<wavetable_voice> *v = new dsp::block_voice<wavetable_voice>();
+    void init_voice(dsp::block_voice<wavetable_voice> *v) {
         v->set_params_ptr(this, sample_rate);
-        return v;
     }
     
     uint32_t get_crate() const { return crate; }
+    /// Same as render_to, but the modulation matrix is evaluated for all voices starting a block at the same time
+    void render_voices(float (*output)[2], int nsamples);
     
     /// process function copied from Organ (will probably need some adjustments as well as implementing the panic flag elsewhere
     uint32_t process(uint32_t offset, uint32_t nsamples, uint32_t inputs_mask, uint32_t outputs_mask) {
@@ -145,7 +171,7 @@ public:
         fill_snapshots(nsamples);
         float buf[MAX_SAMPLE_RUN][2];
         dsp::zero(&buf[0][0], 2 * nsamples);
-        basic_synth::render_to(buf, nsamples);
+        render_voices(buf, nsamples);
         if (!active_voices.empty())
             last_voice = (wavetable_voice *)*active_voices.begin();
         float gain = 1.0f;
@@ -0,0 +1,87 @@
+/* Calf DSP Library
+ * WAV file reading and writing.
+ *
+ * Copyright (C) 2001-2010 Krzysztof Foltman, Markus Schmidt, Thor Harald Johansen and others
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02111-1307, USA.
+ */
+#ifndef CALF_WAVFILE_H
+#define CALF_WAVFILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace calf_utils {
+
+/// Sample format of a WAV file
+struct wav_format
+{
+    int channels;
+    uint32_t sample_rate;
+    int bits;
+    bool is_float;
+
+    wav_format() : channels(0), sample_rate(0), bits(0), is_float(false) {}
+    int frame_bytes() const { return channels * (bits / 8); }
+};
+
+/// Memory mapped WAV file reader (PCM 8/16/24/32 bit, IEEE float 32/64 bit, plain or WAVE_FORMAT_EXTENSIBLE)
+class wav_reader
+{
+    int fd;
+    uint8_t *map;
+    size_t map_size;
+    const uint8_t *data;
+    uint64_t pos;
+    /// How far ahead of the read position the kernel has been asked to page in the file
+    uint64_t prefetched;
+public:
+    wav_format format;
+    uint64_t frames;
+
+    wav_reader() : fd(-1), map(NULL), map_size(0), data(NULL), pos(0), prefetched(0), frames(0) {}
+    ~wav_reader() { close(); }
+    void open(const std::string &filename);
+    void close();
+    /// Read up to len frames, deinterleaved and converted to float
+    /// @return number of frames read (0 at the end of file)
+    uint32_t read(float **channels, uint32_t len);
+    /// Read the whole file (from the current position), one vector per channel
+    void read_all(std::vector<std::vector<float> > &channels);
+};
+
+/// WAV file writer (PCM 16/24 bit or IEEE float 32 bit), the header is finalized on close
+class wav_writer
+{
+    FILE *f;
+    wav_format format;
+    uint64_t frames;
+    std::vector<uint8_t> buffer;
+    std::string filename;
+    void write_header();
+public:
+    wav_writer() : f(NULL), frames(0) {}
+    ~wav_writer() { if (f) fclose(f); }
+    void open(const std::string &_filename, const wav_format &_format);
+    void write(float *const *channels, uint32_t len);
+    void close();
+};
+
+};
+
+#endif
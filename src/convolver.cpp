@@ -0,0 +1,365 @@
+/* Calf DSP Library
+ * Zero-latency partitioned convolution.
+ *
+ * Copyright (C) 2001-2010 Krzysztof Foltman, Markus Schmidt, Thor Harald Johansen and others
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <calf/convolver.h>
+#include <calf/primitives.h>
+#include <algorithm>
+#include <atomic>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <string.h>
+#include "pffft.h"
+
+using namespace dsp;
+
+/// One uniformly partitioned section of the impulse response, covering the taps
+/// [offset, offset + parts * block). The result of input block k (samples k * block
+/// to (k + 1) * block - 1) is written to the output ring at k * block + offset.
+struct convolver::stage
+{
+    convolver *owner;
+    PFFFT_Setup *setup;
+    uint32_t block, fft_size, offset, parts;
+    /// Partition spectra, [channel][part][fft_size] in pffft's internal order
+    float *ir_spectra;
+    /// Frequency domain delay line (spectra of the recent input blocks), [channel][part][fft_size]
+    float *fdl;
+    uint32_t fdl_pos;
+    /// Scratch buffers, fft_size each
+    float *window, *accum, *result, *work;
+    /// Results, [channel][out_mask + 1]
+    float *output;
+    uint32_t out_mask;
+
+    bool background;
+    /// Blocks handed to the worker thread (only used by the processing thread)
+    uint64_t posted;
+    /// Blocks completed by the worker thread
+    std::atomic<uint64_t> done;
+    std::atomic<bool> quit;
+    sem_t jobs;
+    pthread_mutex_t done_mutex;
+    pthread_cond_t done_cond;
+    pthread_t thread;
+
+    stage(convolver *_owner, const float *const *ir, int ir_channels, uint32_t ir_length, uint32_t _block, uint32_t _offset, uint32_t end, bool _background);
+    ~stage();
+    void clear();
+    /// Compute the contribution of input block k for all channels
+    void compute(uint64_t k);
+    /// Wait until block k is completed. In process(), this is the deadline of a background stage:
+    /// normally the block has been done for a while and this returns at once; if the worker is late,
+    /// the processing thread blocks on done_mutex/done_cond (the worker only holds the mutex while
+    /// signalling, never while computing) - see the scheduling note in start_thread
+    void wait_for(uint64_t k);
+    void start_thread();
+    static void *thread_proc(void *arg);
+};
+
+static float *alloc_floats(size_t count)
+{
+    float *ptr = (float *)pffft_aligned_malloc(count * sizeof(float));
+    memset(ptr, 0, count * sizeof(float));
+    return ptr;
+}
+
+convolver::stage::stage(convolver *_owner, const float *const *ir, int ir_channels, uint32_t ir_length, uint32_t _block, uint32_t _offset, uint32_t end, bool _background)
+: owner(_owner)
+, block(_block)
+, fft_size(2 * _block)
+, offset(_offset)
+, background(_background)
+, posted(0)
+, done(0)
+, quit(false)
+{
+    parts = (std::min(end, ir_length) - offset + block - 1) / block;
+    setup = pffft_new_setup(fft_size, PFFFT_REAL);
+    window = alloc_floats(fft_size);
+    accum = alloc_floats(fft_size);
+    result = alloc_floats(fft_size);
+    work = alloc_floats(fft_size);
+    ir_spectra = alloc_floats((size_t)owner->channels * parts * fft_size);
+    fdl = alloc_floats((size_t)owner->channels * parts * fft_size);
+    fdl_pos = 0;
+    uint32_t out_size = 1;
+    while(out_size < offset + block)
+        out_size <<= 1;
+    out_mask = out_size - 1;
+    output = alloc_floats((size_t)owner->channels * out_size);
+
+    for (int c = 0; c < ir_channels; c++)
+    {
+        for (uint32_t p = 0; p < parts; p++)
+        {
+            uint32_t from = offset + p * block;
+            uint32_t count = std::min(block, ir_length - from);
+            memset(window, 0, fft_size * sizeof(float));
+            memcpy(window, ir[c] + from, count * sizeof(float));
+            pffft_transform(setup, window, ir_spectra + ((size_t)c * parts + p) * fft_size, work, PFFFT_FORWARD);
+        }
+    }
+    // when the response is mono, all channels use the same spectra
+    if (ir_channels < owner->channels)
+        memcpy(ir_spectra + (size_t)parts * fft_size, ir_spectra, (size_t)parts * fft_size * sizeof(float));
+
+    if (background)
+    {
+        sem_init(&jobs, 0, 0);
+        pthread_mutex_init(&done_mutex, NULL);
+        pthread_cond_init(&done_cond, NULL);
+        start_thread();
+    }
+}
+
+void convolver::stage::start_thread()
+{
+    pthread_create(&thread, NULL, thread_proc, this);
+    // The processing thread waits for late results, so a worker preempted by ordinary threads
+    // (the GUI, disk I/O) would make it miss its own deadline. The lowest SCHED_FIFO priority puts
+    // the workers above all of those, but below any audio thread. Without the permission to do
+    // that (RLIMIT_RTPRIO), they stay at normal priority.
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+    pthread_setschedparam(thread, SCHED_FIFO, &param);
+}
+
+convolver::stage::~stage()
+{
+    if (background)
+    {
+        quit = true;
+        sem_post(&jobs);
+        pthread_join(thread, NULL);
+        sem_destroy(&jobs);
+        pthread_mutex_destroy(&done_mutex);
+        pthread_cond_destroy(&done_cond);
+    }
+    pffft_destroy_setup(setup);
+    pffft_aligned_free(window);
+    pffft_aligned_free(accum);
+    pffft_aligned_free(result);
+    pffft_aligned_free(work);
+    pffft_aligned_free(ir_spectra);
+    pffft_aligned_free(fdl);
+    pffft_aligned_free(output);
+}
+
+void convolver::stage::clear()
+{
+    if (background)
+        wait_for(posted);
+    memset(fdl, 0, (size_t)owner->channels * parts * fft_size * sizeof(float));
+    memset(output, 0, (size_t)owner->channels * (out_mask + 1) * sizeof(float));
+    fdl_pos = 0;
+    posted = 0;
+    done.store(0);
+}
+
+void convolver::stage::compute(uint64_t k)
+{
+    uint32_t in_mask = owner->in_mask;
+    // previous and current block - both are block aligned, so neither of them wraps around
+    uint32_t prev = (uint32_t)((k - 1) * block) & in_mask, cur = (uint32_t)(k * block) & in_mask;
+    fdl_pos = fdl_pos ? fdl_pos - 1 : parts - 1;
+    float scale = 1.f / fft_size;
+    for (int c = 0; c < owner->channels; c++)
+    {
+        const float *in = &owner->input[c][0];
+        float *fdl_c = fdl + (size_t)c * parts * fft_size;
+        const float *ir_c = ir_spectra + (size_t)c * parts * fft_size;
+        memcpy(window, in + prev, block * sizeof(float));
+        memcpy(window + block, in + cur, block * sizeof(float));
+        pffft_transform(setup, window, fdl_c + fdl_pos * fft_size, work, PFFFT_FORWARD);
+        memset(accum, 0, fft_size * sizeof(float));
+        // fdl_pos is the newest block, which is multiplied by the first partition
+        for (uint32_t p = 0, slot = fdl_pos; p < parts; p++)
+        {
+            pffft_zconvolve_accumulate(setup, fdl_c + slot * fft_size, ir_c + p * fft_size, accum, scale);
+            if (++slot == parts)
+                slot = 0;
+        }
+        pffft_transform(setup, accum, result, work, PFFFT_BACKWARD);
+        // overlap-save: only the second half is free of circular wrap-around
+        memcpy(output + (size_t)c * (out_mask + 1) + ((k * block + offset) & out_mask), result + block, block * sizeof(float));
+    }
+}
+
+void convolver::stage::wait_for(uint64_t k)
+{
+    if (done.load(std::memory_order_acquire) >= k)
+        return;
+    pthread_mutex_lock(&done_mutex);
+    while(done.load(std::memory_order_acquire) < k)
+        pthread_cond_wait(&done_cond, &done_mutex);
+    pthread_mutex_unlock(&done_mutex);
+}
+
+void *convolver::stage::thread_proc(void *arg)
+{
+    stage *self = (stage *)arg;
+    denormal_guard ftz;
+    while(true)
+    {
+        while(sem_wait(&self->jobs) == -1 && errno == EINTR)
+            ;
+        if (self->quit)
+            break;
+        self->compute(self->done.load(std::memory_order_relaxed));
+        self->done.fetch_add(1, std::memory_order_release);
+        pthread_mutex_lock(&self->done_mutex);
+        pthread_cond_broadcast(&self->done_cond);
+        pthread_mutex_unlock(&self->done_mutex);
+    }
+    return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+convolver::convolver(const float *const *ir, int ir_channels, uint32_t ir_length, int _channels, uint32_t head_size)
+: channels(std::min<int>(_channels, MAX_CHANNELS))
+, length(ir_length)
+, head(head_size)
+, time(0)
+{
+    ir_channels = std::min(ir_channels, channels);
+    for (int c = 0; c < channels; c++)
+    {
+        const float *h = ir[std::min(c, ir_channels - 1)];
+        head_taps[c].resize(head);
+        for (uint32_t i = 0; i < head && i < length; i++)
+            head_taps[c][head - 1 - i] = h[i];
+        head_history[c].resize(2 * head);
+    }
+
+    // stage block sizes; each stage starts at twice the block size of the next one,
+    // so that the next stage has one full block period to deliver its first result
+    uint32_t blocks[] = { head, 16 * head, 128 * head };
+    const int nblocks = sizeof(blocks) / sizeof(blocks[0]);
+    uint32_t max_block = head;
+    for (int i = 0; i < nblocks; i++)
+    {
+        uint32_t start = i ? 2 * blocks[i] : head;
+        if (start >= length)
+            break;
+        uint32_t end = i < nblocks - 1 ? 2 * blocks[i + 1] : length;
+        stages.push_back(new stage(this, ir, ir_channels, length, blocks[i], start, end, i > 0));
+        max_block = blocks[i];
+    }
+    // the oldest input sample a background stage may still be reading is 3 blocks behind
+    uint32_t in_size = 1;
+    while(in_size < 4 * max_block)
+        in_size <<= 1;
+    in_mask = in_size - 1;
+    for (int c = 0; c < channels; c++)
+        input[c].resize(in_size);
+}
+
+convolver::~convolver()
+{
+    for (size_t i = 0; i < stages.size(); i++)
+        delete stages[i];
+}
+
+int convolver::get_background_stage_count() const
+{
+    int count = 0;
+    for (size_t i = 0; i < stages.size(); i++)
+        count += stages[i]->background;
+    return count;
+}
+
+void convolver::reset()
+{
+    for (size_t i = 0; i < stages.size(); i++)
+        stages[i]->clear();
+    for (int c = 0; c < channels; c++)
+    {
+        std::fill(head_history[c].begin(), head_history[c].end(), 0.f);
+        std::fill(input[c].begin(), input[c].end(), 0.f);
+    }
+    time = 0;
+}
+
+void convolver::process(const float *const *in, float *const *out, uint32_t len)
+{
+    uint32_t done = 0;
+    while(done < len)
+    {
+        // process up to the end of the current head block
+        uint32_t pos = (uint32_t)time & (head - 1);
+        uint32_t count = std::min(len - done, head - pos);
+        uint32_t in_pos = (uint32_t)time & in_mask;
+        for (int c = 0; c < channels; c++)
+        {
+            memcpy(&input[c][in_pos], in[c] + done, count * sizeof(float));
+            memcpy(&head_history[c][head + pos], in[c] + done, count * sizeof(float));
+        }
+        for (size_t s = 0; s < stages.size(); s++)
+        {
+            stage *st = stages[s];
+            if (st->background && time + count > st->offset)
+                st->wait_for((time + count - 1 - st->offset) / st->block + 1);
+        }
+        for (int c = 0; c < channels; c++)
+        {
+            const float *taps = &head_taps[c][0];
+            const float *hist = &head_history[c][pos + 1];
+            float *dst = out[c] + done;
+            for (uint32_t i = 0; i < count; i++)
+            {
+                float sum = 0.f;
+                for (uint32_t j = 0; j < head; j++)
+                    sum += taps[j] * hist[i + j];
+                dst[i] = sum;
+            }
+            for (size_t s = 0; s < stages.size(); s++)
+            {
+                stage *st = stages[s];
+                const float *src = st->output + (size_t)c * (st->out_mask + 1) + ((uint32_t)time & st->out_mask);
+                for (uint32_t i = 0; i < count; i++)
+                    dst[i] += src[i];
+            }
+        }
+        time += count;
+        done += count;
+        if (pos + count < head)
+            continue;
+        // end of a head block: shift the direct convolution history and start the blocks that have been completed
+        for (int c = 0; c < channels; c++)
+            memcpy(&head_history[c][0], &head_history[c][head], head * sizeof(float));
+        for (size_t s = 0; s < stages.size(); s++)
+        {
+            stage *st = stages[s];
+            if (time & (st->block - 1))
+                continue;
+            if (st->background)
+            {
+                st->posted++;
+                sem_post(&st->jobs);
+            }
+            else
+                st->compute(time / st->block - 1);
+        }
+    }
+}
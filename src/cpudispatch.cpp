@@ -0,0 +1,213 @@
+/* Calf DSP Library
+ * Run-time selection of instruction set specific DSP kernels.
+ *
+ * Copyright (C) 2001-2010 Krzysztof Foltman, Markus Schmidt, Thor Harald Johansen and others
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <config.h>
+#include <calf/cpudispatch.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// AVX2 and AVX-512 variants are only built with GCC-compatible compilers on x86,
+// using target attributes, so that the rest of the library keeps the baseline flags
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CALF_DISPATCH_X86 1
+#else
+#define CALF_DISPATCH_X86 0
+#endif
+
+using namespace dsp;
+
+namespace {
+
+// Kernel bodies - plain loops, written so that the compiler can vectorize them
+// for whatever instruction set the (inlining) caller is compiled for.
+
+#define CALF_KERNEL_BODY static inline __attribute__((always_inline))
+
+CALF_KERNEL_BODY void mul_body(float *__restrict dst, const float *__restrict a, const float *__restrict b, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++)
+        dst[i] = a[i] * b[i];
+}
+
+CALF_KERNEL_BODY void mul_add_body(float *__restrict dst, const float *__restrict a, const float *__restrict b, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++)
+        dst[i] += a[i] * b[i];
+}
+
+CALF_KERNEL_BODY void scale_body(float *__restrict dst, float gain, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++)
+        dst[i] *= gain;
+}
+
+CALF_KERNEL_BODY void axpy_body(float *__restrict dst, const float *__restrict src, float gain, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++)
+        dst[i] += src[i] * gain;
+}
+
+CALF_KERNEL_BODY float peak_body(const float *__restrict a, uint32_t len)
+{
+    float peak = 0.f;
+    for (uint32_t i = 0; i < len; i++)
+        peak = std::max(peak, std::abs(a[i]));
+    return peak;
+}
+
+CALF_KERNEL_BODY float peak_mul_body(const float *__restrict a, const float *__restrict w, uint32_t len)
+{
+    float peak = 0.f;
+    for (uint32_t i = 0; i < len; i++)
+        peak = std::max(peak, std::abs(a[i] * w[i]));
+    return peak;
+}
+
+CALF_KERNEL_BODY float peak_sum_mul_body(const float *__restrict a, const float *__restrict b, const float *__restrict w, uint32_t len)
+{
+    float peak = 0.f;
+    for (uint32_t i = 0; i < len; i++)
+        peak = std::max(peak, std::abs((a[i] + b[i]) * w[i]));
+    return peak;
+}
+
+CALF_KERNEL_BODY void clip_to_limit_body(const float *__restrict x, float *__restrict delta, const float *__restrict w, float level, float boost, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++)
+    {
+        float limit = level * w[i];
+        float value = x[i] + delta[i];
+        // the clamped value differs from the value only where it is out of range
+        float clamped = std::max(-limit, std::min(limit, value));
+        delta[i] += (clamped - value) * boost;
+    }
+}
+
+CALF_KERNEL_BODY void limit_complex_body(float *__restrict c, const float *__restrict limit, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++)
+    {
+        float re = c[2 * i], im = c[2 * i + 1];
+        float mag2 = 2.f * std::sqrt(re * re + im * im);
+        // 1 if within the limit, limit / magnitude otherwise (branchless, so that it vectorizes);
+        // FLT_MIN keeps silence (zero limit and magnitude) from turning into 0/0
+        float gain = limit[i] / std::max(std::max(mag2, limit[i]), FLT_MIN);
+        c[2 * i] = re * gain;
+        c[2 * i + 1] = im * gain;
+    }
+}
+
+#define CALF_DEFINE_KERNELS(suffix, isa, attr) \
+    attr void mul_##suffix(float *dst, const float *a, const float *b, uint32_t len) { mul_body(dst, a, b, len); } \
+    attr void mul_add_##suffix(float *dst, const float *a, const float *b, uint32_t len) { mul_add_body(dst, a, b, len); } \
+    attr void scale_##suffix(float *dst, float gain, uint32_t len) { scale_body(dst, gain, len); } \
+    attr void axpy_##suffix(float *dst, const float *src, float gain, uint32_t len) { axpy_body(dst, src, gain, len); } \
+    attr float peak_##suffix(const float *a, uint32_t len) { return peak_body(a, len); } \
+    attr float peak_mul_##suffix(const float *a, const float *w, uint32_t len) { return peak_mul_body(a, w, len); } \
+    attr float peak_sum_mul_##suffix(const float *a, const float *b, const float *w, uint32_t len) { return peak_sum_mul_body(a, b, w, len); } \
+    attr void clip_to_limit_##suffix(const float *x, float *delta, const float *w, float level, float boost, uint32_t len) { clip_to_limit_body(x, delta, w, level, boost, len); } \
+    attr void limit_complex_##suffix(float *c, const float *limit, uint32_t len) { limit_complex_body(c, limit, len); } \
+    const dsp_kernels kernels_##suffix = { isa, mul_##suffix, mul_add_##suffix, scale_##suffix, axpy_##suffix, \
+        peak_##suffix, peak_mul_##suffix, peak_sum_mul_##suffix, clip_to_limit_##suffix, limit_complex_##suffix };
+
+CALF_DEFINE_KERNELS(generic, cpu_isa_generic, )
+#if CALF_DISPATCH_X86
+CALF_DEFINE_KERNELS(avx2, cpu_isa_avx2, __attribute__((target("avx2,fma"))))
+CALF_DEFINE_KERNELS(avx512, cpu_isa_avx512, __attribute__((target("avx512f,avx512vl,avx512dq,avx2,fma,prefer-vector-width=512"))))
+#endif
+
+const char *isa_names[cpu_isa_count] = { "generic", "avx2", "avx512" };
+
+cpu_isa select_cpu_isa()
+{
+    cpu_isa isa = detect_cpu_isa();
+    const char *force = getenv("CALF_FORCE_ISA");
+    if (force && *force)
+    {
+        int forced = -1;
+        if (!strcmp(force, "sse2"))
+            forced = cpu_isa_generic;
+        for (int i = 0; i < cpu_isa_count; i++)
+            if (!strcmp(force, isa_names[i]))
+                forced = i;
+        if (forced == -1)
+            fprintf(stderr, "Calf: unknown CALF_FORCE_ISA value '%s', using %s\n", force, isa_names[isa]);
+        else if (forced > isa)
+            fprintf(stderr, "Calf: CALF_FORCE_ISA=%s is not supported on this machine, using %s\n", force, isa_names[isa]);
+        else
+            isa = (cpu_isa)forced;
+    }
+    return isa;
+}
+
+}
+
+cpu_isa dsp::detect_cpu_isa()
+{
+#if CALF_DISPATCH_X86
+    // may be called from static constructors, before the CPU model is initialised by libgcc
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512dq"))
+        return cpu_isa_avx512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return cpu_isa_avx2;
+#endif
+    return cpu_isa_generic;
+}
+
+cpu_isa dsp::get_cpu_isa()
+{
+    return get_kernels().isa;
+}
+
+const char *dsp::get_cpu_isa_name(cpu_isa isa)
+{
+    return (isa >= 0 && isa < cpu_isa_count) ? isa_names[isa] : "unknown";
+}
+
+const dsp_kernels *dsp::get_kernels_for(cpu_isa isa)
+{
+    if (isa > detect_cpu_isa())
+        return NULL;
+    switch(isa)
+    {
+    case cpu_isa_generic:
+        return &kernels_generic;
+#if CALF_DISPATCH_X86
+    case cpu_isa_avx2:
+        return &kernels_avx2;
+    case cpu_isa_avx512:
+        return &kernels_avx512;
+#endif
+    default:
+        return NULL;
+    }
+}
+
+const dsp_kernels &dsp::get_kernels()
+{
+    // thread-safe one time initialisation (C++11 magic statics)
+    static const dsp_kernels &kernels = *get_kernels_for(select_cpu_isa());
+    return kernels;
+}
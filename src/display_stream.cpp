@@ -0,0 +1,537 @@
+/* Calf DSP Library
+ * Line graph data streamed from the plugin to the GUI.
+ *
+ * Copyright (C) 2001-2010 Krzysztof Foltman, Markus Schmidt, Thor Harald Johansen and others
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <config.h>
+#include <calf/display_stream.h>
+#include <algorithm>
+#include <string.h>
+
+using namespace std;
+using namespace calf_plugins;
+
+typedef display_stream ds;
+
+namespace {
+
+/// Recorded cairo_iface calls
+enum style_op { OP_RGBA, OP_WIDTH, OP_DASH, OP_LABEL };
+enum { MAX_DASH = 8 };
+
+template<class T>
+inline uint8_t *put(uint8_t *pos, const T &value)
+{
+    memcpy(pos, &value, sizeof(T));
+    return pos + sizeof(T);
+}
+
+/// Bounds-checked reading of a message
+struct message_reader
+{
+    const uint8_t *pos, *end;
+    message_reader(const void *data, uint32_t size) : pos((const uint8_t *)data), end(pos + size) {}
+    bool get_bytes(void *dest, uint32_t size)
+    {
+        if ((uint32_t)(end - pos) < size)
+            return false;
+        memcpy(dest, pos, size);
+        pos += size;
+        return true;
+    }
+    template<class T>
+    bool get(T &value) { return get_bytes(&value, sizeof(T)); }
+};
+
+/// Records the style set by the plugin for an item, to be replayed by the GUI on its own context.
+/// Only the last colour, width and dash pattern matter (plugins often set them once per band or per
+/// point), so they are kept as state and written after the labels by finish.
+struct style_recorder: public cairo_iface
+{
+    enum { STATE_SIZE = 1 + 4 * sizeof(float) + 1 + sizeof(float) + 2 + MAX_DASH * sizeof(float) };
+    uint8_t *pos, *end;
+    bool has_rgba, has_width;
+    float rgba[4], width;
+    int dash_length;
+    float dash[MAX_DASH];
+    style_recorder(uint8_t *_pos, const ds::subscribe_body &size)
+    : pos(_pos), end(_pos + ds::MAX_STYLE - STATE_SIZE), has_rgba(false), has_width(false), dash_length(-1)
+    {
+        size_x = size.size_x;
+        size_y = size.size_y;
+        pad_x = pad_y = 0;
+    }
+    virtual void set_source_rgba(float r, float g, float b, float a)
+    {
+        float c[4] = { r, g, b, a };
+        memcpy(rgba, c, sizeof(rgba));
+        has_rgba = true;
+    }
+    virtual void set_line_width(float _width)
+    {
+        width = _width;
+        has_width = true;
+    }
+    virtual void set_dash(const double *_dash, int length)
+    {
+        dash_length = std::max(0, std::min<int>(length, MAX_DASH));
+        for (int i = 0; i < dash_length; i++)
+            dash[i] = _dash[i];
+    }
+    /// Labels that don't fit are left out
+    virtual void draw_label(const char *label, float x, float y, int lpos, float margin, float align)
+    {
+        uint32_t len = std::min<uint32_t>(strlen(label), ds::MAX_LEGEND);
+        if ((uint32_t)(end - pos) < 3 + 4 * sizeof(float) + len)
+            return;
+        float v[4] = { x, y, margin, align };
+        pos = put(put(put(pos, (uint8_t)OP_LABEL), v), (int8_t)lpos);
+        pos = put(pos, (uint8_t)len);
+        memcpy(pos, label, len);
+        pos += len;
+    }
+    /// Write the state set
+    /// @return end of the recorded style
+    uint8_t *finish()
+    {
+        if (has_rgba)
+            pos = put(put(pos, (uint8_t)OP_RGBA), rgba);
+        if (has_width)
+            pos = put(put(pos, (uint8_t)OP_WIDTH), width);
+        if (dash_length >= 0)
+        {
+            pos = put(put(pos, (uint8_t)OP_DASH), (uint8_t)dash_length);
+            for (int i = 0; i < dash_length; i++)
+                pos = put(pos, dash[i]);
+        }
+        return pos;
+    }
+};
+
+void replay_style(const string &style, cairo_iface *context)
+{
+    message_reader r(style.data(), style.length());
+    uint8_t op;
+    while(r.get(op))
+    {
+        switch(op)
+        {
+        case OP_RGBA: {
+            float c[4];
+            if (!r.get(c))
+                return;
+            context->set_source_rgba(c[0], c[1], c[2], c[3]);
+            break;
+        }
+        case OP_WIDTH: {
+            float width;
+            if (!r.get(width))
+                return;
+            context->set_line_width(width);
+            break;
+        }
+        case OP_DASH: {
+            uint8_t length;
+            float dash[MAX_DASH];
+            double dashd[MAX_DASH];
+            if (!r.get(length) || length > MAX_DASH || !r.get_bytes(dash, length * sizeof(float)))
+                return;
+            for (int i = 0; i < length; i++)
+                dashd[i] = dash[i];
+            context->set_dash(dashd, length);
+            break;
+        }
+        case OP_LABEL: {
+            float v[4];
+            int8_t lpos;
+            uint8_t len;
+            char label[ds::MAX_LEGEND + 1];
+            if (!r.get(v) || !r.get(lpos) || !r.get(len) || len > ds::MAX_LEGEND || !r.get_bytes(label, len))
+                return;
+            label[len] = '\0';
+            context->draw_label(label, v[0], v[1], lpos, v[2], v[3]);
+            break;
+        }
+        default:
+            return;
+        }
+    }
+}
+
+/// FNV-1a, never 0 (which means "not sent")
+uint64_t hash_message(const uint8_t *data, uint32_t size)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (uint32_t i = 0; i < size; i++)
+        hash = (hash ^ data[i]) * 1099511628211ULL;
+    return hash ? hash : 1;
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+
+display_stream_writer::display_stream_writer()
+{
+    source = NULL;
+    sample_rate = 44100;
+    active_count = 0;
+    bytes_sent = 0;
+}
+
+void display_stream_writer::init(const line_graph_iface *_source, uint32_t _sample_rate)
+{
+    source = _source;
+    sample_rate = _sample_rate;
+    subscriptions.resize(ds::MAX_SUBSCRIPTIONS);
+    for (size_t i = 0; i < subscriptions.size(); i++)
+        subscriptions[i].index = -1;
+    active_count = 0;
+    message.resize(sizeof(ds::header) + sizeof(uint16_t) + ds::MAX_STYLE + 8 + ds::MAX_POINTS * sizeof(int16_t));
+    values.resize(ds::MAX_POINTS);
+    legend.reserve(4 * ds::MAX_LEGEND);
+}
+
+bool display_stream_writer::process_request(const void *data, uint32_t size)
+{
+    message_reader r(data, size);
+    ds::header hdr;
+    if (!source || !r.get(hdr) || hdr.magic != ds::MAGIC)
+        return false;
+    if (hdr.type == ds::MSG_UNSUBSCRIBE)
+    {
+        for (size_t i = 0; i < subscriptions.size(); i++)
+        {
+            if (subscriptions[i].index != -1 && (hdr.index == -1 || hdr.index == subscriptions[i].index))
+            {
+                subscriptions[i].index = -1;
+                active_count--;
+            }
+        }
+        return true;
+    }
+    ds::subscribe_body body;
+    if (hdr.type != ds::MSG_SUBSCRIBE || hdr.index < 0 || !r.get(body))
+        return false;
+    // a new subscription to a graph (another GUI, or a resized one) starts with the whole graph
+    subscription *sub = NULL;
+    for (size_t i = 0; i < subscriptions.size() && !sub; i++)
+        if (subscriptions[i].index == hdr.index)
+            sub = &subscriptions[i];
+    for (size_t i = 0; i < subscriptions.size() && !sub; i++)
+    {
+        if (subscriptions[i].index == -1)
+        {
+            sub = &subscriptions[i];
+            active_count++;
+        }
+    }
+    if (!sub)
+        return false;
+    sub->index = hdr.index;
+    sub->size_x = std::max(1, std::min<int>(body.size_x, ds::MAX_POINTS));
+    sub->size_y = body.size_y;
+    sub->interval = sample_rate / std::max(1, std::min<int>(body.fps, 100));
+    sub->countdown = 0;
+    sub->generation = 0;
+    sub->pending = 0;
+    memset(sub->sent, 0, sizeof(sub->sent));
+    return true;
+}
+
+void display_stream_writer::run(uint32_t nsamples, display_stream_output &output)
+{
+    for (size_t i = 0; i < subscriptions.size(); i++)
+    {
+        subscription &sub = subscriptions[i];
+        if (sub.index == -1)
+            continue;
+        if (!sub.pending)
+        {
+            if (sub.countdown > nsamples)
+            {
+                sub.countdown -= nsamples;
+                continue;
+            }
+            sub.countdown = sub.interval;
+            unsigned int layers = 0;
+            if (!source->get_layers(sub.index, sub.generation, layers))
+                continue;
+            sub.pending = layers & ~(LG_CACHE_MOVING | LG_REALTIME_MOVING);
+            if (!sub.pending)
+                continue;
+        }
+        // a frame that didn't fit is continued in the next cycle - the items sent already are
+        // identical to the ones last sent, so they're skipped
+        if (send_frame(sub, output))
+        {
+            sub.pending = 0;
+            sub.generation++;
+        }
+    }
+}
+
+bool display_stream_writer::send_frame(subscription &sub, display_stream_output &output)
+{
+    ds::frame_body frame;
+    frame.layers = sub.pending;
+    uint32_t capacity = output.get_message_capacity();
+    for (int phase = 0; phase < 2; phase++)
+    {
+        for (int kind = 0; kind < ds::KIND_COUNT; kind++)
+        {
+            frame.counts[phase][kind] = ds::UNCHANGED;
+            if (!(sub.pending & ds::get_layer(phase, kind)))
+                continue;
+            uint64_t *sent = sub.sent[phase][kind];
+            int count = 0;
+            for (uint32_t size; count < ds::MAX_ITEMS && (size = make_item(sub, phase, kind, count)) != 0; count++)
+            {
+                uint64_t hash = hash_message(&message[0], size);
+                if (hash == sent[count])
+                    continue;
+                // an item that can never fit (tiny host buffer) is left out rather than retried forever
+                if (size <= capacity)
+                {
+                    void *dest = output.add_message(size);
+                    if (!dest)
+                        return false;
+                    memcpy(dest, &message[0], size);
+                    bytes_sent += size;
+                }
+                sent[count] = hash;
+            }
+            frame.counts[phase][kind] = count;
+        }
+    }
+    uint8_t *dest = (uint8_t *)output.add_message(sizeof(ds::header) + sizeof(frame));
+    if (!dest)
+        return false;
+    ds::header hdr = { ds::MAGIC, ds::MSG_FRAME, 0, 0, 0, sub.index, 0 };
+    put(put(dest, hdr), frame);
+    bytes_sent += sizeof(ds::header) + sizeof(frame);
+    // the GUI drops the items past the counts, so they have to be sent again if they reappear
+    for (int phase = 0; phase < 2; phase++)
+        for (int kind = 0; kind < ds::KIND_COUNT; kind++)
+            if (frame.counts[phase][kind] != ds::UNCHANGED)
+                for (int i = frame.counts[phase][kind]; i < ds::MAX_ITEMS; i++)
+                    sub.sent[phase][kind][i] = 0;
+    return true;
+}
+
+uint32_t display_stream_writer::make_item(const subscription &sub, int phase, int kind, int subindex)
+{
+    ds::header hdr = { ds::MAGIC, ds::MSG_ITEM, (uint8_t)phase, (uint8_t)kind, 0, sub.index, subindex };
+    ds::subscribe_body size = { sub.size_x, sub.size_y, 0, 0 };
+    uint8_t *start = &message[0];
+    style_recorder style(put(start, hdr) + sizeof(uint16_t), size);
+    uint8_t *style_start = style.pos, *style_end, *pos;
+    switch(kind)
+    {
+    case ds::KIND_GRAPH: {
+        int mode = 0, points = sub.size_x;
+        if (!source->get_graph(sub.index, subindex, phase, &values[0], points, &style, &mode))
+            return 0;
+        style_end = style.finish();
+        pos = put(put(style_end, (int32_t)mode), (uint16_t)points);
+        for (int i = 0; i < points; i++)
+            pos = put(pos, ds::quantize(values[i]));
+        break;
+    }
+    case ds::KIND_GRID: {
+        float gpos = 0;
+        bool vertical = false;
+        legend.clear();
+        if (!source->get_gridline(sub.index, subindex, phase, gpos, vertical, legend, &style))
+            return 0;
+        uint8_t len = std::min<size_t>(legend.length(), ds::MAX_LEGEND);
+        style_end = style.finish();
+        pos = put(put(put(style_end, gpos), (uint8_t)vertical), len);
+        memcpy(pos, legend.data(), len);
+        pos += len;
+        break;
+    }
+    case ds::KIND_DOT: {
+        float x = 0, y = 0;
+        int dsize = 3;
+        if (!source->get_dot(sub.index, subindex, phase, x, y, dsize, &style))
+            return 0;
+        style_end = style.finish();
+        pos = put(put(put(style_end, x), y), (int32_t)dsize);
+        break;
+    }
+    default:
+        return 0;
+    }
+    put(start + sizeof(hdr), (uint16_t)(style_end - style_start));
+    return pos - start;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+
+bool display_stream_reader::process_message(const void *data, uint32_t size)
+{
+    message_reader r(data, size);
+    ds::header hdr;
+    if (!r.get(hdr) || hdr.magic != ds::MAGIC)
+        return false;
+    map<int, graph>::iterator g = graphs.find(hdr.index);
+    if (g == graphs.end())
+        return hdr.type == ds::MSG_ITEM || hdr.type == ds::MSG_FRAME;
+    if (hdr.type == ds::MSG_FRAME)
+    {
+        ds::frame_body frame;
+        if (!r.get(frame))
+            return false;
+        for (int phase = 0; phase < 2; phase++)
+        {
+            for (int kind = 0; kind < ds::KIND_COUNT; kind++)
+            {
+                if (frame.counts[phase][kind] == ds::UNCHANGED)
+                    continue;
+                item_list &incoming = g->second.incoming[phase][kind];
+                incoming.resize(std::min<int>(frame.counts[phase][kind], incoming.size()));
+                g->second.items[phase][kind] = incoming;
+            }
+        }
+        g->second.layers |= frame.layers;
+        return true;
+    }
+    uint16_t style_size;
+    if (hdr.type != ds::MSG_ITEM || hdr.phase > 1 || hdr.kind >= ds::KIND_COUNT || hdr.subindex < 0 || hdr.subindex >= ds::MAX_ITEMS
+        || !r.get(style_size) || style_size > r.end - r.pos)
+        return false;
+    item it;
+    it.style.assign((const char *)r.pos, style_size);
+    r.pos += style_size;
+    it.mode = it.size = 0;
+    it.x = it.y = 0;
+    it.vertical = false;
+    switch(hdr.kind)
+    {
+    case ds::KIND_GRAPH: {
+        int32_t mode;
+        uint16_t points;
+        if (!r.get(mode) || !r.get(points) || points > ds::MAX_POINTS)
+            return false;
+        it.mode = mode;
+        it.values.resize(points);
+        if (points && !r.get_bytes(&it.values[0], points * sizeof(int16_t)))
+            return false;
+        break;
+    }
+    case ds::KIND_GRID: {
+        uint8_t vertical, len;
+        char legend[256];
+        if (!r.get(it.x) || !r.get(vertical) || !r.get(len) || !r.get_bytes(legend, len))
+            return false;
+        it.vertical = vertical != 0;
+        it.legend.assign(legend, len);
+        break;
+    }
+    case ds::KIND_DOT: {
+        int32_t dsize;
+        if (!r.get(it.x) || !r.get(it.y) || !r.get(dsize))
+            return false;
+        it.size = dsize;
+        break;
+    }
+    }
+    item_list &incoming = g->second.incoming[hdr.phase][hdr.kind];
+    if ((int)incoming.size() <= hdr.subindex)
+        incoming.resize(hdr.subindex + 1);
+    incoming[hdr.subindex] = it;
+    return true;
+}
+
+void display_stream_reader::unsubscribe_all()
+{
+    ds::header hdr = { ds::MAGIC, ds::MSG_UNSUBSCRIBE, 0, 0, 0, -1, 0 };
+    if (!graphs.empty())
+        send_request(&hdr, sizeof(hdr));
+    graphs.clear();
+}
+
+const display_stream_reader::item *display_stream_reader::get_item(int index, int subindex, int phase, int kind, cairo_iface *context) const
+{
+    graph &g = graphs[index];
+    if (g.size_x != context->size_x || g.size_y != context->size_y)
+    {
+        // first drawn, or resized
+        g.size_x = context->size_x;
+        g.size_y = context->size_y;
+        uint8_t request[sizeof(ds::header) + sizeof(ds::subscribe_body)];
+        ds::header hdr = { ds::MAGIC, ds::MSG_SUBSCRIBE, 0, 0, 0, index, 0 };
+        ds::subscribe_body body = { g.size_x, g.size_y, ds::DEFAULT_FPS, 0 };
+        put(put(request, hdr), body);
+        send_request(request, sizeof(request));
+    }
+    const item_list &list = g.items[phase ? 1 : 0][kind];
+    if (subindex < 0 || subindex >= (int)list.size())
+        return NULL;
+    replay_style(list[subindex].style, context);
+    return &list[subindex];
+}
+
+bool display_stream_reader::get_graph(int index, int subindex, int phase, float *data, int points, cairo_iface *context, int *mode) const
+{
+    const item *it = get_item(index, subindex, phase, ds::KIND_GRAPH, context);
+    if (!it)
+        return false;
+    // the size may differ for a moment after resizing
+    int count = it->values.size();
+    for (int i = 0; i < points; i++)
+        data[i] = count ? ds::dequantize(it->values[count == points ? i : (int64_t)i * count / points]) : INFINITY;
+    if (mode)
+        *mode = it->mode;
+    return true;
+}
+
+bool display_stream_reader::get_dot(int index, int subindex, int phase, float &x, float &y, int &size, cairo_iface *context) const
+{
+    const item *it = get_item(index, subindex, phase, ds::KIND_DOT, context);
+    if (!it)
+        return false;
+    x = it->x;
+    y = it->y;
+    size = it->size;
+    return true;
+}
+
+bool display_stream_reader::get_gridline(int index, int subindex, int phase, float &pos, bool &vertical, std::string &legend, cairo_iface *context) const
+{
+    const item *it = get_item(index, subindex, phase, ds::KIND_GRID, context);
+    if (!it)
+        return false;
+    pos = it->x;
+    vertical = it->vertical;
+    legend = it->legend;
+    return true;
+}
+
+bool display_stream_reader::get_layers(int index, int generation, unsigned int &layers) const
+{
+    graph &g = graphs[index];
+    // redraw everything when the widget asks for it (and to get it subscribed)
+    if (!generation || !g.size_x)
+        layers = LG_CACHE_GRID | LG_REALTIME_GRID | LG_CACHE_GRAPH | LG_REALTIME_GRAPH | LG_CACHE_DOT | LG_REALTIME_DOT;
+    else
+        layers = g.layers;
+    g.layers = 0;
+    return layers != 0;
+}
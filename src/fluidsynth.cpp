@@ -43,9 +43,11 @@ fluidsynth_audio_module::fluidsynth_audio_module()
 void fluidsynth_audio_module::post_instantiate(uint32_t sr)
 {
     srate = sr;
-    settings = new_fluid_settings();
-    synth = create_synth(sfid);
-    soundfont_loaded = sfid != -1;
+    loaded_soundfont *data = load_soundfont(soundfont);
+    if (!data)
+        data = load_soundfont(std::string());
+    swap_soundfont(data);
+    delete data;
 }
 
 void fluidsynth_audio_module::activate()
@@ -56,28 +58,44 @@ void fluidsynth_audio_module::deactivate()
 {
 }
 
-fluid_synth_t *fluidsynth_audio_module::create_synth(int &new_sfid)
+fluidsynth_audio_module::loaded_soundfont::loaded_soundfont()
 {
-    std::fill(set_presets, set_presets + 16, -1);
-    fluid_settings_t *new_settings = new_fluid_settings();
-    fluid_settings_setnum(new_settings, "synth.sample-rate", srate);
-    fluid_synth_t *s = new_fluid_synth(new_settings);
-    if (!soundfont.empty())
+    settings = NULL;
+    synth = NULL;
+    sfid = -1;
+}
+
+fluidsynth_audio_module::loaded_soundfont::~loaded_soundfont()
+{
+    if (synth)
+        delete_fluid_synth(synth);
+    if (settings)
+        delete_fluid_settings(settings);
+}
+
+fluidsynth_audio_module::loaded_soundfont *fluidsynth_audio_module::load_soundfont(const std::string &filename)
+{
+    loaded_soundfont *data = new loaded_soundfont;
+    data->soundfont = filename;
+    data->settings = new_fluid_settings();
+    fluid_settings_setnum(data->settings, "synth.sample-rate", srate);
+    fluid_synth_t *s = data->synth = new_fluid_synth(data->settings);
+    if (!filename.empty())
     {
-        int sid = fluid_synth_sfload(s, soundfont.c_str(), 1);
+        int sid = fluid_synth_sfload(s, filename.c_str(), 1);
         if (sid == -1)
         {
-            delete_fluid_synth(s);
+            delete data;
             return NULL;
         }
         assert(sid >= 0);
         printf("sid=%d\n", sid);
         fluid_synth_sfont_select(s, 0, sid);
-        new_sfid = sid;
+        data->sfid = sid;
 
         fluid_sfont_t* sfont = fluid_synth_get_sfont(s, 0);
 #if FLUIDSYNTH_VERSION_MAJOR < 2
-        soundfont_name = (*sfont->get_name)(sfont);
+        data->soundfont_name = (*sfont->get_name)(sfont);
 
         sfont->iteration_start(sfont);
         
@@ -90,13 +108,13 @@ fluid_synth_t *fluidsynth_audio_module::create_synth(int &new_sfid)
             int bank = tmp.get_banknum(&tmp);
             int num = tmp.get_num(&tmp);
             int id = num + 128 * bank;
-            sf_preset_names[id] = pname;
+            data->sf_preset_names[id] = pname;
             preset_list += calf_utils::i2s(id) + "\t" + pname + "\n";
             if (first_preset == -1)
                 first_preset = id;
         }
 #else
-        soundfont_name = fluid_sfont_get_name(sfont);
+        data->soundfont_name = fluid_sfont_get_name(sfont);
 
         fluid_sfont_iteration_start(sfont);
 
@@ -109,7 +127,7 @@ fluid_synth_t *fluidsynth_audio_module::create_synth(int &new_sfid)
             int bank = fluid_preset_get_banknum(tmp);
             int num = fluid_preset_get_num(tmp);
             int id = num + 128 * bank;
-            sf_preset_names[id] = pname;
+            data->sf_preset_names[id] = pname;
             preset_list += calf_utils::i2s(id) + "\t" + pname + "\n";
             if (first_preset == -1)
                 first_preset = id;
@@ -120,36 +138,97 @@ fluid_synth_t *fluidsynth_audio_module::create_synth(int &new_sfid)
             fluid_synth_bank_select(s, 0, first_preset >> 7);
             fluid_synth_program_change(s, 0, first_preset & 127);        
         }
-        soundfont_preset_list = preset_list;
+        data->soundfont_preset_list = preset_list;
     }
-    else
-        new_sfid = -1;
-    return s;
+    return data;
+}
+
+void fluidsynth_audio_module::swap_soundfont(loaded_soundfont *data)
+{
+    std::swap(settings, data->settings);
+    std::swap(synth, data->synth);
+    std::swap(sfid, data->sfid);
+    soundfont.swap(data->soundfont);
+    soundfont_name.swap(data->soundfont_name);
+    soundfont_preset_list.swap(data->soundfont_preset_list);
+    sf_preset_names.swap(data->sf_preset_names);
+    std::fill(set_presets, set_presets + 16, -1);
+    soundfont_loaded = sfid != -1;
+    for (int i = 0; i < 16; ++i)
+        update_preset_num(i);
+}
+
+void fluidsynth_audio_module::free_soundfont(loaded_soundfont *data)
+{
+    soundfont_job job = { job_free_soundfont, data };
+    if (!worker || !worker->schedule_work(sizeof(job), &job))
+        delete data;
+}
+
+void fluidsynth_audio_module::work(uint32_t size, const void *data, worker_response_iface *response)
+{
+    soundfont_job job;
+    memcpy(&job, data, sizeof(job));
+    if (job.type == job_load_soundfont)
+    {
+        string filename((const char *)data + sizeof(job), size - sizeof(job));
+        printf("Loading %s\n", filename.c_str());
+        loaded_soundfont *result = load_soundfont(filename);
+        if (!result)
+            fprintf(stderr, "Cannot load a soundfont %s\n", filename.c_str());
+        // a NULL result is sent too, so that the status gets refreshed
+        if (!response->respond(sizeof(result), &result))
+            delete result;
+    }
+    else if (job.type == job_free_soundfont)
+        delete job.data;
+}
+
+void fluidsynth_audio_module::work_response(uint32_t size, const void *data)
+{
+    loaded_soundfont *result;
+    memcpy(&result, data, sizeof(result));
+    status_serial++;
+    if (!result)
+        return;
+    swap_soundfont(result);
+    // the previous synth is now in result
+    free_soundfont(result);
 }
 
 void fluidsynth_audio_module::note_on(int channel, int note, int vel)
 {
-    fluid_synth_noteon(synth, channel, note, vel);
+    int ch = synth_channel(channel);
+    if (ch >= 0)
+        fluid_synth_noteon(synth, ch, note, vel);
 }
 
 void fluidsynth_audio_module::note_off(int channel, int note, int vel)
 {
-    fluid_synth_noteoff(synth, channel, note);
+    int ch = synth_channel(channel);
+    if (ch >= 0)
+        fluid_synth_noteoff(synth, ch, note);
 }
 
 void fluidsynth_audio_module::control_change(int channel, int controller, int value)
 {
-    fluid_synth_cc(synth, channel, controller, value);
+    int ch = synth_channel(channel);
+    if (ch < 0)
+        return;
+    fluid_synth_cc(synth, ch, controller, value);
 
     if (controller == 0 || controller == 32)
-        update_preset_num(channel);
+        update_preset_num(ch);
 }
 
 void fluidsynth_audio_module::program_change(int channel, int program)
 {
-    fluid_synth_program_change(synth, channel, program);
+    int ch = synth_channel(channel);
+    if (ch < 0)
+        return;
+    fluid_synth_program_change(synth, ch, program);
 
-    update_preset_num(channel);
+    update_preset_num(ch);
 }
 
 
@@ -213,35 +292,37 @@ char *fluidsynth_audio_module::configure(const char *key, const char *value)
     }
     if (!strcmp(key, "soundfont"))
     {
-        if (value && *value)
+        if (!value)
+            value = "";
+        // First synth not yet created - defer creation up to post_instantiate
+        if (!synth)
         {
-            printf("Loading %s\n", value);
             soundfont = value;
+            return NULL;
         }
-        else
+        // On the audio thread, the synth is created by the worker thread and swapped in by work_response
+        if (worker)
         {
-            printf("Creating a blank synth\n");
-            soundfont.clear();
+            uint32_t len = strlen(value);
+            STACKALLOC(char, msg, sizeof(soundfont_job) + len);
+            soundfont_job job = { job_load_soundfont, NULL };
+            memcpy(msg, &job, sizeof(job));
+            memcpy(msg + sizeof(job), value, len);
+            if (worker->schedule_work(sizeof(job) + len, msg))
+                return NULL;
         }
-        // First synth not yet created - defer creation up to post_instantiate
-        if (!synth)
-            return NULL;
-        int newsfid = -1;
-        fluid_synth_t *new_synth = create_synth(newsfid);
-        soundfont_loaded = newsfid != -1;
+        if (*value)
+            printf("Loading %s\n", value);
+        else
+            printf("Creating a blank synth\n");
+        loaded_soundfont *data = load_soundfont(value);
 
         status_serial++;
         
-        if (new_synth)
-        {
-            synth = new_synth;
-            sfid = newsfid;
-            for (int i = 0; i < 16; ++i)
-                update_preset_num(i);
-        }
-        else
+        if (!data)
             return strdup("Cannot load a soundfont");
-        // XXXKF memory leak
+        swap_soundfont(data);
+        free_soundfont(data);
     }
     return NULL;
 }
@@ -287,7 +368,7 @@ fluidsynth_audio_module::~fluidsynth_audio_module()
         synth = NULL;
     }
     if (settings) {
-        // delete_fluid_settings(settings);
+        delete_fluid_settings(settings);
         settings = NULL;
     }
 }
@@ -19,6 +19,7 @@
  * Boston, MA  02110-1301  USA
  */
 #include <config.h>
+#include <ctype.h>
 #include <limits.h>
 #include <stdlib.h>
 #include <math.h>
@@ -45,6 +46,30 @@ void automation_range::send_configure(const plugin_metadata_iface *metadata, uin
     sci->send_configure(ss1.str().c_str(), ss2.str().c_str());
 }
 
+automation_table::automation_table(const automation_map &map, const plugin_metadata_iface *metadata)
+{
+    // the map is sorted by designator, which is also the table order
+    uint32_t index = 0;
+    first[0] = 0;
+    for (automation_map::const_iterator i = map.begin(); i != map.end(); ++i)
+    {
+        int idx = get_index(i->first);
+        if (idx == -1)
+            continue;
+        for (; index < (uint32_t)idx; index++)
+            first[index + 1] = targets.size();
+        const automation_range &r = i->second;
+        const parameter_properties *props = metadata->get_param_props(r.param_no);
+        targets.push_back(target());
+        target &t = targets.back();
+        t.param_no = r.param_no;
+        for (int value = 0; value < 128; value++)
+            t.values[value] = props->from_01(r.min_value + value * (r.max_value - r.min_value)/ 127.0);
+    }
+    for (; index < CHANNELS * CONTROLLERS; index++)
+        first[index + 1] = targets.size();
+}
+
 automation_range *automation_range::new_from_configure(const plugin_metadata_iface *metadata, const char *key, const char *value, uint32_t &from_controller)
 {
     if (0 != strncmp(key, automation_key_prefix, sizeof(automation_key_prefix) - 1))
@@ -371,9 +396,9 @@ bool calf_plugins::get_freq_gridline(int subindex, float &pos, bool &vertical, s
         return false;
 
     if (!(subindex & 1)) {
-        std::stringstream ss;
-        ss << (36 - 6 * subindex) << " dBFS";
-        legend = ss.str();
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%d dBFS", 36 - 6 * subindex);
+        legend = buf;
     }
     if (!legend.empty() && subindex != 6) {
         context->set_source_rgba(0, 0, 0, 0.1);
@@ -497,30 +522,37 @@ calf_plugins::plugin_registry &calf_plugins::plugin_registry::instance()
     return registry;
 }
 
+static std::string to_lower(const char *str)
+{
+    std::string result(str);
+    for (size_t i = 0; i < result.length(); i++)
+        result[i] = tolower(result[i]);
+    return result;
+}
+
+void calf_plugins::plugin_registry::add(const plugin_metadata_iface *plugin)
+{
+    plugins.push_back(plugin);
+    // insert() keeps the first plugin when names clash, like a linear search would
+    by_label.insert(plugin_index::value_type(plugin->get_plugin_info().label, plugin));
+    by_id.insert(plugin_index::value_type(to_lower(plugin->get_id()), plugin));
+}
+
 const plugin_metadata_iface *calf_plugins::plugin_registry::get_by_uri(const char *plugin_uri)
 {
     static const char prefix[] = "http://calf.sourceforge.net/plugins/";
     if (strncmp(plugin_uri, prefix, sizeof(prefix) - 1))
         return NULL;
-    const char *label = plugin_uri + sizeof(prefix) - 1;
-    for (unsigned int i = 0; i < plugins.size(); i++)
-    {
-        if (!strcmp(plugins[i]->get_plugin_info().label, label))
-            return plugins[i];
-    }
-    return NULL;
+    plugin_index::const_iterator i = by_label.find(plugin_uri + sizeof(prefix) - 1);
+    return i != by_label.end() ? i->second : NULL;
 }
 
 const plugin_metadata_iface *calf_plugins::plugin_registry::get_by_id(const char *id, bool case_sensitive)
 {
-    typedef int (*comparator)(const char *, const char *);
-    comparator comp = case_sensitive ? strcmp : strcasecmp;
-    for (unsigned int i = 0; i < plugins.size(); i++)
-    {
-        if (!comp(plugins[i]->get_id(), id))
-            return plugins[i];
-    }
-    return NULL;
+    plugin_index::const_iterator i = by_id.find(to_lower(id));
+    if (i == by_id.end() || (case_sensitive && strcmp(i->second->get_id(), id)))
+        return NULL;
+    return i->second;
 }
 
 ////////////////////////////////////////////////////////////////////////
@@ -30,6 +30,7 @@ gtk_main_window::gtk_main_window()
     notifier = NULL;
     is_closed = true;
     progress_window = NULL;
+    idle_count = 0;
     images = image_factory();
 }
 
@@ -479,6 +480,9 @@ plugin_strip *gtk_main_window::create_strip(jack_host *plugin)
     GtkWidget *buttonBox = gtk_hbox_new(FALSE, 5);
     gtk_box_pack_start(GTK_BOX(buttonBox), GTK_WIDGET(strip->button), FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(buttonBox), GTK_WIDGET(strip->con), FALSE, FALSE, 0);
+    // DSP load, next to the buttons
+    strip->load = gtk_label_new("");
+    gtk_box_pack_start(GTK_BOX(buttonBox), GTK_WIDGET(strip->load), FALSE, FALSE, 0);
     gtk_container_add(GTK_CONTAINER(balign), buttonBox);
     gtk_table_attach(GTK_TABLE(strip->strip_table), balign, 1, 3, 2, 3, ao, ao, 5, 5);
     gtk_widget_show_all(balign);
@@ -997,12 +1001,16 @@ gboolean gtk_main_window::on_idle(void *data)
     if (!self->refresh_controller.check_redraw(GTK_WIDGET(self->toplevel)))
         return TRUE;
 
+    // the DSP load is updated twice a second
+    bool update_load = (self->idle_count++ % 15) == 0;
     for (std::map<plugin_ctl_iface *, plugin_strip *>::iterator i = self->plugins.begin(); i != self->plugins.end(); ++i)
     {
         if (i->second)
         {
             plugin_ctl_iface *plugin = i->first;
             plugin_strip *strip = i->second;
+            if (update_load && strip->load)
+                self->update_load(strip);
             int idx = 0;
             if (strip->inBox && gtk_widget_is_drawable (strip->inBox)) {
                 for (int i = 0; i < (int)strip->audio_in.size(); i++) {
@@ -1026,6 +1034,22 @@ gboolean gtk_main_window::on_idle(void *data)
     return TRUE;
 }
 
+void gtk_main_window::update_load(plugin_strip *strip)
+{
+    const dsp_load_meter &load = strip->plugin->load;
+    float mean, p95, peak;
+    load.get_stats(mean, p95, peak);
+    char buf[64], tooltip[320];
+    if (load.xruns)
+        snprintf(buf, sizeof(buf), "DSP %.1f%%, %u xruns", mean * 100, (unsigned)load.xruns);
+    else
+        snprintf(buf, sizeof(buf), "DSP %.1f%%", mean * 100);
+    snprintf(tooltip, sizeof(tooltip), "Share of the JACK period used by this plugin\nmean %.1f%%, 95th percentile %.1f%%, maximum %.1f%%\nxruns while processing: %u\nmemory: %.1f MB",
+        mean * 100, p95 * 100, peak * 100, (unsigned)load.xruns, strip->plugin->get_memory_footprint() / 1048576.0);
+    gtk_label_set_text(GTK_LABEL(strip->load), buf);
+    gtk_widget_set_tooltip_text(strip->load, tooltip);
+}
+
 void gtk_main_window::open_file()
 {
     GtkWidget *dialog;
@@ -20,6 +20,7 @@
  
 #include <calf/gui_config.h>
 #include <calf/gui_controls.h>
+#include <calf/gui_layout.h>
 #include <calf/preset.h>
 #include <calf/preset_gui.h>
 #include <gdk/gdk.h>
@@ -199,9 +200,17 @@ void plugin_gui::xml_element_end(void *data, const char *element)
 
 
 GtkWidget *plugin_gui::create_from_xml(plugin_ctl_iface *_plugin, const char *xml)
+{
+    gui_layout layout;
+    std::string error;
+    if (!layout.compile(xml, error))
+        g_error("%s in XML", error.c_str());
+    return create_from_layout(_plugin, &layout);
+}
+
+GtkWidget *plugin_gui::create_from_layout(plugin_ctl_iface *_plugin, const gui_layout *layout)
 {
     top_container = NULL;
-    parser = XML_ParserCreate("UTF-8");
     plugin = _plugin;
     stack.clear();
     ignore_stack = 0;
@@ -213,15 +222,8 @@ GtkWidget *plugin_gui::create_from_xml(plugin_ctl_iface *_plugin, const char *xm
     for (int i = 0; i < size; i++)
         param_name_map[plugin->get_metadata_iface()->get_param_props(i)->short_name] = i;
     
-    XML_SetUserData(parser, this);
-    XML_SetElementHandler(parser, xml_element_start, xml_element_end);
-    XML_Status status = XML_Parse(parser, xml, strlen(xml), 1);
-    if (status == XML_STATUS_ERROR)
-    {
-        g_error("Parse error: %s in XML", XML_ErrorString(XML_GetErrorCode(parser)));
-    }
+    layout->replay(this, xml_element_start, xml_element_end);
     
-    XML_ParserFree(parser);
     last_status_serial_no = plugin->send_status_updates(this, 0);
     return top_container->widget;
 }
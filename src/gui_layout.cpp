@@ -0,0 +1,296 @@
+/* Calf DSP Library
+ * Precompiled GUI layouts.
+ *
+ * Copyright (C) 2001-2010 Krzysztof Foltman, Markus Schmidt, Thor Harald Johansen and others
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <config.h>
+#include <calf/giface.h>
+#include <calf/gui_layout.h>
+#include <errno.h>
+#include <expat.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+using namespace calf_plugins;
+
+namespace calf_plugins {
+
+/// Expat handlers building a gui_layout, with the strings interned
+struct gui_layout_compiler
+{
+    gui_layout &layout;
+    unordered_map<string, int32_t> string_offsets;
+
+    gui_layout_compiler(gui_layout &_layout) : layout(_layout) {}
+
+    int32_t intern(const char *str)
+    {
+        unordered_map<string, int32_t>::const_iterator i = string_offsets.find(str);
+        if (i != string_offsets.end())
+            return i->second;
+        int32_t offset = layout.strings.length();
+        layout.strings.append(str, strlen(str) + 1);
+        string_offsets[str] = offset;
+        return offset;
+    }
+    static void start(void *user_data, const char *element, const char *attributes[])
+    {
+        gui_layout_compiler *self = (gui_layout_compiler *)user_data;
+        gui_layout::node n = { self->intern(element), (int32_t)self->layout.attribute_offsets.size() };
+        for (; *attributes; attributes++)
+            self->layout.attribute_offsets.push_back(self->intern(*attributes));
+        self->layout.attribute_offsets.push_back(-1);
+        self->layout.nodes.push_back(n);
+    }
+    static void end(void *user_data, const char *element)
+    {
+        gui_layout_compiler *self = (gui_layout_compiler *)user_data;
+        gui_layout::node n = { self->intern(element), -1 };
+        self->layout.nodes.push_back(n);
+    }
+};
+
+};
+
+bool gui_layout::compile(const char *xml, std::string &error)
+{
+    strings.clear();
+    nodes.clear();
+    attribute_offsets.clear();
+    gui_layout_compiler compiler(*this);
+    XML_Parser parser = XML_ParserCreate("UTF-8");
+    XML_SetUserData(parser, &compiler);
+    XML_SetElementHandler(parser, gui_layout_compiler::start, gui_layout_compiler::end);
+    XML_Status status = XML_Parse(parser, xml, strlen(xml), 1);
+    if (status == XML_STATUS_ERROR)
+        error = string("Parse error: ") + XML_ErrorString(XML_GetErrorCode(parser)) + " in line " + calf_utils::i2s(XML_GetCurrentLineNumber(parser));
+    XML_ParserFree(parser);
+    resolve();
+    return status != XML_STATUS_ERROR;
+}
+
+void gui_layout::resolve()
+{
+    attribute_ptrs.resize(attribute_offsets.size());
+    for (size_t i = 0; i < attribute_offsets.size(); i++)
+        attribute_ptrs[i] = attribute_offsets[i] == -1 ? NULL : strings.data() + attribute_offsets[i];
+}
+
+void gui_layout::replay(void *user_data, start_handler start, end_handler end) const
+{
+    const char *str = strings.data();
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        const node &n = nodes[i];
+        if (n.attributes != -1)
+            start(user_data, str + n.element, const_cast<const char **>(&attribute_ptrs[n.attributes]));
+        else
+            end(user_data, str + n.element);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+
+// Binary form: a 32-bit length followed by the data, for the strings, the nodes and the
+// attribute offsets. Native byte order - the file is generated on the machine it's installed on.
+
+template<class T>
+static void put_array(string &out, const T *data, uint32_t count)
+{
+    out.append((const char *)&count, sizeof(count));
+    out.append((const char *)data, count * sizeof(T));
+}
+
+template<class T, class Container>
+static bool get_array(const char *&pos, const char *end, Container &result)
+{
+    uint32_t count;
+    if ((size_t)(end - pos) < sizeof(count))
+        return false;
+    memcpy(&count, pos, sizeof(count));
+    pos += sizeof(count);
+    if ((size_t)(end - pos) / sizeof(T) < count)
+        return false;
+    result.resize(count);
+    if (count)
+        memcpy(&result[0], pos, count * sizeof(T));
+    pos += count * sizeof(T);
+    return true;
+}
+
+void gui_layout::serialize(std::string &out) const
+{
+    put_array(out, strings.data(), strings.length());
+    put_array(out, nodes.empty() ? NULL : &nodes[0], nodes.size());
+    put_array(out, attribute_offsets.empty() ? NULL : &attribute_offsets[0], attribute_offsets.size());
+}
+
+bool gui_layout::deserialize(const char *&pos, const char *end)
+{
+    bool ok = get_array<char>(pos, end, strings) && get_array<node>(pos, end, nodes) && get_array<int32_t>(pos, end, attribute_offsets);
+    // everything has to point inside the arrays, at NUL-terminated strings, with terminated attribute lists
+    ok = ok && (strings.empty() || strings[strings.length() - 1] == '\0');
+    ok = ok && (attribute_offsets.empty() || attribute_offsets.back() == -1);
+    int32_t len = strings.length();
+    for (size_t i = 0; ok && i < attribute_offsets.size(); i++)
+        ok = attribute_offsets[i] >= -1 && attribute_offsets[i] < len;
+    for (size_t i = 0; ok && i < nodes.size(); i++)
+        ok = nodes[i].element >= 0 && nodes[i].element < len && nodes[i].attributes >= -1 && nodes[i].attributes < (int32_t)attribute_offsets.size();
+    if (!ok)
+    {
+        strings.clear();
+        nodes.clear();
+        attribute_offsets.clear();
+    }
+    resolve();
+    return ok;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+
+static const char gui_layout_magic[8] = { 'C', 'A', 'L', 'F', 'G', 'U', 'I', '1' };
+static const uint32_t gui_layout_byte_order = 0x01020304;
+
+gui_layout_library &gui_layout_library::instance()
+{
+    static gui_layout_library library;
+    return library;
+}
+
+const gui_layout *gui_layout_library::get(const char *prefix, const char *plugin_id)
+{
+    calf_utils::ptlock lock(mutex);
+    if (!file_checked)
+    {
+        load(PKGLIBDIR "gui-layouts.bin");
+        file_checked = true;
+    }
+    string key = string(prefix) + "/" + plugin_id;
+    if (!layouts.count(key))
+    {
+        // not installed by calfmakerdf - compile the XML file now, once
+        // (a missing file is remembered as an empty layout)
+        if (!add_xml_file(key, PKGLIBDIR "/" + key + ".xml"))
+            layouts[key];
+    }
+    return find(key);
+}
+
+const gui_layout *gui_layout_library::find(const std::string &key) const
+{
+    unordered_map<string, gui_layout>::const_iterator i = layouts.find(key);
+    return i != layouts.end() && i->second.get_element_count() ? &i->second : NULL;
+}
+
+bool gui_layout_library::add_xml_file(const std::string &key, const std::string &filename)
+{
+    string xml, error;
+    try {
+        xml = calf_utils::load_file(filename);
+    }
+    catch(calf_utils::file_exception &e)
+    {
+        return false;
+    }
+    gui_layout &layout = layouts[key];
+    if (layout.compile(xml.c_str(), error))
+        return true;
+    fprintf(stderr, "Calf: cannot compile GUI layout %s: %s\n", filename.c_str(), error.c_str());
+    layouts.erase(key);
+    return false;
+}
+
+int gui_layout_library::add_xml_directory(const std::string &prefix, const std::string &path)
+{
+    struct stat st;
+    int error = stat(path.c_str(), &st) ? errno : S_ISDIR(st.st_mode) ? 0 : ENOTDIR;
+    if (error)
+    {
+        fprintf(stderr, "Calf: cannot read GUI layout directory %s: %s\n", path.c_str(), strerror(error));
+        return -1;
+    }
+    int count = 0;
+    vector<calf_utils::direntry> files = calf_utils::list_directory(path);
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        const string &name = files[i].name;
+        if (name.length() > 4 && name.compare(name.length() - 4, 4, ".xml") == 0)
+            count += add_xml_file(prefix + "/" + name.substr(0, name.length() - 4), files[i].full_path);
+    }
+    return count;
+}
+
+bool gui_layout_library::save(const std::string &filename) const
+{
+    string data(gui_layout_magic, sizeof(gui_layout_magic));
+    uint32_t header[2] = { gui_layout_byte_order, (uint32_t)layouts.size() };
+    data.append((const char *)header, sizeof(header));
+    for (unordered_map<string, gui_layout>::const_iterator i = layouts.begin(); i != layouts.end(); ++i)
+    {
+        put_array(data, i->first.data(), i->first.length());
+        i->second.serialize(data);
+    }
+    FILE *f = fopen(filename.c_str(), "wb");
+    if (!f)
+        return false;
+    bool ok = fwrite(data.data(), 1, data.length(), f) == data.length();
+    return !fclose(f) && ok;
+}
+
+bool gui_layout_library::load(const std::string &filename)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size < (off_t)(sizeof(gui_layout_magic) + 8))
+    {
+        close(fd);
+        return false;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+    const char *pos = (const char *)map, *end = pos + st.st_size;
+    uint32_t header[2];
+    memcpy(header, pos + sizeof(gui_layout_magic), sizeof(header));
+    bool ok = !memcmp(pos, gui_layout_magic, sizeof(gui_layout_magic)) && header[0] == gui_layout_byte_order;
+    pos += sizeof(gui_layout_magic) + sizeof(header);
+    for (uint32_t i = 0; ok && i < header[1]; i++)
+    {
+        string key;
+        ok = get_array<char>(pos, end, key) && layouts[key].deserialize(pos, end);
+        // the damaged layout is compiled from its XML file by get()
+        if (!ok)
+            layouts.erase(key);
+    }
+    munmap(map, st.st_size);
+    if (!ok)
+        fprintf(stderr, "Calf: GUI layout file %s is damaged, using the XML files\n", filename.c_str());
+    return ok;
+}
+
+const gui_layout *calf_plugins::get_gui_layout(const char *prefix, const char *plugin_id)
+{
+    return gui_layout_library::instance().get(prefix, plugin_id);
+}
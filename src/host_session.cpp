@@ -24,7 +24,9 @@
 #include <calf/host_session.h>
 #include <calf/gui.h>
 #include <calf/preset.h>
+#include <algorithm>
 #include <getopt.h>
+#include <list>
 #include <sys/stat.h>
 
 using namespace std;
@@ -44,11 +46,13 @@ host_session::host_session(session_environment_iface *se)
     gui_win = NULL;
     has_gui = true;
     has_trayicon = true;
+    lock_memory = false;
     session_manager = NULL;
     only_load_if_exists = false;
     save_file_on_next_idle_call = false;
     quit_on_next_idle_call = 0;
     handle_event_on_next_idle_call = NULL;
+    xruns_reported = 0;
 }
 
 extern "C" plugin_metadata_iface *create_calf_metadata_by_name(const char *effect_name);
@@ -81,41 +85,142 @@ std::string host_session::get_next_instance_name(const std::string &instance_nam
 
 void host_session::add_plugin(string name, string preset, string instance_name)
 {
-    if (instance_name.empty())
-        instance_name = get_next_instance_name(get_full_plugin_name(name));
-    jack_host *jh = create_jack_host(&client, name.c_str(), instance_name, main_win);
-    if (!jh) {
-        string s = 
-        #define PER_MODULE_ITEM(name, isSynth, jackname) jackname ", "
-        #include <calf/modulelist.h>
-        ;
-        if (!s.empty())
-            s = s.substr(0, s.length() - 2);
-        throw text_exception("Unknown plugin name \"" + name + "\" - allowed are: " + s);
+    vector<plugin_request> requests(1);
+    requests[0].name = name;
+    requests[0].instance_name = instance_name;
+    requests[0].preset_name = preset;
+    add_plugins(requests);
+}
+
+struct plugin_instantiation
+{
+    const vector<host_session::plugin_request> *requests;
+    /// Presets found by name, or given in the requests
+    vector<const plugin_preset *> presets;
+    vector<string> instance_names;
+    vector<jack_host *> hosts;
+    vector<string> errors;
+    jack_client *client;
+    bool lock_memory;
+};
+
+static void lock_plugin_memory(jack_host *jh)
+{
+    if (!jh->module->lock_memory())
+        fprintf(stderr, "Cannot lock the memory of %s in RAM (see ulimit -l)\n", jh->instance_name.c_str());
+}
+
+/// Construct one plugin and restore its state - this doesn't involve JACK or the GUI, so it runs
+/// on the add_plugins thread pool; organ wave tables, delay buffers, soundfonts etc. are prepared here
+static void instantiate_plugin(void *arg, int index)
+{
+    plugin_instantiation *pi = (plugin_instantiation *)arg;
+    const host_session::plugin_request &req = (*pi->requests)[index];
+    try {
+        // no progress reports from here, the GUI is not thread-safe
+        jack_host *jh = create_jack_host(pi->client, req.name.c_str(), pi->instance_names[index], NULL);
+        pi->hosts[index] = jh;
+        jh->init_module();
+        if (pi->lock_memory)
+            lock_plugin_memory(jh);
+        if (pi->presets[index])
+            pi->presets[index]->activate(jh);
+        for (size_t i = 0; i < req.configure_vars.size(); ++i)
+            jh->configure(req.configure_vars[i].first.c_str(), req.configure_vars[i].second.c_str());
+    }
+    catch(std::exception &e)
+    {
+        pi->errors[index] = e.what();
+    }
+}
+
+void host_session::add_plugins(const vector<plugin_request> &requests)
+{
+    plugin_instantiation pi;
+    pi.requests = &requests;
+    pi.presets.resize(requests.size());
+    pi.instance_names.resize(requests.size());
+    pi.hosts.resize(requests.size());
+    pi.errors.resize(requests.size());
+    pi.client = &client;
+    pi.lock_memory = lock_memory;
+    // names and presets are looked up in advance, as the lookups are not thread-safe
+    for (size_t i = 0; i < requests.size(); i++)
+    {
+        const plugin_request &req = requests[i];
+        plugin_metadata_iface *metadata = create_calf_metadata_by_name(req.name.c_str());
+        if (!metadata) {
+            for (size_t j = 0; j < i; j++)
+                instances.erase(pi.instance_names[j]);
+            string s = 
+            #define PER_MODULE_ITEM(name, isSynth, jackname) jackname ", "
+            #include <calf/modulelist.h>
+            ;
+            if (!s.empty())
+                s = s.substr(0, s.length() - 2);
+            throw text_exception("Unknown plugin name \"" + req.name + "\" - allowed are: " + s);
+        }
+        pi.instance_names[i] = req.instance_name.empty() ? get_next_instance_name(metadata->get_label()) : req.instance_name;
+        instances.insert(pi.instance_names[i]);
+        pi.presets[i] = req.preset;
+        if (!req.preset_name.empty()) {
+            int pos = get_user_presets().find(metadata->get_id(), req.preset_name);
+            if (pos != -1)
+                pi.presets[i] = &get_user_presets().presets[pos];
+            else if ((pos = get_builtin_presets().find(metadata->get_id(), req.preset_name)) != -1)
+                pi.presets[i] = &get_builtin_presets().presets[pos];
+            else
+                fprintf(stderr, "Unknown preset: %s\n", req.preset_name.c_str());
+        }
+        delete metadata;
     }
-    instances.insert(jh->instance_name);
-    jh->create();
     
-    plugins.push_back(jh);
-    client.add(jh);
-    if (has_gui)
-        main_win->add_plugin(jh);
-    if (!preset.empty()) {
-        if (!activate_preset(plugins.size() - 1, preset, false))
-        {
-            if (!activate_preset(plugins.size() - 1, preset, true))
-            {
-                fprintf(stderr, "Unknown preset: %s\n", preset.c_str());
+    parallel_for(requests.size(), instantiate_plugin, &pi);
+    
+    // JACK port registration and the GUI stay on this thread, in the original order (which also
+    // determines the port numbers)
+    for (size_t i = 0; i < requests.size(); i++)
+    {
+        jack_host *jh = pi.hosts[i];
+        if (!pi.errors[i].empty() || !jh) {
+            fprintf(stderr, "Cannot create plugin %s: %s\n", requests[i].name.c_str(), pi.errors[i].c_str());
+            instances.erase(pi.instance_names[i]);
+            if (jh) {
+                // no ports to unregister yet
+                jh->client = NULL;
+                delete jh;
             }
+            continue;
+        }
+        const plugin_request &req = requests[i];
+        if (req.input_nr != -1) client.input_nr = req.input_nr;
+        if (req.output_nr != -1) client.output_nr = req.output_nr;
+        if (req.midi_nr != -1) client.midi_nr = req.midi_nr;
+        jh->create_ports();
+        jh->cache_ports();
+        jh->module->set_progress_report_iface(main_win);
+        
+        plugins.push_back(jh);
+        client.add(jh);
+        if (has_gui) {
+            main_win->add_plugin(jh);
+            if (pi.presets[i])
+                main_win->refresh_plugin(jh);
         }
     }
+    if (gui_win)
+        gui_win->refresh();
 }
 
 void host_session::create_plugins_from_list()
 {
+    vector<plugin_request> requests(plugin_names.size());
     for (unsigned int i = 0; i < plugin_names.size(); i++) {
-        add_plugin(plugin_names[i], presets.count(i) ? presets[i] : string());
+        requests[i].name = plugin_names[i];
+        if (presets.count(i))
+            requests[i].preset_name = presets[i];
     }
+    add_plugins(requests);
 }
 
 void host_session::on_main_window_destroy()
@@ -137,6 +242,7 @@ void host_session::open()
         main_win->set_owner(this);
         main_win->add_condition("jackhost");
         main_win->add_condition("directlink");
+        main_win->add_condition("linegraph");
         main_win->add_condition("configure");
     }
     client.create_automation_input();
@@ -199,6 +305,8 @@ void host_session::new_plugin(const char *name)
         return;
     instances.insert(jh->instance_name);
     jh->create();
+    if (lock_memory)
+        lock_plugin_memory(jh);
     
     plugins.push_back(jh);
     client.add(jh);
@@ -254,17 +362,14 @@ void host_session::remove_all_plugins()
 bool host_session::activate_preset(int plugin_no, const std::string &preset, bool builtin)
 {
     string cur_plugin = plugins[plugin_no]->metadata->get_id();
-    preset_vector &pvec = (builtin ? get_builtin_presets() : get_user_presets()).presets;
-    for (unsigned int i = 0; i < pvec.size(); i++) {
-        if (pvec[i].name == preset && pvec[i].plugin == cur_plugin)
-        {
-            pvec[i].activate(plugins[plugin_no]);
-            if (gui_win)
-                gui_win->refresh();
-            return true;
-        }
-    }
-    return false;
+    preset_list &plist = builtin ? get_builtin_presets() : get_user_presets();
+    int i = plist.find(cur_plugin, preset);
+    if (i == -1)
+        return false;
+    plist.presets[i].activate(plugins[plugin_no]);
+    if (gui_win)
+        gui_win->refresh();
+    return true;
 }
 
 void host_session::connect()
@@ -395,26 +500,25 @@ char *host_session::open_file(const char *name)
         remove_all_plugins();
         pl.load(name, true);
         printf("Size %d\n", (int)pl.plugins.size());
+        vector<plugin_request> requests;
         for (unsigned int i = 0; i < pl.plugins.size(); i++)
         {
             preset_list::plugin_snapshot &ps = pl.plugins[i];
-            client.input_nr = ps.input_index;
-            client.output_nr = ps.output_index;
-            client.midi_nr = ps.midi_index;
-            printf("Loading %s\n", ps.type.c_str());
             if (ps.preset_offset < (int)pl.presets.size())
             {
-                add_plugin(ps.type, "", ps.instance_name);
-                pl.presets[ps.preset_offset].activate(plugins[i]);
-                for (size_t j = 0; j < ps.automation_entries.size(); ++j)
-                {
-                    const pair<string, string> &p = ps.automation_entries[j];
-                    plugins[i]->configure(p.first.c_str(), p.second.c_str());
-                }
-                if (has_gui)
-                    main_win->refresh_plugin(plugins[i]);
+                printf("Loading %s\n", ps.type.c_str());
+                plugin_request req;
+                req.name = ps.type;
+                req.instance_name = ps.instance_name;
+                req.preset = &pl.presets[ps.preset_offset];
+                req.configure_vars = ps.automation_entries;
+                req.input_nr = ps.input_index;
+                req.output_nr = ps.output_index;
+                req.midi_nr = ps.midi_index;
+                requests.push_back(req);
             }
         }
+        add_plugins(requests);
     }
     catch(preset_exception &e)
     {
@@ -497,6 +601,9 @@ void host_session::load(session_load_iface *stream)
     // printf("!!!Restore data set!!!\n");
     remove_all_plugins();
     string key, data;
+    // the presets are parsed first, and all the plugins are created at once
+    std::list<preset_list> states;
+    vector<plugin_request> requests;
     while(stream->get_next_item(key, data)) {
         if (key == "global")
         {
@@ -508,31 +615,30 @@ void host_session::load(session_load_iface *stream)
         }
         if (!strncmp(key.c_str(), "Plugin", 6))
         {
-            unsigned int nplugin = atoi(key.c_str() + 6);
             dictionary dict, automation;
             decode_map(dict, data);
             data = dict["preset"];
             if (dict.count("automation"))
                 decode_map(automation, dict["automation"]);
-            string instance_name;
-            if (dict.count("instance_name")) instance_name = dict["instance_name"];
-            if (dict.count("input_name")) client.input_nr = atoi(dict["input_name"].c_str());
-            if (dict.count("output_name")) client.output_nr = atoi(dict["output_name"].c_str());
-            if (dict.count("midi_name")) client.midi_nr = atoi(dict["midi_name"].c_str());
-            preset_list tmp;
+            plugin_request req;
+            if (dict.count("instance_name")) req.instance_name = dict["instance_name"];
+            if (dict.count("input_name")) req.input_nr = atoi(dict["input_name"].c_str());
+            if (dict.count("output_name")) req.output_nr = atoi(dict["output_name"].c_str());
+            if (dict.count("midi_name")) req.midi_nr = atoi(dict["midi_name"].c_str());
+            states.push_back(preset_list());
+            preset_list &tmp = states.back();
             tmp.parse("<presets>"+data+"</presets>", false);
             if (tmp.presets.size())
             {
                 printf("Load plugin %s\n", tmp.presets[0].plugin.c_str());
-                add_plugin(tmp.presets[0].plugin, "", instance_name);
-                tmp.presets[0].activate(plugins[nplugin]);
-                if (has_gui)
-                    main_win->refresh_plugin(plugins[nplugin]);
-                for(dictionary::const_iterator i = automation.begin(); i != automation.end(); ++i)
-                    plugins[nplugin]->configure(i->first.c_str(), i->second.c_str());
+                req.name = tmp.presets[0].plugin;
+                req.preset = &tmp.presets[0];
+                req.configure_vars.assign(automation.begin(), automation.end());
+                requests.push_back(req);
             }
         }
     }
+    add_plugins(requests);
 }
 
 void host_session::save(session_save_iface *stream)
@@ -610,6 +716,26 @@ void host_session::on_idle()
         quit_on_next_idle_call = -quit_on_next_idle_call; // mark the event as handled but preserve signal number
         session_env->quit_gui_loop();
     }
+    if (client.latency_changed)
+    {
+        client.latency_changed = false;
+        client.update_latency_compensation();
+    }
+    uint32_t xruns = client.xrun_count.load(std::memory_order_acquire);
+    if (xruns != xruns_reported)
+    {
+        xruns_reported = xruns;
+        jack_host *culprit = client.xrun_plugin.load(std::memory_order_relaxed);
+        if (std::find(plugins.begin(), plugins.end(), culprit) != plugins.end())
+        {
+            float mean, p95, peak;
+            culprit->load.get_stats(mean, p95, peak);
+            fprintf(stderr, "Calf: xrun #%u while %s was processing (DSP load %.1f%%, peak %.1f%%)\n", xruns_reported,
+                culprit->instance_name.c_str(), mean * 100, peak * 100);
+        }
+        else
+            fprintf(stderr, "Calf: xrun #%u\n", xruns_reported);
+    }
 }
 
 void host_session::set_signal_handlers()
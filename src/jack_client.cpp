@@ -24,6 +24,7 @@
 #include <jack/midiport.h>
 #include <calf/giface.h>
 #include <calf/jackhost.h>
+#include <algorithm>
 #include <set>
 
 using namespace std;
@@ -39,17 +40,26 @@ jack_client::jack_client()
     sample_rate = 0;
     client = NULL;
     automation_port = NULL;
+    latency_changed = false;
+    running_plugin = busiest_plugin = xrun_plugin = NULL;
+    xrun_count = xruns_attributed = 0;
 }
 
 void jack_client::add(jack_host *plugin)
 {
     calf_utils::ptlock lock(mutex);
     plugins.push_back(plugin);
+    latency_order.push_back(plugin);
+    latency_changed = true;
 }
 
 void jack_client::del(jack_host *plugin)
 {
     calf_utils::ptlock lock(mutex);
+    latency_order.erase(std::remove(latency_order.begin(), latency_order.end(), plugin), latency_order.end());
+    latency_changed = true;
+    if (busiest_plugin == plugin)
+        busiest_plugin = NULL;
     for (unsigned int i = 0; i < plugins.size(); i++)
     {
         if (plugins[i] == plugin)
@@ -73,6 +83,11 @@ void jack_client::open(const char *client_name, const char *jack_session_id)
     sample_rate = jack_get_sample_rate(client);
     jack_set_process_callback(client, do_jack_process, this);
     jack_set_buffer_size_callback(client, do_jack_bufsize, this);
+    jack_set_graph_order_callback(client, do_jack_graph_order, this);
+    jack_set_xrun_callback(client, do_jack_xrun, this);
+#if JACK_HAS_LATENCY
+    jack_set_latency_callback(client, do_jack_latency, this);
+#endif
     name = get_name();
 }
 
@@ -126,12 +141,12 @@ class jack_automation: public automation_iface
         }
     }
 public:
-    jack_automation(jack_port_t *automation_port, int nframes, jack_host *_plugin)
+    jack_automation(void *_midi_data, int _event_count, jack_host *_plugin)
     {
         event_pos = 0;
         plugin = _plugin;
-        midi_data = jack_port_get_buffer(automation_port, nframes);
-        event_count = jack_midi_get_event_count(midi_data NFRAMES_MAYBE(nframes));
+        midi_data = _midi_data;
+        event_count = _event_count;
     }
     
     uint32_t apply_and_adjust(uint32_t start, uint32_t time)
@@ -153,17 +168,77 @@ int jack_client::do_jack_process(jack_nframes_t nframes, void *p)
 {
     jack_client *self = (jack_client *)p;
     pttrylock lock(self->mutex);
-    if (lock.is_locked())
+    if (lock.is_locked() && !self->plugins.empty())
     {
+        uint32_t xruns = self->xrun_count.load(std::memory_order_acquire);
+        if (xruns != self->xruns_attributed)
+        {
+            // the plugin pointer is only valid if the plugin still exists
+            self->xruns_attributed = xruns;
+            jack_host *culprit = self->xrun_plugin.load(std::memory_order_relaxed);
+            if (std::find(self->plugins.begin(), self->plugins.end(), culprit) != self->plugins.end())
+                culprit->load.xruns.fetch_add(1, std::memory_order_relaxed);
+        }
+        // the automation events are read by every plugin in turn
+        void *automation_data = jack_port_get_buffer(self->automation_port, nframes);
+        int automation_count = jack_midi_get_event_count(automation_data NFRAMES_MAYBE(nframes));
+        float periods_per_second = (float)self->sample_rate / nframes, busiest_load = -1;
+        struct timespec ts0, ts1;
+        clock_gettime(CLOCK_MONOTONIC, &ts0);
         for(unsigned int i = 0; i < self->plugins.size(); i++)
         {
-            jack_automation au(self->automation_port, nframes, self->plugins[i]);
-            self->plugins[i]->process(nframes, au);
+            jack_host *plugin = self->plugins[i];
+            jack_automation au(automation_data, automation_count, plugin);
+            self->running_plugin.store(plugin, std::memory_order_relaxed);
+            plugin->process(nframes, au);
+            clock_gettime(CLOCK_MONOTONIC, &ts1);
+            // the time between the calls is counted too, so that the loads add up to the whole callback
+            float load = ((ts1.tv_sec - ts0.tv_sec) + 1e-9 * (ts1.tv_nsec - ts0.tv_nsec)) * periods_per_second;
+            plugin->load.add(load);
+            if (load > busiest_load)
+            {
+                busiest_load = load;
+                self->busiest_plugin.store(plugin, std::memory_order_relaxed);
+            }
+            ts0 = ts1;
         }
+        self->running_plugin.store(NULL, std::memory_order_relaxed);
     }
     return 0;
 }
 
+int jack_client::do_jack_xrun(void *p)
+{
+    jack_client *self = (jack_client *)p;
+    // called on a non-realtime thread - just take note, the process thread checks the pointer
+    jack_host *culprit = self->running_plugin.load(std::memory_order_relaxed);
+    if (!culprit)
+        culprit = self->busiest_plugin.load(std::memory_order_relaxed);
+    // the count is released after the pointer, the readers load it first
+    self->xrun_plugin.store(culprit, std::memory_order_relaxed);
+    self->xrun_count.fetch_add(1, std::memory_order_release);
+    return 0;
+}
+
+void dsp_load_meter::get_stats(float &mean, float &p95, float &peak) const
+{
+    uint32_t total = count.load(std::memory_order_acquire), n = std::min<uint32_t>(total, (uint32_t)HISTORY);
+    mean = p95 = peak = 0.f;
+    if (!n)
+        return;
+    float values[HISTORY];
+    std::copy(history, history + n, values);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        mean += values[i];
+        peak = std::max(peak, values[i]);
+    }
+    mean /= n;
+    uint32_t pos = n * 95 / 100;
+    std::nth_element(values, values + pos, values + n);
+    p95 = values[pos];
+}
+
 int jack_client::do_jack_bufsize(jack_nframes_t numsamples, void *p)
 {
     jack_client *self = (jack_client *)p;
@@ -180,6 +255,7 @@ void jack_client::delete_plugins()
         delete plugins[i];
     }
     plugins.clear();
+    latency_order.clear();
 }
 
 void jack_client::create_automation_input()
@@ -283,3 +359,231 @@ void jack_client::apply_plugin_order(const std::vector<int> &indices)
     }
     printf("Order: %s\n", s.c_str());
 }
+
+int jack_client::do_jack_graph_order(void *p)
+{
+    jack_client *self = (jack_client *)p;
+    self->latency_changed = true;
+    return 0;
+}
+
+#if JACK_HAS_LATENCY
+
+/// Combine the latency ranges of all the ports connected to a given port
+static void get_connected_range(jack_client_t *client, jack_port_t *port, jack_latency_callback_mode_t mode, jack_latency_range_t &range)
+{
+    range.min = range.max = 0;
+    const char **conns = jack_port_get_all_connections(client, port);
+    if (!conns)
+        return;
+    bool first = true;
+    for (const char **k = conns; *k; k++)
+    {
+        jack_port_t *other = jack_port_by_name(client, *k);
+        if (!other)
+            continue;
+        jack_latency_range_t r;
+        jack_port_get_latency_range(other, mode, &r);
+        range.min = first ? r.min : std::min(range.min, r.min);
+        range.max = first ? r.max : std::max(range.max, r.max);
+        first = false;
+    }
+    jack_free(conns);
+}
+
+void jack_client::do_jack_latency(jack_latency_callback_mode_t mode, void *p)
+{
+    jack_client *self = (jack_client *)p;
+    // plugins may be being added or removed - try again once that's done
+    pttrylock lock(self->mutex);
+    if (!lock.is_locked())
+    {
+        self->latency_changed = true;
+        return;
+    }
+    const vector<jack_host *> &order = self->latency_order;
+    if (mode == JackCaptureLatency)
+    {
+        // upstream first, so that the connections between the plugins see the updated values
+        for (unsigned int i = 0; i < order.size(); i++)
+        {
+            jack_host *plugin = order[i];
+            jack_latency_range_t in_range = { 0, 0 };
+            for (int j = 0; j < plugin->in_count; j++)
+            {
+                jack_latency_range_t r;
+                get_connected_range(self->client, plugin->inputs[j].handle, mode, r);
+                in_range.min = j ? std::min(in_range.min, r.min) : r.min;
+                in_range.max = std::max(in_range.max, r.max);
+            }
+            for (int j = 0; j < plugin->out_count; j++)
+            {
+                uint32_t delay = plugin->latency + plugin->outputs[j].delay_line.size();
+                jack_latency_range_t r = { in_range.min + delay, in_range.max + delay };
+                jack_port_set_latency_range(plugin->outputs[j].handle, mode, &r);
+            }
+        }
+    }
+    else
+    {
+        for (int i = (int)order.size() - 1; i >= 0; i--)
+        {
+            jack_host *plugin = order[i];
+            jack_latency_range_t out_range = { 0, 0 };
+            for (int j = 0; j < plugin->out_count; j++)
+            {
+                jack_latency_range_t r;
+                get_connected_range(self->client, plugin->outputs[j].handle, mode, r);
+                uint32_t delay = plugin->outputs[j].delay_line.size();
+                out_range.min = j ? std::min(out_range.min, r.min + delay) : r.min + delay;
+                out_range.max = std::max(out_range.max, r.max + delay);
+            }
+            jack_latency_range_t r = { out_range.min + plugin->latency, out_range.max + plugin->latency };
+            for (int j = 0; j < plugin->in_count; j++)
+                jack_port_set_latency_range(plugin->inputs[j].handle, mode, &r);
+        }
+    }
+}
+
+#endif
+
+namespace {
+
+/// Capture latencies of the signals in the plugin graph, and the delays needed to align them
+struct latency_compensator
+{
+    jack_client_t *client;
+    /// Plugin output ports by full name: (plugin, output index)
+    map<string, pair<jack_host *, int> > outputs;
+    /// Latency of the signal at each plugin output already visited, including its delay
+    map<string, uint32_t> arrival;
+    /// Compensation delay for each plugin output
+    map<string, uint32_t> delays;
+
+    /// @return capture latency of the signal coming from a given port
+    uint32_t get_latency(const string &port_name)
+    {
+        map<string, uint32_t>::const_iterator i = arrival.find(port_name);
+        if (i != arrival.end())
+            return i->second;
+        if (outputs.count(port_name))
+            return 0; // a plugin that isn't processed yet (feedback loop)
+#if JACK_HAS_LATENCY
+        jack_port_t *port = jack_port_by_name(client, port_name.c_str());
+        if (port)
+        {
+            jack_latency_range_t range;
+            jack_port_get_latency_range(port, JackCaptureLatency, &range);
+            return range.max;
+        }
+#endif
+        return 0;
+    }
+    /// Delay the plugin outputs among the sources so that all the signals arrive with the same latency
+    /// @return the common latency
+    uint32_t align(const vector<string> &sources)
+    {
+        uint32_t target = 0;
+        for (unsigned int i = 0; i < sources.size(); i++)
+            target = std::max(target, get_latency(sources[i]));
+        for (unsigned int i = 0; i < sources.size(); i++)
+        {
+            map<string, uint32_t>::iterator a = arrival.find(sources[i]);
+            if (a == arrival.end() || a->second >= target)
+                continue;
+            delays[sources[i]] += target - a->second;
+            a->second = target;
+        }
+        return target;
+    }
+    void add_connections(jack_port_t *port, vector<string> &names)
+    {
+        const char **conns = jack_port_get_all_connections(client, port);
+        if (!conns)
+            return;
+        for (const char **k = conns; *k; k++)
+            names.push_back(*k);
+        jack_free(conns);
+    }
+};
+
+}
+
+void jack_client::update_latency_compensation()
+{
+    vector<int> indices;
+    calculate_plugin_order(indices);
+
+    latency_compensator lc;
+    lc.client = client;
+    for (unsigned int i = 0; i < plugins.size(); i++)
+    {
+        for (int j = 0; j < plugins[i]->out_count; j++)
+            lc.outputs[jack_port_name(plugins[i]->outputs[j].handle)] = make_pair(plugins[i], j);
+    }
+    // align all the inputs of each plugin (so that the stereo image and sidechain timing are preserved),
+    // upstream plugins first; an output that feeds several plugins gets the largest delay needed
+    set<string> plugin_inputs;
+    for (unsigned int i = 0; i < indices.size(); i++)
+    {
+        jack_host *plugin = plugins[indices[i]];
+        vector<string> sources;
+        for (int j = 0; j < plugin->in_count; j++)
+        {
+            lc.add_connections(plugin->inputs[j].handle, sources);
+            plugin_inputs.insert(jack_port_name(plugin->inputs[j].handle));
+        }
+        uint32_t latency = lc.align(sources) + plugin->latency;
+        for (int j = 0; j < plugin->out_count; j++)
+            lc.arrival[jack_port_name(plugin->outputs[j].handle)] = latency;
+    }
+    // then the ports of other clients fed by the plugins (like parallel paths mixed at the playback ports)
+    set<string> destinations;
+    for (unsigned int i = 0; i < plugins.size(); i++)
+    {
+        for (int j = 0; j < plugins[i]->out_count; j++)
+        {
+            vector<string> conns;
+            lc.add_connections(plugins[i]->outputs[j].handle, conns);
+            for (unsigned int k = 0; k < conns.size(); k++)
+            {
+                if (!plugin_inputs.count(conns[k]))
+                    destinations.insert(conns[k]);
+            }
+        }
+    }
+    for (set<string>::const_iterator i = destinations.begin(); i != destinations.end(); ++i)
+    {
+        jack_port_t *port = jack_port_by_name(client, i->c_str());
+        if (!port)
+            continue;
+        vector<string> sources;
+        lc.add_connections(port, sources);
+        lc.align(sources);
+    }
+
+    // allocate the new delay lines here, and only swap them in the audio thread's lock
+    vector<pair<jack_host::port *, vector<float> > > changes;
+    for (map<string, pair<jack_host *, int> >::const_iterator i = lc.outputs.begin(); i != lc.outputs.end(); ++i)
+    {
+        jack_host::port &port = i->second.first->outputs[i->second.second];
+        uint32_t delay = lc.delays.count(i->first) ? lc.delays[i->first] : 0;
+        if (delay != port.delay_line.size())
+            changes.push_back(make_pair(&port, vector<float>(delay)));
+    }
+    vector<jack_host *> order;
+    for (unsigned int i = 0; i < indices.size(); i++)
+        order.push_back(plugins[indices[i]]);
+    {
+        ptlock lock(mutex);
+        for (unsigned int i = 0; i < changes.size(); i++)
+        {
+            changes[i].first->delay_line.swap(changes[i].second);
+            changes[i].first->delay_pos = 0;
+        }
+        latency_order.swap(order);
+    }
+#if JACK_HAS_LATENCY
+    jack_recompute_total_latencies(client);
+#endif
+}
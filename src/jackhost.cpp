@@ -51,7 +51,7 @@ jack_host::jack_host(jack_client *_client, audio_module_iface *_module, const st
     
     client = _client;
     cc_mappings = NULL;
-    changed = true;
+    cc_table = NULL;
 
     module->get_port_arrays(ins, outs, params);
     metadata = module->get_metadata_iface();
@@ -64,8 +64,12 @@ jack_host::jack_host(jack_client *_client, audio_module_iface *_module, const st
     write_serials.resize(param_count);
     fill(write_serials.begin(), write_serials.end(), 0);
     last_modify_serial = 0;
+    latency = 0;
+    latency_param = -1;
     for (int i = 0; i < param_count; i++) {
         params[i] = &param_values[i];
+        if (metadata->get_param_props(i)->flags & PF_PROP_LATENCY)
+            latency_param = i;
     }
     clear_preset();
     midi_meter = 0;
@@ -78,6 +82,8 @@ jack_host::~jack_host()
 {
     delete cc_mappings;
     cc_mappings = NULL;
+    delete cc_table;
+    cc_table = NULL;
     delete []param_values;
     if (client)
         destroy();
@@ -88,8 +94,6 @@ void jack_host::create()
     create_ports();    
     cache_ports();
     init_module();
-    
-    changed = false;
 }
 
 void jack_host::create_ports() {
@@ -173,16 +177,16 @@ void jack_host::rename(std::string name) {
 void jack_host::handle_automation_cc(uint32_t designator, int value)
 {
     last_designator = designator;
-    if (!cc_mappings)
+    int index = automation_table::get_index(designator);
+    if (!cc_table || index == -1)
         return;
-    automation_map::const_iterator i = cc_mappings->find(designator);
-    while (i != cc_mappings->end() && i->first == designator)
+    uint32_t end = cc_table->first[index + 1];
+    for (uint32_t i = cc_table->first[index]; i < end; i++)
     {
-        const automation_range &r = i->second;
-        const parameter_properties *props = metadata->get_param_props(r.param_no);
-        set_param_value(r.param_no, props->from_01(r.min_value + value * (r.max_value - r.min_value)/ 127.0));
-        write_serials[r.param_no] = ++last_modify_serial;
-        ++i;
+        const automation_table::target &t = cc_table->targets[i];
+        param_values[t.param_no] = t.values[value & 127];
+        dirty_params.set(t.param_no);
+        write_serials[t.param_no] = ++last_modify_serial;
     }
 }
 
@@ -192,37 +196,6 @@ uint32_t jack_host::get_last_automation_source()
 }
 
 
-void jack_host::handle_event(uint8_t *buffer, uint32_t size)
-{
-    int channel = (buffer[0] & 0x0f) + 1;
-    int value;
-    switch(buffer[0] >> 4)
-    {
-    case 8:
-        module->note_off(channel, buffer[1], buffer[2]);
-        break;
-    case 9:
-        if (!buffer[2])
-            module->note_off(channel, buffer[1], 0);
-        else
-            module->note_on(channel, buffer[1], buffer[2]);
-        break;
-    case 11:
-        module->control_change(channel, buffer[1], buffer[2]);
-        break;
-    case 12:
-        module->program_change(channel, buffer[1]);
-        break;
-    case 13:
-        module->channel_pressure(channel, buffer[1]);
-        break;
-    case 14:
-        value = buffer[1] + 128 * buffer[2] - 8192;
-        module->pitch_bend(channel, value);
-        break;
-    }
-}
-
 void jack_host::destroy()
 {
     port *inputs = get_inputs(), *outputs = get_outputs();
@@ -240,13 +213,19 @@ void jack_host::destroy()
     client = NULL;
 }
 
-void jack_host::process_part(unsigned int time, unsigned int len)
+void jack_host::process_part(unsigned int time, unsigned int len, uint32_t event_count)
 {
+    if (event_count)
+        midi_meter = 1.f;
     if (!len)
+    {
+        // a full queue of events at one position
+        module->process_slice_events(time, time, midi_queue, event_count);
         return;
+    }
     for (int i = 0; i < in_count; i++)
         inputs[i].meter.update(ins[i] + time, len);
-    unsigned int mask = module->process_slice(time, time + len);
+    unsigned int mask = module->process_slice_events(time, time + len, midi_queue, event_count);
     for (int i = 0; i < out_count; i++)
     {
         if (!(mask & (1 << i))) {
@@ -277,49 +256,86 @@ float jack_host::get_level(unsigned int port)
 
 int jack_host::process(jack_nframes_t nframes, automation_iface &automation)
 {
+    dsp::denormal_guard ftz;
     for (int i=0; i<in_count; i++) {
         ins[i] = inputs[i].data = (float *)jack_port_get_buffer(inputs[i].handle, nframes);
     }
     if (metadata->get_midi())
         midi_port.data = (float *)jack_port_get_buffer(midi_port.handle, nframes);
-    if (changed) {
-        module->params_changed();
-        changed = false;
-    }
+    param_mask dirty;
+    if (dirty_params.take(dirty))
+        module->params_changed(dirty);
 
+    // the MIDI events are handed to the module together with the audio of each automation
+    // segment, so that it doesn't have to be processed in pieces between every two events
     unsigned int time = 0;
+    int event_pos = 0, event_count = 0;
     if (metadata->get_midi())
+        event_count = jack_midi_get_event_count(midi_port.data NFRAMES_MAYBE(nframes));
+    while(time < nframes || event_pos < event_count)
     {
+        uint32_t endtime = automation.apply_and_adjust(time, nframes);
+        uint32_t queued = 0;
         jack_midi_event_t event;
-        int count = jack_midi_get_event_count(midi_port.data NFRAMES_MAYBE(nframes));
-        for (int i = 0; i < count; i++)
+        for (; event_pos < event_count; event_pos++)
         {
-            jack_midi_event_get(&event, midi_port.data, i NFRAMES_MAYBE(nframes));
-            uint32_t endtime = automation.apply_and_adjust(time, event.time);
-            unsigned int len = endtime - time;
-            process_part(time, len);
-            
-            midi_meter = 1.f;
-            handle_event(event.buffer, event.size);
-            
-            time = event.time;
+            jack_midi_event_get(&event, midi_port.data, event_pos NFRAMES_MAYBE(nframes));
+            uint32_t event_time = std::min<uint32_t>(std::max<uint32_t>(event.time, time), nframes);
+            if (event_time >= endtime && endtime < nframes)
+                break;
+            if (queued == MAX_QUEUED_EVENTS)
+            {
+                // continue with a new batch from this event on
+                endtime = event_time;
+                break;
+            }
+            if (!event.size || event.size > 3)
+                continue;
+            midi_event &ev = midi_queue[queued++];
+            ev.time = event_time;
+            memset(ev.data, 0, sizeof(ev.data));
+            memcpy(ev.data, event.buffer, event.size);
         }
-    }
-    while(time < nframes)
-    {
-        uint32_t endtime = automation.apply_and_adjust(time, nframes);
-        process_part(time, endtime - time);
+        process_part(time, endtime - time, queued);
         time = endtime;
     }
     module->params_reset();
+    for (int i = 0; i < out_count; i++)
+    {
+        if (!outputs[i].delay_line.empty())
+            outputs[i].delay(outs[i], nframes);
+    }
+    uint32_t new_latency = module->get_latency();
+    if (latency_param != -1)
+        param_values[latency_param] = new_latency;
+    if (new_latency != latency)
+    {
+        latency = new_latency;
+        client->latency_changed = true;
+    }
     return 0;
 }
 
+void jack_host::port::delay(float *buf, uint32_t len)
+{
+    uint32_t size = delay_line.size();
+    float *line = &delay_line[0];
+    for (uint32_t i = 0; i < len; i++)
+    {
+        float tmp = line[delay_pos];
+        line[delay_pos] = buf[i];
+        buf[i] = tmp;
+        if (++delay_pos == size)
+            delay_pos = 0;
+    }
+}
+
 void jack_host::init_module()
 {
     module->set_sample_rate(client->sample_rate);
     module->activate();
     module->params_changed();
+    dirty_params.clear();
 }
 
 void jack_host::cache_ports()
@@ -376,7 +392,11 @@ void jack_host::delete_automation(uint32_t source, int param_no)
 
 void jack_host::replace_automation_map(automation_map *amap)
 {
+    // the table is compiled here, the audio thread only gets the finished one
+    automation_table *table = new automation_table(*amap, metadata);
+    client->atomic_swap(cc_table, table);
     client->atomic_swap(cc_mappings, amap);
+    delete table;
     delete amap;
 }
 
@@ -417,7 +437,7 @@ char *jack_host::configure(const char *key, const char *value)
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-static const char *short_options = "c:i:l:o:m:M:s:S:ehvLnt";
+static const char *short_options = "c:i:l:o:m:M:s:S:ehkvLnt";
 
 static struct option long_options[] = {
     {"help", 0, 0, 'h'},
@@ -434,6 +454,7 @@ static struct option long_options[] = {
     {"list", 0, 0, 'L'},
     {"no-gui", 0, 0, 'n'},
     {"no-tray", 0, 0, 't'},
+    {"lock-memory", 0, 0, 'k'},
     {0,0,0,0},
 };
 
@@ -442,6 +463,7 @@ void print_help(char *argv[])
     printf("JACK host for Calf effects\n"
         "Syntax: %s [--client, -c <name>] [--input, -i <name>] [--output, -o <name>] [--midi, -m <name>] [--load|state, -l|s <session>]\n"
         "       [--connect-midi, -M <name|capture-index>] [--help, -h] [--version, -v] [--list, -L] [--no-tray, -t]\n"
+        "       [--lock-memory, -k]\n"
         "       [!] pluginname[:<preset>] [!] ...\n", 
         argv[0]);
 }
@@ -520,6 +542,9 @@ int main(int argc, char *argv[])
             case 't':
                 sess.has_trayicon = false;
                 break;
+            case 'k':
+                sess.lock_memory = true;
+                break;
             case 'l':
             case 's':
             {
@@ -21,6 +21,8 @@
 #include "config.h"
 #include <calf/gui.h>
 #include <calf/giface.h>
+#include <calf/display_stream.h>
+#include <calf/gui_layout.h>
 #include <calf/lv2_atom.h>
 #include <calf/lv2_data_access.h>
 #include <calf/lv2_options.h>
@@ -42,6 +44,15 @@ struct LV2_Calf_Descriptor {
 /// Temporary assignment to a slot in vector<bool>
 typedef scope_assign<bool, vector<bool>::reference> TempSendSetter;
 
+struct plugin_proxy_base;
+
+/// Line graphs streamed by the plugin, for hosts without instance-access
+struct lv2_display_reader: public display_stream_reader
+{
+    plugin_proxy_base *proxy;
+    virtual void send_request(const void *data, uint32_t size) const;
+};
+
 /// Common data and functions for GTK+ GUI and External GUI
 struct plugin_proxy_base
 {
@@ -60,10 +71,12 @@ struct plugin_proxy_base
     /// External UI host feature (must be set when instantiating external UI plugins)
     lv2_external_ui_host *ext_ui_host;
     bool atom_present;
-    uint32_t property_type, string_type, event_transfer;
+    uint32_t property_type, string_type, chunk_type, event_transfer;
     
     /// Instance pointer - usually NULL unless the host supports instance-access extension
     plugin_ctl_iface *instance;
+    /// Line graphs received through the event ports, when there's no instance pointer
+    lv2_display_reader display;
     /// If true, a given parameter (not port) may be sent to host - it is blocked when the parameter is written to by the host
     vector<bool> sends;
     /// Map of parameter name to parameter index (used for mapping configure values to string ports)
@@ -96,6 +109,12 @@ struct plugin_proxy_base
     /// Obtain instance pointers
     void resolve_instance();
 
+    /// @retval true if line graphs can be streamed from the plugin (instead of read from the instance)
+    bool can_stream_display() const { return !instance && atom_present && event_transfer && chunk_type; }
+
+    /// Send an atom to the plugin's event input
+    void send_atom_to_host(uint32_t type, const void *body, uint32_t size);
+
     /// Obtain line graph interface if available
     const line_graph_iface *get_line_graph_iface() const;
     
@@ -113,6 +132,10 @@ plugin_proxy_base::plugin_proxy_base(const plugin_metadata_iface *metadata, LV2U
     data_access(NULL),
     urid_map(NULL),
     ext_ui_host(NULL),
+    property_type(0),
+    string_type(0),
+    chunk_type(0),
+    event_transfer(0),
     instance(NULL)
 {
     plugin_metadata = metadata;
@@ -150,7 +173,16 @@ plugin_proxy_base::plugin_proxy_base(const plugin_metadata_iface *metadata, LV2U
         {
             ext_ui_host = (lv2_external_ui_host *)features[i]->data;
         }
+        else if (!strcmp(features[i]->URI, LV2_URID_MAP_URI))
+        {
+            urid_map = (const LV2_URID_Map *)features[i]->data;
+        }
     }
+    string_type = map_urid(LV2_ATOM__String);
+    property_type = map_urid(LV2_ATOM__Property);
+    chunk_type = map_urid(LV2_ATOM__Chunk);
+    event_transfer = map_urid(LV2_ATOM__eventTransfer);
+    display.proxy = this;
     resolve_instance();
 }
 
@@ -175,6 +207,21 @@ void plugin_proxy_base::resolve_instance()
     }
 }
 
+void plugin_proxy_base::send_atom_to_host(uint32_t type, const void *body, uint32_t size)
+{
+    vector<uint8_t> buffer(sizeof(LV2_Atom) + size);
+    LV2_Atom *atom = (LV2_Atom *)&buffer[0];
+    atom->type = type;
+    atom->size = size;
+    memcpy(atom + 1, body, size);
+    write_function(controller, param_count + param_offset, buffer.size(), event_transfer, atom);
+}
+
+void lv2_display_reader::send_request(const void *data, uint32_t size) const
+{
+    proxy->send_atom_to_host(proxy->chunk_type, data, size);
+}
+
 uint32_t plugin_proxy_base::map_urid(const char *uri)
 {
     if (!urid_map)
@@ -186,6 +233,8 @@ const line_graph_iface *plugin_proxy_base::get_line_graph_iface() const
 {
     if (instance)
         return instance->get_line_graph_iface();
+    if (can_stream_display())
+        return &display;
     return NULL;
 }
 
@@ -272,6 +321,8 @@ struct lv2_plugin_proxy: public plugin_ctl_iface, public plugin_proxy_base, publ
             conditions.insert("directlink");
             conditions.insert("configure");
         }
+        if (instance || can_stream_display())
+            conditions.insert("linegraph");
         conditions.insert("lv2gui");    
     }
     
@@ -356,9 +407,9 @@ LV2UI_Handle gui_instantiate(const struct _LV2UI_Descriptor* descriptor,
     plugin_gui_window *window = new plugin_gui_window(proxy, NULL);
     plugin_gui *gui = new plugin_gui(window);
     
-    const char *xml = proxy->plugin_metadata->get_gui_xml("gui");
-    assert(xml);
-    gui->optwidget = gui->create_from_xml(proxy, xml);
+    const gui_layout *layout = get_gui_layout("gui", proxy->plugin_metadata->get_id());
+    assert(layout);
+    gui->optwidget = gui->create_from_layout(proxy, layout);
     proxy->enable_all_sends();
     if (gui->optwidget)
     {
@@ -393,10 +444,6 @@ LV2UI_Handle gui_instantiate(const struct _LV2UI_Descriptor* descriptor,
         return (LV2UI_Handle)gui;
 
     const uint32_t uridWindowTitle = uridMap->map(uridMap->handle, LV2_UI__windowTitle);
-    proxy->string_type = uridMap->map(uridMap->handle, LV2_ATOM__String);
-    proxy->property_type = uridMap->map(uridMap->handle, LV2_ATOM__Property);
-    proxy->event_transfer = uridMap->map(uridMap->handle, LV2_ATOM__eventTransfer);
-    proxy->urid_map = uridMap;
 
     proxy->send_configures(gui);
 
@@ -422,6 +469,8 @@ void gui_cleanup(LV2UI_Handle handle)
     lv2_plugin_proxy *proxy = dynamic_cast<lv2_plugin_proxy *>(gui->plugin);
     if (proxy->source_id)
         g_source_remove(proxy->source_id);
+    if (proxy->can_stream_display())
+        proxy->display.unsubscribe_all();
     // If the widget still exists, remove the handler
     if (gui->optwidget)
     {
@@ -457,7 +506,9 @@ void gui_port_event(LV2UI_Handle handle, uint32_t port, uint32_t buffer_size, ui
         if (format == proxy->event_transfer)
         {
             LV2_Atom *atom = (LV2_Atom *)buffer;
-            if (atom->type == proxy->string_type)
+            if (atom->type == proxy->chunk_type)
+                proxy->display.process_message(LV2_ATOM_BODY(atom), atom->size);
+            else if (atom->type == proxy->string_type)
                 printf("Param %d string %s\n", param, (char *)LV2_ATOM_CONTENTS(LV2_Atom_String, atom));
             else if (atom->type == proxy->property_type)
             {
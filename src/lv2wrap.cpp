@@ -13,13 +13,27 @@ lv2_instance::lv2_instance(audio_module_iface *_module)
     in_count = metadata->get_input_count();
     out_count = metadata->get_output_count();
     real_param_count = metadata->get_param_count();
+    last_param_values.resize(real_param_count);
+    latency_param = -1;
+    for (int i = 0; i < real_param_count; i++)
+    {
+        int flags = metadata->get_param_props(i)->flags;
+        if (!(flags & PF_PROP_OUTPUT))
+            input_params.push_back(i);
+        if (flags & PF_PROP_LATENCY)
+            latency_param = i;
+    }
+    dirty_params.set_all();
     
     urid_map = NULL;
     event_in_data = NULL;
     event_out_data = NULL;
     progress_report_feature = NULL;
     options_feature = NULL;
+    worker_schedule_feature = NULL;
+    in_run = false;
     midi_event_type = 0xFFFFFFFF;
+    chunk_type = 0xFFFFFFFF;
 
     srate_to_set = 44100;
     set_srate = true;
@@ -46,6 +60,10 @@ void lv2_instance::lv2_instantiate(const LV2_Descriptor * Descriptor, double sam
         {
             options_feature = (LV2_Options_Interface *)((*features)->data);
         }
+        else if (!strcmp((*features)->URI, LV2_WORKER__schedule))
+        {
+            worker_schedule_feature = (LV2_Worker_Schedule *)((*features)->data);
+        }
         features++;
     }
     post_instantiate();
@@ -55,6 +73,8 @@ void lv2_instance::post_instantiate()
 {
     if (progress_report_feature)
         module->set_progress_report_iface(this);
+    if (worker_schedule_feature && metadata->uses_worker())
+        module->set_worker_iface(this);
     if (urid_map)
     {
         std::vector<std::string> varnames;
@@ -80,6 +100,10 @@ void lv2_instance::post_instantiate()
         assert(sequence_type);
         property_type = urid_map->map(urid_map->handle, LV2_ATOM__Property);
         assert(property_type);
+        chunk_type = urid_map->map(urid_map->handle, LV2_ATOM__Chunk);
+        // line graphs for the GUIs that can't read them from the instance
+        if (module->get_line_graph_iface())
+            display.init(module->get_line_graph_iface(), srate_to_set);
     }
     module->post_instantiate(srate_to_set);
 }
@@ -137,15 +161,37 @@ void lv2_instance::output_event_property(const char *key, const char *value)
     memcpy(p + 1, value, len + 1);
 }
 
+void lv2_instance::update_dirty_params()
+{
+    // LV2 hosts write control ports directly, so compare with the values seen last time
+    for (size_t n = 0; n < input_params.size(); n++)
+    {
+        int i = input_params[n];
+        if (!params[i])
+            continue;
+        float value = *params[i];
+        if (value != last_param_values[i])
+        {
+            last_param_values[i] = value;
+            dirty_params.set(i);
+        }
+    }
+}
+
 void lv2_instance::run(uint32_t SampleCount, bool has_simulate_stereo_input_flag)
 {
+    dsp::denormal_guard ftz;
+    in_run = true;
     if (set_srate) {
         module->set_sample_rate(srate_to_set);
         module->activate();
         set_srate = false;
+        dirty_params.set_all();
     }
-    module->params_changed();
-    uint32_t offset = 0;
+    update_dirty_params();
+    param_mask dirty;
+    dirty_params.take(dirty);
+    module->params_changed(dirty);
     if (event_out_data)
     {
         LV2_Atom *atom = &event_out_data->atom;
@@ -154,16 +200,21 @@ void lv2_instance::run(uint32_t SampleCount, bool has_simulate_stereo_input_flag
         event_out_data->body.unit = 0;
         lv2_atom_sequence_clear(event_out_data);
     }
-    if (event_in_data)
-    {
-        process_events(offset);
-    }
     bool simulate_stereo_input = (in_count > 1) && has_simulate_stereo_input_flag && !ins[1];
     if (simulate_stereo_input)
         ins[1] = ins[0];
-    module->process_slice(offset, SampleCount);
+    if (event_in_data)
+        process_events(SampleCount);
+    else
+        module->process_slice(0, SampleCount);
     if (simulate_stereo_input)
         ins[1] = NULL;
+    if (latency_param != -1 && params[latency_param])
+        *params[latency_param] = module->get_latency();
+    // this calls the module's line graph functions on the audio thread - see display_stream_writer
+    if (event_out_data && display.is_active())
+        display.run(SampleCount, *this);
+    in_run = false;
 }
 
 void lv2_instance::process_event_string(const char *str)
@@ -200,17 +251,43 @@ void lv2_instance::process_event_property(const LV2_Atom_Property *prop)
         printf("Set property %d -> unknown type %d\n", prop->body.key, prop->body.value.type);
 }
 
-void lv2_instance::process_events(uint32_t &offset)
+void lv2_instance::process_events(uint32_t sample_count)
 {
+    // MIDI events are queued and handed to the module with the audio, which is only split
+    // where the module needs it to be; other events are handled between the slices
+    uint32_t offset = 0, queued = 0;
     LV2_ATOM_SEQUENCE_FOREACH(event_in_data, ev) {
         const uint8_t* const data = (const uint8_t*)(ev + 1);
-        uint32_t ts = ev->time.frames;
+        uint32_t ts = (uint32_t)std::min<int64_t>(std::max<int64_t>(ev->time.frames, offset), sample_count);
         // printf("Event: timestamp %d type %x vs %x vs %x\n", ts, ev->body.type, midi_event_type, property_type);
-        if (ts > offset)
+        if (ev->body.type == midi_event_type)
         {
-            module->process_slice(offset, ts);
-            offset = ts;
+            if (queued == MAX_QUEUED_EVENTS)
+            {
+                module->process_slice_events(offset, ts, midi_queue, queued);
+                offset = ts;
+                queued = 0;
+            }
+            if (ev->body.size && ev->body.size <= 3)
+            {
+                midi_event &mev = midi_queue[queued++];
+                mev.time = ts;
+                memset(mev.data, 0, sizeof(mev.data));
+                memcpy(mev.data, data, ev->body.size);
+            }
+            continue;
         }
+        if (ev->body.type == chunk_type)
+        {
+            // display stream requests don't affect the audio, so there's no need to split it
+            display.process_request(LV2_ATOM_BODY_CONST(&ev->body), ev->body.size);
+            continue;
+        }
+        if (ev->body.type != string_type && ev->body.type != property_type)
+            continue;
+        module->process_slice_events(offset, ts, midi_queue, queued);
+        offset = ts;
+        queued = 0;
         if (ev->body.type == string_type)
         {
             process_event_string((const char *)LV2_ATOM_CONTENTS(LV2_Atom_String, &ev->body));
@@ -219,34 +296,8 @@ void lv2_instance::process_events(uint32_t &offset)
         {
             process_event_property((LV2_Atom_Property *)(&ev->body));
         }
-        if (ev->body.type == midi_event_type)
-        {
-            // printf("Midi message %x %x %x %d\n", data[0], data[1], data[2], ev->body.size);
-            int channel = data[0] & 0x0f;
-            switch (lv2_midi_message_type(data))
-            {
-            case LV2_MIDI_MSG_INVALID: break;
-            case LV2_MIDI_MSG_NOTE_OFF : module->note_off(channel, data[1], data[2]); break;
-            case LV2_MIDI_MSG_NOTE_ON: module->note_on(channel, data[1], data[2]); break;
-            case LV2_MIDI_MSG_CONTROLLER: module->control_change(channel, data[1], data[2]); break;
-            case LV2_MIDI_MSG_PGM_CHANGE: module->program_change(channel, data[1]); break;
-            case LV2_MIDI_MSG_CHANNEL_PRESSURE: module->channel_pressure(channel, data[1]); break;
-            case LV2_MIDI_MSG_BENDER: module->pitch_bend(channel, data[1] + 128 * data[2] - 8192); break;
-            case LV2_MIDI_MSG_NOTE_PRESSURE: break;
-            case LV2_MIDI_MSG_SYSTEM_EXCLUSIVE: break;
-            case LV2_MIDI_MSG_MTC_QUARTER: break;
-            case LV2_MIDI_MSG_SONG_POS: break;
-            case LV2_MIDI_MSG_SONG_SELECT: break;
-            case LV2_MIDI_MSG_TUNE_REQUEST: break;
-            case LV2_MIDI_MSG_CLOCK: break;
-            case LV2_MIDI_MSG_START: break;
-            case LV2_MIDI_MSG_CONTINUE: break;
-            case LV2_MIDI_MSG_STOP: break;
-            case LV2_MIDI_MSG_ACTIVE_SENSE: break;
-            case LV2_MIDI_MSG_RESET: break;
-            }
-        }            
     }
+    module->process_slice_events(offset, sample_count, midi_queue, queued);
 }
 
 LV2_State_Status lv2_instance::state_save(
@@ -19,6 +19,7 @@
  * Boston, MA  02110-1301  USA
  */
 #include <calf/giface.h>
+#include <calf/gui_layout.h>
 #include <calf/preset.h>
 #include <calf/utils.h>
 #if USE_LV2
@@ -27,6 +28,7 @@
 #include <calf/lv2_options.h>
 #include <calf/lv2_state.h>
 #include <calf/lv2_urid.h>
+#include <calf/lv2_worker.h>
 #endif
 #include <getopt.h>
 #include <string.h>
@@ -59,7 +61,7 @@ static FILE *open_and_check(const std::string &filename)
 }
 
 #if USE_LV2
-static void add_port(string &ports, const char *symbol, const char *name, const char *direction, int pidx, const char *type = "lv2:AudioPort", bool optional = false)
+static void add_port(string &ports, const char *symbol, const char *name, const char *direction, int pidx, const char *type = "lv2:AudioPort", bool optional = false, int minimum_size = 0)
 {
     stringstream ss;
     const char *ind = "        ";
@@ -77,7 +79,11 @@ static void add_port(string &ports, const char *symbol, const char *name, const
     if (!strcmp(type, "atom:AtomPort")) {
         ss << ind << "atom:bufferType atom:Sequence ;\n"
            << ind << "atom:supports lv2midi:MidiEvent ;\n"
-           << ind << "atom:supports atom:Property ;\n"<< endl;
+           << ind << "atom:supports atom:Property ;\n"
+           << ind << "atom:supports atom:Chunk ;\n";
+        if (minimum_size)
+            ss << ind << "rsz:minimumSize " << minimum_size << " ;\n";
+        ss << endl;
     }
     if (!strcmp(std::string(symbol, 0, 4).c_str(), "in_l")) 
         ss << ind << "lv2:designation pg:left ;\n"
@@ -146,6 +152,11 @@ static bool add_ctl_port(string &ports, const parameter_properties &pp, int pidx
         ss << ind << "lv2:portProperty epp:notAutomatic ;\n";
     if (pp.flags & PF_PROP_OUTPUT_GAIN)
         ss << ind << "lv2:designation param:gain ;\n";
+    if (pp.flags & PF_PROP_LATENCY)
+    {
+        ss << ind << "lv2:portProperty lv2:reportsLatency ;\n";
+        ss << ind << "lv2:designation lv2:latency ;\n";
+    }
     if (type == PF_BOOL)
         ss << ind << "lv2:portProperty lv2:toggled ;\n";
     else if (type == PF_ENUM)
@@ -220,6 +231,7 @@ void make_ttl(string path_prefix, const string *data_dir)
         "@prefix epp: <http://lv2plug.in/ns/ext/port-props#> .\n"
         "@prefix foaf: <http://xmlns.com/foaf/0.1/> .\n"
         "@prefix param: <http://lv2plug.in/ns/ext/parameters#> .\n"
+        "@prefix rsz: <http://lv2plug.in/ns/ext/resize-port#> .\n"
         "\n"
         "<http://calf.sourceforge.net/team>\n"
         "    a foaf:Person ;\n"
@@ -307,6 +319,9 @@ void make_ttl(string path_prefix, const string *data_dir)
                 ttl += gui_uri + portnot;
             }
         }
+        // line graphs are streamed to the GUI if it can't access the instance
+        if (pi->sends_live_updates())
+            ttl += gui_uri + " uiext:portNotification [\n    uiext:plugin " + uri + " ;\n    lv2:symbol \"events_out\" ;\n    uiext:protocol atom:eventTransfer\n] .\n\n";
 #endif
 
         if(pi->get_input_count() == 1) {
@@ -366,6 +381,11 @@ void make_ttl(string path_prefix, const string *data_dir)
         {
             ttl += "    lv2:extensionData <" LV2_STATE__interface "> ;\n";
         }
+        if (pi->uses_worker())
+        {
+            ttl += "    lv2:optionalFeature <" LV2_WORKER__schedule "> ;\n";
+            ttl += "    lv2:extensionData <" LV2_WORKER__interface "> ;\n";
+        }
 
         if(pi->get_input_count() >= 1) {
             ttl += "    pg:mainInput :in ;\n";
@@ -401,7 +421,7 @@ void make_ttl(string path_prefix, const string *data_dir)
                 add_port(ports, "events_in", "Events", "Input", pn++, "atom:AtomPort", true);
         }
         if (needs_event_io) {
-            add_port(ports, "events_out", "Events", "Output", pn++, "atom:AtomPort", true);
+            add_port(ports, "events_out", "Events", "Output", pn++, "atom:AtomPort", true, 16384);
         }
         if (!ports.empty())
             ttl += "    lv2:port " + ports + "\n";
@@ -610,7 +630,7 @@ void make_gui(string path_prefix)
         }
         if (graphs)
         {
-            xml << "    <if cond=\"directlink\">" << endl;
+            xml << "    <if cond=\"linegraph\">" << endl;
             xml << "        <vbox expand-x=\"1\" fill-x=\"1\" attach-x=\"3\" attach-y=\"0\" attach-h=\"" << pi->get_param_count() << "\">" << endl;
             for (int j = 0; j < pi->get_param_count(); j++)
             {
@@ -630,6 +650,23 @@ void make_gui(string path_prefix)
     }
 }
 
+void make_layouts(string path_prefix)
+{
+    if (path_prefix.empty())
+    {
+        fprintf(stderr, "Path parameter is required for layouts mode\n");
+        exit(1);
+    }
+    gui_layout_library library;
+    if (library.add_xml_directory("gui", path_prefix + "gui") < 0 || library.add_xml_directory("strips", path_prefix + "strips") < 0)
+        exit(1);
+    if (!library.save(path_prefix + "gui-layouts.bin"))
+    {
+        fprintf(stderr, "Cannot write %sgui-layouts.bin\n", path_prefix.c_str());
+        exit(1);
+    }
+}
+
 int main(int argc, char *argv[])
 {
     string mode = "rdf";
@@ -649,14 +686,14 @@ int main(int argc, char *argv[])
         switch(c) {
             case 'h':
             case '?':
-                printf("LV2 TTL / XML GUI generator for Calf plugin pack\nSyntax: %s [--help] [--version] [--mode rdf|ttl|gui] [--path <path>]\n", argv[0]);
+                printf("LV2 TTL / XML GUI generator for Calf plugin pack\nSyntax: %s [--help] [--version] [--mode rdf|ttl|gui|layouts] [--path <path>]\n", argv[0]);
                 return 0;
             case 'v':
                 printf("%s\n", PACKAGE_STRING);
                 return 0;
             case 'm':
                 mode = optarg;
-                if (mode != "rdf" && mode != "ttl" && mode != "gui") {
+                if (mode != "rdf" && mode != "ttl" && mode != "gui" && mode != "layouts") {
                     fprintf(stderr, "calfmakerdf: Invalid mode %s\n", optarg);
                     return 1;
                 }
@@ -693,6 +730,9 @@ int main(int argc, char *argv[])
     if (mode == "gui")
         make_gui(path_prefix);
     else
+    if (mode == "layouts")
+        make_layouts(path_prefix);
+    else
     {
         fprintf(stderr, "calfmakerdf: Mode '%s' unsupported in this version\n", mode.c_str());
         return 1;
@@ -59,6 +59,9 @@ const char *periodical_mode_names[] = {
     { 0,           0,           1,     0,  PF_FLOAT | PF_CTL_LED | PF_PROP_OUTPUT | PF_PROP_OPTIONAL, NULL, "clip_outL", "0dB-OutL" }, \
     { 0,           0,           1,     0,  PF_FLOAT | PF_CTL_LED | PF_PROP_OUTPUT | PF_PROP_OPTIONAL, NULL, "clip_outR", "0dB-OutR" },
 
+#define LATENCY_PARAM \
+    { 0,           0,           16384, 0,  PF_INT | PF_CTL_LABEL | PF_UNIT_SAMPLES | PF_PROP_OUTPUT | PF_PROP_OPTIONAL | PF_PROP_LATENCY, NULL, "latency", "Latency" },
+
 #define LPHP_PARAMS \
     { 0,           0,           5,     0,  PF_ENUM | PF_CTL_COMBO, active_mode_names, "hp_active", "HP Active" }, \
     { 30,          10,          20000, 0,  PF_FLOAT | PF_SCALE_LOG | PF_CTL_KNOB | PF_UNIT_HZ, NULL, "hp_freq", "HP Freq" }, \
@@ -152,6 +155,8 @@ CALF_PORT_NAMES(reverb) = {"In L", "In R", "Out L", "Out R"};
 
 const char *reverb_room_sizes[] = { "Small", "Medium", "Large", "Tunnel-like", "Large/smooth", "Experimental" };
 
+const char *reverb_algorithms[] = { "Classic", "Delay network" };
+
 CALF_PORT_PROPS(reverb) = {
     { 0,           0,           1,     0,  PF_FLOAT | PF_SCALE_GAIN | PF_CTL_METER | PF_CTLO_LABEL | PF_UNIT_DB | PF_PROP_OUTPUT | PF_PROP_OPTIONAL, NULL, "meter_inL", "Meter-InL" }, \
     { 0,           0,           1,     0,  PF_FLOAT | PF_SCALE_GAIN | PF_CTL_METER | PF_CTLO_LABEL | PF_UNIT_DB | PF_PROP_OUTPUT | PF_PROP_OPTIONAL, NULL, "meter_inR", "Meter-InR" }, \
@@ -175,6 +180,7 @@ CALF_PORT_PROPS(reverb) = {
     { 0,           0,           1,     0,  PF_FLOAT | PF_CTL_LED | PF_PROP_OUTPUT | PF_PROP_OPTIONAL, NULL, "clip_inL", "0dB-InL" }, \
     { 0,           0,           1,     0,  PF_FLOAT | PF_CTL_LED | PF_PROP_OUTPUT | PF_PROP_OPTIONAL, NULL, "clip_inR", "0dB-InR" }, \
     { 0,           0,           1,     0,  PF_FLOAT | PF_CTL_LED | PF_PROP_OUTPUT | PF_PROP_OPTIONAL, NULL, "clip_outR", "0dB-OutR" },
+    { 0,          0,    1,    0, PF_ENUM | PF_CTL_COMBO, reverb_algorithms, "algorithm", "Algorithm" },
     {}
 };
 
@@ -182,6 +188,26 @@ CALF_PLUGIN_INFO(reverb) = { 0x847e, "Reverb", "Calf Reverb", "Calf Studio Gear"
 
 ////////////////////////////////////////////////////////////////////////////
 
+CALF_PORT_NAMES(convolution_reverb) = {"In L", "In R", "Out L", "Out R"};
+
+CALF_PORT_PROPS(convolution_reverb) = {
+    BYPASS_AND_LEVEL_PARAMS
+    METERING_PARAMS
+    { 1,          0,    2,    0, PF_FLOAT | PF_SCALE_GAIN | PF_CTL_KNOB | PF_UNIT_COEF | PF_PROP_NOBOUNDS, NULL, "dry", "Dry Amount" },
+    { 0.25,       0,    2,    0, PF_FLOAT | PF_SCALE_GAIN | PF_CTL_KNOB | PF_UNIT_COEF | PF_PROP_NOBOUNDS, NULL, "wet", "Wet Amount" },
+    { 0,          0,   60,    0, PF_FLOAT | PF_SCALE_LINEAR | PF_CTL_LABEL | PF_UNIT_SEC | PF_PROP_OUTPUT | PF_PROP_OPTIONAL, NULL, "ir_length", "IR Length" },
+    {}
+};
+
+CALF_PLUGIN_INFO(convolution_reverb) = { 0x8487, "ConvolutionReverb", "Calf Convolution Reverb", "Calf Studio Gear", calf_plugins::calf_copyright_info, "ReverbPlugin" };
+
+void convolution_reverb_metadata::get_configure_vars(vector<string> &names) const
+{
+    names.push_back("ir_file");
+}
+
+////////////////////////////////////////////////////////////////////////////
+
 CALF_PORT_NAMES(filter) = {"In L", "In R", "Out L", "Out R"};
 
 const char *filter_choices[] = {
@@ -713,6 +739,7 @@ CALF_PORT_PROPS(limiter) = {
     { 0.5f,      0.f,         1.f,   0,  PF_FLOAT | PF_SCALE_LINEAR | PF_CTL_KNOB | PF_UNIT_COEF | PF_PROP_GRAPH, NULL, "asc_coeff", "ASC Level" },
     { 1,           1,           4,   0,  PF_INT | PF_SCALE_LINEAR | PF_UNIT_COEF | PF_CTL_KNOB, NULL, "oversampling", "Oversampling" },
     { 1,           0,           1,   0,  PF_BOOL | PF_CTL_TOGGLE, NULL, "auto_level", "Auto-level" },
+    LATENCY_PARAM
     {}
 };
 
@@ -770,6 +797,7 @@ CALF_PORT_PROPS(multibandlimiter) = {
     { 1,           1,           4,   0,  PF_INT | PF_SCALE_LINEAR | PF_UNIT_COEF | PF_CTL_KNOB, NULL, "oversampling", "Oversampling" },
     { 1,           0,           1,   0,  PF_BOOL | PF_CTL_TOGGLE, NULL, "auto_level", "Auto-level" },
 
+    LATENCY_PARAM
     {}
 };
 
@@ -834,6 +862,7 @@ CALF_PORT_PROPS(sidechainlimiter) = {
     { 1,           1,           4,   0,  PF_INT | PF_SCALE_LINEAR | PF_UNIT_COEF | PF_CTL_KNOB, NULL, "oversampling", "Oversampling" },
     { 1,           0.015625,    64,    0,  PF_FLOAT | PF_SCALE_GAIN | PF_CTL_KNOB | PF_UNIT_DB, NULL, "level_sc", "Level S/C"},
     { 1,           0,           1,     0,  PF_BOOL | PF_CTL_TOGGLE, NULL, "auto_level", "Auto-level" },
+    LATENCY_PARAM
     {}
 };
 
@@ -1563,6 +1592,7 @@ CALF_PORT_PROPS(transientdesigner) = {
     { 0,        0,      3, 0,  PF_ENUM | PF_CTL_COMBO, transientdesigner_filter_modes, "hp_mode", "HP-Mode" },
     { 0,        0,      3, 0,  PF_ENUM | PF_CTL_COMBO, transientdesigner_filter_modes, "lp_mode", "LP-Mode" },
     { 0,        0,      1, 0,  PF_BOOL | PF_CTL_TOGGLE, NULL, "listen", "Listen" },
+    LATENCY_PARAM
     {}
 };
 
@@ -1668,6 +1698,7 @@ CALF_PORT_PROPS(psyclipper) = {
     { 15,         -10,         20,    0, PF_INT | PF_SCALE_LINEAR | PF_CTL_FADER | PF_UNIT_DB, NULL, "protection8000", "Protection 8000Hz" },
     { 5,          -10,         20,    0, PF_INT | PF_SCALE_LINEAR | PF_CTL_FADER | PF_UNIT_DB, NULL, "protection16000", "Protection 16000Hz" },
     { 1,           0.125,     1,     0,  PF_FLOAT | PF_SCALE_GAIN | PF_CTL_METER | PF_CTLO_LABEL | PF_CTLO_REVERSE | PF_UNIT_DB | PF_PROP_OUTPUT | PF_PROP_OPTIONAL| PF_PROP_GRAPH, NULL, "margin_shift", "Protection Margin Reduction" },
+    LATENCY_PARAM
     {}
 };
 
@@ -1766,6 +1797,9 @@ CALF_PORT_PROPS(monosynth) = {
     
     { 0,       0,   16,    0, PF_INT | PF_SCALE_LINEAR | PF_CTL_KNOB , NULL, "midi", "MIDI Channel" },
     
+    { 8,          1,    8,    0, PF_INT | PF_SCALE_LINEAR | PF_CTL_KNOB, NULL, "o2_unisonvoices", "Osc2 Unison Voices" },
+    { 0,          0,    1,    0, PF_FLOAT | PF_CTL_KNOB | PF_SCALE_PERC, NULL, "o2_unisonspread", "Osc2 Unison Spread" },
+    
     {}
 };
 
@@ -2192,7 +2226,7 @@ CALF_PLUGIN_INFO(widgets) = { 0x85AB, "Widgets", "Calf Widget Test", "Calf Studi
 
 plugin_registry::plugin_registry()
 {
-    #define PER_MODULE_ITEM(name, isSynth, jackname) plugins.push_back((new name##_metadata));
+    #define PER_MODULE_ITEM(name, isSynth, jackname) add(new name##_metadata);
     #include <calf/modulelist.h>
 }
 
@@ -21,6 +21,7 @@
 #include <calf/modmatrix.h>
 #include <calf/utils.h>
 #include <memory.h>
+#include <algorithm>
 #include <sstream>
 
 using namespace std;
@@ -35,6 +36,43 @@ mod_matrix_impl::mod_matrix_impl(dsp::modulation_entry *_matrix, mod_matrix_meta
     matrix_rows = metadata->get_table_rows();
     for (unsigned int i = 0; i < matrix_rows; i++)
         matrix[i].reset();
+    for (int i = 0; i < 3; i++)
+    {
+        compiled_ops[i].resize(std::max(matrix_rows, 1U));
+        compiled_count[i] = 0;
+    }
+    compiled_front = 0;
+    compiled_middle = 1;
+    compiled_back = 2;
+}
+
+void mod_matrix_impl::compile_matrix()
+{
+    int next = compiled_back;
+    modulation_op *ops = &compiled_ops[next][0];
+    int count = 0;
+    for (unsigned int i = 0; i < matrix_rows; i++)
+    {
+        const modulation_entry &slot = matrix[i];
+        if (!slot.dest || slot.amount == 0)
+            continue;
+        modulation_op &op = ops[count++];
+        const float *c = scaling_coeffs[slot.mapping];
+        op.src1 = slot.src1;
+        op.src2 = slot.src2;
+        op.dest = slot.dest;
+        for (int j = 0; j < 3; j++)
+            op.c[j] = c[j] * slot.amount;
+        // source "None" is always 1, so the mapping of it is a constant
+        if (!slot.src1)
+        {
+            op.c[0] += op.c[1] + op.c[2];
+            op.c[1] = op.c[2] = 0;
+        }
+    }
+    compiled_count[next] = count;
+    // publish the new copy; the previous one, if the audio thread never picked it up, is reused next time
+    compiled_back = compiled_middle.exchange(next | COMPILED_FRESH, std::memory_order_acq_rel) & ~COMPILED_FRESH;
 }
 
 const float mod_matrix_impl::scaling_coeffs[mod_matrix_metadata::map_type_count][3] = {
@@ -149,6 +187,7 @@ char *mod_matrix_impl::configure(const char *key, const char *value)
                 case 3: slot.amount = src->amount; break;
                 case 4: slot.dest = src->dest; break;                    
                 }
+                compile_matrix();
                 return NULL;
             }
             const table_column_info &ci = metadata->get_table_columns()[column];
@@ -162,6 +201,7 @@ char *mod_matrix_impl::configure(const char *key, const char *value)
         set_cell(row, column, value, error);
         if (!error.empty())
             return strdup(error.c_str());
+        compile_matrix();
     }
     return NULL;
 }
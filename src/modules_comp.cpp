@@ -2785,9 +2785,9 @@ bool transientdesigner_audio_module::get_gridline(int index, int subindex, int p
     pos = dB_grid(gain, 128, 0.6);
     context->set_source_rgba(0, 0, 0, subindex & 1 ? 0.1 : 0.2);
     if (!(subindex & 1) && subindex) {
-        std::stringstream ss;
-        ss << (24 - 6 * subindex) << " dB";
-        legend = ss.str();
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%d dB", 24 - 6 * subindex);
+        legend = buf;
     }
     return true;
 }
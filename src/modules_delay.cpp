@@ -19,12 +19,14 @@
  * Boston, MA  02110-1301  USA
  */
  
+#include <errno.h>
 #include <limits.h>
 #include <memory.h>
 #include <math.h>
 #include <calf/giface.h>
 #include <calf/modules_delay.h>
 #include <calf/modules_dev.h>
+#include <calf/wavfile.h>
 #ifndef _MSC_VER
 #include <sys/time.h>
 #endif
@@ -32,6 +34,7 @@ using namespace dsp;
 using namespace calf_plugins;
 
 FORWARD_DECLARE_METADATA(reverb)
+FORWARD_DECLARE_METADATA(convolution_reverb)
 FORWARD_DECLARE_METADATA(vintage_delay)
 FORWARD_DECLARE_METADATA(comp_delay)
 FORWARD_DECLARE_METADATA(haas_enhancer)
@@ -43,9 +46,15 @@ FORWARD_DECLARE_METADATA(reverse_delay)
  * REVERB by Krzysztof Foltman
 **********************************************************************/
 
+reverb_audio_module::reverb_audio_module()
+{
+    algorithm = algorithm_classic;
+}
+
 void reverb_audio_module::activate()
 {
     reverb.reset();
+    fdn.reset();
 }
 
 void reverb_audio_module::deactivate()
@@ -56,6 +65,7 @@ void reverb_audio_module::set_sample_rate(uint32_t sr)
 {
     srate = sr;
     reverb.setup(sr);
+    fdn.setup(sr);
     amount.set_sample_rate(sr);
     int meter[] = {param_meter_inL, param_meter_inR, param_meter_outL, param_meter_outR};
     int clip[] = {param_clip_inL, param_clip_inR, param_clip_outL, param_clip_outR};
@@ -67,6 +77,15 @@ void reverb_audio_module::params_changed()
     reverb.set_type_and_diffusion(fastf2i_drm(*params[par_roomsize]), *params[par_diffusion]);
     reverb.set_time(*params[par_decay]);
     reverb.set_cutoff(*params[par_hfdamp]);
+    fdn.set_type_and_diffusion(fastf2i_drm(*params[par_roomsize]), *params[par_diffusion]);
+    fdn.set_time(*params[par_decay]);
+    fdn.set_cutoff(*params[par_hfdamp]);
+    int new_algorithm = fastf2i_drm(*params[par_algorithm]);
+    if (new_algorithm != algorithm) {
+        reverb.reset();
+        fdn.reset();
+        algorithm = new_algorithm;
+    }
     amount.set_inertia(*params[par_amount]);
     dryamount.set_inertia(*params[par_dry]);
     left_lo.set_lp(dsp::clip(*params[par_treblecut], 20.f, (float)(srate * 0.49f)), srate);
@@ -78,32 +97,44 @@ void reverb_audio_module::params_changed()
 
 uint32_t reverb_audio_module::process(uint32_t offset, uint32_t numsamples, uint32_t inputs_mask, uint32_t outputs_mask)
 {
-    numsamples += offset;
-    for (uint32_t i = offset; i < numsamples; i++) {
+    bool on = *params[par_on] > 0.5;
+    // input gain, pre-delay and filtering, then the reverb itself (in one go for the whole block in case of the delay network)
+    float dry_l[MAX_SAMPLE_RUN], dry_r[MAX_SAMPLE_RUN], wet_l[MAX_SAMPLE_RUN], wet_r[MAX_SAMPLE_RUN];
+    for (uint32_t i = 0; i < numsamples; i++) {
+        stereo_sample<float> s(ins[0][offset + i] * *params[param_level_in],
+                               ins[1][offset + i] * *params[param_level_in]);
+        stereo_sample<float> s2 = pre_delay.process(s, predelay_amt);
+        dry_l[i] = s.left;
+        dry_r[i] = s.right;
+        wet_l[i] = left_lo.process(left_hi.process(s2.left));
+        wet_r[i] = right_lo.process(right_hi.process(s2.right));
+    }
+    if (on) {
+        if (algorithm == algorithm_fdn)
+            fdn.process(wet_l, wet_r, numsamples);
+        else {
+            for (uint32_t i = 0; i < numsamples; i++)
+                reverb.process(wet_l[i], wet_r[i]);
+        }
+    }
+    for (uint32_t i = 0; i < numsamples; i++) {
         float dry = dryamount.get();
         float wet = amount.get();
-        stereo_sample<float> s(ins[0][i] * *params[param_level_in],
-                               ins[1][i] * *params[param_level_in]);
-        stereo_sample<float> s2 = pre_delay.process(s, predelay_amt);
-        
-        float rl = s2.left, rr = s2.right;
-        rl = left_lo.process(left_hi.process(rl));
-        rr = right_lo.process(right_hi.process(rr));
-        if (*params[par_on] > 0.5)
-            reverb.process(rl, rr);
-        outs[0][i] = dry*s.left;
-        outs[1][i] = dry*s.right;
-        if (*params[par_on] > 0.5) {
-            outs[0][i] += wet*rl;
-            outs[1][i] += wet*rr;
+        float outL = dry * dry_l[i];
+        float outR = dry * dry_r[i];
+        if (on) {
+            outL += wet * wet_l[i];
+            outR += wet * wet_r[i];
         }
-        outs[0][i] *= *params[param_level_out];
-        outs[1][i] *= *params[param_level_out];
+        outL *= *params[param_level_out];
+        outR *= *params[param_level_out];
+        outs[0][offset + i] = outL;
+        outs[1][offset + i] = outR;
         
-        float values[] = {s.left, s.right, outs[0][i], outs[1][i]};
+        float values[] = {dry_l[i], dry_r[i], outL, outR};
         meters.process(values);
     }
-    meters.fall(numsamples);
+    meters.fall(offset + numsamples);
     reverb.extra_sanitize();
     left_lo.sanitize();
     left_hi.sanitize();
@@ -112,6 +143,274 @@ uint32_t reverb_audio_module::process(uint32_t offset, uint32_t numsamples, uint
     return outputs_mask;
 }
 
+/**********************************************************************
+ * CONVOLUTION REVERB
+**********************************************************************/
+
+convolution_reverb_audio_module::convolution_reverb_audio_module()
+: pending(NULL)
+, retired(NULL)
+, loader_quit(false)
+, status_serial(1)
+{
+    srate = 0;
+    conv = NULL;
+    loaded_srate = 0;
+    ir_status = "No impulse response";
+    sem_init(&loader_wakeup, 0, 0);
+    pthread_create(&loader, NULL, loader_thread, this);
+}
+
+convolution_reverb_audio_module::~convolution_reverb_audio_module()
+{
+    loader_quit = true;
+    sem_post(&loader_wakeup);
+    pthread_join(loader, NULL);
+    sem_destroy(&loader_wakeup);
+    delete conv;
+    delete pending.exchange(NULL);
+    delete retired.exchange(NULL);
+}
+
+void *convolution_reverb_audio_module::loader_thread(void *arg)
+{
+    convolution_reverb_audio_module *self = (convolution_reverb_audio_module *)arg;
+    while(true)
+    {
+        while(sem_wait(&self->loader_wakeup) == -1 && errno == EINTR)
+            ;
+        if (self->loader_quit)
+            break;
+        delete self->retired.exchange(NULL);
+        self->load_impulse_response();
+    }
+    return NULL;
+}
+
+/// Resample an impulse response using a windowed sinc interpolator (only done once, when loading)
+static void resample_ir(std::vector<float> &data, uint32_t from_rate, uint32_t to_rate)
+{
+    const int half_width = 16;
+    double ratio = (double)to_rate / from_rate;
+    // below 1 when downsampling, to filter out the frequencies above the new Nyquist limit
+    double cutoff = std::min(1.0, ratio);
+    uint32_t out_len = (uint32_t)ceil(data.size() * ratio);
+    std::vector<float> out(out_len);
+    int in_len = data.size();
+    for (uint32_t n = 0; n < out_len; n++)
+    {
+        double t = n / ratio;
+        int center = (int)t;
+        double sum = 0;
+        for (int k = center - half_width + 1; k <= center + half_width; k++)
+        {
+            if (k < 0 || k >= in_len)
+                continue;
+            double x = t - k;
+            double window = 0.42 + 0.5 * cos(M_PI * x / half_width) + 0.08 * cos(2 * M_PI * x / half_width);
+            double sinc = fabs(x) < 1e-9 ? 1.0 : sin(M_PI * x * cutoff) / (M_PI * x * cutoff);
+            sum += data[k] * cutoff * sinc * window;
+        }
+        out[n] = sum;
+    }
+    data.swap(out);
+}
+
+void convolution_reverb_audio_module::load_impulse_response()
+{
+    std::string file;
+    uint32_t sr;
+    {
+        calf_utils::ptlock lock(file_mutex);
+        if (loaded_srate || !srate)
+            return;
+        file = ir_file;
+        sr = srate;
+        loaded_srate = sr;
+    }
+    dsp::convolver *new_conv = NULL;
+    std::string status;
+    if (!file.empty())
+    {
+        try {
+            calf_utils::wav_reader reader;
+            reader.open(file);
+            std::vector<std::vector<float> > data;
+            reader.read_all(data);
+            if (data.size() > 2)
+                data.resize(2);
+            // trim the silence at the end
+            uint32_t length = 0;
+            for (size_t c = 0; c < data.size(); c++)
+                for (uint32_t i = 0; i < data[c].size(); i++)
+                    if (fabs(data[c][i]) > 1e-6f)
+                        length = std::max(length, i + 1);
+            if (!length)
+                throw calf_utils::file_exception(file, "impulse response is silent");
+            // limit to 60 seconds, which is already unreasonably long for a reverb
+            length = std::min<uint32_t>(length, 60 * reader.format.sample_rate);
+            for (size_t c = 0; c < data.size(); c++)
+            {
+                data[c].resize(length);
+                if (reader.format.sample_rate != sr)
+                    resample_ir(data[c], reader.format.sample_rate, sr);
+            }
+            length = data[0].size();
+            // normalize to unity energy gain, so that different responses sound equally loud
+            double energy = 0;
+            for (size_t c = 0; c < data.size(); c++)
+                for (uint32_t i = 0; i < length; i++)
+                    energy += data[c][i] * data[c][i];
+            float gain = 1.0 / sqrt(energy / data.size());
+            const float *ir[2];
+            for (size_t c = 0; c < data.size(); c++)
+            {
+                for (uint32_t i = 0; i < length; i++)
+                    data[c][i] *= gain;
+                ir[c] = &data[c][0];
+            }
+            new_conv = new dsp::convolver(ir, data.size(), length, 2);
+            std::string name = file.substr(file.rfind('/') + 1);
+            status = name + " (" + calf_utils::i2s(reader.format.channels) + " ch, " + calf_utils::i2s(reader.format.sample_rate) + " Hz)";
+        }
+        catch(std::exception &e)
+        {
+            status = e.what();
+        }
+    }
+    else
+    {
+        // an empty response, so that process() drops the current one
+        const float *ir[1] = { NULL };
+        new_conv = new dsp::convolver(ir, 1, 0, 2);
+        status = "No impulse response";
+    }
+    // a convolver that process() has not picked up yet is not needed anymore;
+    // if loading failed, the previous response stays in use
+    if (new_conv)
+        delete pending.exchange(new_conv);
+    {
+        calf_utils::ptlock lock(file_mutex);
+        ir_status = status;
+    }
+    status_serial++;
+}
+
+char *convolution_reverb_audio_module::configure(const char *key, const char *value)
+{
+    if (!strcmp(key, "ir_file"))
+    {
+        {
+            calf_utils::ptlock lock(file_mutex);
+            ir_file = value ? value : "";
+            loaded_srate = 0;
+        }
+        sem_post(&loader_wakeup);
+    }
+    return NULL;
+}
+
+void convolution_reverb_audio_module::send_configures(send_configure_iface *sci)
+{
+    calf_utils::ptlock lock(file_mutex);
+    sci->send_configure("ir_file", ir_file.c_str());
+}
+
+int convolution_reverb_audio_module::send_status_updates(send_updates_iface *sui, int last_serial)
+{
+    int cur_serial = status_serial;
+    if (cur_serial != last_serial)
+    {
+        calf_utils::ptlock lock(file_mutex);
+        sui->send_status("ir_status", ir_status.c_str());
+    }
+    return cur_serial;
+}
+
+void convolution_reverb_audio_module::activate()
+{
+    if (conv)
+        conv->reset();
+}
+
+void convolution_reverb_audio_module::deactivate()
+{
+}
+
+void convolution_reverb_audio_module::set_sample_rate(uint32_t sr)
+{
+    {
+        calf_utils::ptlock lock(file_mutex);
+        srate = sr;
+        if (loaded_srate != sr)
+            loaded_srate = 0;
+    }
+    sem_post(&loader_wakeup);
+    dry.set_sample_rate(sr);
+    wet.set_sample_rate(sr);
+    int meter[] = {param_meter_inL, param_meter_inR, param_meter_outL, param_meter_outR};
+    int clip[] = {param_clip_inL, param_clip_inR, param_clip_outL, param_clip_outR};
+    meters.init(params, meter, clip, 4, sr);
+}
+
+void convolution_reverb_audio_module::params_changed()
+{
+    dry.set_inertia(*params[param_dry]);
+    wet.set_inertia(*params[param_wet]);
+}
+
+uint32_t convolution_reverb_audio_module::process(uint32_t offset, uint32_t numsamples, uint32_t inputs_mask, uint32_t outputs_mask)
+{
+    // pick up a newly loaded impulse response (the old one is freed by the loader thread)
+    if (pending.load(std::memory_order_relaxed) && !retired.load())
+    {
+        dsp::convolver *old = conv;
+        conv = pending.exchange(NULL);
+        retired.store(old);
+        sem_post(&loader_wakeup);
+    }
+    if (params[param_ir_length])
+        *params[param_ir_length] = conv && srate ? conv->get_length() / (float)srate : 0.f;
+
+    bool bypassed = bypass.update(*params[param_bypass] > 0.5f, numsamples);
+    uint32_t end = offset + numsamples;
+    if (bypassed) {
+        for (uint32_t i = offset; i < end; i++) {
+            outs[0][i] = ins[0][i];
+            outs[1][i] = ins[1][i];
+            float values[] = {0, 0, 0, 0};
+            meters.process(values);
+        }
+    } else {
+        float in_l[MAX_SAMPLE_RUN], in_r[MAX_SAMPLE_RUN], wet_l[MAX_SAMPLE_RUN], wet_r[MAX_SAMPLE_RUN];
+        float level_in = *params[param_level_in], level_out = *params[param_level_out];
+        for (uint32_t i = 0; i < numsamples; i++) {
+            in_l[i] = ins[0][offset + i] * level_in;
+            in_r[i] = ins[1][offset + i] * level_in;
+        }
+        if (conv) {
+            const float *conv_in[] = {in_l, in_r};
+            float *conv_out[] = {wet_l, wet_r};
+            conv->process(conv_in, conv_out, numsamples);
+        } else {
+            dsp::zero(wet_l, numsamples);
+            dsp::zero(wet_r, numsamples);
+        }
+        for (uint32_t i = 0; i < numsamples; i++) {
+            float d = dry.get(), w = wet.get();
+            float outL = (in_l[i] * d + wet_l[i] * w) * level_out;
+            float outR = (in_r[i] * d + wet_r[i] * w) * level_out;
+            outs[0][offset + i] = outL;
+            outs[1][offset + i] = outR;
+            float values[] = {in_l[i], in_r[i], outL, outR};
+            meters.process(values);
+        }
+        bypass.crossfade(ins, outs, 2, offset, numsamples);
+    }
+    meters.fall(end);
+    return outputs_mask;
+}
+
 /**********************************************************************
  * VINTAGE DELAY by Krzysztof Foltman
 **********************************************************************/
@@ -119,12 +418,17 @@ uint32_t reverb_audio_module::process(uint32_t offset, uint32_t numsamples, uint
 vintage_delay_audio_module::vintage_delay_audio_module()
 {
     old_medium = -1;
-    for (int i = 0; i < MAX_DELAY; i++) {
-        buffers[0][i] = 0.f;
-        buffers[1][i] = 0.f;
-    }
+    buffers[0] = arena.alloc<float>(MAX_DELAY);
+    buffers[1] = arena.alloc<float>(MAX_DELAY);
     _tap_avg = 0;
     _tap_last = 0;
+    
+    static const int timing_deps[] = { PERIODICAL_PARAMS, par_divide, par_time_l, par_time_r, -1 };
+    static const int gains_deps[] = { par_feedback, par_amount, par_mixmode, -1 };
+    coeffs.depends_on(coeff_timing, timing_deps);
+    coeffs.depends_on(coeff_gains, gains_deps);
+    coeffs.depends_on(coeff_dry, par_dryamount);
+    coeffs.depends_on(coeff_width, par_width);
 }
 
 char *vintage_delay_audio_module::configure(const char *key, const char *value)
@@ -144,60 +448,80 @@ char *vintage_delay_audio_module::configure(const char *key, const char *value)
 
 void vintage_delay_audio_module::params_changed()
 {
-    double bpm = 120;
-    bpm = convert_periodic(*params[param_bpm + (int)((periodic_unit)int(*params[param_timing]))],
-                                  (periodic_unit)int(*params[param_timing]), UNIT_BPM);
-    
-    // not implemented by now
-    //switch ((int)*params[par_frag]) {
-        //case FRAG_PERIODIC:
-            
-            //break;
-        //case FRAG_PATTERN:
-            //int amnt = *params[par_pbeats] * *params[par_pfrag];
-            //break;
-    //}
-    
-    float unit = 60.0 * srate / (bpm * *params[par_divide]);
-    deltime_l = dsp::fastf2i_drm(unit * *params[par_time_l]);
-    deltime_r = dsp::fastf2i_drm(unit * *params[par_time_r]);
-    int deltime_fb = deltime_l + deltime_r;
-    float fb = *params[par_feedback];
-    dry.set_inertia(*params[par_dryamount]);
-    mixmode = dsp::fastf2i_drm(*params[par_mixmode]);
-    medium = dsp::fastf2i_drm(*params[par_medium]);
-    switch(mixmode)
+    params_changed(param_mask::all());
+}
+
+void vintage_delay_audio_module::params_changed(const param_mask &dirty)
+{
+    coeffs.invalidate(dirty);
+    if (coeffs.update(coeff_timing))
     {
-    case MIXMODE_STEREO:
-        fb_left.set_inertia(fb);
-        fb_right.set_inertia(pow(fb, *params[par_time_r] / *params[par_time_l]));
-        amt_left.set_inertia(*params[par_amount]);
-        amt_right.set_inertia(*params[par_amount]);
-        break;
-    case MIXMODE_PINGPONG:
-        fb_left.set_inertia(fb);
-        fb_right.set_inertia(fb);
-        amt_left.set_inertia(*params[par_amount]);
-        amt_right.set_inertia(*params[par_amount]);
-        break;
-    case MIXMODE_LR:
-        fb_left.set_inertia(fb);
-        fb_right.set_inertia(fb);
-        amt_left.set_inertia(*params[par_amount]);                                          // L is straight 'amount'
-        amt_right.set_inertia(*params[par_amount] * pow(fb, 1.0 * deltime_r / deltime_fb)); // R is amount with feedback based dampening as if it ran through R/FB*100% of delay line's dampening
-        // deltime_l <<< deltime_r -> pow() = fb -> full delay line worth of dampening
-        // deltime_l >>> deltime_r -> pow() = 1 -> no dampening
-        break;
-    case MIXMODE_RL:
-        fb_left.set_inertia(fb);
-        fb_right.set_inertia(fb);
-        amt_left.set_inertia(*params[par_amount] * pow(fb, 1.0 * deltime_l / deltime_fb));
-        amt_right.set_inertia(*params[par_amount]);
-        break;
+        double bpm = 120;
+        bpm = convert_periodic(*params[param_bpm + (int)((periodic_unit)int(*params[param_timing]))],
+                                      (periodic_unit)int(*params[param_timing]), UNIT_BPM);
+        
+        // not implemented by now
+        //switch ((int)*params[par_frag]) {
+            //case FRAG_PERIODIC:
+                
+                //break;
+            //case FRAG_PATTERN:
+                //int amnt = *params[par_pbeats] * *params[par_pfrag];
+                //break;
+        //}
+        
+        float unit = 60.0 * srate / (bpm * *params[par_divide]);
+        deltime_l = dsp::fastf2i_drm(unit * *params[par_time_l]);
+        deltime_r = dsp::fastf2i_drm(unit * *params[par_time_r]);
+        // the mix mode gains below depend on the delay time ratio
+        coeffs.invalidate_group(coeff_gains);
     }
-    chmix.set_inertia((1 - *params[par_width]) * 0.5);
+    if (coeffs.update(coeff_dry))
+        dry.set_inertia(*params[par_dryamount]);
+    if (coeffs.update(coeff_gains))
+    {
+        int deltime_fb = deltime_l + deltime_r;
+        float fb = *params[par_feedback];
+        mixmode = dsp::fastf2i_drm(*params[par_mixmode]);
+        switch(mixmode)
+        {
+        case MIXMODE_STEREO:
+            fb_left.set_inertia(fb);
+            fb_right.set_inertia(pow(fb, *params[par_time_r] / *params[par_time_l]));
+            amt_left.set_inertia(*params[par_amount]);
+            amt_right.set_inertia(*params[par_amount]);
+            break;
+        case MIXMODE_PINGPONG:
+            fb_left.set_inertia(fb);
+            fb_right.set_inertia(fb);
+            amt_left.set_inertia(*params[par_amount]);
+            amt_right.set_inertia(*params[par_amount]);
+            break;
+        case MIXMODE_LR:
+            fb_left.set_inertia(fb);
+            fb_right.set_inertia(fb);
+            amt_left.set_inertia(*params[par_amount]);                                          // L is straight 'amount'
+            amt_right.set_inertia(*params[par_amount] * pow(fb, 1.0 * deltime_r / deltime_fb)); // R is amount with feedback based dampening as if it ran through R/FB*100% of delay line's dampening
+            // deltime_l <<< deltime_r -> pow() = fb -> full delay line worth of dampening
+            // deltime_l >>> deltime_r -> pow() = 1 -> no dampening
+            break;
+        case MIXMODE_RL:
+            fb_left.set_inertia(fb);
+            fb_right.set_inertia(fb);
+            amt_left.set_inertia(*params[par_amount] * pow(fb, 1.0 * deltime_l / deltime_fb));
+            amt_right.set_inertia(*params[par_amount]);
+            break;
+        }
+    }
+    if (coeffs.update(coeff_width))
+        chmix.set_inertia((1 - *params[par_width]) * 0.5);
+    if (dirty.test(par_medium))
+        medium = dsp::fastf2i_drm(*params[par_medium]);
     if (medium != old_medium)
+    {
         calc_filters();
+        old_medium = medium;
+    }
 }
 
 void vintage_delay_audio_module::activate()
@@ -214,6 +538,7 @@ void vintage_delay_audio_module::set_sample_rate(uint32_t sr)
 {
     srate = sr;
     old_medium = -1;
+    coeffs.invalidate_group(coeff_timing);
     amt_left.set_sample_rate(sr); amt_right.set_sample_rate(sr);
     fb_left.set_sample_rate(sr); fb_right.set_sample_rate(sr);
 
@@ -375,12 +700,6 @@ comp_delay_audio_module::comp_delay_audio_module()
     write_ptr   = 0;
 }
 
-comp_delay_audio_module::~comp_delay_audio_module()
-{
-    if (buffer != NULL)
-        delete [] buffer;
-}
-
 void comp_delay_audio_module::params_changed()
 {
     delay = (uint32_t)
@@ -405,25 +724,15 @@ void comp_delay_audio_module::deactivate()
 void comp_delay_audio_module::set_sample_rate(uint32_t sr)
 {
     srate = sr;
-    float *old_buf = buffer;
 
     uint32_t min_buf_size = (uint32_t)(srate * COMP_DELAY_MAX_DELAY * 2);
     uint32_t new_buf_size = 2;
     while (new_buf_size < min_buf_size)
         new_buf_size <<= 1;
 
-    float *new_buf = new float[new_buf_size];
-    for (size_t i=0; i<new_buf_size; i++)
-        new_buf[i] = 0.0f;
-
-    // Assign new pointer and size
-    buffer         = new_buf;
+    buffer         = arena.realloc(buffer, new_buf_size);
     buf_size       = new_buf_size;
 
-    // Delete old buffer
-    if (old_buf != NULL)
-        delete [] old_buf;
-        
     int meter[] = {param_meter_inL,  param_meter_inR, param_meter_outL, param_meter_outR};
     int clip[]  = {param_clip_inL, param_clip_inR, param_clip_outL, param_clip_outR};
     meters.init(params, meter, clip, 4, srate);
@@ -503,15 +812,6 @@ haas_enhancer_audio_module::haas_enhancer_audio_module()
     s_bal_r[1]          = 0.0f;
 }
 
-haas_enhancer_audio_module::~haas_enhancer_audio_module()
-{
-    if (buffer != NULL)
-    {
-        delete [] buffer;
-        buffer = NULL;
-    }
-}
-
 void haas_enhancer_audio_module::params_changed()
 {
     m_source            = (uint32_t)(*params[par_m_source]);
@@ -539,25 +839,15 @@ void haas_enhancer_audio_module::deactivate()
 void haas_enhancer_audio_module::set_sample_rate(uint32_t sr)
 {
     srate = sr;
-    float *old_buf = buffer;
 
     uint32_t min_buf_size = (uint32_t)(srate * HAAS_ENHANCER_MAX_DELAY);
     uint32_t new_buf_size = 1;
     while (new_buf_size < min_buf_size)
         new_buf_size <<= 1;
 
-    float *new_buf = new float[new_buf_size];
-    for (size_t i=0; i<new_buf_size; i++)
-        new_buf[i] = 0.0f;
-
-    // Assign new pointer and size
-    buffer         = new_buf;
+    buffer         = arena.realloc(buffer, new_buf_size);
     buf_size       = new_buf_size;
 
-    // Delete old buffer
-    if (old_buf != NULL)
-        delete [] old_buf;
-        
     int meter[] = {param_meter_inL, param_meter_inR,  param_meter_outL, param_meter_outR, param_meter_sideL, param_meter_sideR};
     int clip[] = {param_clip_inL, param_clip_inR, param_clip_outL, param_clip_outR, -1, -1};
     meters.init(params, meter, clip, 6, srate);
@@ -638,10 +928,9 @@ uint32_t haas_enhancer_audio_module::process(uint32_t offset, uint32_t numsample
 
 reverse_delay_audio_module::reverse_delay_audio_module()
 {
-    for (int i = 0; i < MAX_DELAY; i++) {
-        buffers[0][i] = 0.f;
-        buffers[1][i] = 0.f;
-    }
+    buffers[0] = buffers[1] = NULL;
+    buffer_size = 0;
+    deltime_l = deltime_r = 0;
 
     counters[0] = 0;
     counters[1] = 0;
@@ -655,10 +944,11 @@ void reverse_delay_audio_module::params_changed()
     if (*params[par_sync] > 0.5f)
         *params[par_bpm] = *params[par_bpm_host];
 
-    //Max delay line length: (60*192000/30)*16 = 6144000, see buffers declaration
+    //Max delay line length: (60*srate/30)*16 = srate*MAX_DELAY_SECONDS, see buffers declaration
+    //(delays longer than that, from a host tempo below 30 BPM, are clipped)
     float unit = 60.0 * srate / (*params[par_bpm] * *params[par_divide]);
-    deltime_l = dsp::fastf2i_drm(unit * *params[par_time_l]);
-    deltime_r = dsp::fastf2i_drm(unit * *params[par_time_r]);
+    deltime_l = std::min<int>(dsp::fastf2i_drm(unit * *params[par_time_l]), buffer_size);
+    deltime_r = std::min<int>(dsp::fastf2i_drm(unit * *params[par_time_r]), buffer_size);
 
     fb_val.set_inertia(*params[par_feedback]);
     dry.set_inertia(*params[par_amount]);
@@ -674,10 +964,8 @@ void reverse_delay_audio_module::params_changed()
     //Cleanup delay line buffers if reset
     if(*params[par_reset])
     {
-        for (int i = 0; i < MAX_DELAY; i++) {
-            buffers[0][i] = 0.f;
-            buffers[1][i] = 0.f;
-        }
+        memset(buffers[0], 0, buffer_size * sizeof(float));
+        memset(buffers[1], 0, buffer_size * sizeof(float));
 
         feedback_buf[0] = 0;
         feedback_buf[1] = 0;
@@ -695,6 +983,9 @@ void reverse_delay_audio_module::deactivate()
 void reverse_delay_audio_module::set_sample_rate(uint32_t sr)
 {
     srate = sr;
+    buffer_size = sr * MAX_DELAY_SECONDS;
+    buffers[0] = arena.realloc(buffers[0], buffer_size);
+    buffers[1] = arena.realloc(buffers[1], buffer_size);
     fb_val.set_sample_rate(sr);
     dry.set_sample_rate(sr);
     width.set_sample_rate(sr);
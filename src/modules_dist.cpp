@@ -827,7 +827,7 @@ void vinyl_audio_module::post_instantiate(uint32_t sr)
     if((dbufsize & (dbufsize - 1)))
         dbufsize = 1 << (32 - clz(dbufsize - 1));
     dbufrange = sr / 100.0;
-    dbuf = (float*) calloc(dbufsize * channels, sizeof(float));
+    dbuf = arena.alloc<float>(dbufsize * channels);
     dbufpos = 0;
     settings = new_fluid_settings();
     fluid_settings_setnum(settings, "synth.sample-rate", sr);
@@ -856,7 +856,6 @@ void vinyl_audio_module::post_instantiate(uint32_t sr)
 }
 vinyl_audio_module::~vinyl_audio_module()
 {
-    free(dbuf);
     delete_fluid_synth(synth);
     delete_fluid_settings(settings);
 }
@@ -1360,6 +1359,13 @@ void psyclipper_audio_module::set_sample_rate(uint32_t sr)
     srate = sr;
 }
 
+uint32_t psyclipper_audio_module::get_latency()
+{
+    // a sample is fed to the clipper once a whole feed block is collected, and comes
+    // out of it 3 feeds later, to be read in the block after that
+    return clipper[0] ? 4 * clipper[0]->get_feed_size() : 0;
+}
+
 uint32_t psyclipper_audio_module::process(uint32_t offset, uint32_t numsamples, uint32_t inputs_mask, uint32_t outputs_mask)
 {
     bool bypassed = bypass.update(*params[param_bypass] > 0.5f, numsamples);
@@ -59,6 +59,7 @@ inline void undiff_ms(float &left, float &right) {
 
 template<class BaseClass, bool has_lphp>
 equalizerNband_audio_module<BaseClass, has_lphp>::equalizerNband_audio_module()
+: _analyzer(AM::arena)
 {
     is_active = false;
     srate = 0;
@@ -540,23 +541,23 @@ equalizer30band_audio_module::equalizer30band_audio_module() :
 
     fg.set30Bands();
 
-    Eq* ptr30L = new Eq(fg, butterworth);
-    Eq* ptr30R = new Eq(fg, butterworth);
+    Eq* ptr30L = new Eq(fg, butterworth, &arena);
+    Eq* ptr30R = new Eq(fg, butterworth, &arena);
     eq_arrL.push_back(ptr30L);
     eq_arrR.push_back(ptr30R);
 
-    ptr30L = new Eq(fg, chebyshev1);
-    ptr30R = new Eq(fg, chebyshev1);
+    ptr30L = new Eq(fg, chebyshev1, &arena);
+    ptr30R = new Eq(fg, chebyshev1, &arena);
     eq_arrL.push_back(ptr30L);
     eq_arrR.push_back(ptr30R);
 
-    ptr30L = new Eq(fg, chebyshev2);
-    ptr30R = new Eq(fg, chebyshev2);
+    ptr30L = new Eq(fg, chebyshev2, &arena);
+    ptr30R = new Eq(fg, chebyshev2, &arena);
     eq_arrL.push_back(ptr30L);
     eq_arrR.push_back(ptr30R);
 
-    ptr30L = new Eq(fg, elliptic);
-    ptr30R = new Eq(fg, elliptic);
+    ptr30L = new Eq(fg, elliptic, &arena);
+    ptr30R = new Eq(fg, elliptic, &arena);
     eq_arrL.push_back(ptr30L);
     eq_arrR.push_back(ptr30R);
 
@@ -961,11 +962,6 @@ xover_audio_module<XoverBaseClass>::xover_audio_module()
     crossover.init(AM::channels, AM::bands, 44100);
 }
 template<class XoverBaseClass>
-xover_audio_module<XoverBaseClass>::~xover_audio_module()
-{
-    free(buffer);
-}
-template<class XoverBaseClass>
 void xover_audio_module<XoverBaseClass>::activate()
 {
     is_active = true;
@@ -985,7 +981,7 @@ void xover_audio_module<XoverBaseClass>::set_sample_rate(uint32_t sr)
     crossover.set_sample_rate(srate);
     // rebuild buffer
     buffer_size = (int)(srate / 10 * AM::channels * AM::bands + AM::channels * AM::bands); // buffer size attack rate multiplied by channels and bands
-    buffer = (float*) calloc(buffer_size, sizeof(float));
+    buffer = AM::arena.realloc(buffer, buffer_size);
     pos = 0;
     int amount = AM::bands * AM::channels + AM::channels;
     STACKALLOC(int, meter,amount);
@@ -1100,6 +1096,7 @@ template class xover_audio_module<xover4_metadata>;
 **********************************************************************/
 
 vocoder_audio_module::vocoder_audio_module()
+: _analyzer(arena)
 {
     is_active = false;
     srate     = 0;
@@ -67,7 +67,7 @@ void limiter_audio_module::set_srates()
     if (params[param_oversampling]) {
         resampler[0].set_params(srate, *params[param_oversampling], 2);
         resampler[1].set_params(srate, *params[param_oversampling], 2);
-        limiter.set_sample_rate(srate * *params[param_oversampling]);
+        limiter.set_sample_rate(srate * *params[param_oversampling], arena);
     }
 }
 void limiter_audio_module::params_changed()
@@ -94,9 +94,18 @@ void limiter_audio_module::set_sample_rate(uint32_t sr)
     int meter[] = {param_meter_inL, param_meter_inR,  param_meter_outL, param_meter_outR, -param_att};
     int clip[] = {param_clip_inL, param_clip_inR, param_clip_outL, param_clip_outR, -1};
     meters.init(params, meter, clip, 5, srate);
+    // size the lookahead buffers for the highest oversampling here, so that changing it in
+    // params_changed (on the audio thread) only reuses them
+    limiter.set_sample_rate(srate * (int)param_props[param_oversampling].max, arena);
     set_srates();
 }
 
+uint32_t limiter_audio_module::get_latency()
+{
+    // the lookahead buffer runs at the oversampled rate
+    return (uint32_t)lrintf(limiter.get_latency() / std::max(1.f, *params[param_oversampling]));
+}
+
 uint32_t limiter_audio_module::process(uint32_t offset, uint32_t numsamples, uint32_t inputs_mask, uint32_t outputs_mask)
 {
     bool bypassed = bypass.update(*params[param_bypass] > 0.5f, numsamples);
@@ -210,10 +219,6 @@ multibandlimiter_audio_module::multibandlimiter_audio_module()
     
     crossover.init(channels, strips, 44100);
 }
-multibandlimiter_audio_module::~multibandlimiter_audio_module()
-{
-    free(buffer);
-}
 void multibandlimiter_audio_module::activate()
 {
     is_active = true;
@@ -306,24 +311,36 @@ void multibandlimiter_audio_module::params_changed()
 void multibandlimiter_audio_module::set_sample_rate(uint32_t sr)
 {
     srate = sr;
+    // allocate the buffers for the highest oversampling here, so that changing it in
+    // params_changed (on the audio thread) only reuses them
+    float over_set = over;
+    over = param_props[param_oversampling].max;
+    set_srates();
+    over = over_set;
     set_srates();
     int meter[] = {param_meter_inL, param_meter_inR,  param_meter_outL, param_meter_outR, -param_att0, -param_att1, -param_att2, -param_att3};
     int clip[] = {param_clip_inL, param_clip_inR, param_clip_outL, param_clip_outR, -1, -1, -1, -1};
     meters.init(params, meter, clip, 8, srate);
 }
 
+uint32_t multibandlimiter_audio_module::get_latency()
+{
+    // band limiters followed by the broadband limiter, at the oversampled rate
+    return (uint32_t)lrintf((strip[0].get_latency() + broadband.get_latency()) / over);
+}
+
 void multibandlimiter_audio_module::set_srates()
 {
-    broadband.set_sample_rate(srate * over);
+    broadband.set_sample_rate(srate * over, arena);
     crossover.set_sample_rate(srate);
     for (int j = 0; j < strips; j ++) {
-        strip[j].set_sample_rate(srate * over);
+        strip[j].set_sample_rate(srate * over, arena);
         resampler[j][0].set_params(srate, over, 2);
         resampler[j][1].set_params(srate, over, 2);
     }
     // rebuild buffer
     overall_buffer_size = (int)(srate * (100.f / 1000.f) * channels * over) + channels; // buffer size max attack rate
-    buffer = (float*) calloc(overall_buffer_size, sizeof(float));
+    buffer = arena.realloc(buffer, overall_buffer_size);
     pos = 0;
 }
 
@@ -605,10 +622,6 @@ sidechainlimiter_audio_module::sidechainlimiter_audio_module()
     
     crossover.init(channels, strips - 1, 44100);
 }
-sidechainlimiter_audio_module::~sidechainlimiter_audio_module()
-{
-    free(buffer);
-}
 void sidechainlimiter_audio_module::activate()
 {
     is_active = true;
@@ -704,24 +717,36 @@ void sidechainlimiter_audio_module::params_changed()
 void sidechainlimiter_audio_module::set_sample_rate(uint32_t sr)
 {
     srate = sr;
+    // allocate the buffers for the highest oversampling here, so that changing it in
+    // params_changed (on the audio thread) only reuses them
+    float over_set = over;
+    over = param_props[param_oversampling].max;
+    set_srates();
+    over = over_set;
     set_srates();
     int meter[] = {param_meter_inL, param_meter_inR, param_meter_scL, param_meter_scR, param_meter_outL, param_meter_outR, -param_att0, -param_att1, -param_att2, -param_att3, -param_att_sc};
     int clip[] = {param_clip_inL, param_clip_inR, -1, -1, param_clip_outL, param_clip_outR, -1, -1, -1, -1, -1};
     meters.init(params, meter, clip, 8, srate);
 }
 
+uint32_t sidechainlimiter_audio_module::get_latency()
+{
+    // band limiters followed by the broadband limiter, at the oversampled rate
+    return (uint32_t)lrintf((strip[0].get_latency() + broadband.get_latency()) / over);
+}
+
 void sidechainlimiter_audio_module::set_srates()
 {
-    broadband.set_sample_rate(srate * over);
+    broadband.set_sample_rate(srate * over, arena);
     crossover.set_sample_rate(srate);
     for (int j = 0; j < strips; j ++) {
-        strip[j].set_sample_rate(srate * over);
+        strip[j].set_sample_rate(srate * over, arena);
         resampler[j][0].set_params(srate, over, 2);
         resampler[j][1].set_params(srate, over, 2);
     }
     // rebuild buffer
     overall_buffer_size = (int)(srate * (100.f / 1000.f) * channels * over) + channels; // buffer size max attack rate
-    buffer = (float*) calloc(overall_buffer_size, sizeof(float));
+    buffer = arena.realloc(buffer, overall_buffer_size);
     pos = 0;
 }
 
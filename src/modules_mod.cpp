@@ -237,6 +237,7 @@ rotary_speaker_audio_module::rotary_speaker_audio_module()
     aspeed_l = 1.f;
     aspeed_h = 1.f;
     dspeed = 0.f;
+    coeffs.depends_on(coeff_damper, par_test);
 }    
 
 void rotary_speaker_audio_module::set_sample_rate(uint32_t sr)
@@ -251,9 +252,11 @@ void rotary_speaker_audio_module::set_sample_rate(uint32_t sr)
 void rotary_speaker_audio_module::setup()
 {
     crossover1l.set_lp_rbj(800.f, 0.7, (float)srate);
-    crossover1r.set_lp_rbj(800.f, 0.7, (float)srate);
-    crossover2l.set_hp_rbj(800.f, 0.7, (float)srate);
-    crossover2r.set_hp_rbj(800.f, 0.7, (float)srate);
+    crossover1r.copy_coeffs(crossover1l);
+    // the treble path uses a band pass instead of the original 800 Hz high pass
+    crossover2l.set_bp_rbj(2000.f, 0.7, (float)srate);
+    crossover2r.copy_coeffs(crossover2l);
+    coeffs.invalidate_group(coeff_damper);
 }
 
 void rotary_speaker_audio_module::activate()
@@ -285,7 +288,19 @@ void rotary_speaker_audio_module::control_change(int /*channel*/, int ctl, int v
 
 void rotary_speaker_audio_module::params_changed()
 {
-    set_vibrato();
+    params_changed(param_mask::all());
+}
+
+void rotary_speaker_audio_module::params_changed(const param_mask &dirty)
+{
+    coeffs.invalidate(dirty);
+    if (coeffs.update(coeff_damper))
+    {
+        damper1l.set_bp_rbj(1000.f*pow(4.0, *params[par_test]), 0.7, (float)srate);
+        damper1r.copy_coeffs(damper1l);
+    }
+    if (dirty.test(par_speed))
+        set_vibrato();
 }
 
 void rotary_speaker_audio_module::set_vibrato()
@@ -366,18 +381,6 @@ uint32_t rotary_speaker_audio_module::process(uint32_t offset, uint32_t nsamples
             meters.process(values);
         }
     } else {
-        if (true)
-        {
-            crossover2l.set_bp_rbj(2000.f, 0.7, (float)srate);
-            crossover2r.copy_coeffs(crossover2l);
-            damper1l.set_bp_rbj(1000.f*pow(4.0, *params[par_test]), 0.7, (float)srate);
-            damper1r.copy_coeffs(damper1l);
-        }
-        else
-        {
-            crossover2l.set_hp_rbj(800.f, 0.7, (float)srate);
-            crossover2r.copy_coeffs(crossover2l);
-        }
         int shift = (int)(300000 * (*params[par_shift])), pdelta = (int)(300000 * (*params[par_spacing]));
         int md = (int)(100 * (*params[par_moddepth]));
         float mix = 0.5 * (1.0 - *params[par_micdistance]);
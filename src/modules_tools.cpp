@@ -21,6 +21,7 @@
 #include <limits.h>
 #include <memory.h>
 #include <math.h>
+#include <calf/fastmath.h>
 #include <calf/giface.h>
 #include <calf/modules_tools.h>
 #include <calf/modules_dev.h>
@@ -51,9 +52,6 @@ stereo_audio_module::stereo_audio_module() {
     _phase      = -1;
     buffer = NULL;
 }
-stereo_audio_module::~stereo_audio_module() {
-    free(buffer);
-}
 void stereo_audio_module::activate() {
     active = true;
 }
@@ -77,6 +75,15 @@ void stereo_audio_module::params_changed() {
 uint32_t stereo_audio_module::process(uint32_t offset, uint32_t numsamples, uint32_t inputs_mask, uint32_t outputs_mask) {
     bool bypassed = bypass.update(*params[param_bypass] > 0.5f, numsamples);
     uint32_t orig_offset = offset;
+    // softclip the whole block at once: the input gains don't depend on the sample
+    bool softclip = !bypassed && *params[param_softclip];
+    float clipped[2][MAX_SAMPLE_RUN];
+    if (softclip) {
+        float gain_l = *params[param_level_in] * (1.f - std::max(0.f, *params[param_balance_in])) * _sc_level;
+        float gain_r = *params[param_level_in] * (1.f + std::min(0.f, *params[param_balance_in])) * _sc_level;
+        dsp::fastmath::math_block<dsp::fastmath::atan_op>(clipped[0], ins[0] + offset, numsamples, gain_l);
+        dsp::fastmath::math_block<dsp::fastmath::atan_op>(clipped[1], ins[1] + offset, numsamples, gain_r);
+    }
     for(uint32_t i = offset; i < offset + numsamples; i++) {
         if(bypassed) {
             outs[0][i] = ins[0][i];
@@ -103,9 +110,9 @@ uint32_t stereo_audio_module::process(uint32_t offset, uint32_t numsamples, uint
             R *= (1.f + std::min(0.f, *params[param_balance_in]));
             
             // softclip
-            if(*params[param_softclip]) {
-                R = _inv_atan_shape * atan(R * _sc_level);
-                L = _inv_atan_shape * atan(L * _sc_level);
+            if(softclip) {
+                R = _inv_atan_shape * clipped[1][i - orig_offset];
+                L = _inv_atan_shape * clipped[0][i - orig_offset];
             }
             
             // GUI stuff
@@ -247,7 +254,7 @@ void stereo_audio_module::set_sample_rate(uint32_t sr)
     srate = sr;
     // rebuild buffer
     buffer_size = (int)(srate * 0.05 * 2.f); // buffer size attack rate multiplied by 2 channels
-    buffer = (float*) calloc(buffer_size, sizeof(float));
+    buffer = arena.realloc(buffer, buffer_size);
     pos = 0;
     int meter[] = {param_meter_inL, param_meter_inR,  param_meter_outL, param_meter_outR};
     int clip[] = {param_clip_inL, param_clip_inR, param_clip_outL, param_clip_outR};
@@ -267,9 +274,6 @@ mono_audio_module::mono_audio_module() {
     _sc_level   = 0.f;
     buffer = NULL;
 }
-mono_audio_module::~mono_audio_module() {
-    free(buffer);
-}
 void mono_audio_module::activate() {
     active = true;
 }
@@ -293,6 +297,13 @@ void mono_audio_module::params_changed() {
 uint32_t mono_audio_module::process(uint32_t offset, uint32_t numsamples, uint32_t inputs_mask, uint32_t outputs_mask) {
     bool bypassed = bypass.update(*params[param_bypass] > 0.5f, numsamples);
     uint32_t orig_offset = offset;
+    // softclip the whole block at once, as in stereo_audio_module
+    bool softclip = !bypassed && *params[param_softclip];
+    float clipped[MAX_SAMPLE_RUN];
+    if (softclip) {
+        float gain = *params[param_level_in] * _sc_level;
+        dsp::fastmath::math_block<dsp::fastmath::atan_op>(clipped, ins[0] + offset, numsamples, gain);
+    }
     for(uint32_t i = offset; i < offset + numsamples; i++) {
         if(bypassed) {
             outs[0][i] = ins[0][i];
@@ -311,10 +322,10 @@ uint32_t mono_audio_module::process(uint32_t offset, uint32_t numsamples, uint32
             L *= *params[param_level_in];
             
             // softclip
-            if(*params[param_softclip]) {
+            if(softclip) {
                 //int ph = L / fabs(L);
                 //L = L > 0.63 ? ph * (0.63 + 0.36 * (1 - pow(MATH_E, (1.f / 3) * (0.63 + L * ph)))) : L;
-                L = _inv_atan_shape * atan(L * _sc_level);
+                L = _inv_atan_shape * clipped[i - orig_offset];
             }
             
             // GUI stuff
@@ -390,7 +401,7 @@ void mono_audio_module::set_sample_rate(uint32_t sr)
     srate = sr;
     // rebuild buffer
     buffer_size = (int)srate * 0.05 * 2; // delay buffer size multiplied by 2 channels
-    buffer = (float*) calloc(buffer_size, sizeof(float));
+    buffer = arena.realloc(buffer, buffer_size);
     pos = 0;
     int meter[] = {param_meter_in,  param_meter_outL, param_meter_outR};
     int clip[] = {param_clip_in, param_clip_outL, param_clip_outR};
@@ -401,7 +412,9 @@ void mono_audio_module::set_sample_rate(uint32_t sr)
  * ANALYZER by Markus Schmidt and Christian Holschuh
 **********************************************************************/
 
-analyzer_audio_module::analyzer_audio_module() {
+analyzer_audio_module::analyzer_audio_module()
+: _analyzer(arena)
+{
 
     active          = false;
     clip_L          = 0.f;
@@ -411,10 +424,7 @@ analyzer_audio_module::analyzer_audio_module() {
     envelope        = 0.f;
     ppos            = 0;
     plength         = 0;
-    phase_buffer = (float*) calloc(max_phase_buffer_size, sizeof(float));
-}
-analyzer_audio_module::~analyzer_audio_module() {
-    free(phase_buffer);
+    phase_buffer = arena.alloc<float>(max_phase_buffer_size);
 }
 void analyzer_audio_module::activate() {
     active = true;
@@ -580,16 +590,11 @@ multibandenhancer_audio_module::multibandenhancer_audio_module()
     ppos                = 0;
     plength             = 0;
     for (int i = 0; i < strips; i++) {
-        phase_buffer[i] = (float*) calloc(max_phase_buffer_size, sizeof(float));
+        phase_buffer[i] = arena.alloc<float>(max_phase_buffer_size);
         envelope[i] = 0;
     }
     crossover.init(channels, strips, 44100);
 }
-multibandenhancer_audio_module::~multibandenhancer_audio_module()
-{
-    for (int i = 0; i < strips; i++)
-      free(phase_buffer[i]);
-}
 void multibandenhancer_audio_module::activate()
 {
     is_active = true;
@@ -799,13 +804,9 @@ multispread_audio_module::multispread_audio_module()
     fcoeff              = log10(20.f);
     ppos                = 0;
     plength             = 0;
-    phase_buffer        = (float*) calloc(max_phase_buffer_size, sizeof(float));
+    phase_buffer        = arena.alloc<float>(max_phase_buffer_size);
     envelope            = 0;
 }
-multispread_audio_module::~multispread_audio_module()
-{
-    free(phase_buffer);
-}
 void multispread_audio_module::activate()
 {
     is_active = true;
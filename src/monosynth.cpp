@@ -20,6 +20,8 @@
  */
 #include <calf/giface.h>
 #include <calf/modules_synths.h>
+#include <calf/utils.h>
+#include <atomic>
 
 using namespace dsp;
 using namespace calf_plugins;
@@ -35,6 +37,8 @@ monosynth_audio_module::monosynth_audio_module()
 , inertia_pitchbend(1)
 , inertia_pressure(64)
 {
+    // the controllers are only read once per step
+    event_granularity = step_size;
 }
 
 void monosynth_audio_module::reset()
@@ -76,16 +80,22 @@ void monosynth_audio_module::activate()
 
 waveform_family<MONOSYNTH_WAVE_BITS> *monosynth_audio_module::waves;
 
+static std::atomic<bool> waves_inited(false);
+static calf_utils::ptmutex waves_mutex;
+
 void monosynth_audio_module::precalculate_waves(progress_report_iface *reporter)
 {
-    float data[1 << MONOSYNTH_WAVE_BITS];
-    bandlimiter<MONOSYNTH_WAVE_BITS> bl;
-    
-    if (waves)
+    if (waves_inited.load(std::memory_order_acquire))
+        return;
+    // plugins may be instantiated on several threads at once, and the tables are shared
+    calf_utils::ptlock lock(waves_mutex);
+    if (waves_inited.load(std::memory_order_relaxed))
         return;
     
+    float data[1 << MONOSYNTH_WAVE_BITS];
+    bandlimiter<MONOSYNTH_WAVE_BITS> bl;
     static waveform_family<MONOSYNTH_WAVE_BITS> waves_data[wave_count];
-    waves = waves_data;
+    waveform_family<MONOSYNTH_WAVE_BITS> *waves = waves_data;
     
     enum { S = 1 << MONOSYNTH_WAVE_BITS, HS = S / 2, QS = S / 4, QS3 = 3 * QS };
     float iQS = 1.0 / QS;
@@ -201,6 +211,9 @@ void monosynth_audio_module::precalculate_waves(progress_report_iface *reporter)
     }
     normalize_waveform(data, S);
     waves[wave_test8].make(bl, data);
+    // only publish the tables once they are complete
+    monosynth_audio_module::waves = waves_data;
+    waves_inited.store(true, std::memory_order_release);
     if (reporter)
         reporter->report_progress(100, "");
     
@@ -307,16 +320,39 @@ void monosynth_audio_module::calculate_buffer_oscs(float lfo1)
     static const int muls[8] = { 33, -47, 53, -67, 87, -101, 121, -139 };
     float unison = *params[par_o2unison] + moddest[moddest_o2unisonamp] * 0.01;
     float unison_scale = 1.0, unison_delta = 0.0, last_unison_scale = 1.0, unison_scale_delta = 0.0;
-    if (unison > 0)
+    bool use_unison = unison > 0 || last_unison > 0;
+    bool stereo = is_stereo_filter();
+    // sum of the unison voices (left and right when using stereo filters)
+    float unison_buf[step_size], unison_buf2[step_size];
+    if (use_unison)
     {
+        int voices = dsp::clip<int>(*params[par_o2unisonvoices], 1, unison_bank.MaxVoices);
+        // normalised for 8 voices, as before the voice count was adjustable
+        float voice_scale = 2 * sqrt(voices / 8.0);
         float freq = fabs(*params[par_o2unisonfrq] / muls[7]);
         if (moddest[moddest_o2unisondetune] != 0)
             freq *= pow(2.0, moddest[moddest_o2unisondetune]);
         unison_osc.set_freq(freq, srate);
-        last_unison_scale = 1.0 / (1.0 + 2 * last_unison);
-        unison_scale = 1.0 / (1.0 + 2 * unison);
+        last_unison_scale = 1.0 / (1.0 + voice_scale * last_unison);
+        unison_scale = 1.0 / (1.0 + voice_scale * unison);
         unison_delta = (unison - last_unison) * (1.0 / step_size);
         unison_scale_delta = (unison_scale - last_unison_scale) * (1.0 / step_size);
+        
+        // the voices are detuned in opposite directions, and panned accordingly
+        float spread = *params[par_o2unisonspread];
+        unison_bank.voices = voices;
+        for (int j = 0; j < voices; j++)
+        {
+            float pan = muls[j] > 0 ? spread : -spread;
+            unison_bank.phase[j] = osc2.phase + unison_osc.phase * muls[j];
+            unison_bank.phasedelta[j] = osc2.phasedelta + unison_osc.phasedelta * muls[j];
+            unison_bank.gain_left[j] = 1 - pan;
+            unison_bank.gain_right[j] = 1 + pan;
+        }
+        dsp::zero(unison_buf, step_size);
+        dsp::zero(unison_buf2, step_size);
+        unison_bank.render(osc2.waveform, unison_buf, stereo ? unison_buf2 : NULL, step_size, shift2, shift_delta2, mix2);
+        unison_osc.phase += unison_osc.phasedelta * step_size;
     }
     for (uint32_t i = 0; i < step_size; i++) 
     {
@@ -329,18 +365,17 @@ void monosynth_audio_module::calculate_buffer_oscs(float lfo1)
             o1phase = 0;
         float r = 1.0 - o1phase * o1phase;
         float osc1val = osc1.get_phasedist(stretch1, shift1, mix1);
-        float osc2val = osc2.get_phaseshifted(shift2, mix2);
-        if (unison > 0 || last_unison > 0)
+        float osc2val = osc2.get_phaseshifted(shift2, mix2), osc2val2 = osc2val;
+        if (use_unison)
         {
-            for (int j = 0; j < 8; j++)
-                osc2val += last_unison * osc2.get_phaseshifted2(shift2, unison_osc.phase * muls[j], mix2);
-            osc2val *= last_unison_scale;
-
-            unison_osc.step();
+            osc2val2 = (osc2val + last_unison * unison_buf2[i]) * last_unison_scale;
+            osc2val = (osc2val + last_unison * unison_buf[i]) * last_unison_scale;
             last_unison += unison_delta;
             last_unison_scale += unison_scale_delta;
         }
         buffer[i] = lerp(r * osc1val, osc2val, cur_xfade);
+        if (stereo)
+            buffer2[i] = lerp(r * osc1val, osc2val2, cur_xfade);
         osc1.advance();
         osc2.advance();
         shift1 += shift_delta1;
@@ -385,8 +420,9 @@ void monosynth_audio_module::calculate_buffer_stereo()
     for (uint32_t i = 0; i < step_size; i++) 
     {
         float wave1 = buffer[i] * fgain;
+        float wave2 = buffer2[i] * fgain;
         buffer[i] = fgain * filter.process(wave1);
-        buffer2[i] = fgain * filter2.process(wave1);
+        buffer2[i] = fgain * filter2.process(wave2);
         fgain += fgain_delta;
     }
 }
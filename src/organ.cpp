@@ -22,8 +22,13 @@
 
 #include <calf/giface.h>
 #include <calf/organ.h>
+#include <calf/utils.h>
+#include <atomic>
 #include <iostream>
 #include <algorithm>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 using namespace std;
 using namespace dsp;
@@ -37,6 +42,10 @@ organ_audio_module::organ_audio_module()
 : drawbar_organ(&par_values)
 {
     var_map_curve = "2\n0 1\n1 1\n"; // XXXKF hacky bugfix
+    waves_ready = false;
+    waves_requested = false;
+    // voices pick up controller changes once per block (of 64 samples)
+    event_granularity = 64;
 }
 
 void organ_audio_module::activate()
@@ -47,13 +56,36 @@ void organ_audio_module::activate()
 
 void organ_audio_module::post_instantiate(uint32_t)
 {
+    // with a worker thread, the waves are calculated there (requested on the first process call),
+    // so that instantiating doesn't block the host
+    if (worker && !organ_voice_base::waves_precalculated())
+        return;
     dsp::organ_voice_base::precalculate_waves(progress_report);
+    waves_ready = true;
+}
+
+void organ_audio_module::work(uint32_t size, const void *data, worker_response_iface *response)
+{
+    organ_voice_base::precalculate_waves(NULL);
 }
 
 
 uint32_t organ_audio_module::process(uint32_t offset, uint32_t nsamples, uint32_t inputs_mask, uint32_t outputs_mask)
 {
     float *o[2] = { outs[0] + offset, outs[1] + offset };
+    if (!waves_ready)
+    {
+        // the waves are published by the worker thread setting a flag, so picking them up costs nothing
+        waves_ready = organ_voice_base::waves_precalculated();
+        if (!waves_ready)
+        {
+            // wave calculation is the only job there is, so the message carries no information
+            int job = 0;
+            if (!waves_requested)
+                waves_requested = worker->schedule_work(sizeof(job), &job);
+            return 0;
+        }
+    }
     if (panic_flag)
     {
         control_change(120, 0); // stop all sounds
@@ -77,15 +109,18 @@ void organ_audio_module::params_changed() {
 }
 bool organ_audio_module::get_layers(int index, int generation, unsigned int &layers) const
 {
+    // nothing to draw until the worker has calculated the waves
+    if (!organ_voice_base::waves_precalculated())
+        return false;
     layers = LG_REALTIME_GRAPH;
     return true;
 }
 bool organ_audio_module::get_graph(int index, int subindex, int phase, float *data, int points, cairo_iface *context, int *mode) const
 {
-    if (index != par_master || subindex || !phase)
+    // may be called on the audio thread, so never calculate the waves here
+    if (index != par_master || subindex || !phase || !organ_voice_base::waves_precalculated())
         return false;
     
-    organ_voice_base::precalculate_waves(progress_report);
     float *waveforms[9];
     int S[9], S2[9];
     enum { small_waves = organ_voice_base::wave_count_small};
@@ -250,10 +285,21 @@ void organ_voice_base::update_pitch()
     moddphase.set((long int) (phase * parameters->percussion_fm_harmonic * parameters->pitch_bend));
 }
 
+static std::atomic<bool> waves_inited(false);
+static calf_utils::ptmutex waves_mutex;
+
+bool organ_voice_base::waves_precalculated()
+{
+    return waves_inited.load(std::memory_order_acquire);
+}
+
 void organ_voice_base::precalculate_waves(progress_report_iface *reporter)
 {
-    static bool inited = false;
-    if (!inited)
+    if (waves_precalculated())
+        return;
+    // may be called from the worker thread and the GUI thread at the same time
+    calf_utils::ptlock lock(waves_mutex);
+    if (!waves_precalculated())
     {
         static organ_voice_base::small_wave_family waves[organ_voice_base::wave_count_small];
         static organ_voice_base::big_wave_family big_waves[organ_voice_base::wave_count_big];
@@ -501,7 +547,7 @@ void organ_voice_base::precalculate_waves(progress_report_iface *reporter)
         padsynth(bl, blBig, big_waves[wave_choir3 - wave_count_small], 50, 10);
         LARGE_WAVEFORM_PROGRESS();
         
-        inited = true;
+        waves_inited.store(true, std::memory_order_release);
     }
 }
 
@@ -625,6 +671,13 @@ void scanner_vibrato::reset()
     lfo_phase = 0.f;
 }
 
+/// Line box outputs picked by the scanner, for each vibrato type
+static const int scanner_v1[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 8, 8 };
+static const int scanner_v2[] = { 0, 1, 2, 4, 6, 8, 9, 10, 12 };
+static const int scanner_v3[] = { 0, 1, 3, 6, 11, 12, 15, 17, 18, 18, 18 };
+static const int scanner_vfull[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 18 };
+static const int *scanner_taps[] = { NULL, scanner_v1, scanner_v2, scanner_v3, scanner_vfull };
+
 void scanner_vibrato::process(organ_parameters *parameters, float (*data)[2], unsigned int len, float sample_rate)
 {
     if (!len)
@@ -651,12 +704,7 @@ void scanner_vibrato::process(organ_parameters *parameters, float (*data)[2], un
         lfo_phase2 -= 1.0;
     float vib_wet = parameters->lfo_wet;
     float dphase = parameters->lfo_rate / sample_rate;
-    static const int v1[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 8, 8 };
-    static const int v2[] = { 0, 1, 2, 4, 6, 8, 9, 10, 12 };
-    static const int v3[] = { 0, 1, 3, 6, 11, 12, 15, 17, 18, 18, 18 };
-    static const int vfull[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 18 };
-    static const int *vtypes[] = { NULL, v1, v2, v3, vfull };
-    const int *vib = vtypes[vtype];
+    const int *vib = scanner_taps[vtype];
     
     float vibamt = 8 * parameters->lfo_amt;
     if (vtype == organ_enums::lfotype_cvfull)
@@ -696,6 +744,133 @@ void scanner_vibrato::process(organ_parameters *parameters, float (*data)[2], un
         scanner[t].sanitize();
     }
 }
+void scanner_vibrato::process_voices(scanner_vibrato *const *vibratos, float (*const *data)[2], int count, organ_parameters *parameters, unsigned int len, float sample_rate)
+{
+    if (!len)
+        return;
+    
+    int vtype = (int)parameters->lfo_type;
+    if (!vtype || vtype > organ_enums::lfotype_cvfull)
+    {
+        for (int v = 0; v < count; v++)
+            vibratos[v]->legacy.process(parameters, data[v], len, sample_rate);
+        return;
+    }
+    
+    // same line box as in process(), but in single precision, and with the loss compensation
+    // factor included in the coefficients
+    dsp::biquad_coeffs lp[2];
+    lp[0].set_lp_rbj(4000, 0.707, sample_rate);
+    lp[1].set_lp_rbj(4200, 0.707, sample_rate);
+    float a0[2], a1[2], a2[2], b1[2], b2[2];
+    for (int c = 0; c < 2; c++)
+    {
+        a0[c] = lp[c].a0 * 1.03, a1[c] = lp[c].a1 * 1.03, a2[c] = lp[c].a2 * 1.03;
+        b1[c] = lp[c].b1, b2[c] = lp[c].b2;
+    }
+    
+    float phase_offset = parameters->lfo_phase * (1.0 / 360.0);
+    float vib_wet = parameters->lfo_wet;
+    float dphase = parameters->lfo_rate / sample_rate;
+    const int *vib = scanner_taps[vtype];
+    
+    float vibamt = 8 * parameters->lfo_amt;
+    if (vtype == organ_enums::lfotype_cvfull)
+        vibamt = 17 * parameters->lfo_amt;
+    for (int first = 0; first < count; first += Lanes)
+    {
+        int n = std::min<int>(Lanes, count - first);
+        scanner_vibrato *const *vibs = vibratos + first;
+        float (*const *bufs)[2] = data + first;
+        // filter states, [stage][voice]; the unused lanes process silence
+        float w1[ScannerSize][Lanes] __attribute__((aligned(16)));
+        float w2[ScannerSize][Lanes] __attribute__((aligned(16)));
+        float lfo_phase1[Lanes], lfo_phase2[Lanes];
+        for (int t = 0; t < ScannerSize; t++)
+        {
+            for (int l = 0; l < Lanes; l++)
+            {
+                w1[t][l] = l < n ? vibs[l]->scanner[t].w1 : 0.f;
+                w2[t][l] = l < n ? vibs[l]->scanner[t].w2 : 0.f;
+            }
+        }
+        for (int l = 0; l < n; l++)
+        {
+            lfo_phase1[l] = vibs[l]->lfo_phase;
+            lfo_phase2[l] = lfo_phase1[l] + phase_offset;
+            if (lfo_phase2[l] >= 1.0)
+                lfo_phase2[l] -= 1.0;
+        }
+        for (unsigned int i = 0; i < len; i++)
+        {
+            float line[ScannerSize + 1][Lanes] __attribute__((aligned(16)));
+            for (int l = 0; l < Lanes; l++)
+                line[0][l] = l < n ? (bufs[l][i][0] + bufs[l][i][1]) * 0.5f : 0.f;
+            
+#if defined(__SSE2__)
+            __m128 x = _mm_load_ps(line[0]);
+            for (int t = 0; t < ScannerSize; t++)
+            {
+                int c = t & 1;
+                __m128 s1 = _mm_load_ps(w1[t]), s2 = _mm_load_ps(w2[t]);
+                __m128 tmp = _mm_sub_ps(x, _mm_add_ps(_mm_mul_ps(s1, _mm_set1_ps(b1[c])), _mm_mul_ps(s2, _mm_set1_ps(b2[c]))));
+                x = _mm_add_ps(_mm_mul_ps(tmp, _mm_set1_ps(a0[c])), _mm_add_ps(_mm_mul_ps(s1, _mm_set1_ps(a1[c])), _mm_mul_ps(s2, _mm_set1_ps(a2[c]))));
+                _mm_store_ps(w2[t], s1);
+                _mm_store_ps(w1[t], tmp);
+                _mm_store_ps(line[t + 1], x);
+            }
+#else
+            for (int t = 0; t < ScannerSize; t++)
+            {
+                int c = t & 1;
+                for (int l = 0; l < Lanes; l++)
+                {
+                    float tmp = line[t][l] - w1[t][l] * b1[c] - w2[t][l] * b2[c];
+                    line[t + 1][l] = tmp * a0[c] + w1[t][l] * a1[c] + w2[t][l] * a2[c];
+                    w2[t][l] = w1[t][l];
+                    w1[t][l] = tmp;
+                }
+            }
+#endif
+            
+            for (int l = 0; l < n; l++)
+            {
+                float lfo1 = lfo_phase1[l] < 0.5 ? 2 * lfo_phase1[l] : 2 - 2 * lfo_phase1[l];
+                float lfo2 = lfo_phase2[l] < 0.5 ? 2 * lfo_phase2[l] : 2 - 2 * lfo_phase2[l];
+                
+                float pos = vibamt * lfo1;
+                int ipos = (int)pos;
+                float vl = lerp(line[vib[ipos]][l], line[vib[ipos + 1]][l], pos - ipos);
+                
+                pos = vibamt * lfo2;
+                ipos = (int)pos;
+                float vr = lerp(line[vib[ipos]][l], line[vib[ipos + 1]][l], pos - ipos);
+                
+                lfo_phase1[l] += dphase;
+                if (lfo_phase1[l] >= 1.0)
+                    lfo_phase1[l] -= 1.0;
+                lfo_phase2[l] += dphase;
+                if (lfo_phase2[l] >= 1.0)
+                    lfo_phase2[l] -= 1.0;
+                
+                float v0 = line[0][l];
+                bufs[l][i][0] += (vl - v0) * vib_wet;
+                bufs[l][i][1] += (vr - v0) * vib_wet;
+            }
+        }
+        for (int l = 0; l < n; l++)
+        {
+            for (int t = 0; t < ScannerSize; t++)
+            {
+                vibs[l]->scanner[t].w1 = w1[t][l];
+                vibs[l]->scanner[t].w2 = w2[t][l];
+                vibs[l]->scanner[t].sanitize();
+            }
+            vibs[l]->lfo_phase = lfo_phase1[l];
+        }
+    }
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void organ_voice::update_pitch()
@@ -705,8 +880,16 @@ void organ_voice::update_pitch()
 }
 
 void organ_voice::render_block(int snapshot) {
-    if (note == -1)
+    if (!render_block_pre_vibrato(snapshot))
         return;
+    if (fastf2i_drm(parameters->lfo_mode) == lfomode_voice)
+        vibrato.process(parameters, output_buffer, BlockSize, sample_rate);
+    render_block_post_vibrato();
+}
+
+bool organ_voice::render_block_pre_vibrato(int snapshot) {
+    if (note == -1)
+        return false;
 
     dsp::zero(&output_buffer[0][0], Channels * BlockSize);
     dsp::zero(&aux_buffers[1][0][0], 2 * Channels * BlockSize);
@@ -714,7 +897,7 @@ void organ_voice::render_block(int snapshot) {
     {
         if (use_percussion())
             render_percussion_to(output_buffer, BlockSize);
-        return;
+        return false;
     }
 
     inertia_pitchbend.set_inertia(parameters->pitch_bend);
@@ -748,11 +931,11 @@ void organ_voice::render_block(int snapshot) {
             float ampr = amp * 0.5f * (1 + parameters->pan[h]);
             float (*out)[Channels] = aux_buffers[dsp::fastf2i_drm(parameters->routing[h])];
             
+            float wv[BlockSize];
+            big_wave_block(data, tphase.get(), tdphase.get(), wv, BlockSize);
             for (int i=0; i < (int)BlockSize; i++) {
-                float wv = big_wave(data, tphase);
-                out[i][0] += wv * ampl;
-                out[i][1] += wv * ampr;
-                tphase += tdphase;
+                out[i][0] += wv[i] * ampl;
+                out[i][1] += wv[i] * ampr;
             }
         }
         else
@@ -773,11 +956,11 @@ void organ_voice::render_block(int snapshot) {
             float ampr = amp * 0.5f * (1 + parameters->pan[h]);
             float (*out)[Channels] = aux_buffers[dsp::fastf2i_drm(parameters->routing[h])];
             
+            float wv[BlockSize];
+            wave_block(data, tphase.get(), tdphase.get(), wv, BlockSize);
             for (int i=0; i < (int)BlockSize; i++) {
-                float wv = wave(data, tphase);
-                out[i][0] += wv * ampl;
-                out[i][1] += wv * ampr;
-                tphase += tdphase;
+                out[i][0] += wv[i] * ampl;
+                out[i][1] += wv[i] * ampr;
             }
         }
     }
@@ -865,9 +1048,11 @@ void organ_voice::render_block(int snapshot) {
     filterR[0].sanitize();
     filterL[1].sanitize();
     filterR[1].sanitize();
-    if (vibrato_mode == lfomode_voice)
-        vibrato.process(parameters, output_buffer, BlockSize, sample_rate);
+    return true;
+}
 
+void organ_voice::render_block_post_vibrato()
+{
     if (finishing)
     {
         for (int i = 0; i < (int) BlockSize; i++) {
@@ -950,11 +1135,9 @@ void drawbar_organ::update_params()
     parameters->foldvalue = (int)(dphase);
 }
 
-dsp::voice *drawbar_organ::alloc_voice()
+void drawbar_organ::init_voice(organ_block_voice *v)
 {
-    block_voice<organ_voice> *v = new block_voice<organ_voice>();
     v->parameters = parameters;
-    return v;
 }
 
 void drawbar_organ::percussion_note_on(int note, int vel)
@@ -1077,11 +1260,86 @@ void organ_audio_module::deactivate()
     
 }
 
+void drawbar_organ::render_voices(float (*output)[2], int nsamples)
+{
+    enum { BlockSize = organ_block_voice::BlockSize, MaxVoices = 64 };
+    if (dsp::fastf2i_drm(parameters->lfo_mode) != organ_voice_base::lfomode_voice || (int)active_voices.size() > MaxVoices)
+    {
+        pooled_synth::render_to(output, nsamples);
+        return;
+    }
+    // Same as block_voice::render_to for each voice, but done in rounds - in each round, every voice
+    // renders at most one block, and the vibratos of all the voices that did are processed together
+    organ_block_voice *voices[MaxVoices];
+    int pos[MaxVoices], snapshot[MaxVoices];
+    scanner_vibrato *vibratos[MaxVoices];
+    float (*buffers[MaxVoices])[2];
+    organ_block_voice *rendered[MaxVoices];
+    int count = 0;
+    for (dsp::voice **i = active_voices.begin(); i != active_voices.end(); i++)
+    {
+        voices[count] = static_cast<organ_block_voice *>(*i);
+        pos[count] = snapshot[count] = 0;
+        count++;
+    }
+    bool more = true;
+    while(more)
+    {
+        int nrendered = 0;
+        for (int v = 0; v < count; v++)
+        {
+            organ_block_voice *voice = voices[v];
+            if (pos[v] >= nsamples || voice->read_ptr < (unsigned int)BlockSize)
+                continue;
+            if (voice->render_block_pre_vibrato(snapshot[v]))
+            {
+                rendered[nrendered] = voice;
+                vibratos[nrendered] = &voice->get_vibrato();
+                buffers[nrendered++] = voice->get_output_buffer();
+            }
+            snapshot[v]++;
+            voice->read_ptr = 0;
+        }
+        if (nrendered)
+            scanner_vibrato::process_voices(vibratos, buffers, nrendered, parameters, BlockSize, sample_rate);
+        for (int v = 0; v < nrendered; v++)
+            rendered[v]->render_block_post_vibrato();
+        more = false;
+        for (int v = 0; v < count; v++)
+        {
+            organ_block_voice *voice = voices[v];
+            if (pos[v] >= nsamples)
+                continue;
+            int ncopy = std::min<int>(BlockSize - voice->read_ptr, nsamples - pos[v]);
+            float (*src)[2] = voice->get_output_buffer() + voice->read_ptr;
+            for (int i = 0; i < ncopy; i++)
+            {
+                output[pos[v] + i][0] += src[i][0];
+                output[pos[v] + i][1] += src[i][1];
+            }
+            pos[v] += ncopy;
+            voice->read_ptr += ncopy;
+            if (pos[v] < nsamples)
+                more = true;
+        }
+    }
+    // eliminate the voices that aren't sounding anymore
+    for (dsp::voice **i = active_voices.begin(); i != active_voices.end(); ) {
+        organ_block_voice *v = static_cast<organ_block_voice *>(*i);
+        if (!v->organ_block_voice::get_active()) {
+            i = release_voice(i);
+            continue;
+        }
+        update_steal_class(v, v->organ_block_voice::get_priority());
+        i++;
+    }
+}
+
 void drawbar_organ::render_separate(float *output[], int nsamples)
 {
     float buf[MAX_SAMPLE_RUN][2];
     dsp::zero(&buf[0][0], 2 * nsamples);
-    basic_synth::render_to(buf, nsamples);
+    render_voices(buf, nsamples);
     if (dsp::fastf2i_drm(parameters->lfo_mode) == organ_voice_base::lfomode_global)
     {
         for (int i = 0; i < nsamples; i += 64)
@@ -48,6 +48,7 @@ using namespace calf_plugins;
 template<class Module> LV2_Descriptor calf_plugins::lv2_wrapper<Module>::descriptor;
 template<class Module> LV2_Calf_Descriptor calf_plugins::lv2_wrapper<Module>::calf_descriptor;
 template<class Module> LV2_State_Interface calf_plugins::lv2_wrapper<Module>::state_iface;
+template<class Module> LV2_Worker_Interface calf_plugins::lv2_wrapper<Module>::worker_interface;
 
 extern "C" {
 
@@ -62,13 +63,11 @@ const LV2_Descriptor *lv2_descriptor(uint32_t index)
 
 #endif
 
-#if USE_JACK
-
 extern "C" {
 
 audio_module_iface *create_calf_plugin_by_name(const char *effect_name)
 {
-    #define PER_MODULE_ITEM(name, isSynth, jackname) if (!strcasecmp(effect_name, jackname)) return new name##_audio_module;
+    #define PER_MODULE_ITEM(name, isSynth, jackname) if (!strcasecmp(effect_name, jackname)) return new_audio_module<name##_audio_module>();
     #include <calf/modulelist.h>
     return NULL;
 }
@@ -81,5 +80,3 @@ plugin_metadata_iface *create_calf_metadata_by_name(const char *effect_name)
 }
 
 }
-
-#endif
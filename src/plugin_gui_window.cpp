@@ -20,6 +20,7 @@
  
 #include <calf/gui_config.h>
 #include <calf/gui_controls.h>
+#include <calf/gui_layout.h>
 #include <calf/preset.h>
 #include <calf/preset_gui.h>
 #include <gdk/gdk.h>
@@ -60,11 +61,11 @@ gboolean plugin_gui_widget::on_idle(void *data)
 void plugin_gui_widget::create_gui(plugin_ctl_iface *_jh)
 {
     gui = new plugin_gui(this);
-    const char *xml = _jh->get_metadata_iface()->get_gui_xml(prefix.c_str());
-    if (!xml) {
-        xml = "<hbox />";
-    }
-    container = gui->create_from_xml(_jh, xml);
+    const gui_layout *layout = get_gui_layout(prefix.c_str(), _jh->get_metadata_iface()->get_id());
+    if (layout)
+        container = gui->create_from_layout(_jh, layout);
+    else
+        container = gui->create_from_xml(_jh, "<hbox />");
     source_id = g_timeout_add_full(G_PRIORITY_DEFAULT, 1000/30, on_idle, this, NULL); // 30 fps should be enough for everybody
     gui->plugin->send_configures(gui);
 }
@@ -309,12 +310,13 @@ string plugin_gui_window::make_gui_preset_list(GtkActionGroup *grp, bool builtin
 {
     preset_access_iface *pai = gui->preset_access;
     string preset_xml = string(general_preset_pre_xml) + (builtin ? builtin_preset_pre_xml : user_preset_pre_xml);
-    preset_vector &pvec = (builtin ? get_builtin_presets() : get_user_presets()).presets;
+    preset_list &plist = builtin ? get_builtin_presets() : get_user_presets();
+    preset_vector &pvec = plist.presets;
     GtkActionGroup *preset_actions = builtin ? builtin_preset_actions : user_preset_actions;
-    for (unsigned int i = 0; i < pvec.size(); i++)
+    const vector<int> &indices = plist.get_indices_for_plugin(gui->effect_name);
+    for (unsigned int n = 0; n < indices.size(); n++)
     {
-        if (pvec[i].plugin != gui->effect_name)
-            continue;
+        int i = indices[n];
         stringstream ss;
         ss << (builtin ? "builtin_preset" : "user_preset") << i;
         preset_xml += "          <menuitem name=\"" + pvec[i].name+"\" action=\""+ss.str()+"\"/>\n";
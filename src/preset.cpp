@@ -25,6 +25,8 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <unistd.h>
+#include <stdint.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 
 using namespace std;
@@ -72,7 +74,7 @@ string plugin_preset::get_safe_name()
     return ss.str();
 }
 
-void plugin_preset::activate(plugin_ctl_iface *plugin)
+void plugin_preset::activate(plugin_ctl_iface *plugin) const
 {
     // First, clear everything to default values (in case some parameters or variables are missing)
     plugin->clear_preset();
@@ -348,7 +350,7 @@ bool preset_list::load_defaults(bool builtin, const std::string *pkglibdir_path)
         struct stat st;
         string name = preset_list::get_preset_filename(builtin, pkglibdir_path);
         if (!stat(name.c_str(), &st)) {
-            load(name.c_str(), false);
+            load_cached(name.c_str(), get_cache_filename(name));
             if (!presets.empty())
                 return true;
         }
@@ -426,22 +428,258 @@ void preset_list::save(const char *filename)
 
 void preset_list::get_for_plugin(preset_vector &vec, const char *plugin)
 {
-    for (unsigned int i = 0; i < presets.size(); i++)
+    const vector<int> &indices = get_indices_for_plugin(plugin);
+    for (unsigned int i = 0; i < indices.size(); i++)
+        vec.push_back(presets[indices[i]]);
+}
+
+void preset_list::update_index()
+{
+    if (indexed_count > presets.size())
+    {
+        plugin_index.clear();
+        name_index.clear();
+        indexed_count = 0;
+    }
+    for (; indexed_count < presets.size(); indexed_count++)
     {
-        if (presets[i].plugin == plugin)
-            vec.push_back(presets[i]);
+        const plugin_preset &p = presets[indexed_count];
+        plugin_index[p.plugin].push_back(indexed_count);
+        // the first of the presets with the same name wins, as in a linear search
+        name_index.insert(make_pair(p.plugin + '\0' + p.name, (int)indexed_count));
     }
 }
 
+const vector<int> &preset_list::get_indices_for_plugin(const std::string &plugin)
+{
+    static const vector<int> none;
+    update_index();
+    unordered_map<string, vector<int> >::const_iterator i = plugin_index.find(plugin);
+    return i != plugin_index.end() ? i->second : none;
+}
+
+int preset_list::find(const std::string &plugin, const std::string &name)
+{
+    update_index();
+    unordered_map<string, int>::const_iterator i = name_index.find(plugin + '\0' + name);
+    return i != name_index.end() ? i->second : -1;
+}
+
 void preset_list::add(const plugin_preset &sp)
 {
-    for (unsigned int i = 0; i < presets.size(); i++)
+    int i = find(sp.plugin, sp.name);
+    if (i != -1)
+        presets[i] = sp;
+    else
+        presets.push_back(sp);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+
+// Binary preset cache: a header followed by the presets, each stored as
+// bank, program, name, plugin, parameter count, (name, value) pairs, variable count, (key, value) pairs.
+// Strings are a 32-bit length followed by the characters. Native byte order - the cache is never
+// shared between machines; the header tells a cache made on a different architecture apart.
+
+struct preset_cache_header
+{
+    char magic[8];
+    uint32_t byte_order;
+    uint32_t count;
+    int64_t source_mtime, source_mtime_nsec;
+    uint64_t source_size;
+};
+
+static const char preset_cache_magic[8] = { 'C', 'A', 'L', 'F', 'P', 'R', 'C', '1' };
+
+static void fill_cache_header(preset_cache_header &hdr, const struct stat &source, uint32_t count)
+{
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, preset_cache_magic, sizeof(hdr.magic));
+    hdr.byte_order = 0x01020304;
+    hdr.count = count;
+    hdr.source_mtime = source.st_mtim.tv_sec;
+    hdr.source_mtime_nsec = source.st_mtim.tv_nsec;
+    hdr.source_size = source.st_size;
+}
+
+template<class T>
+static inline void cache_put(string &out, const T &value)
+{
+    out.append((const char *)&value, sizeof(value));
+}
+
+static inline void cache_put(string &out, const string &value)
+{
+    cache_put(out, (uint32_t)value.length());
+    out += value;
+}
+
+/// Bounds-checked reader of cache data
+struct preset_cache_reader
+{
+    const char *pos, *end;
+
+    template<class T>
+    inline bool get(T &value)
+    {
+        if ((size_t)(end - pos) < sizeof(value))
+            return false;
+        memcpy(&value, pos, sizeof(value));
+        pos += sizeof(value);
+        return true;
+    }
+    inline bool get(string &value)
     {
-        if (presets[i].plugin == sp.plugin && presets[i].name == sp.name)
+        uint32_t len;
+        if (!get(len) || (size_t)(end - pos) < len)
+            return false;
+        value.assign(pos, len);
+        pos += len;
+        return true;
+    }
+};
+
+string preset_list::get_cache_filename(const std::string &filename)
+{
+    const char *cache_home = getenv("XDG_CACHE_HOME");
+    string dir;
+    if (cache_home && *cache_home)
+        dir = cache_home;
+    else
+    {
+        const char *home = getenv("HOME");
+        if (!home)
+            return string();
+        dir = string(home) + "/.cache";
+    }
+    dir += "/calf";
+    // FNV-1a of the source file name, so that each preset file gets its own cache
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < filename.length(); i++)
+        hash = (hash ^ (uint8_t)filename[i]) * 1099511628211ULL;
+    char name[40];
+    sprintf(name, "/presets-%016llx.bin", (unsigned long long)hash);
+    return dir + name;
+}
+
+bool preset_list::load_cache(const char *cache_filename, const struct stat &source)
+{
+    int fd = open(cache_filename, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size < (off_t)sizeof(preset_cache_header))
+    {
+        close(fd);
+        return false;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    preset_cache_header hdr, expected;
+    memcpy(&hdr, map, sizeof(hdr));
+    fill_cache_header(expected, source, hdr.count);
+    preset_vector loaded;
+    bool ok = !memcmp(&hdr, &expected, sizeof(hdr));
+    if (ok)
+    {
+        preset_cache_reader r = { (const char *)map + sizeof(hdr), (const char *)map + st.st_size };
+        loaded.resize(hdr.count);
+        for (uint32_t i = 0; ok && i < hdr.count; i++)
         {
-            presets[i] = sp;
-            return;
+            plugin_preset &p = loaded[i];
+            uint32_t params, vars;
+            ok = r.get(p.bank) && r.get(p.program) && r.get(p.name) && r.get(p.plugin) && r.get(params) && params <= (uint32_t)(r.end - r.pos);
+            if (!ok)
+                break;
+            p.param_names.resize(params);
+            p.values.resize(params);
+            for (uint32_t j = 0; ok && j < params; j++)
+                ok = r.get(p.param_names[j]) && r.get(p.values[j]);
+            ok = ok && r.get(vars);
+            for (uint32_t j = 0; ok && j < vars; j++)
+            {
+                string key;
+                ok = r.get(key) && r.get(p.variables[key]);
+            }
         }
+        ok = ok && r.pos == r.end;
     }
-    presets.push_back(sp);
+    munmap(map, st.st_size);
+    if (!ok)
+        return false;
+
+    presets.reserve(presets.size() + loaded.size());
+    for (size_t i = 0; i < loaded.size(); i++)
+    {
+        // keep the DSSI program autonumbering going as if the XML file had been parsed
+        last_preset_ids[loaded[i].plugin] = loaded[i].bank * 128 + loaded[i].program;
+        presets.push_back(plugin_preset());
+        std::swap(presets.back(), loaded[i]);
+    }
+    return true;
+}
+
+bool preset_list::save_cache(const char *cache_filename, const struct stat &source)
+{
+    string data;
+    preset_cache_header hdr;
+    fill_cache_header(hdr, source, presets.size());
+    cache_put(data, hdr);
+    for (size_t i = 0; i < presets.size(); i++)
+    {
+        const plugin_preset &p = presets[i];
+        cache_put(data, p.bank);
+        cache_put(data, p.program);
+        cache_put(data, p.name);
+        cache_put(data, p.plugin);
+        cache_put(data, (uint32_t)p.values.size());
+        for (size_t j = 0; j < p.values.size(); j++)
+        {
+            cache_put(data, j < p.param_names.size() ? p.param_names[j] : string());
+            cache_put(data, p.values[j]);
+        }
+        cache_put(data, (uint32_t)p.variables.size());
+        for (map<string, string>::const_iterator j = p.variables.begin(); j != p.variables.end(); ++j)
+        {
+            cache_put(data, j->first);
+            cache_put(data, j->second);
+        }
+    }
+
+    // create the cache directory (and its parent) if needed
+    string dir = cache_filename;
+    dir.erase(dir.rfind('/'));
+    mkdir(dir.substr(0, dir.rfind('/')).c_str(), 0755);
+    mkdir(dir.c_str(), 0755);
+    // write to a temporary file and rename, so that other processes never see a partial cache
+    string tmpname = string(cache_filename) + "." + i2s(getpid());
+    int fd = open(tmpname.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+    bool ok = (size_t)write(fd, data.data(), data.length()) == data.length();
+    ok = !close(fd) && ok;
+    if (ok && !rename(tmpname.c_str(), cache_filename))
+        return true;
+    unlink(tmpname.c_str());
+    return false;
+}
+
+bool preset_list::load_cached(const char *filename, const std::string &cache_filename)
+{
+    struct stat st;
+    if (stat(filename, &st))
+        throw preset_exception("Could not load the presets from ", filename, errno);
+    // the cache holds the presets of a single file, so it's only usable when nothing was loaded before
+    bool use_cache = !cache_filename.empty() && presets.empty();
+    if (use_cache && load_cache(cache_filename.c_str(), st))
+        return true;
+    load(filename, false);
+    // failure to write the cache is not an error - it only makes the next start slower
+    if (use_cache && !save_cache(cache_filename.c_str(), st))
+        fprintf(stderr, "Warning: could not write the preset cache %s\n", cache_filename.c_str());
+    return false;
 }
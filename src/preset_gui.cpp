@@ -68,12 +68,9 @@ void gui_preset_access::store_preset()
     GtkTreeModel *model = GTK_TREE_MODEL(gtk_list_store_new(1, G_TYPE_STRING));
     gtk_combo_box_set_model(GTK_COMBO_BOX(preset_name_combo), model);
     gtk_combo_box_set_entry_text_column(GTK_COMBO_BOX(preset_name_combo), 0);
-    for(preset_vector::const_iterator i = get_user_presets().presets.begin(); i != get_user_presets().presets.end(); ++i)
-    {
-        if (i->plugin != gui->effect_name)
-            continue;
-        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(preset_name_combo), i->name.c_str());
-    }
+    const vector<int> &indices = get_user_presets().get_indices_for_plugin(gui->effect_name);
+    for (size_t i = 0; i < indices.size(); ++i)
+        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(preset_name_combo), get_user_presets().presets[indices[i]].name.c_str());
     int response = gtk_dialog_run(GTK_DIALOG(store_preset_dlg));
 
     plugin_preset sp;
@@ -94,16 +91,7 @@ void gui_preset_access::store_preset()
         {
             tmp = get_user_presets();
         }
-        bool found = false;
-        for(preset_vector::const_iterator i = tmp.presets.begin(); i != tmp.presets.end(); ++i)
-        {
-            if (i->plugin == gui->effect_name && i->name == sp.name)
-            {
-                found = true;
-                break;
-            }
-        }
-        if (found)
+        if (tmp.find(gui->effect_name, sp.name) != -1)
         {
             GtkWidget *dialog = gtk_message_dialog_new(GTK_WINDOW(gui->window->toplevel), GTK_DIALOG_DESTROY_WITH_PARENT, GTK_MESSAGE_QUESTION, GTK_BUTTONS_OK_CANCEL, 
                 "Preset '%s' already exists. Overwrite?", sp.name.c_str());
@@ -0,0 +1,554 @@
+/* Calf DSP Library
+ * Offline renderer - processes audio files through a chain of Calf plugins.
+ *
+ * Copyright (C) 2001-2010 Krzysztof Foltman, Markus Schmidt, Thor Harald Johansen and others
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+#include <calf/giface.h>
+#include <calf/preset.h>
+#include <calf/utils.h>
+#include <calf/wavfile.h>
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace calf_utils;
+using namespace calf_plugins;
+
+extern "C" audio_module_iface *create_calf_plugin_by_name(const char *effect_name);
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// Host for a single plugin instance, processing memory buffers instead of JACK ports
+class render_host: public plugin_ctl_iface
+{
+public:
+    audio_module_iface *module;
+    const plugin_metadata_iface *metadata;
+    float **ins, **outs, **params;
+    vector<float> param_values;
+    /// Parameters modified since the last params_changed call
+    param_mask dirty_params;
+    bool changed;
+    int in_count, out_count, param_count;
+
+    render_host(audio_module_iface *_module, uint32_t sample_rate);
+    ~render_host();
+    /// Process len samples (any length) from the given input buffers into the given output buffers
+    void process(float *const *inputs, float *const *outputs, uint32_t len);
+
+    // Implementations of methods in plugin_ctl_iface
+    virtual float get_param_value(int param_no) { return param_values[param_no]; }
+    virtual void set_param_value(int param_no, float value)
+    {
+        param_values[param_no] = value;
+        dirty_params.set(param_no);
+        changed = true;
+    }
+    virtual bool activate_preset(int bank, int program) { return false; }
+    virtual float get_level(unsigned int port) { return 0.f; }
+    virtual void execute(int cmd_no) { module->execute(cmd_no); }
+    virtual char *configure(const char *key, const char *value) { return module->configure(key, value); }
+    virtual void send_configures(send_configure_iface *sci) { module->send_configures(sci); }
+    virtual int send_status_updates(send_updates_iface *sui, int last_serial) { return module->send_status_updates(sui, last_serial); }
+    virtual const plugin_metadata_iface *get_metadata_iface() const { return metadata; }
+    virtual const line_graph_iface *get_line_graph_iface() const { return module->get_line_graph_iface(); }
+    virtual const phase_graph_iface *get_phase_graph_iface() const { return module->get_phase_graph_iface(); }
+};
+
+render_host::render_host(audio_module_iface *_module, uint32_t sample_rate)
+: module(_module)
+{
+    module->get_port_arrays(ins, outs, params);
+    metadata = module->get_metadata_iface();
+    in_count = metadata->get_input_count();
+    out_count = metadata->get_output_count();
+    param_count = metadata->get_param_count();
+    param_values.resize(param_count);
+    for (int i = 0; i < param_count; i++)
+        params[i] = &param_values[i];
+    clear_preset();
+    module->post_instantiate(sample_rate);
+    module->set_sample_rate(sample_rate);
+    module->activate();
+    module->params_changed();
+    dirty_params.clear();
+    changed = false;
+}
+
+render_host::~render_host()
+{
+    module->deactivate();
+    delete module;
+}
+
+void render_host::process(float *const *inputs, float *const *outputs, uint32_t len)
+{
+    if (changed)
+    {
+        module->params_changed(dirty_params);
+        dirty_params.clear();
+        changed = false;
+    }
+    for (int i = 0; i < in_count; i++)
+        ins[i] = inputs[i];
+    for (int i = 0; i < out_count; i++)
+        outs[i] = outputs[i];
+    uint32_t mask = module->process_slice(0, len);
+    for (int i = 0; i < out_count; i++)
+    {
+        if (!(mask & (1 << i)))
+            dsp::zero(outputs[i], len);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// One plugin in the processing chain, as given on the command line or loaded from a calfjackhost session file
+struct chain_item
+{
+    /// Plugin name (same as for calfjackhost)
+    string name;
+    /// Preset name (looked up in built-in presets first, then user presets), or empty
+    string preset;
+    /// Full state (from calfjackhost session files)
+    plugin_preset state;
+    bool has_state;
+    /// Individual parameters set from the command line (name or short name, value)
+    vector<pair<string, string> > settings;
+
+    chain_item() : has_state(false) {}
+};
+
+struct render_options
+{
+    vector<chain_item> chain;
+    string output;
+    /// Frames processed per block
+    uint32_t block_size;
+    /// Extra seconds of silence processed after the end of each input file (for reverb/delay tails)
+    float tail;
+    /// Output sample size: 0 = 32-bit float, 16 or 24 = integer PCM
+    int bits;
+    int jobs;
+    bool quiet;
+
+    render_options() : block_size(65536), tail(0), bits(0), jobs(1), quiet(false) {}
+};
+
+/// Result of rendering a single file
+struct render_stats
+{
+    uint64_t frames;
+    uint32_t sample_rate;
+    double wall_time, cpu_time;
+    string error;
+    render_stats() : frames(0), sample_rate(0), wall_time(0), cpu_time(0) {}
+};
+
+static double get_time(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/// Plugin construction and preset lookup touch shared state - done one chain at a time
+static ptmutex instantiate_mutex;
+
+static void instantiate_chain(const vector<chain_item> &chain, uint32_t sample_rate, vector<render_host *> &hosts)
+{
+    ptlock lock(instantiate_mutex);
+    for (size_t i = 0; i < chain.size(); i++)
+    {
+        const chain_item &item = chain[i];
+        audio_module_iface *module = create_calf_plugin_by_name(item.name.c_str());
+        if (!module)
+            throw text_exception("Unknown plugin: " + item.name);
+        render_host *host = new render_host(module, sample_rate);
+        hosts.push_back(host);
+        if (item.has_state)
+            const_cast<plugin_preset &>(item.state).activate(host);
+        if (!item.preset.empty())
+        {
+            bool found = false;
+            for (int builtin = 1; builtin >= 0 && !found; builtin--)
+            {
+                preset_vector &pvec = (builtin ? get_builtin_presets() : get_user_presets()).presets;
+                for (size_t j = 0; j < pvec.size() && !found; j++)
+                {
+                    if (pvec[j].name == item.preset && pvec[j].plugin == host->metadata->get_id())
+                    {
+                        pvec[j].activate(host);
+                        found = true;
+                    }
+                }
+            }
+            if (!found)
+                throw text_exception("Unknown preset: " + item.preset + " for plugin " + item.name);
+        }
+        for (size_t j = 0; j < item.settings.size(); j++)
+        {
+            int param_no = -1;
+            for (int k = 0; k < host->param_count; k++)
+            {
+                const parameter_properties *props = host->metadata->get_param_props(k);
+                if (item.settings[j].first == props->short_name || item.settings[j].first == props->name)
+                    param_no = k;
+            }
+            if (param_no == -1)
+                throw text_exception("Unknown parameter: " + item.settings[j].first + " for plugin " + item.name);
+            host->set_param_value(param_no, atof(item.settings[j].second.c_str()));
+        }
+    }
+}
+
+static void render_file(const string &input, const string &output, const render_options &opts, render_stats &stats)
+{
+    double start_wall = get_time(CLOCK_MONOTONIC), start_cpu = get_time(CLOCK_THREAD_CPUTIME_ID);
+    wav_reader reader;
+    reader.open(input);
+    stats.sample_rate = reader.format.sample_rate;
+
+    vector<render_host *> hosts;
+    try {
+        instantiate_chain(opts.chain, reader.format.sample_rate, hosts);
+
+        uint32_t block = opts.block_size;
+        int nch = reader.format.channels;
+        // buffers[0] = file input, buffers[i + 1] = outputs of plugin i
+        vector<vector<float> > storage;
+        vector<vector<float *> > buffers(hosts.size() + 1);
+        storage.resize(nch);
+        for (int c = 0; c < nch; c++)
+        {
+            storage[c].resize(block);
+            buffers[0].push_back(&storage[c][0]);
+        }
+        // plugin inputs take consecutive channels of the previous stage (wrapping around, so mono files feed both inputs of stereo plugins)
+        vector<vector<float *> > inputs(hosts.size());
+        for (size_t i = 0; i < hosts.size(); i++)
+        {
+            const vector<float *> &prev = buffers[i];
+            for (int j = 0; j < hosts[i]->in_count; j++)
+                inputs[i].push_back(prev[j % prev.size()]);
+            for (int j = 0; j < hosts[i]->out_count; j++)
+            {
+                storage.push_back(vector<float>(block));
+                buffers[i + 1].push_back(&storage.back()[0]);
+            }
+            if (buffers[i + 1].empty())
+                throw text_exception("Plugin " + opts.chain[i].name + " has no audio outputs");
+        }
+        // storage may have been reallocated while adding buffers - refresh the pointers
+        for (size_t i = 0, s = 0; i < buffers.size(); i++)
+            for (size_t j = 0; j < buffers[i].size(); j++)
+                buffers[i][j] = &storage[s++][0];
+        for (size_t i = 0; i < hosts.size(); i++)
+            for (int j = 0; j < hosts[i]->in_count; j++)
+                inputs[i][j] = buffers[i][j % buffers[i].size()];
+
+        const vector<float *> &result = buffers.back();
+        wav_format out_format = reader.format;
+        out_format.channels = result.size();
+        out_format.is_float = !opts.bits;
+        out_format.bits = opts.bits ? opts.bits : 32;
+        wav_writer writer;
+        writer.open(output, out_format);
+
+        uint64_t tail_left = (uint64_t)(opts.tail * reader.format.sample_rate);
+        while(true)
+        {
+            uint32_t len = reader.read(&buffers[0][0], block);
+            if (len < block && tail_left)
+            {
+                uint32_t extra = std::min<uint64_t>(tail_left, block - len);
+                for (int c = 0; c < nch; c++)
+                    dsp::zero(buffers[0][c] + len, extra);
+                len += extra;
+                tail_left -= extra;
+            }
+            if (!len)
+                break;
+            for (size_t i = 0; i < hosts.size(); i++)
+                hosts[i]->process(&inputs[i][0], &buffers[i + 1][0], len);
+            writer.write(&result[0], len);
+            stats.frames += len;
+        }
+        writer.close();
+    }
+    catch(...)
+    {
+        for (size_t i = 0; i < hosts.size(); i++)
+            delete hosts[i];
+        throw;
+    }
+    for (size_t i = 0; i < hosts.size(); i++)
+        delete hosts[i];
+    stats.wall_time = get_time(CLOCK_MONOTONIC) - start_wall;
+    stats.cpu_time = get_time(CLOCK_THREAD_CPUTIME_ID) - start_cpu;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct render_queue
+{
+    const render_options *opts;
+    vector<string> inputs, outputs;
+    vector<render_stats> stats;
+    size_t next;
+    ptmutex mutex;
+};
+
+static void *render_thread(void *arg)
+{
+    render_queue *queue = (render_queue *)arg;
+    dsp::denormal_guard ftz;
+    while(true)
+    {
+        size_t job;
+        {
+            ptlock lock(queue->mutex);
+            if (queue->next >= queue->inputs.size())
+                break;
+            job = queue->next++;
+        }
+        render_stats &stats = queue->stats[job];
+        try {
+            render_file(queue->inputs[job], queue->outputs[job], *queue->opts, stats);
+        }
+        catch(std::exception &e)
+        {
+            stats.error = e.what();
+        }
+        ptlock lock(queue->mutex);
+        if (!stats.error.empty())
+            fprintf(stderr, "%s: %s\n", queue->inputs[job].c_str(), stats.error.c_str());
+        else if (!queue->opts->quiet && stats.sample_rate)
+        {
+            double duration = stats.frames / (double)stats.sample_rate;
+            printf("%s -> %s: %.1f s of audio in %.2f s (%.1fx realtime, %.1fx by CPU time)\n", queue->inputs[job].c_str(), queue->outputs[job].c_str(),
+                duration, stats.wall_time, duration / stats.wall_time, stats.cpu_time > 0 ? duration / stats.cpu_time : 0);
+        }
+    }
+    return NULL;
+}
+
+static struct option long_options[] = {
+    {"help", 0, 0, 'h'},
+    {"version", 0, 0, 'v'},
+    {"list", 0, 0, 'L'},
+    {"plugin", 1, 0, 'p'},
+    {"set", 1, 0, 's'},
+    {"load", 1, 0, 'l'},
+    {"output", 1, 0, 'o'},
+    {"jobs", 1, 0, 'j'},
+    {"block", 1, 0, 'b'},
+    {"bits", 1, 0, 'B'},
+    {"tail", 1, 0, 't'},
+    {"quiet", 0, 0, 'q'},
+    {0,0,0,0},
+};
+
+static const char *short_options = "hvLp:s:l:o:j:b:B:t:q";
+
+static void print_help(char *argv[])
+{
+    printf("Offline renderer for Calf effects\n"
+        "Syntax: %s [--plugin, -p <name>[:<preset>]] [--set, -s <param>=<value>] [--load, -l <session>]\n"
+        "       [--output, -o <file or directory>] [--jobs, -j <count>] [--block, -b <frames>] [--bits, -B 16|24|32]\n"
+        "       [--tail, -t <seconds>] [--quiet, -q] [--help, -h] [--version, -v] [--list, -L] input.wav ...\n"
+        "Plugins are processed in the order given; --set applies to the most recently added plugin.\n"
+        "A calfjackhost session file (--load) appends its whole rack to the chain.\n",
+        argv[0]);
+}
+
+static string base_name(const string &path)
+{
+    size_t pos = path.rfind('/');
+    return pos == string::npos ? path : path.substr(pos + 1);
+}
+
+int main(int argc, char *argv[])
+{
+    render_options opts;
+    opts.jobs = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+    vector<string> session_files;
+    while(1)
+    {
+        int option_index;
+        int c = getopt_long(argc, argv, short_options, long_options, &option_index);
+        if (c == -1)
+            break;
+        switch(c) {
+            case 'h':
+            case '?':
+                print_help(argv);
+                return 0;
+            case 'v':
+                printf("%s\n", PACKAGE_STRING);
+                return 0;
+            case 'L':
+            {
+                string s =
+                #define PER_MODULE_ITEM(name, isSynth, jackname) jackname " "
+                #include <calf/modulelist.h>
+                ;
+                if (!s.empty())
+                    s = s.substr(0, s.length() - 1);
+                printf("%s\n", s.c_str());
+                return 0;
+            }
+            case 'p':
+            {
+                chain_item item;
+                item.name = optarg;
+                size_t pos = item.name.find(":");
+                if (pos != string::npos) {
+                    item.preset = item.name.substr(pos + 1);
+                    item.name = item.name.substr(0, pos);
+                }
+                opts.chain.push_back(item);
+                break;
+            }
+            case 's':
+            {
+                string s = optarg;
+                size_t pos = s.find("=");
+                if (opts.chain.empty() || pos == string::npos)
+                {
+                    fprintf(stderr, "--set needs a plugin and a <param>=<value> argument\n");
+                    return 1;
+                }
+                opts.chain.back().settings.push_back(make_pair(s.substr(0, pos), s.substr(pos + 1)));
+                break;
+            }
+            case 'l':
+            {
+                preset_list pl;
+                try {
+                    pl.load(optarg, true);
+                }
+                catch(preset_exception &e)
+                {
+                    fprintf(stderr, "%s\n", e.what());
+                    return 1;
+                }
+                for (size_t i = 0; i < pl.plugins.size(); i++)
+                {
+                    chain_item item;
+                    item.name = pl.plugins[i].type;
+                    if (pl.plugins[i].preset_offset < (int)pl.presets.size())
+                    {
+                        item.state = pl.presets[pl.plugins[i].preset_offset];
+                        item.has_state = true;
+                    }
+                    opts.chain.push_back(item);
+                }
+                break;
+            }
+            case 'o':
+                opts.output = optarg;
+                break;
+            case 'j':
+                opts.jobs = std::max(1, atoi(optarg));
+                break;
+            case 'b':
+                opts.block_size = std::max(1, atoi(optarg));
+                break;
+            case 'B':
+                opts.bits = atoi(optarg);
+                if (opts.bits == 32)
+                    opts.bits = 0;
+                if (opts.bits != 0 && opts.bits != 16 && opts.bits != 24)
+                {
+                    fprintf(stderr, "Unsupported output sample size: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 't':
+                opts.tail = std::max(0.0, atof(optarg));
+                break;
+            case 'q':
+                opts.quiet = true;
+                break;
+        }
+    }
+    if (opts.chain.empty() || optind >= argc || opts.output.empty())
+    {
+        print_help(argv);
+        return 1;
+    }
+    try {
+        get_builtin_presets().load_defaults(true);
+        get_user_presets().load_defaults(false);
+    }
+    catch(calf_plugins::preset_exception &e)
+    {
+        fprintf(stderr, "Error while loading presets: %s\n", e.what());
+        return 1;
+    }
+
+    render_queue queue;
+    queue.opts = &opts;
+    queue.next = 0;
+    struct stat st;
+    bool to_dir = stat(opts.output.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+    for (int i = optind; i < argc; i++)
+    {
+        queue.inputs.push_back(argv[i]);
+        queue.outputs.push_back(to_dir ? opts.output + "/" + base_name(argv[i]) : opts.output);
+        if (queue.outputs.back() == queue.inputs.back())
+        {
+            fprintf(stderr, "Refusing to overwrite the input file %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (!to_dir && queue.inputs.size() > 1)
+    {
+        fprintf(stderr, "Output must be an existing directory when rendering more than one file\n");
+        return 1;
+    }
+    queue.stats.resize(queue.inputs.size());
+
+    double start = get_time(CLOCK_MONOTONIC);
+    int jobs = std::min<int>(opts.jobs, queue.inputs.size());
+    vector<pthread_t> threads(jobs);
+    for (int i = 0; i < jobs; i++)
+        pthread_create(&threads[i], NULL, render_thread, &queue);
+    for (int i = 0; i < jobs; i++)
+        pthread_join(threads[i], NULL);
+    double elapsed = get_time(CLOCK_MONOTONIC) - start;
+
+    double total_audio = 0;
+    int failed = 0;
+    for (size_t i = 0; i < queue.stats.size(); i++)
+    {
+        if (!queue.stats[i].error.empty())
+            failed++;
+        else if (queue.stats[i].sample_rate)
+            total_audio += queue.stats[i].frames / (double)queue.stats[i].sample_rate;
+    }
+    if (!opts.quiet)
+        printf("Rendered %d file(s), %.1f s of audio in %.2f s using %d thread(s): %.1fx realtime\n", (int)queue.inputs.size() - failed, total_audio, elapsed, jobs, elapsed > 0 ? total_audio / elapsed : 0);
+    return failed ? 1 : 0;
+}
@@ -31,6 +31,7 @@ shaping_clipper::shaping_clipper(int sample_rate, int fft_size, float clip_level
     this->adaptive_distortion_strength = 1.0;
     this->overlap = fft_size / 4;
     this->pffft = pffft_new_setup(fft_size, PFFFT_REAL);
+    this->kernels = &dsp::get_kernels();
 
     // The psy masking calculation is O(n^2),
     // so skip it for frequencies not covered by base sampling rantes (i.e. 44k)
@@ -48,6 +49,15 @@ shaping_clipper::shaping_clipper(int sample_rate, int fft_size, float clip_level
 
     this->in_frame.resize(fft_size);
     this->out_dist_frame.resize(fft_size);
+    this->frame_pos = 0;
+    this->last_iterations = 0;
+    this->spread_trim = false;
+    this->scratch = (float*)pffft_aligned_malloc(sizeof(float) * (fft_size * 4 + fft_size / 2 + 1));
+    this->windowed_frame = this->scratch;
+    this->clipping_delta = this->scratch + fft_size;
+    this->spectrum_buf = this->scratch + fft_size * 2;
+    this->fft_work = this->scratch + fft_size * 3;
+    this->mask_curve = this->scratch + fft_size * 4;
     this->margin_curve.resize(fft_size / 2 + 1);
     // normally I use __builtin_ctz for this but the intrinsic is different for
     // different compilers.
@@ -66,6 +76,7 @@ shaping_clipper::shaping_clipper(int sample_rate, int fft_size, float clip_level
 
 shaping_clipper::~shaping_clipper() {
     pffft_destroy_setup(this->pffft);
+    pffft_aligned_free(this->scratch);
 }
 
 int shaping_clipper::get_feed_size() {
@@ -80,38 +91,37 @@ void shaping_clipper::set_iterations(int iterations) {
     this->iterations = iterations;
 }
 
+void shaping_clipper::set_spread_trim(bool trim) {
+    this->spread_trim = trim;
+    generate_spread_table();
+}
+
 void shaping_clipper::set_adaptive_distortion_strength(float strength) {
     this->adaptive_distortion_strength = strength;
 }
 
 void shaping_clipper::feed(const float* in_samples, float* out_samples, bool diff_only, float* total_margin_shift) {
-    // shift in/out buffers
-    for (int i = 0; i < this->size - this->overlap; i++) {
-        this->in_frame[i] = this->in_frame[i + this->overlap];
-        this->out_dist_frame[i] = this->out_dist_frame[i + this->overlap];
-    }
+    // replace the oldest block of the rings with the new one (the distortion of which isn't known yet)
     for (int i = 0; i < this->overlap; i++) {
-        this->in_frame[i + this->size - this->overlap] = in_samples[i];
-        this->out_dist_frame[i + this->size - this->overlap] = 0;
+        this->in_frame[this->frame_pos + i] = in_samples[i];
+        this->out_dist_frame[this->frame_pos + i] = 0;
     }
+    this->frame_pos = (this->frame_pos + this->overlap) % this->size;
 
     float peak;
-    float* windowed_frame = (float*)alloca(sizeof(float) * this->size);
-    float* clipping_delta = (float*)alloca(sizeof(float) * this->size);
-    float* spectrum_buf = (float*)alloca(sizeof(float) * this->size);
-    float* mask_curve = (float*)alloca(sizeof(float) * this->size / 2 + 1);
+    float* windowed_frame = this->windowed_frame;
+    float* clipping_delta = this->clipping_delta;
+    float* spectrum_buf = this->spectrum_buf;
+    float* mask_curve = this->mask_curve;
 
-    apply_window(this->in_frame.data(), windowed_frame);
-    pffft_transform_ordered(this->pffft, windowed_frame, spectrum_buf, NULL, PFFFT_FORWARD);
+    apply_window_ring(this->in_frame.data(), windowed_frame, false);
+    pffft_transform_ordered(this->pffft, windowed_frame, spectrum_buf, this->fft_work, PFFFT_FORWARD);
     calculate_mask_curve(spectrum_buf, mask_curve);
 
     // It would be easier to calculate the peak from the unwindowed input.
     // This is just for consistency with the clipped peak calculateion
     // because the inv_window zeros out samples on the edge of the window.
-    float orig_peak = 0;
-    for (int i = 0; i < this->size; i++) {
-        orig_peak = std::max<float>(orig_peak, std::abs(windowed_frame[i] * inv_window[i]));
-    }
+    float orig_peak = kernels->peak_mul(windowed_frame, inv_window.data(), this->size);
     orig_peak /= this->clip_level;
     peak = orig_peak;
 
@@ -124,8 +134,12 @@ void shaping_clipper::feed(const float* in_samples, float* out_samples, bool dif
         *total_margin_shift = 1.0;
     }
 
-    // repeat clipping-filtering process a few times to control both the peaks and the spectrum
-    for (int i = 0; i < this->iterations; i++) {
+    // repeat clipping-filtering process a few times to control both the peaks and the spectrum,
+    // until the peaks are within the clip level (the following iterations wouldn't change anything
+    // but the mask_curve, whose value isn't used after the last iteration)
+    this->last_iterations = 0;
+    for (int i = 0; i < this->iterations && peak > 1.0; i++) {
+        this->last_iterations++;
         // The last 1/3 of rounds have boosted delta to help reach the peak target faster
         float delta_boost = 1.0;
         if (i >= this->iterations - this->iterations / 3) {
@@ -136,19 +150,15 @@ void shaping_clipper::feed(const float* in_samples, float* out_samples, bool dif
 	}
         clip_to_window(windowed_frame, clipping_delta, delta_boost);
 
-        pffft_transform_ordered(this->pffft, clipping_delta, spectrum_buf, NULL, PFFFT_FORWARD);
+        pffft_transform_ordered(this->pffft, clipping_delta, spectrum_buf, this->fft_work, PFFFT_FORWARD);
 
         limit_clip_spectrum(spectrum_buf, mask_curve);
 
-        pffft_transform_ordered(this->pffft, spectrum_buf, clipping_delta, NULL, PFFFT_BACKWARD);
+        pffft_transform_ordered(this->pffft, spectrum_buf, clipping_delta, this->fft_work, PFFFT_BACKWARD);
         // see pffft.h
-        for (int i = 0; i < this->size; i++) {
-            clipping_delta[i] /= this->size;
-        }
+        kernels->scale(clipping_delta, 1.f / this->size, this->size);
 
-        peak = 0;
-        for (int i = 0; i < this->size; i++)
-            peak = std::max<float>(peak, std::abs((windowed_frame[i] + clipping_delta[i]) * inv_window[i]));
+        peak = kernels->peak_sum_mul(windowed_frame, clipping_delta, inv_window.data(), this->size);
         peak /= this->clip_level;
 
         // Automatically adjust mask_curve as necessary to reach peak target
@@ -179,19 +189,22 @@ void shaping_clipper::feed(const float* in_samples, float* out_samples, bool dif
 
         // Be less strict in the next iteration.
         // This helps with peak control.
-        for (int i = 0; i < this->size / 2 + 1; i++) {
-            mask_curve[i] *= mask_curve_shift;
-        }
+        kernels->scale(mask_curve, mask_curve_shift, this->size / 2 + 1);
     }
 
     // do overlap & add
-    apply_window(clipping_delta, this->out_dist_frame.data(), true);
+    if (this->last_iterations) {
+        apply_window_ring(clipping_delta, this->out_dist_frame.data(), true);
+    }
 
+    // the oldest block is complete now
+    const float* dist = this->out_dist_frame.data() + this->frame_pos;
+    const float* in = this->in_frame.data() + this->frame_pos;
     for (int i = 0; i < this->overlap; i++) {
-        out_samples[i] = this->out_dist_frame[i] / 1.5;
+        out_samples[i] = dist[i] / 1.5;
         // 4 times overlap with squared hanning window results in 1.5 time increase in amplitude
         if (!diff_only) {
-            out_samples[i] += this->in_frame[i];
+            out_samples[i] += in[i];
         }
     }
 }
@@ -245,6 +258,18 @@ void shaping_clipper::generate_spread_table() {
             this->spread_table[base_idx + this->num_psy_bins / 2 + j - bin] /= sum;
         }
 
+        // optionally, only use the part within 60dB of the peak (the peak is at j == bin);
+        // the rest changes the mask curve by a few thousandths of a dB but makes up most of the work
+        if (this->spread_trim) {
+            float threshold = this->spread_table[base_idx + this->num_psy_bins / 2] * 1e-3;
+            while (start_bin < bin && this->spread_table[base_idx + this->num_psy_bins / 2 + start_bin - bin] < threshold) {
+                start_bin++;
+            }
+            while (end_bin - 1 > bin && this->spread_table[base_idx + this->num_psy_bins / 2 + end_bin - 1 - bin] < threshold) {
+                end_bin--;
+            }
+        }
+
         this->spread_table_range[table_index] = std::make_pair(start_bin - bin, end_bin - bin);
 
         int next_bin;
@@ -293,29 +318,30 @@ void shaping_clipper::set_margin_curve(int points[][2], int num_points) {
 }
 
 void shaping_clipper::apply_window(const float* in_frame, float* out_frame, const bool add_to_out_frame) {
-    const float* window = this->window.data();
-    for (int i = 0; i < this->size; i++) {
-        if (add_to_out_frame) {
-            out_frame[i] += in_frame[i] * window[i];
-        } else {
-            out_frame[i] = in_frame[i] * window[i];
-        }
+    if (add_to_out_frame) {
+        kernels->mul_add(out_frame, in_frame, this->window.data(), this->size);
+    } else {
+        kernels->mul(out_frame, in_frame, this->window.data(), this->size);
     }
 }
 
-void shaping_clipper::clip_to_window(const float* windowed_frame, float* clipping_delta, float delta_boost) {
+void shaping_clipper::apply_window_ring(const float* in_frame, float* out_frame, bool to_ring) {
+    // the frame is [frame_pos, size) followed by [0, frame_pos) of the ring
+    int first = this->size - this->frame_pos;
     const float* window = this->window.data();
-    for (int i = 0; i < this->size; i++) {
-        float limit = this->clip_level * window[i];
-        float effective_value = windowed_frame[i] + clipping_delta[i];
-        if (effective_value > limit) {
-            clipping_delta[i] += (limit - effective_value) * delta_boost;
-        } else if (effective_value < -limit) {
-            clipping_delta[i] += (-limit - effective_value) * delta_boost;
-        }
+    if (to_ring) {
+        kernels->mul_add(out_frame + this->frame_pos, in_frame, window, first);
+        kernels->mul_add(out_frame, in_frame + first, window + first, this->frame_pos);
+    } else {
+        kernels->mul(out_frame, in_frame + this->frame_pos, window, first);
+        kernels->mul(out_frame + first, in_frame, window + first, this->frame_pos);
     }
 }
 
+void shaping_clipper::clip_to_window(const float* windowed_frame, float* clipping_delta, float delta_boost) {
+    kernels->clip_to_limit(windowed_frame, clipping_delta, this->window.data(), this->clip_level, delta_boost, this->size);
+}
+
 void shaping_clipper::calculate_mask_curve(const float* spectrum, float* mask_curve) {
     for (int i = 0; i < this->size / 2 + 1; i++) {
         mask_curve[i] = 0;
@@ -337,8 +363,8 @@ void shaping_clipper::calculate_mask_curve(const float* spectrum, float* mask_cu
         int base_idx = table_idx * this->num_psy_bins;
         int start_bin = std::max(0, i + range.first);
         int end_bin = std::min(this->num_psy_bins, i + range.second);
-        for (int j = start_bin; j < end_bin; j++) {
-            mask_curve[j] += this->spread_table[base_idx + this->num_psy_bins / 2 + j - i] * magnitude;
+        if (end_bin > start_bin) {
+            kernels->axpy(mask_curve + start_bin, &this->spread_table[base_idx + this->num_psy_bins / 2 + start_bin - i], magnitude, end_bin - start_bin);
         }
     }
 
@@ -368,18 +394,10 @@ void shaping_clipper::limit_clip_spectrum(float* clip_spectrum, const float* mas
         clip_spectrum[0] /= relative_distortion_level;
     }
     // bin 1..N/2-1
-    for (int i = 1; i < this->size / 2; i++) {
-        float real = clip_spectrum[i * 2];
-        float imag = clip_spectrum[i * 2 + 1];
-        // although the negative frequencies are omitted because they are redundant,
-        // the magnitude of the positive frequencies are not doubled.
-        // Multiply the magnitude by 2 to simulate adding up the + and - frequencies.
-        relative_distortion_level = abs(std::complex<float>(real, imag)) * 2 / mask_curve[i];
-        if (relative_distortion_level > 1.0) {
-            clip_spectrum[i * 2] /= relative_distortion_level;
-            clip_spectrum[i * 2 + 1] /= relative_distortion_level;
-        }
-    }
+    // although the negative frequencies are omitted because they are redundant,
+    // the magnitude of the positive frequencies are not doubled.
+    // The kernel multiplies the magnitude by 2 to simulate adding up the + and - frequencies.
+    kernels->limit_complex(clip_spectrum + 2, mask_curve + 1, this->size / 2 - 1);
     // bin N/2
     relative_distortion_level = std::abs(clip_spectrum[1]) / mask_curve[this->size / 2];
     if (relative_distortion_level > 1.0) {
@@ -23,11 +23,25 @@
 using namespace dsp;
 using namespace std;
 
-void basic_synth::init_voices(int count)
+basic_synth::basic_synth()
+{
+    for (int c = 0; c < steal_class_count; c++)
+    {
+        steal_lists[c].head = steal_lists[c].tail = NULL;
+        steal_lists[c].count = 0;
+    }
+}
+
+void basic_synth::init_voice_arrays(int count)
 {
     allocated_voices.init(count);
     active_voices.init(count);
     unused_voices.init(count);
+}
+
+void basic_synth::init_voices(int count)
+{
+    init_voice_arrays(count);
     for (int i = 0; i < count; i++)
     {
         dsp::voice *v = alloc_voice();
@@ -36,12 +50,59 @@ void basic_synth::init_voices(int count)
     }
 }
 
+void basic_synth::unlink_stealable(dsp::voice *v)
+{
+    if (v->steal_class == -1)
+        return;
+    steal_list &list = steal_lists[v->steal_class];
+    if (v->steal_prev)
+        v->steal_prev->steal_next = v->steal_next;
+    else
+        list.head = v->steal_next;
+    if (v->steal_next)
+        v->steal_next->steal_prev = v->steal_prev;
+    else
+        list.tail = v->steal_prev;
+    list.count--;
+    v->steal_prev = v->steal_next = NULL;
+    v->steal_class = -1;
+}
+
+void basic_synth::update_steal_class(dsp::voice *v, float priority)
+{
+    int sc = priority < 10 ? steal_released : (priority < 150 ? steal_playing : (priority < 10000 ? steal_sostenuto : -1));
+    if (sc == v->steal_class)
+        return;
+    unlink_stealable(v);
+    if (sc == -1)
+        return;
+    steal_list &list = steal_lists[sc];
+    v->steal_class = sc;
+    v->steal_prev = list.tail;
+    v->steal_next = NULL;
+    if (list.tail)
+        list.tail->steal_next = v;
+    else
+        list.head = v;
+    list.tail = v;
+    list.count++;
+}
+
+basic_synth::voice_array::iterator basic_synth::release_voice(voice_array::iterator i)
+{
+    dsp::voice *v = *i;
+    unlink_stealable(v);
+    unused_voices.add(v);
+    return active_voices.erase(i);
+}
+
 void basic_synth::kill_note(int note, int vel, bool just_one)
 {
     for_all_voices(it) {
         // preserve sostenuto notes
         if ((*it)->get_current_note() == note && !(sostenuto && (*it)->sostenuto)) {
             (*it)->note_off(vel);
+            update_steal_class(*it, (*it)->get_priority());
             if (just_one)
                 return;
         }
@@ -63,34 +124,25 @@ dsp::voice *basic_synth::give_voice()
 
 void basic_synth::steal_voice()
 {
-    dsp::voice *found = NULL;
-    float priority = 10000;
-    //int idx = 0;
-    for_all_voices(i)
+    // the oldest voice of the lowest priority class
+    for (int c = 0; c < steal_class_count; c++)
     {
-        //printf("Voice %d priority %f at %p\n", idx++, (*i)->get_priority(), *i);
-        if ((*i)->get_priority() < priority)
+        dsp::voice *found = steal_lists[c].head;
+        if (found)
         {
-            priority = (*i)->get_priority();
-            found = *i;
+            found->steal();
+            update_steal_class(found, found->get_priority());
+            return;
         }
     }
-    //printf("Found: %p\n\n", *found);
-    if (!found)
-        return;
-    
-    found->steal();
 }
 
 void basic_synth::trim_voices()
 {
     // count stealable voices
     unsigned int count = 0;
-    for_all_voices(i)
-    {
-        if ((*i)->get_priority() < 10000)
-            count++;
-    }
+    for (int c = 0; c < steal_class_count; c++)
+        count += steal_lists[c].count;
     // printf("Count=%d limit=%d\n", count, polyphony_limit);
     // steal any voices above polyphony limit
     if (count > polyphony_limit) {
@@ -115,6 +167,7 @@ void basic_synth::note_on(int note, int vel)
     gate.set(note);
     v->note_on(note, vel);
     active_voices.add(v);
+    update_steal_class(v, v->get_priority());
     if (perc) {
         percussion_note_on(note, vel);
     }
@@ -150,6 +203,7 @@ void basic_synth::on_pedal_release()
             (*i)->released = true;
             (*i)->note_off(127);
         }
+        update_steal_class(*i, (*i)->get_priority());
     }
 }
 
@@ -169,6 +223,7 @@ void basic_synth::control_change(int ctl, int val)
             // SOSTENUTO was pressed - move all notes onto sustain stack
             for_all_voices(i) {
                 (*i)->sostenuto = true;
+                update_steal_class(*i, (*i)->get_priority());
             }
         }
         if (!sostenuto && prev) {
@@ -187,6 +242,7 @@ void basic_synth::control_change(int ctl, int val)
                 (*i)->note_off(127);
             else
                 (*i)->steal();
+            update_steal_class(*i, (*i)->get_priority());
         }
     }
     if (ctl == 121) { 
@@ -207,10 +263,10 @@ void basic_synth::render_to(float (*output)[2], int nsamples)
         dsp::voice *v = *i;
         v->render_to(output, nsamples);
         if (!v->get_active()) {
-            i = active_voices.erase(i);
-            unused_voices.add(v);
+            i = release_voice(i);
             continue;
         }
+        update_steal_class(v, v->get_priority());
         i++;
     }
 } 
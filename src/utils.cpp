@@ -24,6 +24,8 @@
 #include <cstring>
 #include <cstdio>
 #include <sstream>
+#include <algorithm>
+#include <unistd.h>
 #ifdef _MSC_VER
 #include <windows.h>
 #endif
@@ -187,6 +189,8 @@ vector <direntry> list_directory(const string &path)
     DIR *dir;
     struct dirent *ent;
     dir = opendir(path.empty() ? "." : path.c_str());
+    if (!dir)
+        return out;
     while ((ent = readdir(dir)) != NULL) {
         direntry f;
         const string file_name = ent->d_name;
@@ -201,4 +205,54 @@ vector <direntry> list_directory(const string &path)
     return out;
 }
 #endif
+
+struct parallel_for_state
+{
+    void (*job)(void *arg, int index);
+    void *arg;
+    int count, next;
+    ptmutex mutex;
+};
+
+static void *parallel_for_thread(void *arg)
+{
+    parallel_for_state *state = (parallel_for_state *)arg;
+    while(true)
+    {
+        int index;
+        {
+            ptlock lock(state->mutex);
+            if (state->next >= state->count)
+                break;
+            index = state->next++;
+        }
+        state->job(state->arg, index);
+    }
+    return NULL;
+}
+
+void parallel_for(int count, void (*job)(void *arg, int index), void *arg, int max_threads)
+{
+    parallel_for_state state;
+    state.job = job;
+    state.arg = arg;
+    state.count = count;
+    state.next = 0;
+    if (max_threads <= 0)
+        max_threads = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+    // the calling thread takes part too
+    int threads = std::min(max_threads, count) - 1;
+    vector<pthread_t> ids(std::max(threads, 0));
+    for (int i = 0; i < threads; i++)
+    {
+        if (pthread_create(&ids[i], NULL, parallel_for_thread, &state))
+        {
+            ids.resize(i);
+            break;
+        }
+    }
+    parallel_for_thread(&state);
+    for (size_t i = 0; i < ids.size(); i++)
+        pthread_join(ids[i], NULL);
+}
 }
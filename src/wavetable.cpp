@@ -25,7 +25,11 @@
     
 #include <calf/giface.h>
 #include <calf/modules_synths.h>
+#include <calf/fft.h>
 #include <iostream>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 FORWARD_DECLARE_METADATA(wavetable)
 
@@ -33,6 +37,142 @@ using namespace dsp;
 using namespace calf_plugins;
 using namespace std;
 
+const int wavetable_mipmap::level_bits[wavetable_mipmap::Levels] = { 9, 8, 7, 7, 6, 5, 5, 5 };
+const int wavetable_mipmap::level_offsets[wavetable_mipmap::Levels] = { 1, 516, 775, 906, 1037, 1104, 1139, 1174 };
+
+wavetable_mipmap::wavetable_mipmap(const int16_t (*tables)[129][256], int count)
+{
+    typedef std::complex<float> cfloat;
+    static dsp::fft<float, 9> fft;
+    cfloat src[256], spectrum[256], bins[512], out[512];
+    data.resize(count * Slices * SliceSize);
+    for (int w = 0; w < count; w++)
+    {
+        for (int s = 0; s < Slices; s++)
+        {
+            for (int i = 0; i < 256; i++)
+                src[i] = cfloat(tables[w][s][i] * (1.0 / 32768.0), 0);
+            fft.calculateN(src, spectrum, false, 8);
+            float *slice = &data[(w * Slices + s) * SliceSize];
+            for (int l = 0; l < Levels; l++)
+            {
+                int bits = level_bits[l], len = 1 << bits;
+                // harmonic 128 of the original is its Nyquist frequency, which has no phase information
+                int harmonics = std::min<int>(MaxHarmonics >> l, 127);
+                float scale = len / 256.0;
+                for (int i = 0; i < len; i++)
+                    bins[i] = 0;
+                bins[0] = spectrum[0] * scale;
+                for (int h = 1; h <= harmonics; h++)
+                {
+                    bins[h] = spectrum[h] * scale;
+                    bins[len - h] = spectrum[256 - h] * scale;
+                }
+                fft.calculateN(bins, out, true, bits);
+                float *table = slice + level_offsets[l];
+                for (int i = 0; i < len; i++)
+                    table[i] = out[i].real();
+                // wrap-around samples for the interpolator
+                table[-1] = table[len - 1];
+                table[len] = table[0];
+                table[len + 1] = table[1];
+                assert(level_offsets[l] + len + 2 == (l < Levels - 1 ? level_offsets[l + 1] - 1 : (int)SliceSize));
+            }
+        }
+    }
+}
+
+const wavetable_mipmap &wavetable_mipmap::get_shared(const int16_t (*tables)[129][256], int count)
+{
+    static wavetable_mipmap shared(tables, count);
+    return shared;
+}
+
+/// 4-point cubic Hermite interpolation between x0 and x1
+static inline float hermite(float xm1, float x0, float x1, float x2, float frac)
+{
+    float c1 = 0.5f * (x1 - xm1);
+    float c2 = xm1 - 2.5f * x0 + 2.f * x1 - 0.5f * x2;
+    float c3 = 0.5f * (x2 - xm1) + 1.5f * (x0 - x1);
+    return ((c3 * frac + c2) * frac + c1) * frac + x0;
+}
+
+#if defined(__SSE2__)
+static inline __m128 hermite(__m128 xm1, __m128 x0, __m128 x1, __m128 x2, __m128 frac)
+{
+    __m128 c1 = _mm_mul_ps(_mm_set1_ps(0.5f), _mm_sub_ps(x1, xm1));
+    __m128 c2 = _mm_sub_ps(_mm_add_ps(xm1, _mm_add_ps(x1, x1)), _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.5f), x0), _mm_mul_ps(_mm_set1_ps(0.5f), x2)));
+    __m128 c3 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(0.5f), _mm_sub_ps(x2, xm1)), _mm_mul_ps(_mm_set1_ps(1.5f), _mm_sub_ps(x0, x1)));
+    return _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(c3, frac), c2), frac), c1), frac), x0);
+}
+#endif
+
+void wavetable_oscillator::render_add(float *out, int count, float shift, float shift_step, float amp, float amp_step)
+{
+    int level = wavetable_mipmap::get_level(phasedelta);
+    int bits = wavetable_mipmap::level_bits[level];
+    const float *base = mips + wavetable_mipmap::level_offsets[level];
+    const float max_shift = 127 * 256;
+    const float fracscale = 1.0f / (1 << 23);
+    int i = 0;
+#if defined(__SSE2__)
+    // 4 samples at a time; the table lookups are scalar, everything else is vectorized
+    __m128i ph = _mm_setr_epi32(phase, phase + phasedelta, phase + 2 * phasedelta, phase + 3 * phasedelta);
+    __m128i ph_step = _mm_set1_epi32(4 * phasedelta);
+    __m128i pos_shift = _mm_cvtsi32_si128(32 - bits), frac_shift = _mm_cvtsi32_si128(bits);
+    __m128 sh = _mm_setr_ps(shift, shift + shift_step, shift + 2 * shift_step, shift + 3 * shift_step);
+    __m128 sh_step = _mm_set1_ps(4 * shift_step);
+    __m128 am = _mm_setr_ps(amp, amp + amp_step, amp + 2 * amp_step, amp + 3 * amp_step);
+    __m128 am_step = _mm_set1_ps(4 * amp_step);
+    for (; i + 4 <= count; i += 4)
+    {
+        int pos[4] __attribute__((aligned(16))), slice[4] __attribute__((aligned(16)));
+        // [tap][lane] for the lower and the upper slice
+        float a[4][4] __attribute__((aligned(16))), b[4][4] __attribute__((aligned(16)));
+        __m128i si = _mm_cvtps_epi32(_mm_max_ps(_mm_setzero_ps(), _mm_min_ps(_mm_set1_ps(max_shift), sh)));
+        _mm_store_si128((__m128i *)pos, _mm_srl_epi32(ph, pos_shift));
+        _mm_store_si128((__m128i *)slice, _mm_srli_epi32(si, 8));
+        for (int k = 0; k < 4; k++)
+        {
+            const float *w1 = base + slice[k] * wavetable_mipmap::SliceSize + pos[k];
+            const float *w2 = w1 + wavetable_mipmap::SliceSize;
+            for (int t = 0; t < 4; t++)
+            {
+                a[t][k] = w1[t - 1];
+                b[t][k] = w2[t - 1];
+            }
+        }
+        __m128 frac = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(_mm_sll_epi32(ph, frac_shift), 9)), _mm_set1_ps(fracscale));
+        __m128 sfrac = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(si, _mm_set1_epi32(255))), _mm_set1_ps(1.0f / 256));
+        __m128 va = hermite(_mm_load_ps(a[0]), _mm_load_ps(a[1]), _mm_load_ps(a[2]), _mm_load_ps(a[3]), frac);
+        __m128 vb = hermite(_mm_load_ps(b[0]), _mm_load_ps(b[1]), _mm_load_ps(b[2]), _mm_load_ps(b[3]), frac);
+        __m128 v = _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), sfrac));
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(v, am)));
+        ph = _mm_add_epi32(ph, ph_step);
+        sh = _mm_add_ps(sh, sh_step);
+        am = _mm_add_ps(am, am_step);
+    }
+    phase += i * phasedelta;
+    shift += i * shift_step;
+    amp += i * amp_step;
+#endif
+    for (; i < count; i++)
+    {
+        int si = fastf2i_drm(dsp::clip(shift, 0.f, max_shift));
+        const float *w1 = base + (si >> 8) * wavetable_mipmap::SliceSize + (phase >> (32 - bits));
+        const float *w2 = w1 + wavetable_mipmap::SliceSize;
+        float frac = ((phase << bits) >> 9) * fracscale;
+        float v1 = hermite(w1[-1], w1[0], w1[1], w1[2], frac);
+        float v2 = hermite(w2[-1], w2[0], w2[1], w2[2], frac);
+        out[i] += amp * dsp::lerp(v1, v2, (si & 255) * (1.0f / 256));
+        phase += phasedelta;
+        shift += shift_step;
+        amp += amp_step;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
 wavetable_voice::wavetable_voice()
 {
     sample_rate = -1;
@@ -91,11 +231,17 @@ void wavetable_voice::steal()
 }
 
 void wavetable_voice::render_block(int current_snapshot)
+{
+    float modsrc[wavetable_metadata::modsrc_count];
+    update_modsrc(modsrc);
+    parent->calculate_modmatrix(moddest, wavetable_metadata::moddest_count, modsrc);
+    render_modulated_block(current_snapshot);
+}
+
+void wavetable_voice::update_modsrc(float *modsrc)
 {
     typedef wavetable_metadata md;
     
-    const float step = 1.f / BlockSize;
-
     float s = 0.001;
     float scl[EnvCount];
     int espc = md::par_eg2attack - md::par_eg1attack;
@@ -114,14 +260,24 @@ void wavetable_voice::render_block(int current_snapshot)
     lfo1.last = lfo1.get();
     lfo2.last = lfo2.get();
 
-    float modsrc[wavetable_metadata::modsrc_count] = { 1.f, velocity, parent->inertia_pressure.get_last(), parent->modwheel_value, (float)envs[0].value * scl[0], (float)envs[1].value * scl[1], (float)envs[2].value * scl[2], 0.5f+0.5f*lfo1.last, 0.5f+0.5f*lfo2.last, dsp::clip<float>(note / 120.0, 0.f, 1.f)};
-    parent->calculate_modmatrix(moddest, md::moddest_count, modsrc);
-    calc_derived_dests(envs[0].value * scl[0] * scl[0]);
+    float values[md::modsrc_count] = { 1.f, velocity, parent->inertia_pressure.get_last(), parent->modwheel_value, (float)envs[0].value * scl[0], (float)envs[1].value * scl[1], (float)envs[2].value * scl[2], 0.5f+0.5f*lfo1.last, 0.5f+0.5f*lfo2.last, dsp::clip<float>(note / 120.0, 0.f, 1.f)};
+    memcpy(modsrc, values, sizeof(values));
+    env0_scaled = envs[0].value * scl[0] * scl[0];
+}
+
+void wavetable_voice::render_modulated_block(int current_snapshot)
+{
+    typedef wavetable_metadata md;
+    
+    const float step = 1.f / BlockSize;
+    calc_derived_dests(env0_scaled);
 
     int ospc = md::par_o2level - md::par_o1level;
     float pb = moddest[md::moddest_pitch] + parent->control_snapshots[current_snapshot].pitchbend;
     for (int j = 0; j < OscCount; j++) {
-        oscs[j].tables = parent->tables[(int)*params[md::par_o1wave + j * ospc]];
+        int wave = (int)*params[md::par_o1wave + j * ospc];
+        oscs[j].tables = parent->tables[wave];
+        oscs[j].mips = parent->mipmaps->get_wave(wave);
         oscs[j].set_freq(note_to_hz(note, *params[md::par_o1transpose + j * ospc] * 100+ *params[md::par_o1detune + j * ospc] + moddest[md::moddest_o1detune + j] + pb), sample_rate);
     }
         
@@ -129,20 +285,17 @@ void wavetable_voice::render_block(int current_snapshot)
     for (int j = 0; j < OscCount; j++) {
         oscshift[j] += *params[md::par_o1offset + j * ospc] * 100;
     }
-    float osstep[2] = { (oscshift[0] - last_oscshift[0]) * step, (oscshift[1] - last_oscshift[1]) * step };
-    float oastep[2] = { (cur_oscamp[0] - last_oscamp[0]) * step, (cur_oscamp[1] - last_oscamp[1]) * step };
-    for (int i = 0; i < BlockSize; i++) {        
-        float value = 0.f;
-
-        for (int j = 0; j < OscCount; j++) {
-            float o = last_oscshift[j] * 0.01;
-            value += last_oscamp[j] * oscs[j].get(dsp::clip(fastf2i_drm(o * 127.0 * 256), 0, 127 * 256));
-            last_oscshift[j] += osstep[j];
-            last_oscamp[j] += oastep[j];
-        }
-        
-        output_buffer[i][0] = output_buffer[i][1] = value;
+    float buffer[BlockSize];
+    dsp::zero(buffer, BlockSize);
+    // shift is in percent, the oscillator takes slice * 256
+    const float shift_scale = 0.01 * 127.0 * 256;
+    for (int j = 0; j < OscCount; j++) {
+        float osstep = (oscshift[j] - last_oscshift[j]) * step;
+        float oastep = (cur_oscamp[j] - last_oscamp[j]) * step;
+        oscs[j].render_add(buffer, BlockSize, last_oscshift[j] * shift_scale, osstep * shift_scale, last_oscamp[j], oastep);
     }
+    for (int i = 0; i < BlockSize; i++)
+        output_buffer[i][0] = output_buffer[i][1] = buffer[i];
     if (envs[0].stopped())
         released = true;
     memcpy(last_oscshift, oscshift, sizeof(oscshift));
@@ -216,11 +369,13 @@ wavetable_audio_module::wavetable_audio_module()
 , inertia_pitchbend(64)
 , inertia_pressure(64)
 {
-    init_voices(36);
-    last_voice = (wavetable_voice *)allocated_voices.items[0];
+    init_pool(36);
+    last_voice = &pool[0];
 
     panic_flag = false;
     modwheel_value = 0.;
+    // voices pick up controller changes once per block
+    event_granularity = wavetable_voice::BlockSize;
     for (int i = 0; i < 129; i += 8)
     {
         for (int j = 0; j < 256; j++)
@@ -593,6 +748,88 @@ wavetable_audio_module::wavetable_audio_module()
             tables[wavetable_metadata::wt_multi2][i][j] = 32767 * v / tv;
         }
     }
+    mipmaps = &wavetable_mipmap::get_shared(tables, wt_count);
+}
+
+void wavetable_audio_module::render_voices(float (*output)[2], int nsamples)
+{
+    typedef dsp::block_voice<wavetable_voice> block_voice;
+    enum { BlockSize = wavetable_voice::BlockSize, MaxVoices = 64 };
+    if ((int)active_voices.size() > MaxVoices)
+    {
+        pooled_synth::render_to(output, nsamples);
+        return;
+    }
+    // Same as block_voice::render_to for each voice, but done in rounds - in each round, every voice
+    // renders at most one block, and the modulation matrix is evaluated for all of them at once
+    float modsrc[modsrc_count][MaxVoices], moddest[moddest_count][MaxVoices];
+    block_voice *voices[MaxVoices], *rendered[MaxVoices];
+    int pos[MaxVoices], snapshot[MaxVoices];
+    int count = 0;
+    for (dsp::voice **i = active_voices.begin(); i != active_voices.end(); i++)
+    {
+        voices[count] = static_cast<block_voice *>(*i);
+        pos[count] = snapshot[count] = 0;
+        count++;
+    }
+    bool more = true;
+    while(more)
+    {
+        int nrendered = 0;
+        for (int v = 0; v < count; v++)
+        {
+            block_voice *voice = voices[v];
+            if (pos[v] >= nsamples || voice->read_ptr < (unsigned int)BlockSize)
+                continue;
+            float values[modsrc_count];
+            voice->update_modsrc(values);
+            for (int j = 0; j < modsrc_count; j++)
+                modsrc[j][nrendered] = values[j];
+            rendered[nrendered++] = voice;
+        }
+        if (nrendered)
+        {
+            calculate_modmatrix_voices(&moddest[0][0], moddest_count, &modsrc[0][0], MaxVoices, nrendered);
+            for (int v = 0; v < nrendered; v++)
+            {
+                float *dest = rendered[v]->get_moddest();
+                for (int j = 0; j < moddest_count; j++)
+                    dest[j] = moddest[j][v];
+            }
+        }
+        more = false;
+        for (int v = 0; v < count; v++)
+        {
+            block_voice *voice = voices[v];
+            if (pos[v] >= nsamples)
+                continue;
+            if (voice->read_ptr == (unsigned int)BlockSize)
+            {
+                voice->render_modulated_block(snapshot[v]++);
+                voice->read_ptr = 0;
+            }
+            int ncopy = std::min<int>(BlockSize - voice->read_ptr, nsamples - pos[v]);
+            float (*src)[2] = voice->output_buffer + voice->read_ptr;
+            for (int i = 0; i < ncopy; i++)
+            {
+                output[pos[v] + i][0] += src[i][0];
+                output[pos[v] + i][1] += src[i][1];
+            }
+            pos[v] += ncopy;
+            voice->read_ptr += ncopy;
+            if (pos[v] < nsamples)
+                more = true;
+        }
+    }
+    for (dsp::voice **i = active_voices.begin(); i != active_voices.end(); ) {
+        block_voice *v = static_cast<block_voice *>(*i);
+        if (!v->block_voice::get_active()) {
+            i = release_voice(i);
+            continue;
+        }
+        update_steal_class(v, v->block_voice::get_priority());
+        i++;
+    }
 }
 
 void wavetable_audio_module::channel_pressure(int /*channel*/, int value)
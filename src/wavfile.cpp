@@ -0,0 +1,262 @@
+/* Calf DSP Library
+ * WAV file reading and writing.
+ *
+ * Copyright (C) 2001-2010 Krzysztof Foltman, Markus Schmidt, Thor Harald Johansen and others
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <calf/utils.h>
+#include <calf/wavfile.h>
+#include <algorithm>
+#include <fcntl.h>
+#include <math.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace calf_utils;
+
+static inline uint16_t get_le16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+static inline uint32_t get_le32(const uint8_t *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+static inline void put_le16(uint8_t *p, uint16_t v) { p[0] = v; p[1] = v >> 8; }
+static inline void put_le32(uint8_t *p, uint32_t v) { p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24; }
+
+void wav_reader::open(const string &filename)
+{
+    fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd == -1)
+        throw file_exception(filename);
+    struct stat st;
+    if (fstat(fd, &st) == -1)
+        throw file_exception(filename);
+    map_size = st.st_size;
+    if (map_size < 12)
+        throw file_exception(filename, "file too short to be a WAV file");
+    map = (uint8_t *)mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        map = NULL;
+        throw file_exception(filename);
+    }
+    madvise(map, map_size, MADV_SEQUENTIAL);
+    if (memcmp(map, "RIFF", 4) || memcmp(map + 8, "WAVE", 4))
+        throw file_exception(filename, "not a RIFF/WAVE file");
+    const uint8_t *end = map + map_size;
+    const uint8_t *chunk = map + 12;
+    uint64_t data_size = 0;
+    while(chunk + 8 <= end)
+    {
+        uint32_t size = get_le32(chunk + 4);
+        const uint8_t *body = chunk + 8;
+        if (!memcmp(chunk, "fmt ", 4) && size >= 16 && body + 16 <= end)
+        {
+            uint16_t tag = get_le16(body);
+            format.channels = get_le16(body + 2);
+            format.sample_rate = get_le32(body + 4);
+            format.bits = get_le16(body + 14);
+            // WAVE_FORMAT_EXTENSIBLE - the actual format tag is the first two bytes of the subformat GUID
+            if (tag == 0xFFFE && size >= 40 && body + 40 <= end)
+                tag = get_le16(body + 24);
+            if (tag == 3)
+                format.is_float = true;
+            else if (tag != 1)
+                throw file_exception(filename, "unsupported WAV format tag " + i2s(tag));
+        }
+        else if (!memcmp(chunk, "data", 4))
+        {
+            data = body;
+            // some writers leave the size at 0 or 0xFFFFFFFF when streaming
+            data_size = (size == 0 || size == 0xFFFFFFFF || body + size > end) ? end - body : size;
+            break;
+        }
+        chunk = body + size + (size & 1);
+    }
+    if (!format.channels || !data)
+        throw file_exception(filename, "no fmt or data chunk");
+    bool valid = format.is_float ? (format.bits == 32 || format.bits == 64) : (format.bits == 8 || format.bits == 16 || format.bits == 24 || format.bits == 32);
+    if (!valid)
+        throw file_exception(filename, "unsupported sample size " + i2s(format.bits));
+    frames = data_size / format.frame_bytes();
+    pos = 0;
+    prefetched = 0;
+}
+
+void wav_reader::close()
+{
+    if (map)
+        munmap(map, map_size);
+    if (fd != -1)
+        ::close(fd);
+    map = NULL;
+    fd = -1;
+}
+
+uint32_t wav_reader::read(float **channels, uint32_t len)
+{
+    if (pos + len > frames)
+        len = frames - pos;
+    int nch = format.channels, fb = format.frame_bytes();
+    // Ask for the next two blocks to be paged in while this one is being processed
+    uint64_t ahead = std::min<uint64_t>(frames, pos + 3 * (uint64_t)len);
+    if (ahead > prefetched)
+    {
+        uint64_t page = sysconf(_SC_PAGESIZE);
+        uintptr_t from = ((uintptr_t)(data + std::max(prefetched, pos) * fb)) & ~(page - 1);
+        uintptr_t to = (uintptr_t)(data + ahead * fb);
+        madvise((void *)from, to - from, MADV_WILLNEED);
+        prefetched = ahead;
+    }
+    const uint8_t *src = data + pos * fb;
+    for (uint32_t i = 0; i < len; i++)
+    {
+        for (int c = 0; c < nch; c++)
+        {
+            float value;
+            switch(format.bits)
+            {
+            case 8:
+                value = (src[0] - 128) * (1.f / 128);
+                src += 1;
+                break;
+            case 16:
+                value = (int16_t)get_le16(src) * (1.f / 32768);
+                src += 2;
+                break;
+            case 24:
+                value = ((int32_t)((src[0] << 8) | (src[1] << 16) | ((uint32_t)src[2] << 24)) >> 8) * (1.f / 8388608);
+                src += 3;
+                break;
+            case 32:
+            {
+                uint32_t v = get_le32(src);
+                if (format.is_float)
+                {
+                    float f;
+                    memcpy(&f, &v, 4);
+                    value = f;
+                }
+                else
+                    value = (int32_t)v * (1.f / 2147483648.f);
+                src += 4;
+                break;
+            }
+            default: // 64-bit float
+            {
+                double d;
+                memcpy(&d, src, 8);
+                value = d;
+                src += 8;
+                break;
+            }
+            }
+            channels[c][i] = value;
+        }
+    }
+    pos += len;
+    return len;
+}
+
+void wav_reader::read_all(vector<vector<float> > &channels)
+{
+    uint32_t len = frames - pos;
+    channels.resize(format.channels);
+    vector<float *> ptrs(format.channels);
+    for (int c = 0; c < format.channels; c++)
+    {
+        channels[c].resize(len);
+        ptrs[c] = &channels[c][0];
+    }
+    if (len)
+        read(&ptrs[0], len);
+}
+
+void wav_writer::open(const string &_filename, const wav_format &_format)
+{
+    filename = _filename;
+    format = _format;
+    frames = 0;
+    f = fopen(filename.c_str(), "wb");
+    if (!f)
+        throw file_exception(filename);
+    // large stdio buffer, the data is written in big blocks anyway
+    setvbuf(f, NULL, _IOFBF, 1 << 20);
+    write_header();
+}
+
+void wav_writer::write_header()
+{
+    uint8_t hdr[44];
+    uint64_t data_size = frames * format.frame_bytes();
+    // sizes that do not fit are left at the maximum, like most other tools do
+    uint32_t data_size32 = data_size > 0xFFFFFFFFULL - 36 ? 0xFFFFFFFFU - 36 : data_size;
+    memcpy(hdr, "RIFF", 4);
+    put_le32(hdr + 4, 36 + data_size32);
+    memcpy(hdr + 8, "WAVEfmt ", 8);
+    put_le32(hdr + 16, 16);
+    put_le16(hdr + 20, format.is_float ? 3 : 1);
+    put_le16(hdr + 22, format.channels);
+    put_le32(hdr + 24, format.sample_rate);
+    put_le32(hdr + 28, format.sample_rate * format.frame_bytes());
+    put_le16(hdr + 32, format.frame_bytes());
+    put_le16(hdr + 34, format.bits);
+    memcpy(hdr + 36, "data", 4);
+    put_le32(hdr + 40, data_size32);
+    if (fwrite(hdr, sizeof(hdr), 1, f) != 1)
+        throw file_exception(filename);
+}
+
+void wav_writer::write(float *const *channels, uint32_t len)
+{
+    int nch = format.channels, bytes = format.bits / 8;
+    buffer.resize((size_t)len * format.frame_bytes());
+    uint8_t *dst = &buffer[0];
+    for (uint32_t i = 0; i < len; i++)
+    {
+        for (int c = 0; c < nch; c++)
+        {
+            float value = channels[c][i];
+            if (format.is_float)
+                memcpy(dst, &value, 4);
+            else
+            {
+                float scale = bytes == 2 ? 32767.f : 8388607.f;
+                int32_t v = lrintf(std::max(-1.f, std::min(1.f, value)) * scale);
+                dst[0] = v;
+                dst[1] = v >> 8;
+                if (bytes == 3)
+                    dst[2] = v >> 16;
+            }
+            dst += bytes;
+        }
+    }
+    if (len && fwrite(&buffer[0], buffer.size(), 1, f) != 1)
+        throw file_exception(filename);
+    frames += len;
+}
+
+void wav_writer::close()
+{
+    if (!f)
+        return;
+    if (fseek(f, 0, SEEK_SET) == 0)
+        write_header();
+    if (fclose(f))
+        throw file_exception(filename);
+    f = NULL;
+}
+